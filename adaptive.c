@@ -0,0 +1,60 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-6-22 10:05:12
+ * @Last modified: 2025-6-22 10:05:12
+ * @Description: adaptive sampling interval controller, fast attack and
+ *               exponential back off. a quiet process costs about as much as a
+ *               max_ms sampler, a burst is followed at min_ms resolution.
+ */
+
+#include "include/memtrc.h"
+#include "include/adaptive.h"
+
+
+int adaptive_init(adaptive_t *a, int min_ms, int max_ms) {
+    if (!a || min_ms <= 0 || max_ms < min_ms) {
+        fprintf(stderr, "Error: invalid adaptive interval bounds %d:%d\n", min_ms, max_ms);
+        return -1;
+    }
+    memset(a, 0, sizeof(adaptive_t));
+    a->min_ms = min_ms;
+    a->max_ms = max_ms;
+    a->cur_ms = min_ms;     //start fast until the process has shown its pace
+    return 0;
+}
+
+
+/*
+ * feed one RSS sample, return the interval to the next one. volatile means the
+ * last step moved RSS by more than the noise floor, or the rate's recent
+ * deviation would move it that far within one min_ms interval. the horizon is
+ * fixed on purpose: scaling it with cur_ms would re-trigger while backing off.
+ */
+int adaptive_next(adaptive_t *a, long long ts_ms, long value) {
+    if (!a) return ADAPTIVE_MAX_MS;
+    a->samples++;
+    if (a->cur_ms == a->min_ms) a->fast_samples++;
+
+    if (a->primed && ts_ms > a->last_ts) {
+        long delta = value - a->last_value;
+        double rate = (double)delta / (ts_ms - a->last_ts);
+        double diff = rate - a->rate_mean;
+        a->rate_mean += ADAPTIVE_ALPHA * diff;
+        a->rate_var = (1 - ADAPTIVE_ALPHA) * (a->rate_var + ADAPTIVE_ALPHA * diff * diff);
+
+        //noise floor scales with the process so huge heaps don't chase page churn
+        long noise = value / 256 > ADAPTIVE_NOISE_BYTES ? value / 256 : ADAPTIVE_NOISE_BYTES;
+        int moved = labs(delta) >= noise;
+        int noisy = sqrt(a->rate_var) * a->min_ms >= noise;
+        if (moved || noisy) {
+            a->cur_ms = a->min_ms;
+        } else {
+            a->cur_ms = a->cur_ms * 2 > a->max_ms ? a->max_ms : a->cur_ms * 2;
+        }
+    }
+    a->primed = 1;
+    a->last_ts = ts_ms;
+    a->last_value = value;
+    a->total_ms += a->cur_ms;
+    return a->cur_ms;
+}
@@ -0,0 +1,317 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-7-9 21:03:37
+ * @Last modified: 2025-7-9 21:03:37
+ * @Description: memtrc side of the allocation profiler. drains the target's
+ *               per-thread rings once per tick, orders the events by sequence
+ *               (a block may be freed by another thread than the one that
+ *               allocated it) and keeps estimated live bytes per call site.
+ *               frames are shown as module+offset from the target's maps.
+ */
+
+#include "include/memtrc.h"
+#include "include/allocprof.h"
+#include "include/topn.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#define BLOCK_SLOTS   (ALLOCPROF_ADDR_SLOTS * 2)
+#define BLOCK_EMPTY   0
+#define BLOCK_DELETED 1
+#define MAP_ENTRIES   512
+
+
+int allocprof_attach(allocprof_t *ap, pid_t pid) {
+    if (!ap || pid <= 0) {
+        fprintf(stderr, "Error: Invalid arguments to allocprof_attach()\n");
+        return -1;
+    }
+    memset(ap, 0, sizeof(allocprof_t));
+    char name[64];
+    snprintf(name, sizeof(name), ALLOCPROF_SHM_FMT, (int)pid);
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        fprintf(stderr, "No allocation profile for %d (%s), start it with "
+                "LD_PRELOAD=libmemtrc_preload.so\n", pid, strerror(errno));
+        return -1;
+    }
+    void *map = mmap(NULL, sizeof(allocprof_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Failed to map allocation profile of %d: %s\n", pid, strerror(errno));
+        return -1;
+    }
+    ap->shm = map;
+    if (memcmp(ap->shm->magic, ALLOCPROF_MAGIC, 4) != 0 ||
+        ap->shm->version != ALLOCPROF_VERSION || ap->shm->nrings != ALLOCPROF_RINGS) {
+        fprintf(stderr, "Allocation profile of %d has another layout\n", pid);
+        allocprof_detach(ap);
+        return -1;
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    ap->pid = pid;
+    ap->sites = calloc(ALLOCPROF_SITES, sizeof(allocprof_site_t));
+    ap->blocks = calloc(BLOCK_SLOTS, sizeof(allocprof_block_t));
+    ap->batch = malloc(ALLOCPROF_RINGS * ALLOCPROF_RING_EVENTS * sizeof(allocprof_event_t));
+    ap->pending = malloc(ALLOCPROF_PENDING * sizeof(allocprof_pending_t));
+    if (!ap->sites || !ap->blocks || !ap->batch || !ap->pending) {
+        fprintf(stderr, "Error: out of memory for the allocation profile\n");
+        allocprof_detach(ap);
+        return -1;
+    }
+    return 0;
+}
+
+
+static inline uint64_t mix(uint64_t h, uint64_t v) {
+    h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    return h;
+}
+
+
+//site of a stack, the last slot takes every stack once the table is full
+static uint32_t site_of(allocprof_t *ap, const allocprof_event_t *ev) {
+    uint64_t h = 1469598103934665603ULL;
+    for (uint32_t i = 0; i < ev->depth; i++) h = mix(h, ev->frames[i]);
+    if (h == 0) h = 1;
+    const uint32_t usable = ALLOCPROF_SITES - 1;
+    for (uint32_t i = 0; i < usable; i++) {
+        allocprof_site_t *s = &ap->sites[(h + i) % usable];
+        if (s->hash == h) return (h + i) % usable;
+        if (s->hash == 0) {
+            s->hash = h;
+            s->depth = ev->depth;
+            memcpy(s->frames, ev->frames, ev->depth * sizeof(uint64_t));
+            return (h + i) % usable;
+        }
+    }
+    return usable;
+}
+
+
+static allocprof_block_t *find_block(allocprof_t *ap, uint64_t addr, int insert) {
+    uint64_t h = addr * 0x9e3779b97f4a7c15ULL;
+    allocprof_block_t *reuse = NULL;
+    for (uint32_t i = 0; i < BLOCK_SLOTS; i++) {
+        allocprof_block_t *b = &ap->blocks[(h + i) & (BLOCK_SLOTS - 1)];
+        if (b->addr == addr) return b;
+        if (b->addr == BLOCK_DELETED && !reuse) reuse = b;
+        if (b->addr == BLOCK_EMPTY) return insert ? (reuse ? reuse : b) : NULL;
+    }
+    return insert ? reuse : NULL;
+}
+
+
+static int by_seq(const void *a, const void *b) {
+    uint64_t x = ((const allocprof_event_t *)a)->seq;
+    uint64_t y = ((const allocprof_event_t *)b)->seq;
+    return x < y ? -1 : x > y;
+}
+
+
+//a pending free of addr after seq: the block was gone before we saw it allocated
+static int take_pending(allocprof_t *ap, uint64_t addr, uint64_t seq) {
+    int best = -1;
+    for (int i = 0; i < ap->npending; i++) {
+        const allocprof_pending_t *p = &ap->pending[i];
+        if (p->addr == addr && p->seq > seq && (best < 0 || p->seq < ap->pending[best].seq)) best = i;
+    }
+    if (best < 0) return 0;
+    ap->pending[best] = ap->pending[--ap->npending];
+    return 1;
+}
+
+
+/*
+ * drain every ring, returns the number of events applied. rings are read one
+ * after the other, so a free may be drained a poll before its alloc; such frees
+ * wait in the pending table for one poll and only then count as unknown.
+ */
+int allocprof_poll(allocprof_t *ap) {
+    if (!ap || !ap->shm) return -1;
+    size_t n = 0;
+    for (int r = 0; r < ALLOCPROF_RINGS; r++) {
+        allocprof_ring_t *ring = &ap->shm->rings[r];
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t tail = ring->tail;
+        for (; tail < head; tail++) {
+            ap->batch[n++] = ring->events[tail & (ALLOCPROF_RING_EVENTS - 1)];
+        }
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+    qsort(ap->batch, n, sizeof(allocprof_event_t), by_seq);
+    ap->polls++;
+
+    for (size_t i = 0; i < n; i++) {
+        const allocprof_event_t *ev = &ap->batch[i];
+        if (ev->type == ALLOCPROF_ALLOC) {
+            uint32_t site = site_of(ap, ev);
+            if (ap->npending && take_pending(ap, ev->addr, ev->seq)) {
+                ap->sites[site].allocs++;
+                ap->sites[site].frees++;
+                continue;
+            }
+            allocprof_block_t *b = find_block(ap, ev->addr, 1);
+            if (!b) continue;
+            b->addr = ev->addr;
+            b->site = site;
+            b->weight = ev->weight;
+            ap->sites[site].live += ev->weight;
+            ap->sites[site].allocs++;
+        } else {
+            allocprof_block_t *b = find_block(ap, ev->addr, 0);
+            if (!b) {
+                if (ap->npending < ALLOCPROF_PENDING) {
+                    ap->pending[ap->npending++] = (allocprof_pending_t){ ev->addr, ev->seq, ap->polls };
+                } else {
+                    ap->unknown_frees++;
+                }
+                continue;
+            }
+            ap->sites[b->site].live -= b->weight;
+            ap->sites[b->site].frees++;
+            b->addr = BLOCK_DELETED;
+        }
+    }
+    //pending since the previous poll and still unmatched: allocated before we attached
+    for (int i = 0; i < ap->npending;) {
+        if (ap->pending[i].poll == ap->polls) {
+            i++;
+            continue;
+        }
+        ap->unknown_frees++;
+        ap->pending[i] = ap->pending[--ap->npending];
+    }
+    ap->events += n;
+    return (int)n;
+}
+
+
+int64_t allocprof_live(const allocprof_t *ap) {
+    int64_t live = 0;
+    for (int i = 0; ap && ap->sites && i < ALLOCPROF_SITES; i++) live += ap->sites[i].live;
+    return live;
+}
+
+
+static int site_key(const void *item, const void *ctx, double key[2]) {
+    const allocprof_site_t *s = item;
+    (void)ctx;
+    key[0] = (double)(s->live - s->reported);
+    key[1] = (double)s->live;
+    return s->allocs != 0;
+}
+
+
+/*
+ * the n sites that grew most since the last report (live bytes break ties),
+ * into out; returns how many were found. reporting resets the growth baseline.
+ */
+int allocprof_top(allocprof_t *ap, allocprof_site_t **out, int n) {
+    if (!ap || !ap->sites || !out || n <= 0) return 0;
+    return topn_select(ap->sites, ALLOCPROF_SITES, sizeof(allocprof_site_t), site_key, NULL,
+                       (const void **)out, n);
+}
+
+
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    uint64_t offset;
+    char name[64];
+} map_entry_t;
+
+
+//executable mappings of pid, for module+offset names
+static int load_maps(pid_t pid, map_entry_t *maps, int cap) {
+    char path[PATH_MAX];
+    if (proc_path(path, sizeof(path), pid, "maps") != 0) return 0;
+    FILE *fp = fopen(path, "r");
+    if (!fp) return 0;
+    char line[PATH_MAX + 128];
+    int n = 0;
+    while (n < cap && fgets(line, sizeof(line), fp)) {
+        unsigned long long start, end, off;
+        char perms[8];
+        int pos = 0;
+        if (sscanf(line, "%llx-%llx %7s %llx %*s %*s%n", &start, &end, perms, &off, &pos) < 4 ||
+            perms[2] != 'x') {
+            continue;
+        }
+        char *file = line + pos;
+        while (*file == ' ') file++;
+        file[strcspn(file, "\n")] = '\0';
+        const char *base = strrchr(file, '/');
+        maps[n].start = start;
+        maps[n].end = end;
+        maps[n].offset = off;
+        snprintf(maps[n].name, sizeof(maps[n].name), "%s", base ? base + 1 : *file ? file : "anon");
+        n++;
+    }
+    fclose(fp);
+    return n;
+}
+
+
+static void frame_name(uint64_t pc, const map_entry_t *maps, int nmaps, char *buf, size_t size) {
+    for (int i = 0; i < nmaps; i++) {
+        if (pc >= maps[i].start && pc < maps[i].end) {
+            snprintf(buf, size, "%s+0x%llx", maps[i].name,
+                     (unsigned long long)(pc - maps[i].start + maps[i].offset));
+            return;
+        }
+    }
+    snprintf(buf, size, "0x%llx", (unsigned long long)pc);
+}
+
+
+//top growing sites, one line each with their innermost frames
+void allocprof_report(allocprof_t *ap, FILE *fp, int n) {
+    if (!ap || !ap->shm || !fp) return;
+    allocprof_site_t *top[ALLOCPROF_TOP];
+    if (n > ALLOCPROF_TOP) n = ALLOCPROF_TOP;
+    int found = allocprof_top(ap, top, n);
+
+    uint64_t dropped = ap->shm->dropped;
+    for (int r = 0; r < ALLOCPROF_RINGS; r++) dropped += ap->shm->rings[r].dropped;
+    fprintf(fp, "allocation sites: %.1f MB live sampled, 1 sample per %llu KB, %llu events, "
+            "%llu dropped\n", allocprof_live(ap) / (1024.0 * 1024.0),
+            (unsigned long long)ap->shm->sample_bytes / 1024,
+            (unsigned long long)ap->events, (unsigned long long)dropped);
+    if (found == 0) return;
+
+    map_entry_t *maps = malloc(MAP_ENTRIES * sizeof(map_entry_t));
+    int nmaps = maps ? load_maps(ap->pid, maps, MAP_ENTRIES) : 0;
+    for (int i = 0; i < found; i++) {
+        allocprof_site_t *s = top[i];
+        char stack[256] = "", frame[96];
+        size_t len = 0;
+        for (uint32_t f = 0; f < s->depth && f < 3; f++) {
+            frame_name(s->frames[f], maps, nmaps, frame, sizeof(frame));
+            len += snprintf(stack + len, sizeof(stack) - len, "%s%s", f ? " < " : "", frame);
+            if (len >= sizeof(stack)) break;
+        }
+        fprintf(fp, "  %+9.1f KB  live %9.1f KB  %s\n",
+                (s->live - s->reported) / 1024.0, s->live / 1024.0, stack);
+    }
+    for (int i = 0; i < ALLOCPROF_SITES; i++) ap->sites[i].reported = ap->sites[i].live;
+    free(maps);
+}
+
+
+void allocprof_detach(allocprof_t *ap) {
+    if (!ap) return;
+    if (ap->shm) munmap(ap->shm, sizeof(allocprof_shm_t));
+    //the target unlinks its segment at exit, a killed one leaves it behind
+    if (ap->pid > 0 && !process_exists(ap->pid)) {
+        char name[64];
+        snprintf(name, sizeof(name), ALLOCPROF_SHM_FMT, (int)ap->pid);
+        shm_unlink(name);
+    }
+    free(ap->sites);
+    free(ap->blocks);
+    free(ap->batch);
+    free(ap->pending);
+    memset(ap, 0, sizeof(allocprof_t));
+}
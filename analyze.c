@@ -0,0 +1,651 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-5-18 10:12:31
+ * @Last modified: 2025-5-18 10:12:31
+ * @Description: analyze existing write_log() text logs. The file is mmap'd,
+ *               split at newline boundaries across threads and parsed with a
+ *               hand-written scanner (no sscanf per line), then summarized.
+ */
+
+#include "include/memtrc.h"
+#include "include/chart.h"
+#include "include/analyze.h"
+#include "include/codec.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+//days since 1970-01-01 of a proleptic gregorian date (H. Hinnant's algorithm)
+static long long days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    long long era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (long long)doe - 719468;
+}
+
+
+static inline int digits2(const char *p) {
+    return (p[0] - '0') * 10 + (p[1] - '0');
+}
+
+
+static inline int is_digits(const char *p, int n) {
+    for (int i = 0; i < n; i++) {
+        if ((unsigned)(p[i] - '0') > 9) return 0;
+    }
+    return 1;
+}
+
+
+//parse "YYYY-MM-DD HH:MM:SS[.mmm]" at p, return its length or -1
+static int parse_timestamp(const char *p, const char *end, long long *ts_ms) {
+    if (end - p < 19 || !is_digits(p, 4) || p[4] != '-' || !is_digits(p + 5, 2) ||
+        p[7] != '-' || !is_digits(p + 8, 2) || p[10] != ' ' || !is_digits(p + 11, 2) ||
+        p[13] != ':' || !is_digits(p + 14, 2) || p[16] != ':' || !is_digits(p + 17, 2)) {
+        return -1;
+    }
+    int year = digits2(p) * 100 + digits2(p + 2);
+    long long days = days_from_civil(year, digits2(p + 5), digits2(p + 8));
+    long long secs = days * 86400 + digits2(p + 11) * 3600 +
+                     digits2(p + 14) * 60 + digits2(p + 17);
+    *ts_ms = secs * 1000;
+    //millisecond logs (adaptive sampling) keep their sub second spacing
+    if (end - p >= 23 && p[19] == '.' && is_digits(p + 20, 3)) {
+        *ts_ms += (p[20] - '0') * 100 + digits2(p + 21);
+        return 23;
+    }
+    return 19;
+}
+
+
+//parse an optionally negative decimal, advance *pp past it
+static inline int parse_long(const char **pp, const char *end, long *out) {
+    const char *p = *pp;
+    int neg = 0;
+    if (p < end && *p == '-') {
+        neg = 1;
+        p++;
+    }
+    if (p >= end || (unsigned)(*p - '0') > 9) return -1;
+    long v = 0;
+    while (p < end && (unsigned)(*p - '0') <= 9) {
+        v = v * 10 + (*p++ - '0');
+    }
+    *out = neg ? -v : v;
+    *pp = p;
+    return 0;
+}
+
+
+/*
+ * line layout (see write_log()):
+ * [YYYY-MM-DD HH:MM:SS.mmm] type: user process, VSZ: n KB, RSS: n KB, Data: n KB, Stack: n KB
+ * [YYYY-MM-DD HH:MM:SS.mmm] type: kernel process, RSS: n KB, VSZ: n KB
+ * older logs have no ".mmm" and parse the same.
+ * unknown "Key: value" columns are skipped so newer logs still parse.
+ * scans from p up to the next '\n' in a single pass, returns the line end
+ * ('\n' or end) and sets *ok when the line is a sample
+ */
+static const char *scan_line(const char *p, const char *end, log_record_t *rec, int *ok) {
+    static const char type_tag[] = "] type: ";
+    *ok = 0;
+
+    if (end - p < 21 + (long)sizeof(type_tag) - 1 || *p != '[') goto skip;
+    int ts_len = parse_timestamp(p + 1, end, &rec->ts_ms);
+    if (ts_len < 0) goto skip;
+    p += 1 + ts_len;
+    if (end - p < (long)sizeof(type_tag) - 1 ||
+        memcmp(p, type_tag, sizeof(type_tag) - 1) != 0) goto skip;
+    p += sizeof(type_tag) - 1;
+
+    //skip "user process" / "kernel process", fixed text is jumped not scanned
+    if (end - p >= 12 && memcmp(p, "user process", 12) == 0) {
+        p += 12;
+    } else if (end - p >= 14 && memcmp(p, "kernel process", 14) == 0) {
+        p += 14;
+    }
+    while (p < end && *p != ',' && *p != '\n') p++;
+
+    int columns = 0;
+    rec->vmrss = -1;
+    rec->vmsize = -1;
+    while (p + 2 < end && p[0] == ',' && p[1] == ' ') {
+        const char *key = p + 2;
+        p = key;
+        while (p < end && *p != ':' && *p != '\n') p++;   //keys are a few chars
+        if (p + 2 > end || *p != ':') goto skip;
+        size_t key_len = p - key;
+        p++;
+        while (p < end && *p == ' ') p++;
+
+        long value;
+        if (parse_long(&p, end, &value) != 0) goto skip;
+        if (key_len == 3 && key[1] == 'S') {
+            if (key[0] == 'R' && key[2] == 'S') {
+                rec->vmrss = value;
+                columns++;
+            } else if (key[0] == 'V' && key[2] == 'Z') {
+                rec->vmsize = value;
+                columns++;
+            }
+        }
+        //skip unit suffix up to the next column
+        if (end - p >= 3 && p[0] == ' ' && p[1] == 'K' && p[2] == 'B') p += 3;
+        while (p < end && *p != ',' && *p != '\n') p++;
+    }
+    *ok = columns > 0;
+
+skip:
+    if (p < end && *p != '\n') {
+        const char *nl = memchr(p, '\n', end - p);
+        p = nl ? nl : end;
+    }
+    return p < end ? p : end;
+}
+
+
+//return 1 when the line is a sample, 0 otherwise
+int parse_log_line(const char *line, size_t len, log_record_t *rec) {
+    int ok;
+    scan_line(line, line + len, rec, &ok);
+    return ok;
+}
+
+
+/*
+ * parse every line of buf into a growing record array.
+ * return 0 on success, -1 when out of memory
+ */
+int parse_log_buffer(const char *buf, size_t len, log_record_t **recs,
+        size_t *count, size_t *cap, size_t *skipped) {
+    const char *p = buf;
+    const char *end = buf + len;
+
+    while (p < end) {
+        if (*count == *cap) {
+            //first guess from the typical line length, untouched pages cost nothing
+            size_t new_cap = *cap ? *cap * 2 : len / 64 + 1024;
+            log_record_t *tmp = realloc(*recs, new_cap * sizeof(log_record_t));
+            if (!tmp) {
+                fprintf(stderr, "Error: out of memory while parsing log\n");
+                return -1;
+            }
+            *recs = tmp;
+            *cap = new_cap;
+        }
+        if (*p == '\n') {  //empty line
+            p++;
+            continue;
+        }
+        int ok;
+        p = scan_line(p, end, &(*recs)[*count], &ok) + 1;
+        if (ok) {
+            (*count)++;
+        } else {
+            (*skipped)++;
+        }
+    }
+    return 0;
+}
+
+
+typedef struct {
+    const char *begin;
+    const char *end;
+    log_record_t *recs;
+    size_t count;
+    size_t cap;
+    size_t skipped;
+    int ret;
+} parse_chunk_t;
+
+
+static void *parse_chunk_thread(void *arg) {
+    parse_chunk_t *chunk = (parse_chunk_t *)arg;
+    chunk->ret = parse_log_buffer(chunk->begin, chunk->end - chunk->begin,
+            &chunk->recs, &chunk->count, &chunk->cap, &chunk->skipped);
+    return NULL;
+}
+
+
+static double elapsed_secs(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+
+//load a trace -z log, columns are VSZ, RSS, Data, Stack
+static int load_compressed_log(const char *path, log_data_t *data) {
+    codec_reader_t reader;
+    if (codec_reader_open(&reader, path) != 0) return -1;
+
+    long long *ts = malloc(CODEC_BLOCK_ROWS * sizeof(long long));
+    long (*vals)[CODEC_BLOCK_ROWS] = malloc(CODEC_MAX_COLS * sizeof(*vals));
+    size_t cap = reader.nblocks * CODEC_BLOCK_ROWS;
+    data->records = malloc((cap ? cap : 1) * sizeof(log_record_t));
+    int ret = (ts && vals && data->records) ? 0 : -1;
+    if (ret != 0) fprintf(stderr, "Error: out of memory loading %s\n", path);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t b = 0; ret == 0 && b < reader.nblocks; b++) {
+        codec_block_t blk;
+        if (codec_reader_block(&reader, b, &blk) != 0) {
+            ret = -1;
+            break;
+        }
+        data->bytes += blk.nbytes;
+        if (codec_decode_block(reader.ncols, &blk, ts, vals) != 0) ret = -1;
+        for (uint32_t i = 0; ret == 0 && i < blk.rows; i++) {
+            log_record_t *rec = &data->records[data->count++];
+            rec->ts_ms = ts[i];
+            rec->vmsize = vals[0][i];
+            rec->vmrss = reader.ncols > 1 ? vals[1][i] : -1;
+        }
+        codec_free_block(&blk);
+    }
+    data->parse_secs = elapsed_secs(&start);
+    data->threads = 1;
+
+    free(ts);
+    free(vals);
+    codec_reader_close(&reader);
+    if (ret != 0) free_log_data(data);
+    return ret;
+}
+
+
+int load_log_file(const char *path, int threads, log_data_t *data) {
+    if (!path || !data) {
+        fprintf(stderr, "Error: Invalid arguments to load_log_file()\n");
+        return -1;
+    }
+    memset(data, 0, sizeof(log_data_t));
+    if (codec_is_compressed(path)) {
+        return load_compressed_log(path, data);
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Can't open file %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        fprintf(stderr, "Can't stat file %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    data->bytes = st.st_size;
+    if (data->bytes == 0) {
+        close(fd);
+        return 0;
+    }
+
+    char *map = mmap(NULL, data->bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  //the mapping keeps the file referenced
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Can't mmap file %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    posix_madvise(map, data->bytes, POSIX_MADV_SEQUENTIAL);
+    posix_madvise(map, data->bytes, POSIX_MADV_WILLNEED);
+
+    //pick thread count, never give a thread less than ANALYZE_MIN_CHUNK
+    if (threads <= 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = ncpu > 0 ? (int)ncpu : 1;
+    }
+    if (threads > ANALYZE_MAX_THREADS) threads = ANALYZE_MAX_THREADS;
+    if ((size_t)threads > data->bytes / ANALYZE_MIN_CHUNK) {
+        threads = (int)(data->bytes / ANALYZE_MIN_CHUNK);
+    }
+    if (threads < 1) threads = 1;
+
+    //split at newline boundaries
+    parse_chunk_t chunks[ANALYZE_MAX_THREADS];
+    const char *file_end = map + data->bytes;
+    const char *pos = map;
+    for (int i = 0; i < threads; i++) {
+        memset(&chunks[i], 0, sizeof(parse_chunk_t));
+        chunks[i].begin = pos;
+        const char *cut = (i == threads - 1) ? file_end :
+                map + data->bytes / threads * (i + 1);
+        if (cut < pos) cut = pos;
+        if (cut < file_end) {
+            const char *nl = memchr(cut, '\n', file_end - cut);
+            cut = nl ? nl + 1 : file_end;
+        }
+        chunks[i].end = cut;
+        pos = cut;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pthread_t tids[ANALYZE_MAX_THREADS];
+    int started = 0;
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&tids[i], NULL, parse_chunk_thread, &chunks[i]) != 0) {
+            break;
+        }
+        started = i;
+    }
+    //parse whatever could not get its own thread on the calling thread
+    parse_chunk_thread(&chunks[0]);
+    for (int i = started + 1; i < threads; i++) {
+        parse_chunk_thread(&chunks[i]);
+    }
+    for (int i = 1; i <= started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    data->parse_secs = elapsed_secs(&start);
+    data->threads = started + 1;
+    munmap(map, data->bytes);
+
+    //concatenate chunk results in file order
+    int ret = 0;
+    size_t total = 0;
+    for (int i = 0; i < threads; i++) {
+        if (chunks[i].ret != 0) ret = -1;
+        total += chunks[i].count;
+        data->skipped += chunks[i].skipped;
+    }
+    if (ret == 0 && total > 0) {
+        data->records = chunks[0].recs;
+        chunks[0].recs = NULL;
+        if (threads > 1) {
+            log_record_t *tmp = realloc(data->records, total * sizeof(log_record_t));
+            if (!tmp) {
+                fprintf(stderr, "Error: out of memory while merging log chunks\n");
+                ret = -1;
+            } else {
+                data->records = tmp;
+                size_t off = chunks[0].count;
+                for (int i = 1; i < threads; i++) {
+                    memcpy(data->records + off, chunks[i].recs,
+                            chunks[i].count * sizeof(log_record_t));
+                    off += chunks[i].count;
+                }
+            }
+        }
+        data->count = total;
+    }
+    for (int i = 0; i < threads; i++) {
+        free(chunks[i].recs);
+    }
+    if (ret != 0) {
+        free_log_data(data);
+    }
+    return ret;
+}
+
+
+void free_log_data(log_data_t *data) {
+    if (!data) return;
+    free(data->records);
+    data->records = NULL;
+    data->count = 0;
+}
+
+
+static inline long field_value(const log_record_t *rec, log_field_t field) {
+    return field == LOG_FIELD_RSS ? rec->vmrss : rec->vmsize;
+}
+
+
+//quickselect, partially reorders values so values[k] is the k-th smallest
+static long select_kth(long *values, size_t n, size_t k) {
+    long lo = 0, hi = (long)n - 1;
+    while (lo < hi) {
+        long pivot = values[lo + (hi - lo) / 2];
+        long i = lo, j = hi;
+        while (i <= j) {
+            while (values[i] < pivot) i++;
+            while (values[j] > pivot) j--;
+            if (i <= j) {
+                long tmp = values[i];
+                values[i++] = values[j];
+                values[j--] = tmp;
+            }
+        }
+        if ((long)k <= j) hi = j;
+        else if ((long)k >= i) lo = i;
+        else break;
+    }
+    return values[k];
+}
+
+
+int compute_series_stats(const log_data_t *data, log_field_t field, series_stats_t *st) {
+    if (!data || !st) {
+        fprintf(stderr, "Error: Invalid arguments to compute_series_stats()\n");
+        return -1;
+    }
+    memset(st, 0, sizeof(series_stats_t));
+
+    long *values = malloc((data->count ? data->count : 1) * sizeof(long));
+    if (!values) {
+        fprintf(stderr, "Error: out of memory computing statistics\n");
+        return -1;
+    }
+
+    //single pass: extremes, mean and least squares sums relative to the first sample
+    size_t n = 0;
+    double sum = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+    long long t0 = 0, t_last = 0;
+    st->peak = LONG_MIN;
+    st->min = LONG_MAX;
+    for (size_t i = 0; i < data->count; i++) {
+        long v = field_value(&data->records[i], field);
+        if (v < 0) continue;
+        if (n == 0) t0 = data->records[i].ts_ms;
+        t_last = data->records[i].ts_ms;
+        double x = (t_last - t0) / 1000.0;
+        values[n++] = v;
+        sum += v;
+        sx += x;
+        sy += v;
+        sxx += x * x;
+        sxy += x * v;
+        if (v > st->peak) st->peak = v;
+        if (v < st->min) st->min = v;
+    }
+
+    st->samples = n;
+    if (n == 0) {
+        st->peak = st->min = 0;
+        free(values);
+        return 0;
+    }
+    st->mean = sum / n;
+    st->span_secs = (t_last - t0) / 1000.0;
+    double denom = n * sxx - sx * sx;
+    st->growth_per_sec = denom > 0 ? (n * sxy - sx * sy) / denom : 0;
+
+    st->p50 = select_kth(values, n, (n - 1) * 50 / 100);
+    st->p90 = select_kth(values, n, (n - 1) * 90 / 100);
+    st->p95 = select_kth(values, n, (n - 1) * 95 / 100);
+    st->p99 = select_kth(values, n, (n - 1) * 99 / 100);
+    free(values);
+    return 0;
+}
+
+
+void print_series_stats(const char *name, const series_stats_t *st) {
+    printf("%s: samples %zu, peak %ld KB, min %ld KB, mean %.1f KB\n",
+           name, st->samples, st->peak, st->min, st->mean);
+    printf("    p50 %ld KB, p90 %ld KB, p95 %ld KB, p99 %ld KB\n", st->p50, st->p90, st->p95, st->p99);
+    printf("    growth %.3f KB/s (%.1f KB/h) over %.0f s\n",
+           st->growth_per_sec, st->growth_per_sec * 3600, st->span_secs);
+}
+
+
+//downsample a series into a chart history, one bucket max per column keeps peaks visible
+static void chart_series(const log_data_t *data, log_field_t field, const char *title) {
+    history_data_t hist;
+    init_history(&hist);
+
+    const int buckets = CHART_WIDTH - 1;
+    size_t n = data->count;
+    for (int b = 0; b < buckets && n > 0; b++) {
+        size_t from = n * b / buckets;
+        size_t to = n * (b + 1) / buckets;
+        long best = -1;
+        for (size_t i = from; i < to; i++) {
+            long v = field_value(&data->records[i], field);
+            if (v > best) best = v;
+        }
+        if (best >= 0) update_history(&hist, best);
+    }
+    if (hist.count > 0) {
+        draw_chart(&hist, title);
+    }
+    cleanup_history(&hist);
+}
+
+
+/*
+ * encode the parsed trace with the block codec and decode it back, prints the
+ * compression ratio against raw longs and the text log plus both throughputs
+ */
+int report_codec_stats(const log_data_t *data) {
+    if (!data || data->count == 0) return 0;
+
+    ts_series_t *s = malloc(sizeof(ts_series_t));
+    long long *ts = malloc(CODEC_BLOCK_ROWS * sizeof(long long));
+    long (*vals)[CODEC_BLOCK_ROWS] = malloc(CODEC_MAX_COLS * sizeof(*vals));
+    if (!s || !ts || !vals || ts_series_init(s, 2) != 0) {
+        fprintf(stderr, "Error: out of memory measuring codec\n");
+        free(s);
+        free(ts);
+        free(vals);
+        return -1;
+    }
+
+    int ret = 0;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < data->count && ret == 0; i++) {
+        long row[2] = { data->records[i].vmsize, data->records[i].vmrss };
+        ret = ts_series_append(s, data->records[i].ts_ms, row);
+    }
+    if (ret == 0) ret = ts_series_seal(s);
+    double enc_secs = elapsed_secs(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t b = 0; b < s->nblocks && ret == 0; b++) {
+        ret = codec_decode_block(s->ncols, &s->blocks[b], ts, vals);
+    }
+    double dec_secs = elapsed_secs(&start);
+
+    if (ret == 0) {
+        size_t raw = data->count * (sizeof(long long) + 2 * sizeof(long));
+        double msamples = data->count / 1e6;
+        printf("codec: %zu bytes for %zu samples (%.2f bytes/sample), "
+               "%.1fx vs raw, %.1fx vs text\n",
+               s->enc_bytes, data->count, (double)s->enc_bytes / data->count,
+               (double)raw / s->enc_bytes,
+               data->bytes ? (double)data->bytes / s->enc_bytes : 0.0);
+        printf("    encode %.1f Msamples/s, decode %.1f Msamples/s\n",
+               enc_secs > 0 ? msamples / enc_secs : 0.0,
+               dec_secs > 0 ? msamples / dec_secs : 0.0);
+    }
+    ts_series_free(s);
+    free(s);
+    free(ts);
+    free(vals);
+    return ret;
+}
+
+
+//rss and vsz, when given, also collect the samples for merged quantiles
+static int analyze_one(const char *path, int threads, sketch_t *rss_dist, sketch_t *vsz_dist) {
+    log_data_t data;
+    if (load_log_file(path, threads, &data) != 0) {
+        return -1;
+    }
+    for (size_t i = 0; rss_dist && i < data.count; i++) {
+        if (data.records[i].vmrss >= 0) sketch_add(rss_dist, data.records[i].vmrss);
+        if (data.records[i].vmsize >= 0) sketch_add(vsz_dist, data.records[i].vmsize);
+    }
+
+    printf("==== log analysis: %s ====\n", path);
+    double mb = data.bytes / (1024.0 * 1024.0);
+    printf("parsed %.1f MB, %zu samples, %zu other lines in %.3f s (%d threads, %.0f MB/s)\n",
+           mb, data.count, data.skipped, data.parse_secs, data.threads,
+           data.parse_secs > 0 ? mb / data.parse_secs : 0.0);
+
+    if (data.count == 0) {
+        printf("no samples found\n");
+        free_log_data(&data);
+        return 0;
+    }
+
+    series_stats_t rss, vsz;
+    if (compute_series_stats(&data, LOG_FIELD_RSS, &rss) != 0 ||
+        compute_series_stats(&data, LOG_FIELD_VSZ, &vsz) != 0) {
+        free_log_data(&data);
+        return -1;
+    }
+    print_series_stats("RSS", &rss);
+    print_series_stats("VSZ", &vsz);
+    if (!codec_is_compressed(path)) {
+        report_codec_stats(&data);
+    }
+
+    if (rss.samples > 0) chart_series(&data, LOG_FIELD_RSS, "RSS History (log)");
+    if (vsz.samples > 0) chart_series(&data, LOG_FIELD_VSZ, "VSZ History (log)");
+    printf("=====================\n");
+
+    free_log_data(&data);
+    return 0;
+}
+
+
+int analyze_log(const char *path, int threads) {
+    return analyze_one(path, threads, NULL, NULL);
+}
+
+
+//each log on its own, then the quantiles of all of them merged, e.g. one log per target
+int analyze_logs(char *paths[], int count, int threads) {
+    if (!paths || count <= 0) return -1;
+    if (count == 1) return analyze_log(paths[0], threads);
+
+    sketch_t *dist = malloc(2 * sizeof(sketch_t));
+    if (!dist) {
+        fprintf(stderr, "Error: out of memory merging logs\n");
+        return -1;
+    }
+    sketch_init(&dist[0]);
+    sketch_init(&dist[1]);
+    int ret = 0;
+    for (int i = 0; i < count; i++) {
+        //one sketch per log merged into the total, like combining separate sessions
+        sketch_t *part = malloc(2 * sizeof(sketch_t));
+        if (!part) {
+            ret = -1;
+            break;
+        }
+        sketch_init(&part[0]);
+        sketch_init(&part[1]);
+        if (analyze_one(paths[i], threads, &part[0], &part[1]) != 0) {
+            fprintf(stderr, "Error: can't analyze log file %s\n", paths[i]);
+            ret = -1;
+        }
+        sketch_merge(&dist[0], &part[0]);
+        sketch_merge(&dist[1], &part[1]);
+        free(part);
+    }
+    printf("==== merged: %d logs ====\n", count);
+    sketch_print(stdout, "RSS", &dist[0]);
+    sketch_print(stdout, "VSZ", &dist[1]);
+    printf("=====================\n");
+    free(dist);
+    return ret;
+}
@@ -0,0 +1,1264 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-6-10 21:03:18
+ * @Last modified: 2025-6-10 21:03:18
+ * @Description: microbenchmarks of the hot paths, run by `make bench`.
+ *               every case is timed in calibrated batches, the report has
+ *               warmup, repetitions, median/p99 ns per op and allocations per op.
+ */
+
+
+#define _DEFAULT_SOURCE     //MAP_ANONYMOUS for the perturbation workload, before any header
+#include "include/memtrc.h"
+#include "include/chart.h"
+#include "include/analyze.h"
+#include "include/codec.h"
+#include "include/fixture.h"
+#include "include/sampler.h"
+#include "include/colstore.h"
+#include "include/sink.h"
+#include "include/leader.h"
+#include "include/numa.h"
+#include "include/kmem.h"
+#include "include/libmemtrc.h"
+#include "include/sketch.h"
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+
+#define BENCH_DEFAULT_REPS   200
+#define BENCH_DEFAULT_WARMUP 50         //ms
+#define BENCH_BATCH_NS       50000ULL   //target duration of one timed batch
+#define BENCH_SKIP           1          //setup: case can't run on this machine, not a failure
+
+
+/*
+ * allocation counting: glibc lets a program replace malloc, so these wrappers
+ * see every allocation including the ones made inside libc (fopen buffers etc.)
+ */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+static unsigned long alloc_count = 0;
+
+void *malloc(size_t size) {
+    __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size) {
+    __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+    void *p = __libc_memalign(alignment, size);
+    if (!p) return ENOMEM;
+    *memptr = p;
+    return 0;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __libc_memalign(alignment, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+
+
+typedef struct {
+    const char *name;
+    int (*setup)(void **ctx);       //optional, return 0 on success
+    void (*run)(void *ctx);         //one operation
+    void (*teardown)(void *ctx);    //optional
+} bench_case_t;
+
+typedef struct {
+    const char *name;
+    unsigned long warmup_ops;
+    int reps;
+    unsigned long batch;            //ops per timed repetition
+    double median_ns;
+    double p99_ns;
+    double mean_ns;
+    double allocs_per_op;
+} bench_result_t;
+
+typedef enum {
+    FORMAT_TEXT,
+    FORMAT_CSV,
+    FORMAT_JSON
+} bench_format_t;
+
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+static uint64_t run_batch(const bench_case_t *bc, void *ctx, unsigned long ops) {
+    uint64_t start = now_ns();
+    for (unsigned long i = 0; i < ops; i++) {
+        bc->run(ctx);
+    }
+    return now_ns() - start;
+}
+
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+
+static int run_case(const bench_case_t *bc, int reps, int warmup_ms, bench_result_t *res) {
+    void *ctx = NULL;
+    memset(res, 0, sizeof(bench_result_t));
+    res->name = bc->name;
+    res->reps = reps;
+    int rc = bc->setup ? bc->setup(&ctx) : 0;
+    if (rc == BENCH_SKIP) {
+        fprintf(stderr, "bench %s: not supported here, skipped\n", bc->name);
+        return BENCH_SKIP;
+    }
+    if (rc != 0) {
+        fprintf(stderr, "bench %s: setup failed, skipped\n", bc->name);
+        return -1;
+    }
+
+    //calibrate batch size so one repetition is well above clock overhead,
+    //after one untimed call so first-touch costs don't shrink the batch
+    bc->run(ctx);
+    unsigned long batch = 1;
+    while (batch < (1UL << 24) && run_batch(bc, ctx, batch) < BENCH_BATCH_NS) {
+        batch *= 2;
+    }
+    res->batch = batch;
+
+    //warmup: caches, page cache of /proc files, branch predictors
+    uint64_t warm_end = now_ns() + (uint64_t)warmup_ms * 1000000ULL;
+    while (now_ns() < warm_end) {
+        run_batch(bc, ctx, batch);
+        res->warmup_ops += batch;
+    }
+
+    double *samples = __libc_malloc(reps * sizeof(double));
+    if (!samples) {
+        fprintf(stderr, "bench %s: out of memory\n", bc->name);
+        if (bc->teardown) bc->teardown(ctx);
+        return -1;
+    }
+    unsigned long allocs_before = __atomic_load_n(&alloc_count, __ATOMIC_RELAXED);
+    double total = 0;
+    for (int r = 0; r < reps; r++) {
+        samples[r] = (double)run_batch(bc, ctx, batch) / batch;
+        total += samples[r];
+    }
+    unsigned long allocs = __atomic_load_n(&alloc_count, __ATOMIC_RELAXED) - allocs_before;
+
+    qsort(samples, reps, sizeof(double), cmp_double);
+    res->median_ns = samples[reps / 2];
+    res->p99_ns = samples[(reps * 99) / 100 < reps ? (reps * 99) / 100 : reps - 1];
+    res->mean_ns = total / reps;
+    res->allocs_per_op = (double)allocs / ((double)reps * batch);
+    __libc_free(samples);
+
+    if (bc->teardown) bc->teardown(ctx);
+    return 0;
+}
+
+
+/* ---- benchmark cases ---- */
+
+static void bench_read_mem_info_live(void *ctx) {
+    (void)ctx;
+    mem_info_t info;
+    read_mem_info(getpid(), &info);
+}
+
+
+static void bench_get_process_type(void *ctx) {
+    (void)ctx;
+    get_process_type(getpid());
+}
+
+
+//cache cleared every op, the cost of the first classification of a pid
+static void bench_get_process_type_miss(void *ctx) {
+    (void)ctx;
+    proc_type_cache_clear();
+    get_process_type(getpid());
+}
+
+
+static int setup_history(void **ctx) {
+    history_data_t *hist = __libc_malloc(sizeof(history_data_t));
+    if (!hist) return -1;
+    init_history(hist);
+    for (int i = 0; i < MAX_HISTORY; i++) {
+        update_history(hist, 1000 + (i * 37) % 500);
+    }
+    *ctx = hist;
+    return 0;
+}
+
+
+static void teardown_history(void *ctx) {
+    cleanup_history(ctx);
+    __libc_free(ctx);
+}
+
+
+static void bench_update_history(void *ctx) {
+    static long value = 0;
+    update_history(ctx, value++ & 0xffff);
+}
+
+
+static void bench_prepare_chart(void *ctx) {
+    char chart[CHART_HEIGHT][CHART_WIDTH + 1];
+    prepare_chart(ctx, chart);
+    __asm__ volatile("" : : "r"(chart) : "memory");
+}
+
+
+//charts print to stdout, point it at /dev/null for the duration
+static int saved_stdout = -1;
+
+static int setup_chart_devnull(void **ctx) {
+    if (setup_history(ctx) != 0) return -1;
+    fflush(stdout);
+    int devnull = open("/dev/null", O_WRONLY);
+    saved_stdout = dup(STDOUT_FILENO);
+    if (devnull < 0 || saved_stdout < 0 || dup2(devnull, STDOUT_FILENO) < 0) {
+        if (devnull >= 0) close(devnull);
+        teardown_history(*ctx);
+        return -1;
+    }
+    close(devnull);
+    return 0;
+}
+
+
+static void teardown_chart_devnull(void *ctx) {
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+    teardown_history(ctx);
+}
+
+
+static void bench_draw_chart(void *ctx) {
+    draw_chart(ctx, "Bench Chart");
+}
+
+
+static int setup_devnull_file(void **ctx) {
+    FILE *fp = fopen("/dev/null", "w");
+    if (!fp) return -1;
+    *ctx = fp;
+    return 0;
+}
+
+
+static void teardown_devnull_file(void *ctx) {
+    fclose(ctx);
+}
+
+
+static void bench_write_log(void *ctx) {
+    static const mem_info_t info = {
+        .proc_type = PROC_TYPE_USER,
+        .vmsize = 123456789,
+        .vmrss = 23456789,
+        .vmdata = 3456789,
+        .vmstk = 135168
+    };
+    write_log(ctx, &info);
+}
+
+
+/*
+ * the csv / json lines sinks into /dev/null at a 100 Hz sample clock, against
+ * write_log_devnull: same row, printf and strftime per line and a flush each
+ */
+static int setup_sink(void **ctx, sink_format_t format) {
+    sink_t *s = __libc_malloc(sizeof(sink_t));
+    if (!s || sink_open(s, "/dev/null", format, 0, 0) != 0) return -1;
+    *ctx = s;
+    return 0;
+}
+
+static int setup_sink_csv(void **ctx) { return setup_sink(ctx, SINK_CSV); }
+static int setup_sink_jsonl(void **ctx) { return setup_sink(ctx, SINK_JSONL); }
+
+
+static void teardown_sink(void *ctx) {
+    sink_close(ctx);
+    __libc_free(ctx);
+}
+
+
+static void bench_sink_write(void *ctx) {
+    static long long ts = 1700000000000LL;
+    static const mem_info_t info = {
+        .proc_type = PROC_TYPE_USER,
+        .vmsize = 123456789,
+        .vmrss = 23456789,
+        .vmdata = 3456789,
+        .vmstk = 135168
+    };
+    sink_write(ctx, ts += 10, 1234, &info);
+}
+
+
+static void bench_parse_command(void *ctx) {
+    (void)ctx;
+    char line[] = "trace 1234 -c -i 2 -l memory.log\n";
+    char *args[MAX_ARGS];
+    int arg_count;
+    parse_command(line, args, &arg_count);
+}
+
+
+static void bench_parse_log_line(void *ctx) {
+    (void)ctx;
+    static const char line[] = "[2025-05-01 10:00:00] type: user process, "
+            "VSZ: 123456 KB, RSS: 23456 KB, Data: 3456 KB, Stack: 132 KB";
+    log_record_t rec;
+    parse_log_line(line, sizeof(line) - 1, &rec);
+    __asm__ volatile("" : : "r"(&rec) : "memory");
+}
+
+
+static int setup_series(void **ctx) {
+    ts_series_t *s = __libc_malloc(sizeof(ts_series_t));
+    if (!s || ts_series_init(s, 2) != 0) return -1;
+    *ctx = s;
+    return 0;
+}
+
+
+static void teardown_series(void *ctx) {
+    ts_series_free(ctx);
+    __libc_free(ctx);
+}
+
+
+static void bench_series_append(void *ctx) {
+    static long long ts = 0;
+    ts_series_t *s = ctx;
+    long row[2] = { 4096L * (10000 + (ts >> 6 & 7)), 4096L * 50000 };
+    ts_series_append(s, ts += 100, row);
+    //bound memory: long runs only need the steady state cost
+    if (s->nblocks >= 64) ts_series_free(s);
+}
+
+
+/*
+ * fixture cases: a synthetic /proc tree built once in /tmp, so the numbers
+ * do not depend on what happens to run on the machine
+ */
+static int fixture_pids = 1000;
+static char fixture_root[PATH_MAX] = "";
+
+static void remove_fixture(void) {
+    set_procfs_root("/proc");
+    if (fixture_root[0]) fixture_remove(fixture_root);
+    fixture_root[0] = '\0';
+}
+
+
+static int setup_fixture(void **ctx) {
+    *ctx = NULL;
+    if (!fixture_root[0]) {
+        fixture_opts_t opts;
+        fixture_default_opts(&opts);
+        opts.count = fixture_pids;
+        strcpy(fixture_root, "/tmp/memtrc_fixture_XXXXXX");
+        if (!mkdtemp(fixture_root)) {
+            fixture_root[0] = '\0';
+            return -1;
+        }
+        atexit(remove_fixture);
+        if (fixture_generate(fixture_root, &opts) != 0) return -1;
+    }
+    return set_procfs_root(fixture_root) == 0 ? 0 : -1;
+}
+
+
+static void teardown_fixture(void *ctx) {
+    (void)ctx;
+    set_procfs_root("/proc");
+}
+
+
+static void bench_read_mem_info_fixture(void *ctx) {
+    (void)ctx;
+    static int next = 0;
+    mem_info_t info;
+    read_mem_info(1000 + next, &info);
+    if (++next >= fixture_pids) next = 0;
+}
+
+
+//one op is a full pass over the tree, the way a system wide view would see it
+static void bench_fixture_scan(void *ctx) {
+    (void)ctx;
+    DIR *dir = opendir(get_procfs_root());
+    if (!dir) return;
+    struct dirent *de;
+    long total = 0;
+    while ((de = readdir(dir)) != NULL) {
+        if (de->d_name[0] < '0' || de->d_name[0] > '9') continue;
+        mem_info_t info;
+        if (read_mem_info(atoi(de->d_name), &info) == 0 &&
+            info.proc_type == PROC_TYPE_USER) {
+            total += info.vmrss;
+        }
+    }
+    closedir(dir);
+    __asm__ volatile("" : : "r"(total) : "memory");
+}
+
+
+/*
+ * numa_maps of a large process, 5000 mappings over two nodes: one op is a
+ * full parse from an unlinked temp file, allocs/op should stay 0
+ */
+#define NUMA_BENCH_LINES 5000
+
+static int setup_numa_maps(void **ctx) {
+    FILE *fp = tmpfile();
+    if (!fp) return -1;
+    for (int i = 0; i < NUMA_BENCH_LINES; i++) {
+        unsigned long addr = 0x7f0000000000UL + (unsigned long)i * 0x200000;
+        if (i % 4 == 0) {
+            fprintf(fp, "%lx default file=/usr/lib/x86_64-linux-gnu/libexample%d.so.1 mapped=%d "
+                    "mapmax=3 N0=%d N1=%d kernelpagesize_kB=4\n", addr, i, 40 + i % 7, 30, 10 + i % 7);
+        } else {
+            fprintf(fp, "%lx default anon=%d dirty=%d active=0 N0=%d N1=%d kernelpagesize_kB=4\n",
+                    addr, 512, 512, 256 + i % 100, 256 - i % 100);
+        }
+    }
+    fflush(fp);
+    int *fd = __libc_malloc(sizeof(int));
+    if (!fd) return -1;
+    *fd = dup(fileno(fp));
+    fclose(fp);
+    *ctx = fd;
+    return *fd < 0 ? -1 : 0;
+}
+
+
+static void bench_numa_parse(void *ctx) {
+    static numa_usage_t usage;
+    int fd = *(int *)ctx;
+    lseek(fd, 0, SEEK_SET);
+    numa_parse(fd, &usage);
+}
+
+
+static void teardown_numa_maps(void *ctx) {
+    close(*(int *)ctx);
+    __libc_free(ctx);
+}
+
+
+
+//a kmem sample of the live kernel, after the first one mostly unchanged slab lines
+static int setup_kmem(void **ctx) {
+    kmem_t *km = __libc_malloc(sizeof(kmem_t));
+    if (!km) return -1;
+    if (kmem_init(km) != 0 || kmem_sample(km, 0) != 0) {
+        __libc_free(km);
+        return -1;
+    }
+    *ctx = km;
+    return 0;
+}
+
+
+static void bench_kmem_sample(void *ctx) {
+    kmem_t *km = ctx;
+    kmem_sample(km, (long long)km->samples * 1000);
+}
+
+
+static void teardown_kmem(void *ctx) {
+    kmem_free(ctx);
+    __libc_free(ctx);
+}
+
+
+//one libmemtrc sample: statm pread, getrusage and the trigger checks
+static int setup_self(void **ctx) {
+    memtrc_self_t *ms = __libc_malloc(sizeof(memtrc_self_t));
+    if (!ms) return -1;
+    if (memtrc_self_init(ms) != 0) {
+        __libc_free(ms);
+        return -1;
+    }
+    memtrc_self_set_threshold(ms, 1L << 30);
+    memtrc_self_set_growth(ms, 1L << 20, 1000);
+    *ctx = ms;
+    return 0;
+}
+
+
+static void bench_self_sample(void *ctx) {
+    memtrc_self_sample(ctx, NULL);
+}
+
+
+static void teardown_self(void *ctx) {
+    memtrc_self_free(ctx);
+    __libc_free(ctx);
+}
+
+//the same pass for the leaderboard: one stat read per pid, merged into the table
+static int setup_leader(void **ctx) {
+    if (setup_fixture(ctx) != 0) return -1;
+    leader_t *lb = __libc_malloc(sizeof(leader_t));
+    if (!lb || leader_init(lb, 300000) != 0) {
+        __libc_free(lb);
+        teardown_fixture(NULL);
+        return -1;
+    }
+    *ctx = lb;
+    return 0;
+}
+
+
+static void bench_leader_scan(void *ctx) {
+    static long long now_ms = 0;
+    leader_scan(ctx, now_ms += 1000);
+}
+
+
+static void teardown_leader(void *ctx) {
+    leader_free(ctx);
+    __libc_free(ctx);
+    teardown_fixture(NULL);
+}
+
+
+/*
+ * fleet aggregation over 100k targets: RSS sum/min/max/count above a threshold
+ * from the column store with each kernel, and the same from one history per
+ * target, the pointer walk the column store replaces
+ */
+#define FLEET_TARGETS 100000
+
+static int setup_colstore(void **ctx) {
+    colstore_t *cs = __libc_malloc(sizeof(colstore_t));
+    if (!cs) return -1;
+    if (colstore_init(cs, FLEET_TARGETS) != 0) {
+        __libc_free(cs);
+        return -1;
+    }
+    for (int i = 0; i < FLEET_TARGETS; i++) {
+        mem_info_t info = { .proc_type = PROC_TYPE_USER };
+        info.vmrss = (long)(i * 7919 % 2000000) * KB_UNIT;
+        info.vmsize = info.vmrss * 3;
+        colstore_set(cs, i, 1000 + i, &info);
+    }
+    *ctx = cs;
+    return 0;
+}
+
+
+static int setup_colstore_kernel(void **ctx, colstore_kernel_t kernel) {
+    if (colstore_set_kernel(kernel) != 0) return BENCH_SKIP;
+    return setup_colstore(ctx);
+}
+
+static int setup_colstore_scalar(void **ctx) { return setup_colstore_kernel(ctx, COLSTORE_KERNEL_SCALAR); }
+static int setup_colstore_sse2(void **ctx) { return setup_colstore_kernel(ctx, COLSTORE_KERNEL_SSE2); }
+static int setup_colstore_avx2(void **ctx) { return setup_colstore_kernel(ctx, COLSTORE_KERNEL_AVX2); }
+
+
+static void teardown_colstore(void *ctx) {
+    colstore_free(ctx);
+    __libc_free(ctx);
+    colstore_set_kernel(COLSTORE_KERNEL_AUTO);
+}
+
+
+static void bench_colstore_aggregate(void *ctx) {
+    colstore_agg_t agg;
+    colstore_aggregate(ctx, COL_RSS, 1000000, &agg);
+    __asm__ volatile("" : : "r"(&agg) : "memory");
+}
+
+
+static int setup_fleet_history(void **ctx) {
+    history_data_t **hists = __libc_malloc(FLEET_TARGETS * sizeof(history_data_t *));
+    if (!hists) return -1;
+    for (int i = 0; i < FLEET_TARGETS; i++) {
+        hists[i] = __libc_malloc(sizeof(history_data_t));
+        if (!hists[i]) return -1;
+        init_history(hists[i]);
+        update_history(hists[i], (long)(i * 7919 % 2000000) * KB_UNIT);
+    }
+    *ctx = hists;
+    return 0;
+}
+
+
+static void teardown_fleet_history(void *ctx) {
+    history_data_t **hists = ctx;
+    for (int i = 0; i < FLEET_TARGETS; i++) __libc_free(hists[i]);
+    __libc_free(hists);
+}
+
+
+static void bench_fleet_history(void *ctx) {
+    history_data_t **hists = ctx;
+    long long sum = 0;
+    long lo = LONG_MAX, hi = 0, above = 0;
+    for (int i = 0; i < FLEET_TARGETS; i++) {
+        long v = hists[i]->data[hists[i]->count - 1];
+        sum += v;
+        if (v < lo) lo = v;
+        if (v > hi) hi = v;
+        above += v > 1000000L * KB_UNIT;
+    }
+    __asm__ volatile("" : : "r"(sum), "r"(lo), "r"(hi), "r"(above) : "memory");
+}
+
+
+static const bench_case_t cases[] = {
+    { "read_mem_info_live", NULL, bench_read_mem_info_live, NULL },
+    { "get_process_type", NULL, bench_get_process_type, NULL },
+    { "get_process_type_miss", NULL, bench_get_process_type_miss, NULL },
+    { "update_history", setup_history, bench_update_history, teardown_history },
+    { "prepare_chart", setup_history, bench_prepare_chart, teardown_history },
+    { "draw_chart_devnull", setup_chart_devnull, bench_draw_chart, teardown_chart_devnull },
+    { "write_log_devnull", setup_devnull_file, bench_write_log, teardown_devnull_file },
+    { "sink_csv_devnull", setup_sink_csv, bench_sink_write, teardown_sink },
+    { "sink_jsonl_devnull", setup_sink_jsonl, bench_sink_write, teardown_sink },
+    { "parse_command", NULL, bench_parse_command, NULL },
+    { "parse_log_line", NULL, bench_parse_log_line, NULL },
+    { "ts_series_append", setup_series, bench_series_append, teardown_series },
+    { "read_mem_info_fixture", setup_fixture, bench_read_mem_info_fixture, teardown_fixture },
+    { "fixture_scan", setup_fixture, bench_fixture_scan, teardown_fixture },
+    { "leader_scan_fixture", setup_leader, bench_leader_scan, teardown_leader },
+    { "numa_parse_5k", setup_numa_maps, bench_numa_parse, teardown_numa_maps },
+    { "kmem_sample_live", setup_kmem, bench_kmem_sample, teardown_kmem },
+    { "memtrc_self_sample", setup_self, bench_self_sample, teardown_self },
+    { "fleet_history_100k", setup_fleet_history, bench_fleet_history, teardown_fleet_history },
+    { "colstore_scalar_100k", setup_colstore_scalar, bench_colstore_aggregate, teardown_colstore },
+    { "colstore_sse2_100k", setup_colstore_sse2, bench_colstore_aggregate, teardown_colstore },
+    { "colstore_avx2_100k", setup_colstore_avx2, bench_colstore_aggregate, teardown_colstore },
+};
+
+
+static void print_result(bench_format_t fmt, const bench_result_t *r, int first) {
+    switch (fmt) {
+        case FORMAT_CSV:
+            printf("%s,%lu,%d,%lu,%.1f,%.1f,%.1f,%.3f\n", r->name, r->warmup_ops, r->reps,
+                   r->batch, r->median_ns, r->p99_ns, r->mean_ns, r->allocs_per_op);
+            break;
+        case FORMAT_JSON:
+            printf("%s    {\"name\": \"%s\", \"warmup_ops\": %lu, \"reps\": %d, \"batch\": %lu, "
+                   "\"median_ns\": %.1f, \"p99_ns\": %.1f, \"mean_ns\": %.1f, "
+                   "\"allocs_per_op\": %.3f}",
+                   first ? "" : ",\n", r->name, r->warmup_ops, r->reps, r->batch,
+                   r->median_ns, r->p99_ns, r->mean_ns, r->allocs_per_op);
+            break;
+        case FORMAT_TEXT:
+        default:
+            printf("%-22s %10lu %6d %8lu %12.1f %12.1f %10.3f\n", r->name, r->warmup_ops,
+                   r->reps, r->batch, r->median_ns, r->p99_ns, r->allocs_per_op);
+            break;
+    }
+}
+
+
+/*
+ * sampler scaling: whole ticks over n targets for each backend, reported as
+ * ticks per second, cpu per tick and syscalls per tick. targets come from a
+ * fixture tree by default, -L samples the live /proc (pids reused round robin)
+ */
+#define SCALING_MIN_SECS 1.0
+#define SCALING_MIN_TICKS 3
+
+static double cpu_seconds(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+           ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+
+static int collect_live_pids(pid_t *pids, int max) {
+    DIR *dir = opendir("/proc");
+    int n = 0;
+    if (!dir) return 0;
+    struct dirent *de;
+    while (n < max && (de = readdir(dir)) != NULL) {
+        if (de->d_name[0] >= '1' && de->d_name[0] <= '9') pids[n++] = atoi(de->d_name);
+    }
+    closedir(dir);
+    return n;
+}
+
+
+static int run_scaling(bench_format_t fmt, const char *sizes, int live) {
+    int counts[16], nsizes = 0, max = 0;
+    char *copy = strdup(sizes), *save = NULL;
+    for (char *tok = strtok_r(copy, ",", &save); tok && nsizes < 16;
+         tok = strtok_r(NULL, ",", &save)) {
+        counts[nsizes] = atoi(tok);
+        if (counts[nsizes] <= 0) {
+            free(copy);
+            return -1;
+        }
+        if (counts[nsizes] > max) max = counts[nsizes];
+        nsizes++;
+    }
+    free(copy);
+
+    pid_t live_pids[4096];
+    int nlive = 0;
+    if (live) {
+        nlive = collect_live_pids(live_pids, 4096);
+        if (nlive == 0) return -1;
+    } else {
+        fixture_pids = max;
+        void *ctx;
+        fprintf(stderr, "generating %d pid fixture...\n", max);
+        if (setup_fixture(&ctx) != 0) return -1;
+    }
+
+    if (fmt == FORMAT_CSV) {
+        printf("backend,targets,ticks,ticks_per_sec,cpu_us_per_tick,syscalls_per_tick\n");
+    } else if (fmt == FORMAT_JSON) {
+        printf("{\"sampler_scaling\": [\n");
+    } else {
+        printf("%-10s %8s %8s %12s %14s %14s\n", "backend", "targets", "ticks",
+               "ticks/s", "cpu us/tick", "syscalls/tick");
+    }
+
+    int first = 1, failed = 0;
+    sampler_backend_t backends[] = { SAMPLER_PREAD, SAMPLER_URING };
+    for (int i = 0; i < nsizes; i++) {
+        for (int b = 0; b < 2; b++) {
+            sampler_t smp;
+            if (sampler_init(&smp, backends[b]) != 0) return -1;
+            if (smp.backend != backends[b]) {   //io_uring unavailable, nothing to compare
+                sampler_free(&smp);
+                continue;
+            }
+            int added = 0;
+            for (int t = 0; t < counts[i]; t++) {
+                pid_t pid = live ? live_pids[t % nlive] : 1000 + t;
+                if (sampler_add(&smp, pid) != 0) break;
+                added++;
+            }
+            if (added < counts[i]) {
+                fprintf(stderr, "%s: only %d of %d targets, skipped\n",
+                        sampler_backend_name(backends[b]), added, counts[i]);
+                sampler_free(&smp);
+                failed++;
+                continue;
+            }
+
+            sampler_tick(&smp);     //registers fds, faults in buffers
+            unsigned long long sys0 = smp.syscalls;
+            unsigned long ticks = 0;
+            double cpu0 = cpu_seconds();
+            uint64_t t0 = now_ns(), elapsed;
+            do {
+                sampler_tick(&smp);
+                ticks++;
+                elapsed = now_ns() - t0;
+            } while (elapsed < SCALING_MIN_SECS * 1e9 || ticks < SCALING_MIN_TICKS);
+            double cpu = cpu_seconds() - cpu0;
+            double tps = ticks / (elapsed / 1e9);
+            double cpu_us = cpu * 1e6 / ticks;
+            double sys = (double)(smp.syscalls - sys0) / ticks;
+
+            if (fmt == FORMAT_CSV) {
+                printf("%s,%d,%lu,%.2f,%.1f,%.1f\n", sampler_backend_name(smp.backend),
+                       counts[i], ticks, tps, cpu_us, sys);
+            } else if (fmt == FORMAT_JSON) {
+                printf("%s    {\"backend\": \"%s\", \"targets\": %d, \"ticks\": %lu, "
+                       "\"ticks_per_sec\": %.2f, \"cpu_us_per_tick\": %.1f, "
+                       "\"syscalls_per_tick\": %.1f}", first ? "" : ",\n",
+                       sampler_backend_name(smp.backend), counts[i], ticks, tps, cpu_us, sys);
+            } else {
+                printf("%-10s %8d %8lu %12.2f %14.1f %14.1f\n", sampler_backend_name(smp.backend),
+                       counts[i], ticks, tps, cpu_us, sys);
+            }
+            first = 0;
+            fflush(stdout);
+            sampler_free(&smp);
+        }
+    }
+    if (fmt == FORMAT_JSON) printf("\n]}\n");
+    if (!live) teardown_fixture(NULL);
+    return failed ? 1 : 0;
+}
+
+
+
+/*
+ * libmemtrc's sampler thread at hz for SELF_COST_SECS, as a service would run
+ * it: the thread's own cpu time per sample and as a share of one cpu
+ */
+#define SELF_COST_SECS 5
+
+static int run_self_cost(bench_format_t fmt, int hz) {
+    memtrc_self_t ms;
+    if (hz <= 0 || hz > 1000 || memtrc_self_init(&ms) != 0) return -1;
+    memtrc_self_set_threshold(&ms, 1L << 30);
+    memtrc_self_set_growth(&ms, 1L << 20, 1000);
+    uint64_t t0 = now_ns();
+    if (memtrc_self_start(&ms, 1000 / hz) != 0) {
+        memtrc_self_free(&ms);
+        return -1;
+    }
+    sleep(SELF_COST_SECS);
+    memtrc_self_stop(&ms);
+    double secs = (now_ns() - t0) / 1e9;
+    double us = ms.head ? ms.cpu_ns / 1e3 / ms.head : 0.0;
+    double share = ms.cpu_ns / 1e9 / secs * 100.0;
+    if (fmt == FORMAT_CSV) {
+        printf("hz,seconds,samples,cpu_us_per_sample,cpu_percent\n%d,%.2f,%lu,%.2f,%.4f\n",
+               hz, secs, ms.head, us, share);
+    } else if (fmt == FORMAT_JSON) {
+        printf("{\"self_cost\": {\"hz\": %d, \"seconds\": %.2f, \"samples\": %lu, "
+               "\"cpu_us_per_sample\": %.2f, \"cpu_percent\": %.4f}}\n", hz, secs, ms.head, us, share);
+    } else {
+        printf("%6s %8s %8s %14s %8s\n", "hz", "seconds", "samples", "cpu us/sample", "cpu %");
+        printf("%6d %8.2f %8lu %14.2f %8.4f\n", hz, secs, ms.head, us, share);
+    }
+    memtrc_self_free(&ms);
+    return 0;
+}
+
+
+/*
+ * target perturbation: a forked workload whose threads mmap, fault in and
+ * munmap 64 KB over and over (mmap lock writers and page faults) next to
+ * PERTURB_VMAS small mappings that make smaps long, timed per operation.
+ * the bench process traces it with one collection mode at one interval, and
+ * the workload's throughput and latency quantiles are compared with an
+ * untraced run before and after, which also shows the noise between runs
+ */
+#define PERTURB_VMAS     4000
+#define PERTURB_OP_BYTES (64 * 1024)
+#define PERTURB_THREADS  4         //at most, one per online cpu by default
+#define PERTURB_SECS     2
+#define PERTURB_MAX_THREADS 64
+
+typedef enum {
+    PERTURB_NONE,
+    PERTURB_STATUS,         //read_mem_info(), what trace does every tick
+    PERTURB_ROLLUP,         //smaps_rollup, the flight recorder's snapshot
+    PERTURB_SMAPS,          //full smaps
+    PERTURB_NUMA,           //numa_maps, trace -N
+    PERTURB_MODES
+} perturb_mode_t;
+
+static const char *perturb_names[PERTURB_MODES] = {
+    "none", "status", "smaps_rollup", "smaps", "numa_maps"
+};
+
+typedef struct {
+    uint64_t ops;
+    sketch_t lat;           //ns per operation
+} perturb_slot_t;
+
+//shared with the forked workload
+typedef struct {
+    int ready;
+    int go;
+    int stop;
+    int threads;
+    perturb_slot_t slots[PERTURB_MAX_THREADS];
+} perturb_shm_t;
+
+typedef struct {
+    perturb_shm_t *shm;
+    int idx;
+} perturb_arg_t;
+
+
+static void *perturb_worker(void *arg) {
+    perturb_arg_t *pa = arg;
+    perturb_shm_t *shm = pa->shm;
+    perturb_slot_t *slot = &shm->slots[pa->idx];
+    long page = sysconf(_SC_PAGESIZE);
+    while (!__atomic_load_n(&shm->go, __ATOMIC_ACQUIRE)) sched_yield();
+    while (!__atomic_load_n(&shm->stop, __ATOMIC_RELAXED)) {
+        uint64_t t0 = now_ns();
+        char *p = mmap(NULL, PERTURB_OP_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) break;
+        for (long off = 0; off < PERTURB_OP_BYTES; off += page) p[off] = 1;
+        munmap(p, PERTURB_OP_BYTES);
+        sketch_add(&slot->lat, (long)(now_ns() - t0));
+        slot->ops++;
+    }
+    return NULL;
+}
+
+
+static void perturb_workload(perturb_shm_t *shm) {
+    long page = sysconf(_SC_PAGESIZE);
+    //alternating protections keep the small mappings from merging
+    for (int i = 0; i < PERTURB_VMAS; i++) {
+        char *p = mmap(NULL, page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) break;
+        p[0] = 1;
+        if (i % 2) mprotect(p, page, PROT_READ);
+    }
+    pthread_t tids[PERTURB_MAX_THREADS];
+    perturb_arg_t args[PERTURB_MAX_THREADS];
+    int started = 0;
+    for (; started < shm->threads; started++) {
+        args[started].shm = shm;
+        args[started].idx = started;
+        if (pthread_create(&tids[started], NULL, perturb_worker, &args[started]) != 0) break;
+    }
+    __atomic_store_n(&shm->ready, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < started; i++) pthread_join(tids[i], NULL);
+}
+
+
+//whole file through buf, the way the tool's readers consume it
+static long perturb_read(pid_t pid, const char *file, char *buf, size_t size) {
+    char path[PATH_MAX];
+    if (proc_path(path, sizeof(path), pid, file) != 0) return -1;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    long total = 0;
+    ssize_t n;
+    while ((n = read(fd, buf, size)) > 0) total += n;
+    close(fd);
+    return total;
+}
+
+
+static void perturb_probe(perturb_mode_t mode, pid_t pid, char *buf, size_t size) {
+    mem_info_t info;
+    numa_usage_t usage;
+    char path[PATH_MAX];
+    switch (mode) {
+        case PERTURB_STATUS:
+            read_mem_info(pid, &info);
+            break;
+        case PERTURB_ROLLUP:
+            perturb_read(pid, "smaps_rollup", buf, size);
+            break;
+        case PERTURB_SMAPS:
+            perturb_read(pid, "smaps", buf, size);
+            break;
+        case PERTURB_NUMA:
+            if (proc_path(path, sizeof(path), pid, "numa_maps") == 0) {
+                int fd = open(path, O_RDONLY | O_CLOEXEC);
+                if (fd >= 0) {
+                    numa_parse(fd, &usage);
+                    close(fd);
+                }
+            }
+            break;
+        case PERTURB_NONE:
+        default:
+            break;
+    }
+}
+
+
+typedef struct {
+    perturb_mode_t mode;
+    int interval_ms;
+    double ops_per_sec;
+    long p50_ns, p99_ns, p999_ns, max_ns;
+    unsigned long probes;
+    double probe_us;        //mean cost of one probe in the tracer
+} perturb_result_t;
+
+
+static int perturb_run(perturb_mode_t mode, int interval_ms, int threads, int secs, perturb_result_t *r) {
+    perturb_shm_t *shm = mmap(NULL, sizeof(perturb_shm_t), PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shm == MAP_FAILED) return -1;
+    memset(shm, 0, sizeof(perturb_shm_t));
+    shm->threads = threads;
+    for (int i = 0; i < threads; i++) sketch_init(&shm->slots[i].lat);
+    pid_t pid = fork();
+    if (pid < 0) {
+        munmap(shm, sizeof(perturb_shm_t));
+        return -1;
+    }
+    if (pid == 0) {
+        perturb_workload(shm);
+        _exit(0);
+    }
+    //a workload killed while setting up (oom, a signal) never gets ready
+    while (!__atomic_load_n(&shm->ready, __ATOMIC_ACQUIRE)) {
+        if (waitpid(pid, NULL, WNOHANG) != 0) {
+            fprintf(stderr, "perturbation: workload exited before it was ready\n");
+            munmap(shm, sizeof(perturb_shm_t));
+            return -1;
+        }
+        usleep(1000);
+    }
+
+    static char buf[65536];
+    memset(r, 0, sizeof(perturb_result_t));
+    r->mode = mode;
+    r->interval_ms = interval_ms;
+    uint64_t probe_ns = 0;
+    __atomic_store_n(&shm->go, 1, __ATOMIC_RELEASE);
+    uint64_t t0 = now_ns(), end = t0 + (uint64_t)secs * 1000000000ULL;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (now_ns() < end) {
+        if (mode != PERTURB_NONE) {
+            uint64_t p0 = now_ns();
+            perturb_probe(mode, pid, buf, sizeof(buf));
+            probe_ns += now_ns() - p0;
+            r->probes++;
+        }
+        next.tv_nsec += (long)(mode == PERTURB_NONE ? 100 : interval_ms) * 1000000L;
+        next.tv_sec += next.tv_nsec / 1000000000L;
+        next.tv_nsec %= 1000000000L;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+    __atomic_store_n(&shm->stop, 1, __ATOMIC_RELAXED);
+    double elapsed = (now_ns() - t0) / 1e9;
+    waitpid(pid, NULL, 0);
+    proc_type_cache_forget(pid);
+
+    static sketch_t lat;
+    sketch_init(&lat);
+    uint64_t ops = 0;
+    for (int i = 0; i < threads; i++) {
+        ops += shm->slots[i].ops;
+        sketch_merge(&lat, &shm->slots[i].lat);
+    }
+    munmap(shm, sizeof(perturb_shm_t));
+    r->ops_per_sec = ops / elapsed;
+    r->p50_ns = sketch_quantile(&lat, 0.50);
+    r->p99_ns = sketch_quantile(&lat, 0.99);
+    r->p999_ns = sketch_quantile(&lat, 0.999);
+    r->max_ns = lat.max;
+    r->probe_us = r->probes ? probe_ns / 1e3 / r->probes : 0.0;
+    return 0;
+}
+
+
+static void perturb_print(bench_format_t fmt, const perturb_result_t *r, double base_ops, int first) {
+    double delta = base_ops > 0 ? (r->ops_per_sec / base_ops - 1.0) * 100.0 : 0.0;
+    switch (fmt) {
+        case FORMAT_CSV:
+            printf("%s,%d,%.0f,%.2f,%.2f,%.2f,%.2f,%.2f,%lu,%.1f\n", perturb_names[r->mode],
+                   r->interval_ms, r->ops_per_sec, delta, r->p50_ns / 1e3, r->p99_ns / 1e3,
+                   r->p999_ns / 1e3, r->max_ns / 1e3, r->probes, r->probe_us);
+            break;
+        case FORMAT_JSON:
+            printf("%s    {\"mode\": \"%s\", \"interval_ms\": %d, \"ops_per_sec\": %.0f, "
+                   "\"ops_delta_pct\": %.2f, \"p50_us\": %.2f, \"p99_us\": %.2f, \"p999_us\": %.2f, "
+                   "\"max_us\": %.2f, \"probes\": %lu, \"probe_us\": %.1f}", first ? "" : ",\n",
+                   perturb_names[r->mode], r->interval_ms, r->ops_per_sec, delta, r->p50_ns / 1e3,
+                   r->p99_ns / 1e3, r->p999_ns / 1e3, r->max_ns / 1e3, r->probes, r->probe_us);
+            break;
+        case FORMAT_TEXT:
+        default:
+            printf("%-13s %8d %10.0f %+8.2f %9.1f %9.1f %9.1f %10.1f %8lu %10.1f\n",
+                   perturb_names[r->mode], r->interval_ms, r->ops_per_sec, delta, r->p50_ns / 1e3,
+                   r->p99_ns / 1e3, r->p999_ns / 1e3, r->max_ns / 1e3, r->probes, r->probe_us);
+            break;
+    }
+    fflush(stdout);
+}
+
+
+//every mode at every interval in the list, between two untraced runs
+static int run_perturbation(bench_format_t fmt, const char *intervals, int threads, int secs) {
+    int ms[16], n = 0;
+    char *copy = strdup(intervals), *save = NULL;
+    for (char *tok = strtok_r(copy, ",", &save); tok && n < 16; tok = strtok_r(NULL, ",", &save)) {
+        ms[n] = atoi(tok);
+        if (ms[n] <= 0) {
+            free(copy);
+            return -1;
+        }
+        n++;
+    }
+    free(copy);
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus < 1 ? 1 : cpus > PERTURB_THREADS ? PERTURB_THREADS : (int)cpus;
+    }
+    if (n == 0 || threads <= 0 || threads > PERTURB_MAX_THREADS || secs <= 0) return -1;
+
+    if (fmt == FORMAT_CSV) {
+        printf("mode,interval_ms,ops_per_sec,ops_delta_pct,p50_us,p99_us,p999_us,max_us,probes,probe_us\n");
+    } else if (fmt == FORMAT_JSON) {
+        printf("{\"perturbation\": {\"threads\": %d, \"seconds\": %d, \"vmas\": %d, \"runs\": [\n",
+               threads, secs, PERTURB_VMAS);
+    } else {
+        printf("workload: %d threads of mmap + fault + munmap %d KB, %d extra mappings, %d s per run\n",
+               threads, PERTURB_OP_BYTES / 1024, PERTURB_VMAS, secs);
+        printf("%-13s %8s %10s %8s %9s %9s %9s %10s %8s %10s\n", "mode", "every ms", "ops/s",
+               "ops %", "p50 us", "p99 us", "p99.9 us", "max us", "probes", "probe us");
+    }
+    perturb_result_t base, r;
+    if (perturb_run(PERTURB_NONE, 0, threads, secs, &base) != 0) {
+        if (fmt == FORMAT_JSON) printf("]}}\n");   //keep the document parseable
+        return 1;
+    }
+    perturb_print(fmt, &base, base.ops_per_sec, 1);
+    int failed = 0;
+    for (int mode = PERTURB_STATUS; mode < PERTURB_MODES; mode++) {
+        for (int i = 0; i < n; i++) {
+            if (perturb_run(mode, ms[i], threads, secs, &r) != 0) {
+                failed++;
+                continue;
+            }
+            perturb_print(fmt, &r, base.ops_per_sec, 0);
+        }
+    }
+    //untraced again: how far apart two identical runs are on this machine
+    if (perturb_run(PERTURB_NONE, 0, threads, secs, &r) == 0) {
+        perturb_print(fmt, &r, base.ops_per_sec, 0);
+    }
+    if (fmt == FORMAT_JSON) printf("\n]}}\n");
+    return failed ? 1 : 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-f text|csv|json] [-r reps] [-w warmup_ms] [-n fixture_pids] [name_filter]\n"
+            "       %s [-f text|csv|json] -s n1,n2,... [-L]   sampler backends at n targets\n"
+            "       %s [-f text|csv|json] -H hz   libmemtrc sampler thread cost at hz\n"
+            "       %s [-f text|csv|json] -P ms1,ms2,... [-T threads] [-D secs]   "
+            "impact of tracing on a workload\n",
+            prog, prog, prog, prog);
+}
+
+
+int main(int argc, char *argv[]) {
+    bench_format_t fmt = FORMAT_TEXT;
+    int reps = BENCH_DEFAULT_REPS;
+    int warmup_ms = BENCH_DEFAULT_WARMUP;
+    const char *filter = NULL;
+    const char *scaling = NULL;
+    int live = 0;
+    int self_hz = 0;
+    const char *perturb = NULL;
+    int perturb_threads = 0;
+    int perturb_secs = PERTURB_SECS;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "csv") == 0) fmt = FORMAT_CSV;
+            else if (strcmp(argv[i], "json") == 0) fmt = FORMAT_JSON;
+            else if (strcmp(argv[i], "text") == 0) fmt = FORMAT_TEXT;
+            else {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            reps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            warmup_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            fixture_pids = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            scaling = argv[++i];
+        } else if (strcmp(argv[i], "-L") == 0) {
+            live = 1;
+        } else if (strcmp(argv[i], "-H") == 0 && i + 1 < argc) {
+            self_hz = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-P") == 0 && i + 1 < argc) {
+            perturb = argv[++i];
+        } else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc) {
+            perturb_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-D") == 0 && i + 1 < argc) {
+            perturb_secs = atoi(argv[++i]);
+        } else if (argv[i][0] != '-') {
+            filter = argv[i];
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (reps <= 0 || warmup_ms < 0 || fixture_pids <= 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (perturb) {
+        int rc = run_perturbation(fmt, perturb, perturb_threads, perturb_secs);
+        if (rc < 0) usage(argv[0]);
+        return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    if (self_hz) {
+        int rc = run_self_cost(fmt, self_hz);
+        if (rc < 0) usage(argv[0]);
+        return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    if (scaling) {
+        int rc = run_scaling(fmt, scaling, live);
+        if (rc < 0) usage(argv[0]);
+        return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    switch (fmt) {
+        case FORMAT_CSV:
+            printf("name,warmup_ops,reps,batch,median_ns,p99_ns,mean_ns,allocs_per_op\n");
+            break;
+        case FORMAT_JSON:
+            printf("{\"benchmarks\": [\n");
+            break;
+        case FORMAT_TEXT:
+        default:
+            printf("%-22s %10s %6s %8s %12s %12s %10s\n", "benchmark", "warmup", "reps",
+                   "batch", "median ns/op", "p99 ns/op", "allocs/op");
+            break;
+    }
+
+    int first = 1;
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (filter && !strstr(cases[i].name, filter)) continue;
+        bench_result_t res;
+        int rc = run_case(&cases[i], reps, warmup_ms, &res);
+        if (rc == BENCH_SKIP) continue;
+        if (rc != 0) {
+            failed++;
+            continue;
+        }
+        print_result(fmt, &res, first);
+        first = 0;
+        fflush(stdout);
+    }
+    if (fmt == FORMAT_JSON) {
+        printf("\n]}\n");
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -36,6 +36,12 @@ void init_history(history_data_t *hist) {
 
 
 void update_history(history_data_t *hist, long value) {
+    update_history_at(hist, 0, value);
+}
+
+
+//ts_ms places the point on a time axis, so unevenly spaced samples chart correctly
+void update_history_at(history_data_t *hist, long long ts_ms, long value) {
     if (!hist) {
         fprintf(stderr, "Error: history_data_t pointer is NULL\n");
         return;
@@ -54,11 +60,13 @@ void update_history(history_data_t *hist, long value) {
     //move data when hist is full
     if (hist->count == MAX_HISTORY) {
         memmove(hist->data, hist->data + 1, (MAX_HISTORY - 1) * sizeof(long));
+        memmove(hist->ts, hist->ts + 1, (MAX_HISTORY - 1) * sizeof(long long));
         hist->count--;
     }
     
     //add new data
     if (hist->count < MAX_HISTORY) {
+        hist->ts[hist->count] = ts_ms;
         hist->data[hist->count++] = value;
     } else {
         fprintf(stderr, "Error: Cannot add more data, history is full\n");
@@ -116,16 +124,25 @@ void prepare_chart(const history_data_t *hist, char chart[CHART_HEIGHT][CHART_WI
     if (hist->count > 0) {
         long range = hist->max_value - hist->min_value;
         if (range == 0) range = 1;
-        for (int i = 0; i < hist->count && i < CHART_WIDTH - 1; i++) {
+        //timestamped histories span the whole width by time, others one column per point
+        long long t0 = hist->ts[0];
+        long long span = hist->ts[hist->count - 1] - t0;
+        int timed = t0 > 0 && span > 0;
+        for (int i = 0; i < hist->count && (timed || i < CHART_WIDTH - 1); i++) {
             /*
              * need exercise due diligence to ensure the range 
              * and bounds are valid,because we are using chart 
              * with fixed array
             */
+            int x = i + 1;
+            if (timed) {
+                if (hist->ts[i] < t0) continue;
+                x = 1 + (int)((hist->ts[i] - t0) * (CHART_WIDTH - 2) / span);
+            }
             int y = CHART_HEIGHT - 2 - 
                    (int)((hist->data[i] - hist->min_value) * (CHART_HEIGHT - 3) / range);
-            if (y >= 0 && y < CHART_HEIGHT - 1) {
-                chart[y][i + 1] = '*';
+            if (y >= 0 && y < CHART_HEIGHT - 1 && x > 0 && x < CHART_WIDTH) {
+                chart[y][x] = '*';
             }
         }
     }
@@ -287,3 +304,75 @@ void stop_realtime_chart() {
     printf("\033[?25h"); //display cursor
     printf("\n\n");
 }
+
+
+//fold one row into the time bucket it falls in, a bucket keeps its max to show peaks
+typedef struct {
+    long long first_ts;
+    long long span;         //last_ts - first_ts + 1
+    long long bucket;       //current bucket index, -1 before the first row
+    long bucket_max;
+} series_fold_t;
+
+static void flush_series_bucket(history_data_t *hist, series_fold_t *f) {
+    if (f->bucket < 0) return;
+    const long long buckets = CHART_WIDTH - 1;
+    long long ts = f->first_ts + f->bucket * f->span / buckets;
+    update_history_at(hist, ts > 0 ? ts : 1, f->bucket_max < 0 ? 0 : f->bucket_max);
+}
+
+static void fold_series_row(history_data_t *hist, series_fold_t *f, long long ts, long value) {
+    const long long buckets = CHART_WIDTH - 1;
+    long long b = (ts - f->first_ts) * buckets / f->span;
+    if (b < 0) b = 0;
+    if (b >= buckets) b = buckets - 1;
+    if (b != f->bucket) {
+        flush_series_bucket(hist, f);
+        f->bucket = b;
+        f->bucket_max = LONG_MIN;
+    }
+    if (value > f->bucket_max) f->bucket_max = value;
+}
+
+
+//draw a whole compressed series, downsampled to the chart width
+void draw_series_chart(const ts_series_t *series, int col, const char *title) {
+    if (!series || col < 0 || col >= series->ncols) {
+        fprintf(stderr, "Error: invalid series or column\n");
+        return;
+    }
+    if (series->rows == 0) return;
+
+    long long *ts = malloc(CODEC_BLOCK_ROWS * sizeof(long long));
+    long (*vals)[CODEC_BLOCK_ROWS] = malloc(CODEC_MAX_COLS * sizeof(*vals));
+    if (!ts || !vals) {
+        fprintf(stderr, "Error: out of memory drawing series\n");
+        free(ts);
+        free(vals);
+        return;
+    }
+
+    //buckets cover equal time, not equal row counts, so dense bursts keep their width
+    series_fold_t fold = { 0, 1, -1, LONG_MIN };
+    fold.first_ts = series->nblocks ? series->blocks[0].first_ts : series->tail_ts[0];
+    long long last_ts = series->tail_rows ? series->tail_ts[series->tail_rows - 1] :
+                        series->blocks[series->nblocks - 1].last_ts;
+    fold.span = last_ts - fold.first_ts + 1;
+
+    history_data_t hist;
+    init_history(&hist);
+    for (size_t i = 0; i < series->nblocks; i++) {
+        if (codec_decode_block(series->ncols, &series->blocks[i], ts, vals) != 0) break;
+        for (uint32_t j = 0; j < series->blocks[i].rows; j++) {
+            fold_series_row(&hist, &fold, ts[j], vals[col][j]);
+        }
+    }
+    for (uint32_t j = 0; j < series->tail_rows; j++) {
+        fold_series_row(&hist, &fold, series->tail_ts[j], series->tail_vals[col][j]);
+    }
+    flush_series_bucket(&hist, &fold);
+    draw_chart(&hist, title);
+    cleanup_history(&hist);
+    free(ts);
+    free(vals);
+}
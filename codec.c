@@ -0,0 +1,513 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-5-25 09:40:12
+ * @Last modified: 2025-5-25 09:40:12
+ * @Description: Gorilla style block codec for memory samples.
+ *               timestamps: delta-of-delta, values: zigzag delta scaled by the
+ *               block's common alignment (page aligned counters lose their
+ *               low zero bits), both written with variable length bit buckets.
+ */
+
+#include "include/memtrc.h"
+#include "include/codec.h"
+#include <sys/stat.h>
+
+/*
+ * block payload layout (bit stream, msb first):
+ *   per column: 6 bit shift, 64 bit first value
+ *   per row >= 1: timestamp dod code, then one value code per column
+ * a code is a unary bucket prefix followed by the zigzag payload:
+ *   '0' -> zero, '10' -> b1 bits, '110' -> b2 bits, '1110' -> b3 bits, '1111' -> 64 bits
+ */
+static const int ts_bucket_bits[3] = { 7, 9, 12 };
+static const int val_bucket_bits[3] = { 6, 13, 20 };
+
+#define BLOCK_HEADER_BYTES (2 * sizeof(long long) + 2 * sizeof(uint32_t))
+
+
+typedef struct {
+    unsigned char *buf;
+    size_t len;
+    size_t cap;
+    uint64_t acc;   //pending bits, right aligned
+    int nbits;
+} bit_writer_t;
+
+typedef struct {
+    const unsigned char *buf;
+    size_t len;
+    size_t pos;
+    uint64_t acc;
+    int nbits;
+} bit_reader_t;
+
+
+static inline uint64_t zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+
+static inline int64_t unzigzag(uint64_t v) {
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+
+//append the low n bits of v, n <= 32
+static inline int bw_put32(bit_writer_t *w, uint32_t v, int n) {
+    if (n == 0) return 0;
+    w->acc = (w->acc << n) | (v & (n == 32 ? 0xffffffffu : ((1u << n) - 1)));
+    w->nbits += n;
+    if (w->len + 8 > w->cap) {
+        size_t new_cap = w->cap ? w->cap * 2 : 256;
+        unsigned char *tmp = realloc(w->buf, new_cap);
+        if (!tmp) return -1;
+        w->buf = tmp;
+        w->cap = new_cap;
+    }
+    while (w->nbits >= 8) {
+        w->nbits -= 8;
+        w->buf[w->len++] = (unsigned char)(w->acc >> w->nbits);
+    }
+    return 0;
+}
+
+
+static inline int bw_put64(bit_writer_t *w, uint64_t v) {
+    if (bw_put32(w, (uint32_t)(v >> 32), 32) != 0) return -1;
+    return bw_put32(w, (uint32_t)v, 32);
+}
+
+
+static int bw_flush(bit_writer_t *w) {
+    if (w->nbits > 0) {
+        return bw_put32(w, 0, 8 - w->nbits);
+    }
+    return 0;
+}
+
+
+static inline uint32_t br_get32(bit_reader_t *r, int n) {
+    if (n == 0) return 0;
+    while (r->nbits < n) {
+        uint64_t byte = r->pos < r->len ? r->buf[r->pos] : 0;
+        r->pos++;
+        r->acc = (r->acc << 8) | byte;
+        r->nbits += 8;
+    }
+    r->nbits -= n;
+    return (uint32_t)(r->acc >> r->nbits) & (n == 32 ? 0xffffffffu : ((1u << n) - 1));
+}
+
+
+static inline uint64_t br_get64(bit_reader_t *r) {
+    uint64_t hi = br_get32(r, 32);
+    return (hi << 32) | br_get32(r, 32);
+}
+
+
+static inline int put_code(bit_writer_t *w, uint64_t zz, const int bits[3]) {
+    if (zz == 0) return bw_put32(w, 0, 1);
+    for (int b = 0; b < 3; b++) {
+        if (zz < (1ULL << bits[b])) {
+            //prefix: b + 1 ones followed by a zero
+            if (bw_put32(w, ((1u << (b + 2)) - 2), b + 2) != 0) return -1;
+            return bw_put32(w, (uint32_t)zz, bits[b]);
+        }
+    }
+    if (bw_put32(w, 0xf, 4) != 0) return -1;
+    return bw_put64(w, zz);
+}
+
+
+static inline uint64_t get_code(bit_reader_t *r, const int bits[3]) {
+    int ones = 0;
+    while (ones < 4 && br_get32(r, 1)) ones++;
+    if (ones == 0) return 0;
+    if (ones == 4) return br_get64(r);
+    return br_get32(r, bits[ones - 1]);
+}
+
+
+int codec_encode_block(int ncols, const long long *ts, long vals[][CODEC_BLOCK_ROWS],
+        uint32_t rows, codec_block_t *blk) {
+    if (ncols <= 0 || ncols > CODEC_MAX_COLS || !ts || !vals || !blk ||
+        rows == 0 || rows > CODEC_BLOCK_ROWS) {
+        fprintf(stderr, "Error: Invalid arguments to codec_encode_block()\n");
+        return -1;
+    }
+    bit_writer_t w = {0};
+
+    //common trailing zero bits of all deltas, 12 for byte counts of whole pages
+    int shift[CODEC_MAX_COLS];
+    for (int c = 0; c < ncols; c++) {
+        uint64_t bits = 0;
+        for (uint32_t i = 1; i < rows; i++) {
+            bits |= (uint64_t)(vals[c][i] - vals[c][i - 1]);
+        }
+        shift[c] = bits ? __builtin_ctzll(bits) : 0;
+        if (bw_put32(&w, shift[c], 6) != 0 || bw_put64(&w, (uint64_t)vals[c][0]) != 0) {
+            goto oom;
+        }
+    }
+
+    long long prev_delta = 0;
+    for (uint32_t i = 1; i < rows; i++) {
+        long long delta = ts[i] - ts[i - 1];
+        if (put_code(&w, zigzag(delta - prev_delta), ts_bucket_bits) != 0) goto oom;
+        prev_delta = delta;
+        for (int c = 0; c < ncols; c++) {
+            int64_t d = (int64_t)(vals[c][i] - vals[c][i - 1]) >> shift[c];
+            if (put_code(&w, zigzag(d), val_bucket_bits) != 0) goto oom;
+        }
+    }
+    if (bw_flush(&w) != 0) goto oom;
+
+    blk->first_ts = ts[0];
+    blk->last_ts = ts[rows - 1];
+    blk->rows = rows;
+    blk->nbytes = (uint32_t)w.len;
+    blk->payload = w.buf;
+    return 0;
+
+oom:
+    fprintf(stderr, "Error: out of memory encoding block\n");
+    free(w.buf);
+    return -1;
+}
+
+
+int codec_decode_block(int ncols, const codec_block_t *blk, long long *ts,
+        long vals[][CODEC_BLOCK_ROWS]) {
+    if (ncols <= 0 || ncols > CODEC_MAX_COLS || !blk || !ts || !vals ||
+        blk->rows == 0 || blk->rows > CODEC_BLOCK_ROWS) {
+        fprintf(stderr, "Error: Invalid arguments to codec_decode_block()\n");
+        return -1;
+    }
+    bit_reader_t r = { .buf = blk->payload, .len = blk->nbytes };
+
+    int shift[CODEC_MAX_COLS];
+    for (int c = 0; c < ncols; c++) {
+        shift[c] = br_get32(&r, 6);
+        vals[c][0] = (long)br_get64(&r);
+    }
+    ts[0] = blk->first_ts;
+
+    long long delta = 0;
+    for (uint32_t i = 1; i < blk->rows; i++) {
+        delta += unzigzag(get_code(&r, ts_bucket_bits));
+        ts[i] = ts[i - 1] + delta;
+        for (int c = 0; c < ncols; c++) {
+            int64_t d = unzigzag(get_code(&r, val_bucket_bits));
+            vals[c][i] = vals[c][i - 1] + (long)((uint64_t)d << shift[c]);
+        }
+    }
+    if (r.pos > r.len) {
+        fprintf(stderr, "Error: truncated block payload\n");
+        return -1;
+    }
+    return 0;
+}
+
+
+void codec_free_block(codec_block_t *blk) {
+    if (!blk) return;
+    free(blk->payload);
+    blk->payload = NULL;
+    blk->nbytes = 0;
+    blk->rows = 0;
+}
+
+
+int ts_series_init(ts_series_t *s, int ncols) {
+    if (!s || ncols <= 0 || ncols > CODEC_MAX_COLS) {
+        fprintf(stderr, "Error: Invalid arguments to ts_series_init()\n");
+        return -1;
+    }
+    memset(s, 0, sizeof(ts_series_t));
+    s->ncols = ncols;
+    return 0;
+}
+
+
+//encode the tail into a sealed block, no-op on an empty tail
+int ts_series_seal(ts_series_t *s) {
+    if (!s || s->tail_rows == 0) return 0;
+    if (s->nblocks == s->cap) {
+        size_t new_cap = s->cap ? s->cap * 2 : 16;
+        codec_block_t *tmp = realloc(s->blocks, new_cap * sizeof(codec_block_t));
+        if (!tmp) {
+            fprintf(stderr, "Error: out of memory growing block index\n");
+            return -1;
+        }
+        s->blocks = tmp;
+        s->cap = new_cap;
+    }
+    codec_block_t *blk = &s->blocks[s->nblocks];
+    if (codec_encode_block(s->ncols, s->tail_ts, s->tail_vals, s->tail_rows, blk) != 0) {
+        return -1;
+    }
+    s->nblocks++;
+    s->enc_bytes += blk->nbytes + BLOCK_HEADER_BYTES;
+    s->tail_rows = 0;
+    return 0;
+}
+
+
+int ts_series_append(ts_series_t *s, long long ts, const long *vals) {
+    if (!s || !vals) {
+        fprintf(stderr, "Error: Invalid arguments to ts_series_append()\n");
+        return -1;
+    }
+    uint32_t i = s->tail_rows;
+    s->tail_ts[i] = ts;
+    for (int c = 0; c < s->ncols; c++) {
+        s->tail_vals[c][i] = vals[c];
+    }
+    s->tail_rows++;
+    s->rows++;
+    if (s->tail_rows == CODEC_BLOCK_ROWS) {
+        return ts_series_seal(s);
+    }
+    return 0;
+}
+
+
+//index of the sealed block holding ts (last block starting at or before it), -1 if none
+long ts_series_find_block(const ts_series_t *s, long long ts) {
+    if (!s || s->nblocks == 0 || ts < s->blocks[0].first_ts) return -1;
+    size_t lo = 0, hi = s->nblocks;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (s->blocks[mid].first_ts <= ts) lo = mid;
+        else hi = mid;
+    }
+    return (long)lo;
+}
+
+
+size_t ts_series_memory(const ts_series_t *s) {
+    if (!s) return 0;
+    size_t bytes = sizeof(ts_series_t) + s->cap * sizeof(codec_block_t);
+    for (size_t i = 0; i < s->nblocks; i++) {
+        bytes += s->blocks[i].nbytes;
+    }
+    return bytes;
+}
+
+
+void ts_series_free(ts_series_t *s) {
+    if (!s) return;
+    for (size_t i = 0; i < s->nblocks; i++) {
+        codec_free_block(&s->blocks[i]);
+    }
+    free(s->blocks);
+    s->blocks = NULL;
+    s->nblocks = s->cap = 0;
+    s->tail_rows = 0;
+    s->rows = 0;
+    s->enc_bytes = 0;
+}
+
+
+/*
+ * on-disk format: "MTZ1", uint32 ncols, then blocks of
+ * { int64 first_ts, int64 last_ts, uint32 rows, uint32 nbytes, payload }
+ * in host byte order. blocks are self contained, so a reader can seek to any.
+ */
+static int write_block(FILE *fp, const codec_block_t *blk) {
+    if (fwrite(&blk->first_ts, sizeof(blk->first_ts), 1, fp) != 1 ||
+        fwrite(&blk->last_ts, sizeof(blk->last_ts), 1, fp) != 1 ||
+        fwrite(&blk->rows, sizeof(blk->rows), 1, fp) != 1 ||
+        fwrite(&blk->nbytes, sizeof(blk->nbytes), 1, fp) != 1 ||
+        fwrite(blk->payload, 1, blk->nbytes, fp) != blk->nbytes) {
+        fprintf(stderr, "Error writing compressed log: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+
+//write out and drop sealed blocks, the writer only keeps the open tail in memory
+static int writer_drain(codec_writer_t *w) {
+    int ret = 0;
+    for (size_t i = 0; i < w->series.nblocks; i++) {
+        if (ret == 0 && write_block(w->fp, &w->series.blocks[i]) != 0) ret = -1;
+        w->file_bytes += BLOCK_HEADER_BYTES + w->series.blocks[i].nbytes;
+        codec_free_block(&w->series.blocks[i]);
+    }
+    w->series.nblocks = 0;
+    if (ret == 0 && fflush(w->fp) != 0) {
+        fprintf(stderr, "Error flushing compressed log: %s\n", strerror(errno));
+        ret = -1;
+    }
+    return ret;
+}
+
+
+int codec_writer_open(codec_writer_t *w, const char *path, int ncols) {
+    if (!w || !path) {
+        fprintf(stderr, "Error: Invalid arguments to codec_writer_open()\n");
+        return -1;
+    }
+    memset(w, 0, sizeof(codec_writer_t));
+    if (ts_series_init(&w->series, ncols) != 0) return -1;
+
+    //blocks are self contained, so an existing log is simply appended to
+    w->fp = fopen(path, "a+b");
+    if (!w->fp) {
+        fprintf(stderr, "Can't open file %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    uint32_t cols = ncols;
+    char magic[4];
+    uint32_t file_cols;
+    if (fseek(w->fp, 0, SEEK_END) == 0 && ftell(w->fp) > 0) {
+        rewind(w->fp);
+        if (fread(magic, 1, 4, w->fp) != 4 || memcmp(magic, CODEC_MAGIC, 4) != 0 ||
+            fread(&file_cols, sizeof(file_cols), 1, w->fp) != 1 || file_cols != cols) {
+            fprintf(stderr, "Error: %s is not a compressed log with %d columns\n", path, ncols);
+            fclose(w->fp);
+            w->fp = NULL;
+            return -1;
+        }
+        return 0;
+    }
+    if (fwrite(CODEC_MAGIC, 1, 4, w->fp) != 4 || fwrite(&cols, sizeof(cols), 1, w->fp) != 1) {
+        fprintf(stderr, "Error writing compressed log header: %s\n", strerror(errno));
+        fclose(w->fp);
+        w->fp = NULL;
+        return -1;
+    }
+    w->file_bytes = 4 + sizeof(cols);
+    return 0;
+}
+
+
+//a slow tracer fills a block in hours, so the tail is also sealed by age
+int codec_writer_append(codec_writer_t *w, long long ts, const long *vals) {
+    if (!w || !w->fp) return -1;
+    if (ts_series_append(&w->series, ts, vals) != 0) return -1;
+    ts_series_t *s = &w->series;
+    if (s->tail_rows > 0 && ts - s->tail_ts[0] >= CODEC_FLUSH_MS && ts_series_seal(s) != 0) {
+        return -1;
+    }
+    return s->nblocks ? writer_drain(w) : 0;
+}
+
+
+//seal the partial tail as a short block and close the file
+int codec_writer_close(codec_writer_t *w) {
+    if (!w || !w->fp) return -1;
+    int ret = 0;
+    if (ts_series_seal(&w->series) != 0 || writer_drain(w) != 0) ret = -1;
+    if (fclose(w->fp) != 0) {
+        fprintf(stderr, "Failed to close compressed log: %s\n", strerror(errno));
+        ret = -1;
+    }
+    w->fp = NULL;
+    ts_series_free(&w->series);
+    return ret;
+}
+
+
+int codec_is_compressed(const char *path) {
+    char magic[4];
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return 0;
+    int ret = fread(magic, 1, 4, fp) == 4 && memcmp(magic, CODEC_MAGIC, 4) == 0;
+    fclose(fp);
+    return ret;
+}
+
+
+//read the header and build the block offset index without touching payloads
+int codec_reader_open(codec_reader_t *r, const char *path) {
+    if (!r || !path) {
+        fprintf(stderr, "Error: Invalid arguments to codec_reader_open()\n");
+        return -1;
+    }
+    memset(r, 0, sizeof(codec_reader_t));
+    r->fp = fopen(path, "rb");
+    if (!r->fp) {
+        fprintf(stderr, "Can't open file %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    char magic[4];
+    uint32_t cols;
+    if (fread(magic, 1, 4, r->fp) != 4 || memcmp(magic, CODEC_MAGIC, 4) != 0 ||
+        fread(&cols, sizeof(cols), 1, r->fp) != 1 || cols == 0 || cols > CODEC_MAX_COLS) {
+        fprintf(stderr, "Error: %s is not a compressed memtrc log\n", path);
+        codec_reader_close(r);
+        return -1;
+    }
+    r->ncols = (int)cols;
+    struct stat sb;
+    if (fstat(fileno(r->fp), &sb) != 0) {
+        fprintf(stderr, "Can't stat %s: %s\n", path, strerror(errno));
+        codec_reader_close(r);
+        return -1;
+    }
+
+    size_t cap = 0;
+    for (;;) {
+        long off = ftell(r->fp);
+        long long first_last[2];
+        uint32_t rows_bytes[2];
+        if (fread(first_last, sizeof(first_last), 1, r->fp) != 1 ||
+            fread(rows_bytes, sizeof(rows_bytes), 1, r->fp) != 1) {
+            break;  //eof, a torn trailing header is ignored
+        }
+        //fseek happily goes past the end, a torn trailing payload is ignored too
+        long end = ftell(r->fp) + (long)rows_bytes[1];
+        if (end > sb.st_size || fseek(r->fp, end, SEEK_SET) != 0) break;
+        if (r->nblocks == cap) {
+            cap = cap ? cap * 2 : 64;
+            long *tmp = realloc(r->offsets, cap * sizeof(long));
+            if (!tmp) {
+                fprintf(stderr, "Error: out of memory indexing %s\n", path);
+                codec_reader_close(r);
+                return -1;
+            }
+            r->offsets = tmp;
+        }
+        r->offsets[r->nblocks++] = off;
+    }
+    return 0;
+}
+
+
+//load block idx, payload is malloc'd and released by codec_free_block()
+int codec_reader_block(codec_reader_t *r, size_t idx, codec_block_t *blk) {
+    if (!r || !r->fp || !blk || idx >= r->nblocks) return -1;
+    memset(blk, 0, sizeof(codec_block_t));
+    if (fseek(r->fp, r->offsets[idx], SEEK_SET) != 0 ||
+        fread(&blk->first_ts, sizeof(blk->first_ts), 1, r->fp) != 1 ||
+        fread(&blk->last_ts, sizeof(blk->last_ts), 1, r->fp) != 1 ||
+        fread(&blk->rows, sizeof(blk->rows), 1, r->fp) != 1 ||
+        fread(&blk->nbytes, sizeof(blk->nbytes), 1, r->fp) != 1) {
+        fprintf(stderr, "Error reading block %zu header\n", idx);
+        return -1;
+    }
+    blk->payload = malloc(blk->nbytes ? blk->nbytes : 1);
+    if (!blk->payload) {
+        fprintf(stderr, "Error: out of memory reading block %zu\n", idx);
+        return -1;
+    }
+    if (fread(blk->payload, 1, blk->nbytes, r->fp) != blk->nbytes) {
+        fprintf(stderr, "Error reading block %zu payload\n", idx);
+        codec_free_block(blk);
+        return -1;
+    }
+    return 0;
+}
+
+
+void codec_reader_close(codec_reader_t *r) {
+    if (!r) return;
+    if (r->fp) fclose(r->fp);
+    free(r->offsets);
+    r->fp = NULL;
+    r->offsets = NULL;
+    r->nblocks = 0;
+}
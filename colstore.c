@@ -0,0 +1,290 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-7-18 20:37:51
+ * @Last modified: 2025-7-18 20:37:51
+ * @Description: column store and its aggregation kernels. every kernel makes
+ *               one pass for sum, min, max and the count above a threshold.
+ *               the vector ones are compiled with target attributes, so the
+ *               binary runs anywhere and only takes AVX2 where the cpu has it.
+ *               sums widen to 64 bits, values are never negative.
+ */
+#include "include/memtrc.h"
+#include "include/colstore.h"
+#include "include/sampler.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define COLSTORE_HAVE_X86 1
+#endif
+
+typedef void (*agg_fn_t)(const int32_t *v, size_t n, int32_t thr, colstore_agg_t *out);
+
+static colstore_kernel_t active_kernel = COLSTORE_KERNEL_AUTO;
+static agg_fn_t active_fn;
+
+
+static void agg_scalar(const int32_t *v, size_t n, int32_t thr, colstore_agg_t *out) {
+    int64_t sum = 0;
+    int32_t lo = INT32_MAX, hi = INT32_MIN;
+    size_t above = 0;
+    for (size_t i = 0; i < n; i++) {
+        sum += v[i];
+        if (v[i] < lo) lo = v[i];
+        if (v[i] > hi) hi = v[i];
+        above += v[i] > thr;
+    }
+    out->sum += sum;
+    if (lo < out->min) out->min = lo;
+    if (hi > out->max) out->max = hi;
+    out->above += above;
+}
+
+
+#ifdef COLSTORE_HAVE_X86
+
+//SSE2 has no 32 bit min/max, they are a compare and a blend
+__attribute__((target("sse2")))
+static void agg_sse2(const int32_t *v, size_t n, int32_t thr, colstore_agg_t *out) {
+    size_t i = 0;
+    __m128i zero = _mm_setzero_si128();
+    __m128i vthr = _mm_set1_epi32(thr);
+    __m128i vmin = _mm_set1_epi32(INT32_MAX), vmax = _mm_set1_epi32(INT32_MIN);
+    __m128i vsum = zero, vabove = zero;
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = _mm_load_si128((const __m128i *)(v + i));
+        __m128i lt = _mm_cmplt_epi32(x, vmin);
+        vmin = _mm_or_si128(_mm_and_si128(lt, x), _mm_andnot_si128(lt, vmin));
+        __m128i gt = _mm_cmpgt_epi32(x, vmax);
+        vmax = _mm_or_si128(_mm_and_si128(gt, x), _mm_andnot_si128(gt, vmax));
+        vabove = _mm_sub_epi32(vabove, _mm_cmpgt_epi32(x, vthr));
+        vsum = _mm_add_epi64(vsum, _mm_unpacklo_epi32(x, zero));
+        vsum = _mm_add_epi64(vsum, _mm_unpackhi_epi32(x, zero));
+    }
+    int32_t lanes_min[4], lanes_max[4], lanes_above[4];
+    int64_t lanes_sum[2];
+    _mm_storeu_si128((__m128i *)lanes_min, vmin);
+    _mm_storeu_si128((__m128i *)lanes_max, vmax);
+    _mm_storeu_si128((__m128i *)lanes_above, vabove);
+    _mm_storeu_si128((__m128i *)lanes_sum, vsum);
+    for (int k = 0; k < 4; k++) {
+        if (lanes_min[k] < out->min) out->min = lanes_min[k];
+        if (lanes_max[k] > out->max) out->max = lanes_max[k];
+        out->above += (uint32_t)lanes_above[k];
+    }
+    out->sum += lanes_sum[0] + lanes_sum[1];
+    agg_scalar(v + i, n - i, thr, out);
+}
+
+
+__attribute__((target("avx2")))
+static void agg_avx2(const int32_t *v, size_t n, int32_t thr, colstore_agg_t *out) {
+    size_t i = 0;
+    __m256i vthr = _mm256_set1_epi32(thr);
+    __m256i vmin = _mm256_set1_epi32(INT32_MAX), vmax = _mm256_set1_epi32(INT32_MIN);
+    __m256i vsum = _mm256_setzero_si256(), vabove = _mm256_setzero_si256();
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_load_si256((const __m256i *)(v + i));
+        vmin = _mm256_min_epi32(vmin, x);
+        vmax = _mm256_max_epi32(vmax, x);
+        vabove = _mm256_sub_epi32(vabove, _mm256_cmpgt_epi32(x, vthr));
+        vsum = _mm256_add_epi64(vsum, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(x)));
+        vsum = _mm256_add_epi64(vsum, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(x, 1)));
+    }
+    int32_t lanes_min[8], lanes_max[8], lanes_above[8];
+    int64_t lanes_sum[4];
+    _mm256_storeu_si256((__m256i *)lanes_min, vmin);
+    _mm256_storeu_si256((__m256i *)lanes_max, vmax);
+    _mm256_storeu_si256((__m256i *)lanes_above, vabove);
+    _mm256_storeu_si256((__m256i *)lanes_sum, vsum);
+    for (int k = 0; k < 8; k++) {
+        if (lanes_min[k] < out->min) out->min = lanes_min[k];
+        if (lanes_max[k] > out->max) out->max = lanes_max[k];
+        out->above += (uint32_t)lanes_above[k];
+    }
+    out->sum += lanes_sum[0] + lanes_sum[1] + lanes_sum[2] + lanes_sum[3];
+    agg_scalar(v + i, n - i, thr, out);
+}
+
+#endif
+
+
+static int kernel_supported(colstore_kernel_t kernel) {
+    switch (kernel) {
+        case COLSTORE_KERNEL_SCALAR: return 1;
+#ifdef COLSTORE_HAVE_X86
+        case COLSTORE_KERNEL_SSE2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse2");
+        case COLSTORE_KERNEL_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        default: return 0;
+    }
+}
+
+
+//AUTO takes the widest supported kernel, -1 if the one asked for isn't
+int colstore_set_kernel(colstore_kernel_t kernel) {
+    if (kernel == COLSTORE_KERNEL_AUTO) {
+        kernel = kernel_supported(COLSTORE_KERNEL_AVX2) ? COLSTORE_KERNEL_AVX2 :
+                 kernel_supported(COLSTORE_KERNEL_SSE2) ? COLSTORE_KERNEL_SSE2 :
+                 COLSTORE_KERNEL_SCALAR;
+    }
+    if (!kernel_supported(kernel)) return -1;
+    switch (kernel) {
+#ifdef COLSTORE_HAVE_X86
+        case COLSTORE_KERNEL_SSE2: active_fn = agg_sse2; break;
+        case COLSTORE_KERNEL_AVX2: active_fn = agg_avx2; break;
+#endif
+        default: active_fn = agg_scalar; break;
+    }
+    active_kernel = kernel;
+    return 0;
+}
+
+
+colstore_kernel_t colstore_get_kernel(void) {
+    if (!active_fn) colstore_set_kernel(COLSTORE_KERNEL_AUTO);
+    return active_kernel;
+}
+
+
+const char *colstore_kernel_name(colstore_kernel_t kernel) {
+    switch (kernel) {
+        case COLSTORE_KERNEL_SCALAR: return "scalar";
+        case COLSTORE_KERNEL_SSE2: return "sse2";
+        case COLSTORE_KERNEL_AVX2: return "avx2";
+        case COLSTORE_KERNEL_AUTO:
+        default: return "auto";
+    }
+}
+
+
+static int grow(colstore_t *cs, size_t cap) {
+    //whole vectors of slack, so a column never ends inside a vector's cache line
+    cap = (cap + 15) & ~(size_t)15;
+    for (int c = 0; c < COL_COUNT; c++) {
+        void *col;
+        if (posix_memalign(&col, COLSTORE_ALIGN, cap * sizeof(int32_t)) != 0) return -1;
+        if (cs->count) memcpy(col, cs->cols[c], cs->count * sizeof(int32_t));
+        free(cs->cols[c]);
+        cs->cols[c] = col;
+    }
+    pid_t *pids = realloc(cs->pids, cap * sizeof(pid_t));
+    if (!pids) return -1;
+    cs->pids = pids;
+    cs->cap = cap;
+    return 0;
+}
+
+
+int colstore_init(colstore_t *cs, size_t cap) {
+    if (!cs) {
+        fprintf(stderr, "Error: Invalid arguments to colstore_init()\n");
+        return -1;
+    }
+    memset(cs, 0, sizeof(colstore_t));
+    if (grow(cs, cap ? cap : 64) != 0) {
+        fprintf(stderr, "Error: out of memory for the column store\n");
+        colstore_free(cs);
+        return -1;
+    }
+    colstore_get_kernel();
+    return 0;
+}
+
+
+static int32_t to_kb(long bytes) {
+    long kb = bytes / KB_UNIT;
+    return kb < 0 ? 0 : kb > INT32_MAX ? INT32_MAX : (int32_t)kb;
+}
+
+
+//slot == count appends a slot, any other slot is overwritten
+int colstore_set(colstore_t *cs, size_t slot, pid_t pid, const mem_info_t *info) {
+    if (!cs || !info || slot > cs->count) return -1;
+    if (slot == cs->cap && grow(cs, cs->cap * 2) != 0) return -1;
+    cs->pids[slot] = pid;
+    cs->cols[COL_VSZ][slot] = to_kb(info->vmsize);
+    cs->cols[COL_RSS][slot] = to_kb(info->vmrss);
+    cs->cols[COL_DATA][slot] = to_kb(info->vmdata);
+    cs->cols[COL_STACK][slot] = to_kb(info->vmstk);
+    if (slot == cs->count) cs->count++;
+    return 0;
+}
+
+
+//the last slot moves into the hole, columns stay dense
+void colstore_remove(colstore_t *cs, size_t slot) {
+    if (!cs || slot >= cs->count) return;
+    size_t last = --cs->count;
+    cs->pids[slot] = cs->pids[last];
+    for (int c = 0; c < COL_COUNT; c++) cs->cols[c][slot] = cs->cols[c][last];
+}
+
+
+/*
+ * one sampler tick into the columns: user targets that answered it, in sampler
+ * order. kernel threads have no memory of their own and are left out.
+ */
+int colstore_load(colstore_t *cs, const sampler_t *s) {
+    if (!cs || !s) return -1;
+    cs->count = 0;
+    for (int i = 0; i < s->count; i++) {
+        const sampler_target_t *t = &s->targets[i];
+        if (t->fd < 0 || t->info.proc_type == PROC_TYPE_KERNEL) continue;
+        if (colstore_set(cs, cs->count, t->pid, &t->info) != 0) return -1;
+    }
+    return (int)cs->count;
+}
+
+
+void colstore_aggregate(const colstore_t *cs, colstore_col_t col, int32_t threshold_kb,
+                        colstore_agg_t *out) {
+    if (!out) return;
+    memset(out, 0, sizeof(colstore_agg_t));
+    out->min = INT32_MAX;
+    out->max = INT32_MIN;
+    if (!cs || col >= COL_COUNT || cs->count == 0) {
+        out->min = out->max = 0;
+        return;
+    }
+    if (!active_fn) colstore_set_kernel(COLSTORE_KERNEL_AUTO);
+    out->n = cs->count;
+    active_fn(cs->cols[col], cs->count, threshold_kb, out);
+}
+
+
+void colstore_window_reset(colstore_window_t *w) {
+    if (!w) return;
+    memset(w, 0, sizeof(colstore_window_t));
+    w->min = INT32_MAX;
+    w->max = INT32_MIN;
+}
+
+
+void colstore_window_add(colstore_window_t *w, const colstore_agg_t *agg) {
+    if (!w || !agg) return;
+    w->ticks++;
+    if (agg->n == 0) return;
+    w->n += agg->n;
+    w->sum += agg->sum;
+    if (agg->min < w->min) w->min = agg->min;
+    if (agg->max > w->max) w->max = agg->max;
+    w->above += agg->above;
+    if (agg->above > w->above_peak) w->above_peak = agg->above;
+}
+
+
+double colstore_window_mean(const colstore_window_t *w) {
+    return w && w->n ? (double)w->sum / w->n : 0;
+}
+
+
+void colstore_free(colstore_t *cs) {
+    if (!cs) return;
+    for (int c = 0; c < COL_COUNT; c++) free(cs->cols[c]);
+    free(cs->pids);
+    memset(cs, 0, sizeof(colstore_t));
+}
@@ -0,0 +1,399 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-7-15 19:52:08
+ * @Last modified: 2025-7-15 19:52:08
+ * @Description: page fault sampling through perf_event_open. per thread, a
+ *               PAGE_FAULTS_MIN event owns the mmap'd ring and PAGE_FAULTS_MAJ
+ *               is redirected into it (PERF_EVENT_IOC_SET_OUTPUT). records are
+ *               parsed where they lie in the ring, only one wrapping around its
+ *               end is copied out. the kernel can't mmap inherited per task
+ *               events, so every poll also looks for new threads in task/.
+ */
+#define _GNU_SOURCE
+#include "include/memtrc.h"
+#include "include/faultprof.h"
+#include "include/topn.h"
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define SAMPLE_TYPE (PERF_SAMPLE_IP | PERF_SAMPLE_TID | PERF_SAMPLE_ADDR | PERF_SAMPLE_ID)
+
+//PERF_RECORD_SAMPLE with SAMPLE_TYPE, fields in the kernel's order
+typedef struct {
+    struct perf_event_header header;
+    uint64_t ip;
+    uint32_t pid;
+    uint32_t tid;
+    uint64_t addr;
+    uint64_t id;
+} fault_sample_t;
+
+
+static int perf_open(struct perf_event_attr *attr, pid_t tid) {
+    return (int)syscall(__NR_perf_event_open, attr, tid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+
+static void close_ring(faultprof_ring_t *r, size_t map_size) {
+    if (r->map && r->map != MAP_FAILED) munmap(r->map, map_size);
+    if (r->maj_fd >= 0) close(r->maj_fd);
+    if (r->min_fd >= 0) close(r->min_fd);
+    r->map = NULL;
+    r->min_fd = r->maj_fd = -1;
+}
+
+
+//both events of one thread, sharing the minor event's ring
+static int open_ring(faultprof_t *fp, faultprof_ring_t *r, pid_t tid) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_SOFTWARE;
+    attr.config = PERF_COUNT_SW_PAGE_FAULTS_MIN;
+    attr.sample_period = fp->period;
+    attr.sample_type = SAMPLE_TYPE;
+    attr.disabled = 1;
+    attr.exclude_hv = 1;
+    r->maj_fd = -1;
+    r->min_fd = perf_open(&attr, tid);
+    if (r->min_fd < 0 && errno == EACCES) {
+        attr.exclude_kernel = 1;    //unprivileged: faults taken in copy_to_user and friends are lost
+        r->min_fd = perf_open(&attr, tid);
+    }
+    if (r->min_fd < 0) return -1;
+    attr.config = PERF_COUNT_SW_PAGE_FAULTS_MAJ;
+    attr.sample_period = 1;
+    r->maj_fd = perf_open(&attr, tid);
+
+    size_t map_size = fp->data_size + sysconf(_SC_PAGESIZE);
+    r->map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, r->min_fd, 0);
+    if (r->maj_fd < 0 || r->map == MAP_FAILED ||
+        ioctl(r->maj_fd, PERF_EVENT_IOC_SET_OUTPUT, r->min_fd) != 0 ||
+        ioctl(r->maj_fd, PERF_EVENT_IOC_ID, &r->maj_id) != 0) {
+        close_ring(r, map_size);
+        return -1;
+    }
+    ioctl(r->min_fd, PERF_EVENT_IOC_ENABLE, 0);
+    ioctl(r->maj_fd, PERF_EVENT_IOC_ENABLE, 0);
+    r->tid = tid;
+    return 0;
+}
+
+
+static const char *special_or_base(const char *path) {
+    if (*path == '\0') return "anon";
+    if (*path == '[') return path;
+    const char *base = strrchr(path, '/');
+    return base ? base + 1 : path;
+}
+
+
+/*
+ * reread the target's maps. counts follow a mapping that is still there (same
+ * name and start or end, so a growing heap or stack keeps them), mappings that
+ * went away stay behind the live ones, out of lookups but in the report.
+ */
+static int load_regions(faultprof_t *fp) {
+    char path[PATH_MAX];
+    if (proc_path(path, sizeof(path), fp->pid, "maps") != 0) return -1;
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    faultprof_region_t *next = calloc(FAULTPROF_REGIONS, sizeof(faultprof_region_t));
+    if (!next) {
+        fclose(f);
+        return -1;
+    }
+    char line[PATH_MAX + 128];
+    int n = 0;
+    while (n < FAULTPROF_REGIONS && fgets(line, sizeof(line), f)) {
+        unsigned long long start, end, off;
+        char perms[8];
+        int pos = 0;
+        if (sscanf(line, "%llx-%llx %7s %llx %*s %*s%n", &start, &end, perms, &off, &pos) < 4) {
+            continue;
+        }
+        char *file = line + pos;
+        while (*file == ' ') file++;
+        file[strcspn(file, "\n")] = '\0';
+        faultprof_region_t *r = &next[n++];
+        r->start = start;
+        r->end = end;
+        r->offset = off;
+        snprintf(r->perms, sizeof(r->perms), "%.4s", perms);
+        snprintf(r->name, sizeof(r->name), "%s", special_or_base(file));
+    }
+    fclose(f);
+    int live = n;
+
+    for (int i = 0; fp->regions && i < fp->nregions; i++) {
+        faultprof_region_t *old = &fp->regions[i];
+        if (old->minor == 0 && old->major == 0) continue;
+        int j = 0;
+        for (; j < live; j++) {
+            faultprof_region_t *r = &next[j];
+            if (strcmp(r->name, old->name) == 0 && (r->start == old->start || r->end == old->end)) {
+                r->minor += old->minor;
+                r->major += old->major;
+                break;
+            }
+        }
+        if (j == live && n < FAULTPROF_REGIONS) next[n++] = *old;
+    }
+    free(fp->regions);
+    fp->regions = next;
+    fp->nregions = n;
+    fp->live_regions = live;
+    return 0;
+}
+
+
+static faultprof_region_t *find_region(const faultprof_t *fp, uint64_t addr) {
+    int lo = 0, hi = fp->live_regions - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        faultprof_region_t *r = &fp->regions[mid];
+        if (addr < r->start) hi = mid - 1;
+        else if (addr >= r->end) lo = mid + 1;
+        else return r;
+    }
+    return NULL;
+}
+
+
+static faultprof_site_t *site_of(faultprof_t *fp, uint64_t ip) {
+    uint64_t h = ip * 0x9e3779b97f4a7c15ULL;
+    const uint32_t usable = FAULTPROF_SITES - 1;
+    if (ip == 0) return &fp->sites[usable];
+    for (uint32_t i = 0; i < usable; i++) {
+        faultprof_site_t *s = &fp->sites[(h + i) % usable];
+        if (s->ip == ip) return s;
+        if (s->ip == 0) {
+            s->ip = ip;
+            return s;
+        }
+    }
+    return &fp->sites[usable];
+}
+
+
+/*
+ * match the rings to the target's threads: new threads get one, rings of
+ * threads that exited are closed (after the poll that drained them). returns
+ * the first errno of a failed open, 0 if none failed.
+ */
+static int scan_threads(faultprof_t *fp) {
+    char path[PATH_MAX];
+    DIR *dir = proc_path(path, sizeof(path), fp->pid, "task") == 0 ? opendir(path) : NULL;
+    if (!dir) return errno;
+    for (int i = 0; i < fp->nrings; i++) fp->rings[i].seen = 0;
+    struct dirent *de;
+    int err = 0;
+    while ((de = readdir(dir))) {
+        pid_t tid = atoi(de->d_name);
+        if (tid <= 0) continue;
+        int i = 0;
+        while (i < fp->nrings && fp->rings[i].tid != tid) i++;
+        if (i < fp->nrings) {
+            fp->rings[i].seen = 1;
+        } else if (fp->nrings < FAULTPROF_THREADS) {
+            if (open_ring(fp, &fp->rings[fp->nrings], tid) == 0) {
+                fp->rings[fp->nrings++].seen = 1;
+            } else if (!err) {
+                err = errno;
+            }
+        }
+    }
+    closedir(dir);
+    size_t map_size = fp->data_size + sysconf(_SC_PAGESIZE);
+    for (int i = fp->nrings - 1; i >= 0; i--) {
+        if (fp->rings[i].seen) continue;
+        close_ring(&fp->rings[i], map_size);
+        fp->rings[i] = fp->rings[--fp->nrings];
+    }
+    return err;
+}
+
+
+int faultprof_attach(faultprof_t *fp, pid_t pid, uint64_t period) {
+    if (!fp || pid <= 0 || period == 0) {
+        fprintf(stderr, "Error: Invalid arguments to faultprof_attach()\n");
+        return -1;
+    }
+    memset(fp, 0, sizeof(faultprof_t));
+    fp->pid = pid;
+    fp->period = period;
+    fp->data_size = FAULTPROF_PAGES * (size_t)sysconf(_SC_PAGESIZE);
+    fp->sites = calloc(FAULTPROF_SITES, sizeof(faultprof_site_t));
+    if (!fp->sites || load_regions(fp) != 0) {
+        fprintf(stderr, "Failed to read the mappings of %d\n", pid);
+        faultprof_detach(fp);
+        return -1;
+    }
+
+    int err = scan_threads(fp);
+    if (fp->nrings == 0) {
+        fprintf(stderr, "Failed to open page fault events for %d: %s\n", pid,
+                strerror(err ? err : ESRCH));
+        faultprof_detach(fp);
+        return -1;
+    }
+    return 0;
+}
+
+
+static void apply_sample(faultprof_t *fp, const faultprof_ring_t *ring,
+                         const fault_sample_t *s, int *reloaded) {
+    int major = s->id == ring->maj_id;
+    uint64_t weight = major ? 1 : fp->period;
+    fp->samples++;
+    if (major) fp->major += weight;
+    else fp->minor += weight;
+
+    faultprof_region_t *r = find_region(fp, s->addr);
+    if (!r && !*reloaded) {
+        //a mapping newer than our copy of maps, reread it once per poll
+        *reloaded = 1;
+        load_regions(fp);
+        r = find_region(fp, s->addr);
+    }
+    if (r) {
+        if (major) r->major += weight;
+        else r->minor += weight;
+    } else {
+        fp->unmapped += weight;
+    }
+    faultprof_site_t *site = site_of(fp, s->ip);
+    if (major) site->major += weight;
+    else site->minor += weight;
+}
+
+
+//drain every ring and follow thread changes, returns the number of samples applied
+int faultprof_poll(faultprof_t *fp) {
+    if (!fp || !fp->sites) return -1;
+    uint64_t before = fp->samples;
+    int reloaded = 0;
+    const uint64_t mask = fp->data_size - 1;
+    for (int i = 0; i < fp->nrings; i++) {
+        faultprof_ring_t *ring = &fp->rings[i];
+        struct perf_event_mmap_page *meta = ring->map;
+        const char *data = (const char *)ring->map + meta->data_offset;
+        uint64_t head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+        uint64_t tail = meta->data_tail;
+        while (tail < head) {
+            //records are 8 byte multiples, so a header never straddles the end
+            const struct perf_event_header *h = (const void *)(data + (tail & mask));
+            if (h->size == 0) break;
+            const char *rec = (const char *)h;
+            uint64_t copy[32];
+            size_t off = tail & mask;
+            if (off + h->size > fp->data_size) {
+                if (h->size > sizeof(copy)) {
+                    tail += h->size;
+                    continue;
+                }
+                size_t first = fp->data_size - off;
+                memcpy(copy, data + off, first);
+                memcpy((char *)copy + first, data, h->size - first);
+                rec = (const char *)copy;
+            }
+            if (h->type == PERF_RECORD_SAMPLE && h->size >= sizeof(fault_sample_t)) {
+                apply_sample(fp, ring, (const fault_sample_t *)rec, &reloaded);
+            } else if (h->type == PERF_RECORD_LOST) {
+                fp->lost += ((const uint64_t *)(rec + sizeof(*h)))[1];     //id, lost
+            } else if (h->type == PERF_RECORD_THROTTLE) {
+                fp->throttled++;
+            }
+            tail += h->size;
+        }
+        __atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+    }
+    scan_threads(fp);
+    return (int)(fp->samples - before);
+}
+
+
+static int region_key(const void *item, const void *ctx, double key[2]) {
+    const faultprof_region_t *r = item;
+    (void)ctx;
+    key[0] = (double)(r->minor + r->major);
+    key[1] = (double)r->major;
+    return r->minor + r->major != 0;
+}
+
+
+static int site_key(const void *item, const void *ctx, double key[2]) {
+    const faultprof_site_t *s = item;
+    (void)ctx;
+    key[0] = (double)(s->minor + s->major);
+    key[1] = (double)s->major;
+    return s->minor + s->major != 0;
+}
+
+
+//top n by minor + major faults, majors break ties
+int faultprof_top_regions(const faultprof_t *fp, const faultprof_region_t **out, int n) {
+    if (!fp || !fp->regions || !out || n <= 0) return 0;
+    return topn_select(fp->regions, fp->nregions, sizeof(faultprof_region_t), region_key, NULL,
+                       (const void **)out, n);
+}
+
+
+int faultprof_top_sites(const faultprof_t *fp, const faultprof_site_t **out, int n) {
+    if (!fp || !fp->sites || !out || n <= 0) return 0;
+    return topn_select(fp->sites, FAULTPROF_SITES, sizeof(faultprof_site_t), site_key, NULL,
+                       (const void **)out, n);
+}
+
+
+//hottest mappings and faulting instructions, with what was lost on the way
+void faultprof_report(const faultprof_t *fp, FILE *out, int n) {
+    if (!fp || !fp->sites || !out) return;
+    if (n > FAULTPROF_TOP) n = FAULTPROF_TOP;
+    fprintf(out, "page faults: %llu minor, %llu major from %llu samples (1 per %llu minor), "
+            "%llu lost, %llu throttled, %llu outside any mapping\n",
+            (unsigned long long)fp->minor, (unsigned long long)fp->major,
+            (unsigned long long)fp->samples, (unsigned long long)fp->period,
+            (unsigned long long)fp->lost, (unsigned long long)fp->throttled,
+            (unsigned long long)fp->unmapped);
+
+    const faultprof_region_t *regions[FAULTPROF_TOP];
+    int found = faultprof_top_regions(fp, regions, n);
+    for (int i = 0; i < found; i++) {
+        const faultprof_region_t *r = regions[i];
+        fprintf(out, "  %9llu min %6llu maj  %-4s %9.1f KB  %s%s\n",
+                (unsigned long long)r->minor, (unsigned long long)r->major, r->perms,
+                (r->end - r->start) / 1024.0, r->name,
+                r < fp->regions + fp->live_regions ? "" : " (unmapped)");
+    }
+    const faultprof_site_t *sites[FAULTPROF_TOP];
+    found = faultprof_top_sites(fp, sites, n);
+    for (int i = 0; i < found; i++) {
+        const faultprof_site_t *s = sites[i];
+        const faultprof_region_t *r = s->ip ? find_region(fp, s->ip) : NULL;
+        char where[96];
+        if (r) {
+            snprintf(where, sizeof(where), "%s+0x%llx", r->name,
+                     (unsigned long long)(s->ip - r->start + r->offset));
+        } else if (s->ip) {
+            snprintf(where, sizeof(where), "0x%llx", (unsigned long long)s->ip);
+        } else {
+            snprintf(where, sizeof(where), "other sites");
+        }
+        fprintf(out, "  %9llu min %6llu maj  at %s\n",
+                (unsigned long long)s->minor, (unsigned long long)s->major, where);
+    }
+}
+
+
+void faultprof_detach(faultprof_t *fp) {
+    if (!fp) return;
+    size_t map_size = fp->data_size + sysconf(_SC_PAGESIZE);
+    for (int i = 0; i < fp->nrings; i++) close_ring(&fp->rings[i], map_size);
+    free(fp->regions);
+    free(fp->sites);
+    memset(fp, 0, sizeof(faultprof_t));
+}
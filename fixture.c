@@ -0,0 +1,307 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-6-14 15:26:09
+ * @Last modified: 2025-6-14 15:26:09
+ * @Description: writes synthetic /proc trees (status, statm, stat, cmdline, smaps,
+ *               smaps_rollup).
+ *               the content is a pure function of the options and the seed, so
+ *               the same tree can be rebuilt on any machine.
+ */
+
+#include "include/memtrc.h"
+#include "include/fixture.h"
+#include <ftw.h>
+#include <sys/stat.h>
+
+#define FIXTURE_PAGE_KB 4
+
+
+void fixture_default_opts(fixture_opts_t *opts) {
+    if (!opts) return;
+    memset(opts, 0, sizeof(fixture_opts_t));
+    opts->count = 1000;
+    opts->first_pid = 1000;
+    opts->kernel_every = 10;
+    opts->zombie_every = 0;
+    opts->stopped_every = 0;
+    opts->status_pad_lines = 0;
+    opts->smaps_mappings = 8;
+    opts->seed = 1;
+}
+
+
+//xorshift32, deterministic across libcs unlike rand()
+static unsigned int next_rand(unsigned int *state) {
+    unsigned int x = *state ? *state : 0x9e3779b9u;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+
+void fixture_make_proc(const fixture_opts_t *opts, int index, fixture_proc_t *proc) {
+    unsigned int rnd = opts->seed * 2654435761u + (unsigned int)index * 40503u + 1;
+    memset(proc, 0, sizeof(fixture_proc_t));
+    proc->pid = opts->first_pid + index;
+    proc->kind = FIXTURE_USER;
+    //kinds are placed by position so counts are exact, kernel wins on overlap
+    if (opts->kernel_every > 0 && index % opts->kernel_every == opts->kernel_every - 1) {
+        proc->kind = FIXTURE_KERNEL;
+    } else if (opts->zombie_every > 0 && index % opts->zombie_every == opts->zombie_every - 1) {
+        proc->kind = FIXTURE_ZOMBIE;
+    } else if (opts->stopped_every > 0 && index % opts->stopped_every == opts->stopped_every - 1) {
+        proc->kind = FIXTURE_STOPPED;
+    }
+    snprintf(proc->comm, sizeof(proc->comm), "%s%d",
+             proc->kind == FIXTURE_KERNEL ? "kworker/" : "worker", index % 1000);
+    proc->starttime = 1000 + (unsigned long long)index * 7 + next_rand(&rnd) % 5;
+    if (proc->kind == FIXTURE_KERNEL || proc->kind == FIXTURE_ZOMBIE) return;
+
+    proc->vmsize_kb = 100000 + (next_rand(&rnd) % 4000000) / FIXTURE_PAGE_KB * FIXTURE_PAGE_KB;
+    proc->vmrss_kb = (proc->vmsize_kb / 8 + next_rand(&rnd) % 50000) /
+                     FIXTURE_PAGE_KB * FIXTURE_PAGE_KB;
+    proc->vmdata_kb = proc->vmrss_kb / 2 / FIXTURE_PAGE_KB * FIXTURE_PAGE_KB;
+    proc->vmstk_kb = 132;
+    proc->minflt = next_rand(&rnd) % 1000000;
+    proc->majflt = next_rand(&rnd) % 100;
+}
+
+
+static FILE *open_file(const char *dir, const char *name) {
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/%s", dir, name) >= (int)sizeof(path)) {
+        fprintf(stderr, "Path too long: %s/%s\n", dir, name);
+        return NULL;
+    }
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "Can't open file %s: %s\n", path, strerror(errno));
+    }
+    return fp;
+}
+
+
+static int write_file(const char *dir, const char *name, const char *data, size_t len) {
+    FILE *fp = open_file(dir, name);
+    if (!fp) return -1;
+    int ret = 0;
+    if (len && fwrite(data, 1, len, fp) != len) {
+        fprintf(stderr, "Error writing %s/%s: %s\n", dir, name, strerror(errno));
+        ret = -1;
+    }
+    if (fclose(fp) != 0) ret = -1;
+    return ret;
+}
+
+
+static int write_status(const char *dir, const fixture_proc_t *proc, const fixture_opts_t *opts) {
+    static const char states[] = { 'S', 'S', 'Z', 'T' };
+    static const char *state_names[] = { "sleeping", "sleeping", "zombie", "stopped" };
+    FILE *fp = open_file(dir, "status");
+    if (!fp) return -1;
+
+    fprintf(fp, "Name:\t%s\nUmask:\t0022\nState:\t%c (%s)\nTgid:\t%d\nNgid:\t0\n"
+            "Pid:\t%d\nPPid:\t%d\nTracerPid:\t0\nUid:\t0\t0\t0\t0\nGid:\t0\t0\t0\t0\n"
+            "FDSize:\t64\nGroups:\t\n",
+            proc->comm, states[proc->kind], state_names[proc->kind], proc->pid,
+            proc->pid, proc->kind == FIXTURE_KERNEL ? 2 : 1);
+    if (proc->kind == FIXTURE_USER || proc->kind == FIXTURE_STOPPED) {
+        fprintf(fp, "VmPeak:\t%8ld kB\nVmSize:\t%8ld kB\nVmLck:\t       0 kB\n"
+                "VmPin:\t       0 kB\nVmHWM:\t%8ld kB\nVmRSS:\t%8ld kB\n"
+                "RssAnon:\t%8ld kB\nRssFile:\t%8ld kB\nRssShmem:\t       0 kB\n"
+                "VmData:\t%8ld kB\nVmStk:\t%8ld kB\nVmExe:\t     132 kB\n"
+                "VmLib:\t    2048 kB\nVmPTE:\t      64 kB\nVmSwap:\t       0 kB\n",
+                proc->vmsize_kb, proc->vmsize_kb, proc->vmrss_kb, proc->vmrss_kb,
+                proc->vmrss_kb * 3 / 4, proc->vmrss_kb / 4,
+                proc->vmdata_kb, proc->vmstk_kb);
+    }
+    fprintf(fp, "Threads:\t1\nSigQ:\t0/63304\nSigPnd:\t0000000000000000\n"
+            "Cpus_allowed:\tff\nCpus_allowed_list:\t0-7\n"
+            "Mems_allowed:\t00000000,00000001\nMems_allowed_list:\t0\n"
+            "voluntary_ctxt_switches:\t10\nnonvoluntary_ctxt_switches:\t0\n");
+    for (int i = 0; i < opts->status_pad_lines; i++) {
+        fprintf(fp, "x_pad_%d:\t%d\n", i, i);
+    }
+    return fclose(fp) == 0 ? 0 : -1;
+}
+
+
+static int write_stat(const char *dir, const fixture_proc_t *proc) {
+    static const char states[] = { 'S', 'S', 'Z', 'T' };
+    char buf[1024];
+    unsigned long flags = proc->kind == FIXTURE_KERNEL ? (PF_KTHREAD | 0x40) : 0x400100;
+    //fields 1..52, see proc(5)
+    int n = snprintf(buf, sizeof(buf),
+            "%d (%s) %c %d %d %d 0 -1 %lu %lu 0 %lu 0 0 0 0 0 20 0 1 0 %llu %lu %ld "
+            "18446744073709551615 0 0 0 0 0 0 0 2147483647 0 1 0 0 17 0 0 0 0 0 0 0 0 0 0 0 0 0\n",
+            proc->pid, proc->comm, states[proc->kind],
+            proc->kind == FIXTURE_KERNEL ? 2 : 1, proc->pid, proc->pid,
+            flags, proc->minflt, proc->majflt, proc->starttime,
+            (unsigned long)proc->vmsize_kb * KB_UNIT, proc->vmrss_kb / FIXTURE_PAGE_KB);
+    return write_file(dir, "stat", buf, n);
+}
+
+
+static int write_statm(const char *dir, const fixture_proc_t *proc) {
+    char buf[128];
+    int n = snprintf(buf, sizeof(buf), "%ld %ld %ld 33 0 %ld 0\n",
+            proc->vmsize_kb / FIXTURE_PAGE_KB, proc->vmrss_kb / FIXTURE_PAGE_KB,
+            proc->vmrss_kb / 4 / FIXTURE_PAGE_KB,
+            (proc->vmdata_kb + proc->vmstk_kb) / FIXTURE_PAGE_KB);
+    return write_file(dir, "statm", buf, n);
+}
+
+
+static int write_cmdline(const char *dir, const fixture_proc_t *proc) {
+    char buf[64];
+    if (proc->kind != FIXTURE_USER && proc->kind != FIXTURE_STOPPED) {
+        return write_file(dir, "cmdline", "", 0);
+    }
+    int n = snprintf(buf, sizeof(buf), "/usr/bin/%s", proc->comm);
+    memcpy(buf + n, "\0--serve\0", 9);
+    return write_file(dir, "cmdline", buf, n + 9);
+}
+
+
+static int write_smaps(const char *dir, const fixture_proc_t *proc, int mappings) {
+    FILE *fp = open_file(dir, "smaps");
+    if (!fp) return -1;
+    long rss_left = proc->vmrss_kb;
+    unsigned long addr = 0x400000UL;
+    for (int i = 0; i < mappings && proc->vmsize_kb > 0; i++) {
+        long size = proc->vmsize_kb / mappings / FIXTURE_PAGE_KB * FIXTURE_PAGE_KB;
+        long rss = i == mappings - 1 ? rss_left : proc->vmrss_kb / mappings;
+        if (size < FIXTURE_PAGE_KB) size = FIXTURE_PAGE_KB;
+        if (rss > size) rss = size;
+        rss_left -= rss;
+        fprintf(fp, "%012lx-%012lx rw-p 00000000 00:00 0 %s\n", addr,
+                addr + size * KB_UNIT, i == 0 ? "[heap]" : "");
+        fprintf(fp, "Size:           %8ld kB\nKernelPageSize:        4 kB\n"
+                "MMUPageSize:           4 kB\nRss:            %8ld kB\n"
+                "Pss:            %8ld kB\nShared_Clean:          0 kB\n"
+                "Shared_Dirty:          0 kB\nPrivate_Clean:         0 kB\n"
+                "Private_Dirty:  %8ld kB\nReferenced:     %8ld kB\n"
+                "Anonymous:      %8ld kB\nSwap:                  0 kB\n"
+                "Locked:                0 kB\nVmFlags: rd wr mr mw me ac\n",
+                size, rss, rss, rss, rss, rss);
+        addr += (size + FIXTURE_PAGE_KB) * KB_UNIT;
+    }
+    if (fclose(fp) != 0) return -1;
+
+    //smaps_rollup is the sum of the mappings above, as the kernel computes it
+    char buf[512];
+    int n = snprintf(buf, sizeof(buf),
+            "00400000-7ffffffff000 ---p 00000000 00:00 0                          [rollup]\n"
+            "Rss:            %8ld kB\nPss:            %8ld kB\nPss_Anon:       %8ld kB\n"
+            "Shared_Clean:          0 kB\nShared_Dirty:          0 kB\n"
+            "Private_Clean:         0 kB\nPrivate_Dirty:  %8ld kB\n"
+            "Anonymous:      %8ld kB\nSwap:                  0 kB\n",
+            proc->vmrss_kb, proc->vmrss_kb, proc->vmrss_kb, proc->vmrss_kb, proc->vmrss_kb);
+    return write_file(dir, "smaps_rollup", buf, n);
+}
+
+
+int fixture_write_proc(const char *root, const fixture_proc_t *proc, const fixture_opts_t *opts) {
+    char dir[PATH_MAX];
+    if (snprintf(dir, sizeof(dir), "%s/%d", root, proc->pid) >= (int)sizeof(dir)) {
+        fprintf(stderr, "Path too long for pid %d\n", proc->pid);
+        return -1;
+    }
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Can't create %s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+    if (write_status(dir, proc, opts) != 0 || write_stat(dir, proc) != 0 ||
+        write_statm(dir, proc) != 0 || write_cmdline(dir, proc) != 0) {
+        return -1;
+    }
+    if (opts->smaps_mappings > 0 && write_smaps(dir, proc, opts->smaps_mappings) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+
+/*
+ * system wide pressure/memory and vmstat, the counters grow with tick so
+ * consecutive calls look like a system under steady reclaim
+ */
+int fixture_write_system(const char *root, unsigned long tick) {
+    char dir[PATH_MAX];
+    if (snprintf(dir, sizeof(dir), "%s/pressure", root) >= (int)sizeof(dir) ||
+        (mkdir(dir, 0755) != 0 && errno != EEXIST)) {
+        fprintf(stderr, "Can't create %s/pressure\n", root);
+        return -1;
+    }
+    char buf[512];
+    int n = snprintf(buf, sizeof(buf),
+                     "some avg10=1.50 avg60=0.80 avg300=0.20 total=%lu\n"
+                     "full avg10=0.50 avg60=0.20 avg300=0.05 total=%lu\n",
+                     tick * 15000, tick * 5000);
+    if (write_file(dir, "memory", buf, n) != 0) return -1;
+    n = snprintf(buf, sizeof(buf),
+                 "nr_free_pages 100000\npswpin %lu\npswpout %lu\n"
+                 "pgsteal_kswapd %lu\npgsteal_direct %lu\n"
+                 "pgscan_kswapd %lu\npgscan_direct %lu\n"
+                 "pgscan_anon %lu\npgscan_file %lu\n",
+                 tick * 10, tick * 20, tick * 800, tick * 200,
+                 tick * 1500, tick * 500, tick * 1000, tick * 1000);
+    return write_file(root, "vmstat", buf, n);
+}
+
+
+//the marker fixture_remove() looks for, so it never deletes a tree it didn't make
+int fixture_mark(const char *root) {
+    static const char note[] = "synthetic /proc tree, procfix -r removes it\n";
+    if (!root) {
+        fprintf(stderr, "Error: Invalid arguments to fixture_mark()\n");
+        return -1;
+    }
+    return write_file(root, FIXTURE_MARKER, note, sizeof(note) - 1);
+}
+
+
+int fixture_generate(const char *root, const fixture_opts_t *opts) {
+    if (!root || !opts || opts->count < 0 || opts->first_pid <= 0) {
+        fprintf(stderr, "Error: Invalid arguments to fixture_generate()\n");
+        return -1;
+    }
+    if (mkdir(root, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Can't create %s: %s\n", root, strerror(errno));
+        return -1;
+    }
+    if (fixture_mark(root) != 0 || fixture_write_system(root, 0) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < opts->count; i++) {
+        fixture_proc_t proc;
+        fixture_make_proc(opts, i, &proc);
+        if (fixture_write_proc(root, &proc, opts) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+static int remove_entry(const char *path, const struct stat *sb, int flag, struct FTW *ftwbuf) {
+    (void)sb;
+    (void)flag;
+    (void)ftwbuf;
+    return remove(path);
+}
+
+
+//only trees that carry the marker, anything else is left alone
+int fixture_remove(const char *root) {
+    char marker[PATH_MAX];
+    struct stat sb;
+    if (!root || snprintf(marker, sizeof(marker), "%s/%s", root, FIXTURE_MARKER) >= (int)sizeof(marker) ||
+        lstat(marker, &sb) != 0 || !S_ISREG(sb.st_mode)) {
+        fprintf(stderr, "Error: refusing to remove %s, not a fixture tree\n", root ? root : "(null)");
+        return -1;
+    }
+    return nftw(root, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
@@ -0,0 +1,271 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-8-2 16:27:51
+ * @Last modified: 2025-8-2 16:27:51
+ * @Description: process group footprint from pagemap. pass 1 walks every
+ *               member's mappings and sets each present pfn in `seen`, a pfn
+ *               that was already there goes to `multi` as well (atomic ors, the
+ *               workers share the bitmaps). pass 2 walks them again and counts
+ *               the pages missing from `multi`, which are private to the member.
+ *               members keep running, so pages that move between the passes
+ *               make the private counts approximate.
+ */
+
+#include "include/memtrc.h"
+#include "include/group.h"
+#include <fcntl.h>
+#include <time.h>
+
+#define PM_PRESENT (1ULL << 63)
+#define PM_SWAPPED (1ULL << 62)
+#define PM_PFN     ((1ULL << 55) - 1)
+
+
+int group_init(group_t *g) {
+    if (!g) {
+        fprintf(stderr, "Error: Invalid arguments to group_init()\n");
+        return -1;
+    }
+    memset(g, 0, sizeof(group_t));
+    g->page_kb = sysconf(_SC_PAGESIZE) / 1024;
+    if (g->page_kb <= 0) g->page_kb = 4;
+    return 0;
+}
+
+
+int group_add(group_t *g, pid_t pid) {
+    if (!g || pid <= 0) {
+        fprintf(stderr, "Error: Invalid arguments to group_add()\n");
+        return -1;
+    }
+    for (int i = 0; i < g->count; i++) {
+        if (g->members[i].pid == pid) return 0;
+    }
+    if (g->count == g->cap) {
+        int cap = g->cap ? g->cap * 2 : 16;
+        group_member_t *m = realloc(g->members, cap * sizeof(group_member_t));
+        if (!m) return -1;
+        g->members = m;
+        g->cap = cap;
+    }
+    memset(&g->members[g->count], 0, sizeof(group_member_t));
+    g->members[g->count++].pid = pid;
+    return 0;
+}
+
+
+//highest pfn + 1 from the zones' start_pfn and spanned pages
+static uint64_t find_max_pfn(long page_kb) {
+    uint64_t max_pfn = 0, spanned = 0;
+    FILE *fp = fopen("/proc/zoneinfo", "r");
+    if (fp) {
+        char line[256];
+        unsigned long long v;
+        while (fgets(line, sizeof(line), fp)) {
+            if (sscanf(line, " spanned %llu", &v) == 1) {
+                spanned = v;
+            } else if (sscanf(line, " start_pfn: %llu", &v) == 1 && v + spanned > max_pfn) {
+                max_pfn = v + spanned;
+            }
+        }
+        fclose(fp);
+    }
+    if (max_pfn == 0) {
+        //no zoneinfo: physical pages plus room for the holes below 4 GB
+        max_pfn = (uint64_t)sysconf(_SC_PHYS_PAGES) + (4ULL << 20) / page_kb;
+    }
+    return max_pfn;
+}
+
+
+//one member, one pass; pagemap has an entry per virtual page
+static void walk_member(group_t *g, group_member_t *m, uint64_t *buf) {
+    char path[PATH_MAX];
+    if (proc_path(path, sizeof(path), m->pid, "maps") != 0) return;
+    FILE *maps = fopen(path, "r");
+    if (!maps) {
+        m->error = errno;
+        return;
+    }
+    int fd = proc_path(path, sizeof(path), m->pid, "pagemap") == 0 ? open(path, O_RDONLY | O_CLOEXEC) : -1;
+    if (fd < 0) {
+        m->error = errno;
+        fclose(maps);
+        return;
+    }
+    uint64_t page_size = (uint64_t)g->page_kb * 1024;
+    long present = 0, private = 0, swapped = 0, no_pfn = 0;
+    char line[PATH_MAX + 128];
+    while (fgets(line, sizeof(line), maps)) {
+        unsigned long long start, end;
+        if (sscanf(line, "%llx-%llx", &start, &end) != 2) continue;
+        for (uint64_t vpn = start / page_size; vpn < end / page_size; ) {
+            size_t n = end / page_size - vpn;
+            if (n > GROUP_CHUNK) n = GROUP_CHUNK;
+            ssize_t got = pread(fd, buf, n * sizeof(uint64_t), (off_t)(vpn * sizeof(uint64_t)));
+            if (got <= 0) break;    //[vsyscall] and friends
+            n = (size_t)got / sizeof(uint64_t);
+            for (size_t i = 0; i < n; i++) {
+                uint64_t e = buf[i];
+                if (!(e & PM_PRESENT)) {
+                    if (e & PM_SWAPPED) swapped++;
+                    continue;
+                }
+                present++;
+                uint64_t pfn = e & PM_PFN;
+                if (pfn == 0) {
+                    no_pfn++;
+                    continue;
+                }
+                if (pfn >= g->max_pfn) continue;   //device memory, outside the zones
+                uint64_t bit = 1ULL << (pfn & 63);
+                if (g->pass == 1) {
+                    uint64_t old = __atomic_fetch_or(&g->seen[pfn >> 6], bit, __ATOMIC_RELAXED);
+                    if (old & bit) __atomic_fetch_or(&g->multi[pfn >> 6], bit, __ATOMIC_RELAXED);
+                } else if (!(g->multi[pfn >> 6] & bit)) {
+                    private++;
+                }
+            }
+            vpn += n;
+        }
+    }
+    close(fd);
+    fclose(maps);
+    if (g->pass == 1) {
+        m->rss_pages = present;
+        m->swap_pages = swapped;
+        if (present > 0 && no_pfn == present) __atomic_store_n(&g->no_pfn, 1, __ATOMIC_RELAXED);
+    } else {
+        m->private_pages = private;
+    }
+}
+
+
+static void *group_worker(void *arg) {
+    group_t *g = arg;
+    uint64_t *buf = malloc(GROUP_CHUNK * sizeof(uint64_t));
+    if (!buf) return NULL;
+    for (;;) {
+        int i = __atomic_fetch_add(&g->next, 1, __ATOMIC_RELAXED);
+        if (i >= g->count) break;
+        walk_member(g, &g->members[i], buf);
+    }
+    free(buf);
+    return NULL;
+}
+
+
+static void run_pass(group_t *g, int pass) {
+    pthread_t tids[64];
+    int n = g->threads < 64 ? g->threads : 64;
+    g->pass = pass;
+    g->next = 0;
+    int started = 0;
+    for (; started < n - 1; started++) {
+        if (pthread_create(&tids[started], NULL, group_worker, g) != 0) break;
+    }
+    group_worker(g);        //the caller is a worker too
+    for (int i = 0; i < started; i++) pthread_join(tids[i], NULL);
+}
+
+
+/*
+ * walk every member twice with up to threads workers. returns 0, or -1 when
+ * the bitmaps can't be had or the pfns are hidden (not root)
+ */
+int group_scan(group_t *g, int threads) {
+    if (!g || g->count == 0) {
+        fprintf(stderr, "Error: Invalid arguments to group_scan()\n");
+        return -1;
+    }
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if (!g->seen) {
+        g->max_pfn = find_max_pfn(g->page_kb);
+        g->words = (g->max_pfn + 63) / 64;
+        if (2 * g->words * sizeof(uint64_t) > GROUP_MAX_BYTES) {
+            fprintf(stderr, "Error: %llu pfns need more than %lu MB of bitmaps\n",
+                    (unsigned long long)g->max_pfn, GROUP_MAX_BYTES >> 20);
+            return -1;
+        }
+        g->seen = calloc(g->words, sizeof(uint64_t));
+        g->multi = calloc(g->words, sizeof(uint64_t));
+        if (!g->seen || !g->multi) {
+            fprintf(stderr, "Error: out of memory for the pfn bitmaps\n");
+            free(g->seen);
+            free(g->multi);
+            g->seen = g->multi = NULL;
+            return -1;
+        }
+    } else {
+        memset(g->seen, 0, g->words * sizeof(uint64_t));
+        memset(g->multi, 0, g->words * sizeof(uint64_t));
+    }
+    g->threads = threads > 0 ? threads : GROUP_THREADS;
+    if (g->threads > g->count) g->threads = g->count;
+    g->no_pfn = 0;
+    for (int i = 0; i < g->count; i++) {
+        pid_t pid = g->members[i].pid;
+        memset(&g->members[i], 0, sizeof(group_member_t));
+        g->members[i].pid = pid;
+    }
+
+    run_pass(g, 1);
+    if (g->no_pfn) {
+        fprintf(stderr, "pagemap hides physical frames, group needs CAP_SYS_ADMIN (root)\n");
+        return -1;
+    }
+    run_pass(g, 2);
+
+    g->unique_pages = g->shared_pages = 0;
+    for (size_t w = 0; w < g->words; w++) {
+        g->unique_pages += __builtin_popcountll(g->seen[w]);
+        g->shared_pages += __builtin_popcountll(g->multi[w]);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    g->scan_us = (t1.tv_sec - t0.tv_sec) * 1000000LL + (t1.tv_nsec - t0.tv_nsec) / 1000;
+    return 0;
+}
+
+
+void group_report(const group_t *g, FILE *fp) {
+    if (!g || !fp || !g->seen) return;
+    long rss = 0, swap = 0;
+    int failed = 0;
+    for (int i = 0; i < g->count; i++) {
+        rss += g->members[i].rss_pages;
+        swap += g->members[i].swap_pages;
+        if (g->members[i].error) failed++;
+    }
+    long kb = g->page_kb;
+    fprintf(fp, "==== group of %d processes (%d unreadable), %d threads, %.1f ms ====\n",
+            g->count, failed, g->threads, g->scan_us / 1000.0);
+    fprintf(fp, "unique %ld KB | summed RSS %ld KB (%.2fx) | shared within the group %ld KB | "
+            "swapped %ld KB\n", g->unique_pages * kb, rss * kb,
+            g->unique_pages ? (double)rss / g->unique_pages : 0.0, g->shared_pages * kb, swap * kb);
+    fprintf(fp, "%8s %-16s %12s %12s %12s\n", "pid", "comm", "RSS KB", "private KB", "shared KB");
+    for (int i = 0; i < g->count; i++) {
+        const group_member_t *m = &g->members[i];
+        char path[PATH_MAX], comm[32] = "?";
+        FILE *cf = proc_path(path, sizeof(path), m->pid, "comm") == 0 ? fopen(path, "r") : NULL;
+        if (cf) {
+            if (fgets(comm, sizeof(comm), cf)) comm[strcspn(comm, "\n")] = '\0';
+            fclose(cf);
+        }
+        if (m->error) {
+            fprintf(fp, "%8d %-16s %s\n", m->pid, comm, strerror(m->error));
+            continue;
+        }
+        fprintf(fp, "%8d %-16s %12ld %12ld %12ld\n", m->pid, comm, m->rss_pages * kb,
+                m->private_pages * kb, (m->rss_pages - m->private_pages) * kb);
+    }
+}
+
+
+void group_free(group_t *g) {
+    if (!g) return;
+    free(g->members);
+    free(g->seen);
+    free(g->multi);
+    memset(g, 0, sizeof(group_t));
+}
@@ -0,0 +1,306 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-8-11 21:06:44
+ * @Last modified: 2025-8-11 21:06:44
+ * @Description: workload shapes. every step_ms the expected KB above the
+ *               baseline is computed from the shape and the elapsed time, the
+ *               process is brought there (pages touched one by one or given
+ *               back with MADV_DONTNEED, stack frames recursed into) and the
+ *               KB actually reached goes to the truth file as
+ *               "t_ms,expected_kb,event", after a "#" header with the spec.
+ */
+
+#define _DEFAULT_SOURCE     //MAP_ANONYMOUS and madvise(), before any header
+#include "include/memtrc.h"
+#include "include/hog.h"
+#include "include/libmemtrc.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#define HOG_ALIGN (2UL << 20)   //huge page boundary
+
+static const char *pattern_names[HOG_PATTERNS] = {
+    "leak", "sawtooth", "spike", "stack", "churn", "huge"
+};
+
+typedef struct {
+    const hog_spec_t *spec;
+    FILE *truth;
+    hog_result_t *res;
+    long page_kb;
+    struct timespec t0;
+    struct timespec next;
+    char *map;                  //what mmap returned, region is aligned inside it
+    size_t map_len;
+    char *region;
+    size_t region_pages;
+    size_t touched;             //pages from the region start
+    long huge_kb;               //THP backs the region: a touch faults in this much
+    long last_kb;
+    double churn_due;           //pairs owed, rate is rarely a multiple of the step
+    int done;
+} hog_ctx_t;
+
+
+void hog_default_spec(hog_spec_t *spec, hog_pattern_t pattern) {
+    if (!spec) return;
+    memset(spec, 0, sizeof(hog_spec_t));
+    spec->pattern = pattern;
+    spec->size_kb = 64 * 1024;
+    spec->duration_ms = 5000;
+    spec->period_ms = 1000;
+    spec->step_ms = HOG_STEP_MS;
+    if (pattern == HOG_STACK) {
+        spec->size_kb = 4 * 1024;
+    } else if (pattern == HOG_CHURN) {
+        spec->size_kb = 256;
+        spec->rate = 1000;
+    }
+}
+
+
+int hog_parse_pattern(const char *name) {
+    for (int p = 0; name && p < HOG_PATTERNS; p++) {
+        if (strcmp(name, pattern_names[p]) == 0) return p;
+    }
+    return -1;
+}
+
+
+const char *hog_pattern_name(hog_pattern_t pattern) {
+    return pattern >= 0 && pattern < HOG_PATTERNS ? pattern_names[pattern] : "?";
+}
+
+
+//the shape itself, KB above the baseline at t_ms, rounded down to what can be touched
+long hog_expected_kb(const hog_spec_t *spec, long long t_ms) {
+    if (!spec || spec->duration_ms <= 0 || t_ms < 0) return 0;
+    long long d = spec->duration_ms;
+    long long ramp = d / 2 > 0 ? d / 2 : 1;
+    if (t_ms > d) t_ms = d;
+    long kb = 0, unit = sysconf(_SC_PAGESIZE) / 1024;
+    switch (spec->pattern) {
+        case HOG_LEAK:
+            kb = (long)(spec->size_kb * t_ms / d);
+            break;
+        case HOG_SAWTOOTH:
+            if (spec->period_ms > 0) kb = (long)(spec->size_kb * (t_ms % spec->period_ms) / spec->period_ms);
+            break;
+        case HOG_SPIKE:
+            kb = t_ms >= d / 3 && t_ms < d / 3 + spec->period_ms ? spec->size_kb : 0;
+            break;
+        case HOG_STACK:
+            kb = t_ms < ramp ? (long)(spec->size_kb * t_ms / ramp) : spec->size_kb;
+            unit = HOG_FRAME_KB;
+            break;
+        case HOG_HUGE:
+            if (spec->rate > 0) kb = (long)(spec->rate * t_ms / 1000);
+            else kb = t_ms < ramp ? (long)(spec->size_kb * t_ms / ramp) : spec->size_kb;
+            if (kb > spec->size_kb) kb = spec->size_kb;
+            break;
+        case HOG_CHURN:
+        default:
+            break;
+    }
+    if (unit <= 0) unit = 4;
+    return kb - kb % unit;
+}
+
+
+static long long elapsed_ms(const hog_ctx_t *c) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - c->t0.tv_sec) * 1000LL + (now.tv_nsec - c->t0.tv_nsec) / 1000000;
+}
+
+
+static void wait_step(hog_ctx_t *c) {
+    c->next.tv_nsec += (long)c->spec->step_ms * 1000000L;
+    c->next.tv_sec += c->next.tv_nsec / 1000000000L;
+    c->next.tv_nsec %= 1000000000L;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &c->next, NULL) == EINTR) {
+    }
+}
+
+
+static void truth_row(hog_ctx_t *c, long long t_ms, long kb, const char *event) {
+    if (kb > c->res->peak_kb) c->res->peak_kb = kb;
+    if (c->res->steps++ == 0 && !event) event = "start";
+    if (t_ms >= c->spec->duration_ms && !event) event = "end";
+    c->last_kb = kb;
+    if (c->truth) fprintf(c->truth, "%lld,%ld,%s\n", t_ms, kb, event ? event : "");
+}
+
+
+//touch up to kb or give the pages above it back; returns the KB now resident
+static long region_set(hog_ctx_t *c, long kb) {
+    size_t page = (size_t)c->page_kb * 1024;
+    size_t want = (size_t)(kb / c->page_kb);
+    if (want > c->region_pages) want = c->region_pages;
+    for (; c->touched < want; c->touched++) c->region[c->touched * page] = 1;
+    if (want < c->touched) {
+        madvise(c->region + want * page, (c->touched - want) * page, MADV_DONTNEED);
+        c->touched = want;
+    }
+    long kb_now = (long)c->touched * c->page_kb;
+    //a touched huge page is resident as a whole, the tail past the last one isn't huge
+    long whole = c->huge_kb > 0 ? c->spec->size_kb - c->spec->size_kb % c->huge_kb : 0;
+    if (kb_now > 0 && kb_now < whole) kb_now = (kb_now + c->huge_kb - 1) / c->huge_kb * c->huge_kb;
+    return kb_now;
+}
+
+
+//advised regions get huge pages unless THP is off altogether
+static int thp_enabled(void) {
+    char buf[128];
+    int fd = open("/sys/kernel/mm/transparent_hugepage/enabled", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) return 0;
+    buf[n] = '\0';
+    return strstr(buf, "[never]") == NULL;
+}
+
+
+static void churn_step(hog_ctx_t *c, long long dt_ms) {
+    size_t len = (size_t)c->spec->size_kb * 1024, page = (size_t)c->page_kb * 1024;
+    c->churn_due += (double)c->spec->rate * dt_ms / 1000.0;
+    for (; c->churn_due >= 1.0; c->churn_due -= 1.0) {
+        char *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) continue;
+        for (size_t off = 0; off < len; off += page) p[off] = 1;
+        munmap(p, len);
+        c->res->events++;
+    }
+}
+
+
+static int run_region(hog_ctx_t *c) {
+    const hog_spec_t *spec = c->spec;
+    if (spec->pattern != HOG_CHURN) {
+        c->map_len = (size_t)spec->size_kb * 1024 + HOG_ALIGN;
+        c->map = mmap(NULL, c->map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (c->map == MAP_FAILED) {
+            fprintf(stderr, "Failed to map %ld KB: %s\n", spec->size_kb, strerror(errno));
+            c->map = NULL;
+            return -1;
+        }
+        c->region = (char *)(((uintptr_t)c->map + HOG_ALIGN - 1) & ~(HOG_ALIGN - 1));
+        c->region_pages = (size_t)(spec->size_kb / c->page_kb);
+#ifdef MADV_HUGEPAGE
+        if (spec->pattern == HOG_HUGE && thp_enabled() &&
+            madvise(c->region, (size_t)spec->size_kb * 1024, MADV_HUGEPAGE) == 0) {
+            c->huge_kb = (long)(HOG_ALIGN / 1024);
+        }
+#endif
+    }
+    long long last_t = 0;
+    for (;;) {
+        long long t = elapsed_ms(c);
+        if (t > spec->duration_ms) t = spec->duration_ms;
+        long want = hog_expected_kb(spec, t);
+        const char *event = NULL;
+        char pairs[32];
+        long kb = 0;
+        if (spec->pattern == HOG_CHURN) {
+            unsigned long before = c->res->events;
+            churn_step(c, t - last_t);
+            snprintf(pairs, sizeof(pairs), "pairs=%lu", c->res->events - before);
+            event = pairs;
+        } else {
+            kb = region_set(c, want);
+            if (c->res->steps > 0 && kb < c->last_kb) {
+                event = spec->pattern == HOG_SPIKE ? "release" : "drop";
+                if (spec->pattern == HOG_SAWTOOTH) c->res->events++;
+            } else if (spec->pattern == HOG_SPIKE && c->last_kb == 0 && kb > 0) {
+                event = "spike";
+                c->res->events++;
+            }
+        }
+        truth_row(c, t, kb, event);
+        last_t = t;
+        if (t >= spec->duration_ms) break;
+        wait_step(c);
+    }
+    if (c->map) munmap(c->map, c->map_len);
+    return 0;
+}
+
+
+//a frame per HOG_FRAME_KB, deeper frames return only once the pattern is over
+static __attribute__((noinline)) void stack_frame(hog_ctx_t *c, long depth) {
+    volatile char frame[HOG_FRAME_KB * 1024];
+    frame[0] = 1;
+    frame[sizeof(frame) - 1] = 1;
+    while (!c->done) {
+        long long t = elapsed_ms(c);
+        if (t > c->spec->duration_ms) t = c->spec->duration_ms;
+        if (hog_expected_kb(c->spec, t) / HOG_FRAME_KB > depth) {
+            stack_frame(c, depth + 1);
+            continue;
+        }
+        truth_row(c, t, depth * HOG_FRAME_KB, NULL);
+        if (t >= c->spec->duration_ms) {
+            c->done = 1;
+            break;
+        }
+        wait_step(c);
+    }
+    frame[1] = frame[0];    //no tail call, the frame stays on the stack
+}
+
+
+static long self_rss_kb(long page_kb) {
+    memtrc_sample_t s;
+    int fd = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    int ret = memtrc_read_statm(fd, page_kb, &s);
+    close(fd);
+    return ret == 0 ? s.rss_kb : -1;
+}
+
+
+//runs the pattern in the calling thread (stack grows the caller's own stack)
+int hog_run(const hog_spec_t *spec, FILE *truth, hog_result_t *res) {
+    if (!spec || !res || spec->pattern < 0 || spec->pattern >= HOG_PATTERNS || spec->size_kb <= 0 ||
+        spec->duration_ms <= 0 || spec->step_ms <= 0 ||
+        ((spec->pattern == HOG_SAWTOOTH || spec->pattern == HOG_SPIKE) && spec->period_ms <= 0) ||
+        (spec->pattern == HOG_CHURN && spec->rate <= 0)) {
+        fprintf(stderr, "Error: Invalid arguments to hog_run()\n");
+        return -1;
+    }
+    hog_spec_t local = *spec;
+    if (local.pattern == HOG_STACK) {
+        struct rlimit rl;
+        if (getrlimit(RLIMIT_STACK, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY) {
+            long max_kb = ((long)rl.rlim_cur - HOG_STACK_SPARE) / 1024;
+            if (local.size_kb > max_kb) local.size_kb = max_kb > 0 ? max_kb : HOG_FRAME_KB;
+        }
+    }
+    hog_ctx_t c;
+    memset(&c, 0, sizeof(c));
+    memset(res, 0, sizeof(hog_result_t));
+    c.spec = &local;
+    c.truth = truth;
+    c.res = res;
+    c.page_kb = sysconf(_SC_PAGESIZE) / 1024;
+    if (c.page_kb <= 0) c.page_kb = 4;
+    res->baseline_kb = self_rss_kb(c.page_kb);
+    if (truth) {
+        fprintf(truth, "# memhog pattern=%s size_kb=%ld duration_ms=%d period_ms=%d rate=%ld "
+                "step_ms=%d pid=%d\n# baseline_kb=%ld\nt_ms,expected_kb,event\n",
+                pattern_names[local.pattern], local.size_kb, local.duration_ms, local.period_ms,
+                local.rate, local.step_ms, getpid(), res->baseline_kb);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &c.t0);
+    c.next = c.t0;
+    int ret = 0;
+    if (local.pattern == HOG_STACK) stack_frame(&c, 1);
+    else ret = run_region(&c);
+    res->elapsed_ms = elapsed_ms(&c);
+    if (truth) fflush(truth);
+    return ret;
+}
@@ -0,0 +1,34 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-6-22 10:05:12
+ * @Last modified: 2025-6-22 10:05:12
+ * @Description: adaptive sampling interval. drops to the minimum interval as
+ *               soon as RSS moves or its rate gets noisy, doubles back up to
+ *               the maximum while the process stays quiet.
+ */
+#ifndef ADAPTIVE_H
+#define ADAPTIVE_H
+
+#define ADAPTIVE_MIN_MS       10
+#define ADAPTIVE_MAX_MS       1000
+#define ADAPTIVE_NOISE_BYTES  (64L * 1024)  //smaller RSS moves count as stable
+#define ADAPTIVE_ALPHA        0.3           //weight of the newest rate in the ewma
+
+typedef struct {
+    int min_ms;
+    int max_ms;
+    int cur_ms;             //interval until the next sample
+    int primed;             //a previous sample exists
+    long long last_ts;      //ms
+    long last_value;
+    double rate_mean;       //ewma of the RSS rate, bytes per ms
+    double rate_var;        //ewma variance of the rate
+    unsigned long samples;
+    unsigned long fast_samples; //samples taken at min_ms
+    long long total_ms;     //sum of the intervals handed out
+} adaptive_t;
+
+int adaptive_init(adaptive_t *a, int min_ms, int max_ms);
+int adaptive_next(adaptive_t *a, long long ts_ms, long value);
+
+#endif
@@ -0,0 +1,107 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-7-9 21:03:37
+ * @Last modified: 2025-7-9 21:03:37
+ * @Description: allocation profiler. libmemtrc_preload.so samples allocations
+ *               in the target into per-thread rings of a shared memory segment,
+ *               memtrc drains them and keeps live bytes per call site.
+ */
+#ifndef ALLOCPROF_H
+#define ALLOCPROF_H
+#include <stdint.h>
+#include <sys/types.h>
+#include <stdio.h>
+
+#define ALLOCPROF_MAGIC        "MTAP"
+#define ALLOCPROF_VERSION      1
+#define ALLOCPROF_SHM_FMT      "/memtrc-%d"      //shm_open name, %d is the target pid
+#define ALLOCPROF_RINGS        64                //threads profiled at once
+#define ALLOCPROF_RING_EVENTS  1024              //per thread, a power of two
+#define ALLOCPROF_DEPTH        8                 //frames kept per sample
+#define ALLOCPROF_SAMPLE_BYTES (512 * 1024)      //mean bytes between samples, $MEMTRC_SAMPLE_BYTES
+#define ALLOCPROF_ADDR_SLOTS   (1 << 16)         //sampled blocks live at once, preload side
+#define ALLOCPROF_SITES        4096              //call sites, memtrc side
+#define ALLOCPROF_PENDING      256               //frees seen before their alloc, memtrc side
+#define ALLOCPROF_TOP          5
+
+typedef enum {
+    ALLOCPROF_ALLOC = 1,
+    ALLOCPROF_FREE = 2
+} allocprof_event_type_t;
+
+typedef struct {
+    uint64_t seq;                       //global order, frees may land in another thread's ring
+    uint64_t addr;
+    uint64_t size;                      //requested bytes, 0 for frees
+    uint64_t weight;                    //bytes this sample stands for
+    uint32_t type;
+    uint32_t depth;
+    uint64_t frames[ALLOCPROF_DEPTH];
+} allocprof_event_t;
+
+//single producer (the owning thread), single consumer (memtrc)
+typedef struct {
+    uint32_t owner;                     //tid, 0 when free to claim
+    uint32_t pad;
+    uint64_t head;                      //written by the producer with release stores
+    uint64_t tail;                      //written by memtrc with release stores
+    uint64_t dropped;                   //samples lost to a full ring
+    allocprof_event_t events[ALLOCPROF_RING_EVENTS];
+} allocprof_ring_t;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    int32_t pid;
+    uint32_t nrings;
+    uint64_t sample_bytes;
+    uint64_t seq;                       //next event sequence number
+    uint64_t dropped;                   //threads without a ring, full address table
+    allocprof_ring_t rings[ALLOCPROF_RINGS];
+} allocprof_shm_t;
+
+//memtrc side
+typedef struct {
+    uint64_t hash;                      //0 marks an empty slot
+    uint32_t depth;
+    uint64_t frames[ALLOCPROF_DEPTH];
+    int64_t live;                       //estimated live bytes
+    int64_t reported;                   //live at the last report, growth is measured from it
+    uint64_t allocs;
+    uint64_t frees;
+} allocprof_site_t;
+
+typedef struct {
+    uint64_t addr;                      //0 empty, 1 deleted
+    uint32_t site;
+    uint64_t weight;
+} allocprof_block_t;
+
+//a free drained before its alloc (a ring read earlier), matched on the next poll
+typedef struct {
+    uint64_t addr;
+    uint64_t seq;
+    uint64_t poll;                      //the poll that saw it
+} allocprof_pending_t;
+
+typedef struct allocprof {
+    pid_t pid;
+    allocprof_shm_t *shm;
+    allocprof_site_t *sites;            //ALLOCPROF_SITES, the last one collects overflow
+    allocprof_block_t *blocks;          //ALLOCPROF_ADDR_SLOTS * 2
+    allocprof_event_t *batch;           //one poll, sorted by seq
+    allocprof_pending_t *pending;       //ALLOCPROF_PENDING
+    int npending;
+    uint64_t polls;
+    uint64_t events;
+    uint64_t unknown_frees;             //blocks allocated before we attached
+} allocprof_t;
+
+int allocprof_attach(allocprof_t *ap, pid_t pid);
+int allocprof_poll(allocprof_t *ap);
+int64_t allocprof_live(const allocprof_t *ap);
+int allocprof_top(allocprof_t *ap, allocprof_site_t **out, int n);
+void allocprof_report(allocprof_t *ap, FILE *fp, int n);
+void allocprof_detach(allocprof_t *ap);
+
+#endif
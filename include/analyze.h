@@ -0,0 +1,62 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-5-18 10:12:31
+ * @Last modified: 2025-5-18 10:12:31
+ * @Description: offline analysis of text logs produced by write_log(),
+ *               including the line scanner, summary statistics and chart rendering
+ */
+#ifndef ANALYZE_H
+#define ANALYZE_H
+#include "memtrc.h"
+#include "sketch.h"
+
+#define ANALYZE_MAX_THREADS 16
+#define ANALYZE_MIN_CHUNK   (8UL << 20)  //don't split below 8MB per thread
+
+typedef enum {
+    LOG_FIELD_RSS,
+    LOG_FIELD_VSZ
+} log_field_t;
+
+typedef struct {
+    long long ts_ms;    //sample time in ms, log clock (local time as written)
+    long vmrss;         //-1 when the line has no RSS column
+    long vmsize;        //-1 when the line has no VSZ column
+} log_record_t;
+
+typedef struct {
+    log_record_t *records;
+    size_t count;
+    size_t skipped;     //lines not in write_log() format
+    size_t bytes;       //size of the parsed file
+    double parse_secs;  //wall time of the parse phase
+    int threads;        //threads used for parsing
+} log_data_t;
+
+typedef struct {
+    size_t samples;
+    long peak;
+    long min;
+    double mean;
+    long p50;
+    long p90;
+    long p95;
+    long p99;
+    double growth_per_sec;  //least squares slope, log unit per second
+    double span_secs;
+} series_stats_t;
+
+int parse_log_line(const char *line, size_t len, log_record_t *rec);
+int parse_log_buffer(const char *buf, size_t len, log_record_t **recs,
+        size_t *count, size_t *cap, size_t *skipped);
+
+int load_log_file(const char *path, int threads, log_data_t *data);
+void free_log_data(log_data_t *data);
+
+int compute_series_stats(const log_data_t *data, log_field_t field, series_stats_t *st);
+void print_series_stats(const char *name, const series_stats_t *st);
+int report_codec_stats(const log_data_t *data);
+int analyze_log(const char *path, int threads);
+int analyze_logs(char *paths[], int count, int threads);
+
+#endif
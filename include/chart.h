@@ -9,6 +9,7 @@
 #ifndef CHART_H
 #define CHART_H
 #include "memtrc.h"
+#include "codec.h"
 
 #define MAX_HISTORY 100  // Maximum number of data points to display 
 #define CHART_HEIGHT 20
@@ -16,6 +17,7 @@
 
 typedef struct {
     long data[MAX_HISTORY]; 
+    long long ts[MAX_HISTORY];  //sample time in ms, 0 when spacing is implied by the index
     int count;
     long max_value;
     long min_value;
@@ -24,6 +26,7 @@ typedef struct {
 
 void init_history(history_data_t *hist);
 void update_history(history_data_t *hist, long value);
+void update_history_at(history_data_t *hist, long long ts_ms, long value);
 void cleanup_history(history_data_t *hist);
 
 void prepare_chart(const history_data_t *hist, 
@@ -35,5 +38,6 @@ void draw_chart_incremental(const history_data_t *hist, const char *title);
 void draw_realtime_chart(history_data_t *hist, const char *title,
         int interval_ms, long (*update_func)(void*), void *context);
 void stop_realtime_chart();
+void draw_series_chart(const ts_series_t *series, int col, const char *title);
 
 #endif
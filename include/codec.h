@@ -0,0 +1,76 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-5-25 09:40:12
+ * @Last modified: 2025-5-25 09:40:12
+ * @Description: delta-of-delta sample codec (Gorilla style), used for long
+ *               in-memory histories and as the on-disk compressed log format
+ */
+#ifndef CODEC_H
+#define CODEC_H
+#include "memtrc.h"
+#include <stdint.h>
+
+#define CODEC_BLOCK_ROWS 1024   //rows per block, the unit of random access
+#define CODEC_MAX_COLS   4      //VSZ, RSS, Data, Stack
+#define CODEC_MAGIC      "MTZ1"
+#define CODEC_FLUSH_MS   60000  //writer seals a partial block once it spans this
+
+typedef struct {
+    long long first_ts;     //ms, timestamp of row 0
+    long long last_ts;      //ms, timestamp of the last row
+    uint32_t rows;
+    uint32_t nbytes;        //payload size
+    unsigned char *payload; //bitstream, see codec.c
+} codec_block_t;
+
+typedef struct {
+    int ncols;
+    codec_block_t *blocks;  //sealed blocks, ordered by time
+    size_t nblocks;
+    size_t cap;
+
+    //open tail block, kept raw until it is full
+    long long tail_ts[CODEC_BLOCK_ROWS];
+    long tail_vals[CODEC_MAX_COLS][CODEC_BLOCK_ROWS];
+    uint32_t tail_rows;
+
+    size_t rows;            //rows appended so far
+    size_t enc_bytes;       //payload + block header bytes of sealed blocks
+} ts_series_t;
+
+typedef struct codec_writer {
+    FILE *fp;
+    ts_series_t series;
+    size_t file_bytes;
+} codec_writer_t;
+
+typedef struct {
+    FILE *fp;
+    int ncols;
+    long *offsets;          //file offset of each block header
+    size_t nblocks;
+} codec_reader_t;
+
+int codec_encode_block(int ncols, const long long *ts, long vals[][CODEC_BLOCK_ROWS],
+        uint32_t rows, codec_block_t *blk);
+int codec_decode_block(int ncols, const codec_block_t *blk, long long *ts,
+        long vals[][CODEC_BLOCK_ROWS]);
+void codec_free_block(codec_block_t *blk);
+
+int ts_series_init(ts_series_t *s, int ncols);
+int ts_series_append(ts_series_t *s, long long ts, const long *vals);
+int ts_series_seal(ts_series_t *s);
+long ts_series_find_block(const ts_series_t *s, long long ts);
+size_t ts_series_memory(const ts_series_t *s);
+void ts_series_free(ts_series_t *s);
+
+int codec_writer_open(codec_writer_t *w, const char *path, int ncols);
+int codec_writer_append(codec_writer_t *w, long long ts, const long *vals);
+int codec_writer_close(codec_writer_t *w);
+
+int codec_reader_open(codec_reader_t *r, const char *path);
+int codec_reader_block(codec_reader_t *r, size_t idx, codec_block_t *blk);
+void codec_reader_close(codec_reader_t *r);
+int codec_is_compressed(const char *path);
+
+#endif
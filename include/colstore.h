@@ -0,0 +1,76 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-7-18 20:37:51
+ * @Last modified: 2025-7-18 20:37:51
+ * @Description: column store for many targets. one 64 byte aligned int32
+ *               column per metric, in KB as /proc reports them (2 TB per
+ *               target), indexed by target slot, so fleet aggregates are a
+ *               linear scan. the scan kernel is AVX2, SSE2 or scalar, picked
+ *               at runtime from the cpu's features.
+ */
+#ifndef COLSTORE_H
+#define COLSTORE_H
+#include "memtrc.h"
+#include <stdint.h>
+
+#define COLSTORE_ALIGN 64       //bytes, a cache line and a multiple of every vector width
+
+typedef enum {
+    COL_VSZ,
+    COL_RSS,
+    COL_DATA,
+    COL_STACK,
+    COL_COUNT
+} colstore_col_t;
+
+typedef enum {
+    COLSTORE_KERNEL_AUTO,       //the widest the cpu supports
+    COLSTORE_KERNEL_SCALAR,
+    COLSTORE_KERNEL_SSE2,
+    COLSTORE_KERNEL_AVX2
+} colstore_kernel_t;
+
+typedef struct colstore {
+    int32_t *cols[COL_COUNT];   //KB, COLSTORE_ALIGN aligned
+    pid_t *pids;                //target of each slot
+    size_t count;
+    size_t cap;
+} colstore_t;
+
+//one column over all slots of one tick
+typedef struct {
+    size_t n;
+    int64_t sum;                //KB
+    int32_t min;
+    int32_t max;
+    size_t above;               //slots over the threshold
+} colstore_agg_t;
+
+//ticks folded together, e.g. a minute of them
+typedef struct {
+    unsigned long ticks;
+    size_t n;                   //slots summed over the ticks, mean = sum / n
+    int64_t sum;
+    int32_t min;
+    int32_t max;
+    size_t above;               //slot-ticks over the threshold
+    size_t above_peak;          //most slots over it in one tick
+} colstore_window_t;
+
+struct sampler;
+
+int colstore_init(colstore_t *cs, size_t cap);
+int colstore_set(colstore_t *cs, size_t slot, pid_t pid, const mem_info_t *info);
+int colstore_load(colstore_t *cs, const struct sampler *s);
+void colstore_remove(colstore_t *cs, size_t slot);
+void colstore_aggregate(const colstore_t *cs, colstore_col_t col, int32_t threshold_kb,
+                        colstore_agg_t *out);
+void colstore_window_reset(colstore_window_t *w);
+void colstore_window_add(colstore_window_t *w, const colstore_agg_t *agg);
+double colstore_window_mean(const colstore_window_t *w);
+int colstore_set_kernel(colstore_kernel_t kernel);
+colstore_kernel_t colstore_get_kernel(void);
+const char *colstore_kernel_name(colstore_kernel_t kernel);
+void colstore_free(colstore_t *cs);
+
+#endif
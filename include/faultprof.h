@@ -0,0 +1,73 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-7-15 19:52:08
+ * @Last modified: 2025-7-15 19:52:08
+ * @Description: page fault attribution with perf_event software events. minor
+ *               and major fault samples (ip, tid, fault address) of every thread
+ *               land in one mmap'd ring per thread and are aggregated by mapping
+ *               of the target and by faulting instruction. no PMU is needed.
+ */
+#ifndef FAULTPROF_H
+#define FAULTPROF_H
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#define FAULTPROF_PAGES     64          //data pages per thread ring, a power of two
+#define FAULTPROF_THREADS   64          //threads sampled at once
+#define FAULTPROF_PERIOD    1           //minor faults per sample, majors are all sampled
+#define FAULTPROF_REGIONS   2048        //mappings of the target
+#define FAULTPROF_SITES     4096        //faulting instructions
+#define FAULTPROF_TOP       5
+
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    uint64_t offset;
+    char perms[5];
+    char name[64];
+    uint64_t minor;                     //estimated faults, samples times the period
+    uint64_t major;
+} faultprof_region_t;
+
+typedef struct {
+    uint64_t ip;                        //0 marks an empty slot
+    uint64_t minor;
+    uint64_t major;
+} faultprof_site_t;
+
+typedef struct {
+    void *map;                          //metadata page plus FAULTPROF_PAGES of data
+    int min_fd;                         //owns the ring
+    int maj_fd;                         //redirected into it
+    uint64_t maj_id;                    //tells the two apart in a sample
+    pid_t tid;
+    int seen;                           //still in task/ at the last scan
+} faultprof_ring_t;
+
+typedef struct faultprof {
+    pid_t pid;
+    uint64_t period;
+    size_t data_size;                   //bytes of data per ring
+    faultprof_ring_t rings[FAULTPROF_THREADS];
+    int nrings;
+    faultprof_region_t *regions;        //live mappings sorted by start, then unmapped ones
+    int nregions;
+    int live_regions;
+    faultprof_site_t *sites;            //the last slot collects overflow
+    uint64_t samples;
+    uint64_t minor;
+    uint64_t major;
+    uint64_t lost;                      //PERF_RECORD_LOST, the ring was full
+    uint64_t throttled;                 //the kernel slowed sampling down
+    uint64_t unmapped;                  //fault address in no mapping, even after a reload
+} faultprof_t;
+
+int faultprof_attach(faultprof_t *fp, pid_t pid, uint64_t period);
+int faultprof_poll(faultprof_t *fp);
+int faultprof_top_regions(const faultprof_t *fp, const faultprof_region_t **out, int n);
+int faultprof_top_sites(const faultprof_t *fp, const faultprof_site_t **out, int n);
+void faultprof_report(const faultprof_t *fp, FILE *out, int n);
+void faultprof_detach(faultprof_t *fp);
+
+#endif
@@ -0,0 +1,52 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-6-14 15:26:09
+ * @Last modified: 2025-6-14 15:26:09
+ * @Description: synthetic /proc trees for reproducible tests and benchmarks
+ */
+#ifndef FIXTURE_H
+#define FIXTURE_H
+#include "memtrc.h"
+
+#define FIXTURE_MARKER  ".memtrc_fixture"   //at the root of every generated tree
+
+typedef enum {
+    FIXTURE_USER,
+    FIXTURE_KERNEL,     //kernel thread look-alike: empty cmdline, no Vm* lines
+    FIXTURE_ZOMBIE,     //user process after exit: state Z, mm already gone
+    FIXTURE_STOPPED     //user process with state T
+} fixture_kind_t;
+
+typedef struct {
+    pid_t pid;
+    fixture_kind_t kind;
+    char comm[16];
+    unsigned long long starttime;   //clock ticks after boot, stat field 22
+    long vmsize_kb;
+    long vmrss_kb;
+    long vmdata_kb;
+    long vmstk_kb;
+    unsigned long minflt;
+    unsigned long majflt;
+} fixture_proc_t;
+
+typedef struct {
+    int count;              //number of processes
+    pid_t first_pid;
+    int kernel_every;       //every n-th pid is a kernel thread, 0 for none
+    int zombie_every;
+    int stopped_every;
+    int status_pad_lines;   //extra filler lines, simulates huge status files
+    int smaps_mappings;     //mappings written to smaps, 0 skips smaps
+    unsigned int seed;
+} fixture_opts_t;
+
+void fixture_default_opts(fixture_opts_t *opts);
+void fixture_make_proc(const fixture_opts_t *opts, int index, fixture_proc_t *proc);
+int fixture_write_proc(const char *root, const fixture_proc_t *proc, const fixture_opts_t *opts);
+int fixture_write_system(const char *root, unsigned long tick);
+int fixture_mark(const char *root);
+int fixture_generate(const char *root, const fixture_opts_t *opts);
+int fixture_remove(const char *root);
+
+#endif
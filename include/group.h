@@ -0,0 +1,53 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-8-2 16:27:51
+ * @Last modified: 2025-8-2 16:27:51
+ * @Description: exact memory of a process group. every member's resident
+ *               pages are looked up in /proc/<pid>/pagemap (PFNs need
+ *               CAP_SYS_ADMIN) and set in two bitmaps over physical memory,
+ *               seen and seen twice, so copy-on-write pages of pre-forked
+ *               workers are counted once. members are walked in parallel.
+ */
+#ifndef GROUP_H
+#define GROUP_H
+#include "memtrc.h"
+#include <stdint.h>
+#include <stdio.h>
+
+#define GROUP_THREADS   8               //default workers, at most one per member
+#define GROUP_CHUNK     8192            //pagemap entries per read, 64 KB
+#define GROUP_MAX_BYTES (512UL << 20)   //both bitmaps together, about 2 TB of ram
+
+typedef struct {
+    pid_t pid;
+    long rss_pages;                     //present pages, as seen through pagemap
+    long private_pages;                 //present in no other member
+    long swap_pages;
+    int error;                          //errno of a failed walk, 0 when fine
+} group_member_t;
+
+typedef struct group {
+    group_member_t *members;
+    int count;
+    int cap;
+    uint64_t *seen;                     //bit per pfn mapped by a member
+    uint64_t *multi;                    //bit per pfn mapped by two or more
+    uint64_t max_pfn;
+    size_t words;
+    long page_kb;
+    long unique_pages;
+    long shared_pages;                  //distinct pages in two or more members
+    int threads;
+    int next;                           //next member to walk, shared by the workers
+    int pass;                           //1 sets the bitmaps, 2 counts private pages
+    int no_pfn;                         //pagemap hid the pfns, we lack the privilege
+    long long scan_us;
+} group_t;
+
+int group_init(group_t *g);
+int group_add(group_t *g, pid_t pid);
+int group_scan(group_t *g, int threads);
+void group_report(const group_t *g, FILE *fp);
+void group_free(group_t *g);
+
+#endif
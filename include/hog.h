@@ -0,0 +1,54 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-8-11 21:06:44
+ * @Last modified: 2025-8-11 21:06:44
+ * @Description: synthetic memory workloads with known shapes. the calling
+ *               process itself leaks, saws, spikes, grows its stack, churns
+ *               mappings or touches a huge region, one step at a time, and
+ *               writes the ground truth of every step, so measured curves and
+ *               detections can be checked against it. memhog is the front end.
+ */
+#ifndef HOG_H
+#define HOG_H
+#include "memtrc.h"
+#include <stdio.h>
+
+#define HOG_STEP_MS     10
+#define HOG_FRAME_KB    4               //stack grows a frame of this at a time
+#define HOG_STACK_SPARE (256 * 1024)    //bytes of the stack limit left alone
+
+typedef enum {
+    HOG_LEAK,                           //0 to size over the duration, never freed
+    HOG_SAWTOOTH,                       //0 to size every period, then all freed (a gc cycle)
+    HOG_SPIKE,                          //size at once after a third of the duration, for period ms
+    HOG_STACK,                          //stack down to size over half the duration, then held
+    HOG_CHURN,                          //rate mmap + touch + munmap of size per second, flat
+    HOG_HUGE,                           //one size region (THP advised) touched at rate KB/s,
+                                        //truth in whole huge pages while THP is on
+    HOG_PATTERNS
+} hog_pattern_t;
+
+typedef struct {
+    hog_pattern_t pattern;
+    long size_kb;
+    int duration_ms;
+    int period_ms;                      //sawtooth cycle, spike hold
+    long rate;                          //churn: pairs per second; huge: KB per second
+    int step_ms;
+} hog_spec_t;
+
+typedef struct {
+    long baseline_kb;                   //RSS before the first step
+    long peak_kb;                       //largest expected KB above the baseline
+    unsigned long events;               //drops, spikes, churn pairs
+    unsigned long steps;
+    long long elapsed_ms;
+} hog_result_t;
+
+void hog_default_spec(hog_spec_t *spec, hog_pattern_t pattern);
+int hog_parse_pattern(const char *name);
+const char *hog_pattern_name(hog_pattern_t pattern);
+long hog_expected_kb(const hog_spec_t *spec, long long t_ms);
+int hog_run(const hog_spec_t *spec, FILE *truth, hog_result_t *res);
+
+#endif
@@ -0,0 +1,77 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-8-5 20:18:02
+ * @Last modified: 2025-8-5 20:18:02
+ * @Description: kernel memory: the kernel fields of /proc/meminfo, every slab
+ *               cache from /proc/slabinfo and vmalloc use by caller from
+ *               /proc/vmallocinfo, on a slow cadence. slabinfo and vmallocinfo
+ *               are root only, without them only the meminfo totals are kept.
+ */
+#ifndef KMEM_H
+#define KMEM_H
+#include "memtrc.h"
+#include "chart.h"
+#include <stdint.h>
+#include <stdio.h>
+
+#define KMEM_INTERVAL_S   10
+#define KMEM_VMALLOC_EVERY 6            //vmallocinfo walks the vmap areas under a lock
+#define KMEM_CALLERS      1024          //vmalloc callers, a power of two
+#define KMEM_TOP          5
+#define KMEM_BUF          16384
+
+typedef enum {
+    KMEM_SLAB,
+    KMEM_SRECLAIMABLE,
+    KMEM_SUNRECLAIM,
+    KMEM_VMALLOC,
+    KMEM_PAGETABLES,
+    KMEM_KERNELSTACK,
+    KMEM_FIELDS
+} kmem_field_t;
+
+typedef struct {
+    char name[32];
+    uint64_t line_hash;                 //raw slabinfo line, equal means unchanged
+    long objsize;
+    long active_objs;
+    long num_objs;
+    long kb;                            //slabs * pages per slab
+    long start_kb;                      //at the first sample
+    unsigned long gen;                  //last sample that listed the cache
+    history_data_t *hist;               //allocated once the cache changes
+} kmem_slab_t;
+
+typedef struct {
+    char caller[48];                    //symbol without the offset
+    long kb;
+    long start_kb;
+    unsigned long gen;
+} kmem_caller_t;
+
+typedef struct kmem {
+    long page_kb;
+    unsigned long samples;
+    long fields[KMEM_FIELDS];           //KB, -1 when the kernel has no such line
+    long start_fields[KMEM_FIELDS];
+    history_data_t field_hist[KMEM_FIELDS];
+    kmem_slab_t *slabs;
+    int nslabs;
+    int slab_cap;
+    int slab_cursor;                    //caches come in the same order every time
+    int have_slabinfo;
+    unsigned long slab_changed;         //caches parsed in the last sample
+    kmem_caller_t *callers;             //KMEM_CALLERS slots, open addressing
+    int have_vmalloc;
+    unsigned long vmalloc_gen;
+    long long sample_us;
+} kmem_t;
+
+int kmem_init(kmem_t *km);
+int kmem_sample(kmem_t *km, long long now_ms);
+int kmem_top_slabs(const kmem_t *km, const kmem_slab_t **out, int n);
+int kmem_top_callers(const kmem_t *km, const kmem_caller_t **out, int n);
+void kmem_report(const kmem_t *km, FILE *fp, int n);
+void kmem_free(kmem_t *km);
+
+#endif
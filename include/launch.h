@@ -0,0 +1,43 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-7-13 10:18:44
+ * @Last modified: 2025-7-13 10:18:44
+ * @Description: run a command under the sampler from exec on. the child is held
+ *               until its status file is open, stopped at its first instruction
+ *               when ptrace allows it, then sampled densely early and sparsely
+ *               later: a fixed number of samples per doubling of the run time.
+ */
+#ifndef LAUNCH_H
+#define LAUNCH_H
+#include "memtrc.h"
+#include <sys/resource.h>
+
+#define LAUNCH_MIN_US   250     //first interval
+#define LAUNCH_MAX_MS   100     //default longest interval
+#define LAUNCH_DENSITY  20      //samples per doubling of the elapsed time
+
+typedef struct {
+    long long t_us;             //since exec
+    mem_info_t info;
+    long vmhwm;                 //bytes, VmHWM of the same read
+} launch_sample_t;
+
+typedef struct {
+    pid_t pid;
+    int traced;                 //held at the first instruction with ptrace
+    int status;                 //wait status
+    struct rusage ru;           //of the child, from wait4()
+    long long start_ms;         //wall clock at exec, samples are relative to it
+    long long wall_us;          //exec to exit
+    long vmhwm;                 //last VmHWM seen, bytes
+    long peak_rss;              //largest sampled VmRSS, bytes
+    launch_sample_t *samples;
+    size_t count;
+    size_t cap;
+} launch_t;
+
+int launch_run(launch_t *l, char *const argv[], int max_ms);
+void launch_report(const launch_t *l);
+void launch_free(launch_t *l);
+
+#endif
@@ -0,0 +1,82 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-7-27 19:12:30
+ * @Last modified: 2025-7-27 19:12:30
+ * @Description: system wide growth leaderboard. every scan reads the stat file
+ *               of each process (starttime and rss in one read) and merges it
+ *               into a pid sorted table of small fixed size entries, each with
+ *               a few rss baselines spaced over the window, so "who grew most
+ *               in the last 5 minutes" is one pass over the table.
+ */
+#ifndef LEADER_H
+#define LEADER_H
+#include "memtrc.h"
+#include <stdint.h>
+#include <stdio.h>
+
+#define LEADER_POINTS   5               //baselines per entry, the window slides by window / 4
+#define LEADER_ABSENT   UINT32_MAX      //baseline taken before the process existed
+#define LEADER_MIN_KB   1024            //smaller baselines are left out of the relative ranking
+#define LEADER_TOP      10
+
+typedef enum {
+    LEADER_ABS,         //most KB gained since the window start
+    LEADER_REL,         //largest gain relative to the baseline
+    LEADER_NEW          //born inside the window, by current rss
+} leader_rank_t;
+
+//one process, 32 bytes; (pid, start) tells a reused pid from the old process
+typedef struct {
+    int32_t pid;
+    uint32_t start;                     //starttime, low 32 bits
+    uint32_t rss_kb;
+    uint32_t base_kb[LEADER_POINTS];    //rss at each baseline point
+} leader_entry_t;
+
+typedef struct {
+    int32_t pid;
+    uint32_t start;
+    uint32_t rss_kb;
+} leader_seen_t;
+
+typedef struct leader {
+    leader_entry_t *cur;                //sorted by pid
+    leader_entry_t *next;               //merge target, swapped with cur
+    leader_seen_t *seen;                //the last scan
+    size_t count;
+    size_t cap;
+    long long window_ms;
+    long long point_ms[LEADER_POINTS];  //when each baseline was taken, 0 if never
+    int point;                          //newest baseline, the oldest is point + 1
+    uint64_t exited_kb[LEADER_POINTS];  //last rss of processes gone after each point
+    uint32_t exited_n[LEADER_POINTS];
+    long page_kb;
+    unsigned long scans;
+    long long scan_us;                  //duration of the last scan
+} leader_t;
+
+typedef struct {
+    pid_t pid;
+    long base_kb;                       //-1 for processes born inside the window
+    long rss_kb;
+} leader_row_t;
+
+typedef struct {
+    size_t procs;
+    long long span_ms;                  //what the window covers so far
+    long long grown_kb;                 //sum of gains of processes older than the window
+    long long shrunk_kb;
+    size_t new_n;
+    long long new_kb;
+    size_t exited_n;
+    long long exited_kb;
+} leader_totals_t;
+
+int leader_init(leader_t *lb, long long window_ms);
+int leader_scan(leader_t *lb, long long now_ms);
+int leader_top(const leader_t *lb, leader_rank_t by, leader_row_t *out, int n);
+void leader_totals(const leader_t *lb, long long now_ms, leader_totals_t *t);
+void leader_report(const leader_t *lb, long long now_ms, FILE *fp, int n);
+void leader_free(leader_t *lb);
+
+#endif
@@ -0,0 +1,84 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-8-8 19:52:36
+ * @Last modified: 2025-8-8 19:52:36
+ * @Description: libmemtrc, in-process self monitoring. a service embeds a
+ *               memtrc_self_t and gets a background thread that samples its
+ *               own memory from /proc/self/statm (one pread on a kept fd) and
+ *               getrusage, keeps the recent samples and calls back when RSS
+ *               crosses a threshold or grows too fast. no globals, no stdio,
+ *               nothing is printed: errors are -1 with errno set. this header
+ *               stands alone, link with libmemtrc.a or -lmemtrc and -pthread.
+ */
+#ifndef LIBMEMTRC_H
+#define LIBMEMTRC_H
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MEMTRC_SELF_HISTORY 1024        //samples kept, a power of two
+
+typedef struct {
+    long long ts_ms;                    //CLOCK_MONOTONIC
+    long vmsize_kb;
+    long rss_kb;
+    long shared_kb;                     //resident file and shmem pages
+    long data_kb;                       //data and stack, touched or not
+    long maxrss_kb;                     //peak RSS, from getrusage
+    long minflt;
+    long majflt;
+} memtrc_sample_t;
+
+typedef enum {
+    MEMTRC_THRESHOLD,                   //RSS went over the threshold
+    MEMTRC_GROWTH                       //RSS grew by growth_kb within growth_ms
+} memtrc_event_kind_t;
+
+typedef struct {
+    memtrc_event_kind_t kind;
+    memtrc_sample_t sample;             //the sample that fired it
+    long grown_kb;                      //growth events: KB gained
+    long long over_ms;                  //and over how long
+} memtrc_event_t;
+
+//runs on the sampler thread, keep it short; it may call memtrc_self_latest/history
+typedef void (*memtrc_self_cb)(const memtrc_event_t *ev, void *ctx);
+
+typedef struct memtrc_self {
+    int statm_fd;
+    long page_kb;
+    long threshold_kb;                  //0 disables
+    long growth_kb;                     //0 disables
+    int growth_ms;
+    memtrc_self_cb cb;
+    void *ctx;
+
+    memtrc_sample_t *ring;              //MEMTRC_SELF_HISTORY entries
+    unsigned long head;                 //samples ever taken
+    unsigned long window_start;         //oldest sample inside growth_ms
+    int above;                          //threshold is edge triggered
+    unsigned long events;
+
+    pthread_mutex_t lock;               //ring, triggers and running
+    pthread_cond_t wake;                //stop wakes the sampler early
+    pthread_t thread;
+    int period_ms;
+    int running;
+    int started;
+    long long cpu_ns;                   //sampler thread cpu, set when it stops
+} memtrc_self_t;
+
+int memtrc_read_statm(int fd, long page_kb, memtrc_sample_t *s);
+
+int memtrc_self_init(memtrc_self_t *ms);
+void memtrc_self_set_threshold(memtrc_self_t *ms, long rss_kb);
+void memtrc_self_set_growth(memtrc_self_t *ms, long kb, int within_ms);
+void memtrc_self_set_callback(memtrc_self_t *ms, memtrc_self_cb cb, void *ctx);
+int memtrc_self_sample(memtrc_self_t *ms, memtrc_sample_t *out);
+int memtrc_self_start(memtrc_self_t *ms, int period_ms);
+void memtrc_self_stop(memtrc_self_t *ms);
+int memtrc_self_latest(memtrc_self_t *ms, memtrc_sample_t *out);
+size_t memtrc_self_history(memtrc_self_t *ms, memtrc_sample_t *out, size_t n);
+void memtrc_self_free(memtrc_self_t *ms);
+
+#endif
@@ -32,6 +32,7 @@
 #define MAX_ARGS 16
 #define KB_UNIT 1024    //1KB = 1024 bytes
 #define MAX_CMD_LENGTH 256
+#define PF_KTHREAD 0x00200000UL   //include/linux/sched.h, set for every kernel thread
 
 
 typedef enum {
@@ -48,18 +49,47 @@ typedef struct {
     proc_type_t proc_type; //process type
 } mem_info_t;
 
+typedef struct {
+    char state;                     //R, S, D, Z, T, ...
+    pid_t ppid;
+    unsigned long flags;            //PF_* bits, PF_KTHREAD marks kernel threads
+    unsigned long minflt;
+    unsigned long majflt;
+    unsigned long long starttime;   //clock ticks after boot, with pid identifies a process
+} proc_stat_t;
+
 typedef struct {
     char *log_file;     //log file path
     FILE *log_fp;       //log file pointer
     int interval;       //monitor interval
+    int adaptive;       //interval follows RSS volatility, see adaptive.h
+    int min_interval_ms; //adaptive bounds
+    int max_interval_ms;
+    int pressure;       //co-sample faults, PSI and reclaim, see pressure.h
     int continuous;     //continue monitoring    
     int monitoring;     //monitoring flag
     pid_t target_pid;   //target pid
+    struct codec_writer *zlog; //compressed log writer, see codec.h
+    struct sink *sink;  //csv / json lines rows, see sink.h
+    struct recorder *recorder; //flight recorder, see recorder.h
+    struct retention *retain;  //tiered history of the last trace, see retention.h
+    struct allocprof *allocprof; //allocation sites of a preloaded target, see allocprof.h
+    struct faultprof *faultprof; //page fault samples by mapping and site, see faultprof.h
+    struct numa *numa;  //numa_maps placement per node, see numa.h
     pthread_mutex_t lock; //mutex lock for thread safety    
 } config_t;
 
 typedef enum {
     CMD_TRACE,    //trace process memory
+    CMD_RUN,      //launch a command and trace it from exec
+    CMD_TOP,      //system wide growth leaderboard
+    CMD_GROUP,    //exact footprint of a process group
+    CMD_KMEM,     //slab, vmalloc and the kernel meminfo fields
+    CMD_ANALYZE,  //analyze an existing log file
+    CMD_HISTORY,  //chart a time range of the retained history
+    CMD_EXPORT,   //export a time range of the retained history
+    CMD_STATS,    //show memtrc's own overhead
+    CMD_PROCFS,   //show or set the procfs root
     CMD_HELP,     //display help
     CMD_QUIT,     //quit
     CMD_UNKNOWN   //unknown command
@@ -67,13 +97,27 @@ typedef enum {
 
 extern config_t *g_cfg; //global config pointer
 
+struct pressure_rates;  //see pressure.h
+
+int set_procfs_root(const char *root);
+const char *get_procfs_root(void);
+int proc_path(char *buf, size_t size, pid_t pid, const char *file);
+int process_exists(pid_t pid);
+
+int read_proc_stat(pid_t pid, proc_stat_t *st);
 proc_type_t get_process_type(pid_t pid);
+void proc_type_cache_forget(pid_t pid);
+void proc_type_cache_clear(void);
 int read_user_proc_mem_info(pid_t pid, mem_info_t *info);
 int read_kernel_proc_mem_info(pid_t pid, mem_info_t *info);
 
 int read_mem_info(pid_t pid, mem_info_t *info);
 void display_mem_info(const mem_info_t *info);
 void write_log(FILE *fp, const mem_info_t *info);
+void write_log_at(FILE *fp, long long ts_ms, const mem_info_t *info);
+void write_log_ex(FILE *fp, long long ts_ms, const mem_info_t *info,
+        const struct pressure_rates *rates);
+long long current_time_ms(void);
 
 int init_config(config_t *cfg);
 void cleanup_config(config_t *cfg);
@@ -0,0 +1,61 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-7-29 21:40:18
+ * @Last modified: 2025-7-29 21:40:18
+ * @Description: NUMA placement from /proc/<pid>/numa_maps. the kernel walks
+ *               every page of every mapping to produce it, so it is sampled on
+ *               its own slower cadence. pages are summed per node and mapping
+ *               type, and split local/remote against the nodes of the cpus the
+ *               target's threads last ran on.
+ */
+#ifndef NUMA_H
+#define NUMA_H
+#include "memtrc.h"
+#include "chart.h"
+#include <stdint.h>
+#include <stdio.h>
+
+#define NUMA_MAX_NODES   64
+#define NUMA_MAX_CPUS    4096
+#define NUMA_CHART_NODES 4              //nodes charted, the table shows all
+#define NUMA_INTERVAL_MS 10000
+#define NUMA_BUF         16384          //parser window, a line is at most a path plus counters
+
+typedef enum {
+    NUMA_ANON,
+    NUMA_HEAP,
+    NUMA_STACK,
+    NUMA_FILE,
+    NUMA_KINDS
+} numa_kind_t;
+
+typedef struct {
+    long kb[NUMA_MAX_NODES][NUMA_KINDS];
+    int nodes;                          //highest node with pages + 1
+    long lines;
+} numa_usage_t;
+
+typedef struct numa {
+    pid_t pid;
+    long long interval_ms;
+    long long last_ms;
+    int16_t cpu_node[NUMA_MAX_CPUS];
+    int sys_nodes;
+    numa_usage_t cur;
+    uint64_t local_nodes;               //bit per node a thread last ran on
+    long local_kb;
+    long remote_kb;
+    unsigned long samples;
+    long long parse_us;                 //last numa_maps read
+    history_data_t node_hist[NUMA_CHART_NODES];
+    history_data_t remote_hist;         //remote share in 0.1 %
+} numa_t;
+
+int numa_open(numa_t *nm, pid_t pid, long long interval_ms);
+int numa_parse(int fd, numa_usage_t *u);
+int numa_sample(numa_t *nm, long long now_ms);
+long numa_node_kb(const numa_usage_t *u, int node);
+void numa_report(const numa_t *nm, FILE *fp);
+void numa_close(numa_t *nm);
+
+#endif
@@ -0,0 +1,51 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-7-6 14:52:19
+ * @Last modified: 2025-7-6 14:52:19
+ * @Description: page fault and memory pressure co-sampling. per target fault
+ *               counters from /proc/<pid>/stat, system wide PSI and reclaim
+ *               counters read once per tick and shared by every target.
+ */
+#ifndef PRESSURE_H
+#define PRESSURE_H
+#include "memtrc.h"
+
+//system wide, cumulative as the kernel reports them
+typedef struct {
+    int has_psi;                        //0 without CONFIG_PSI or when disabled
+    double some_avg10;                  //% of the last 10 s some task stalled on memory
+    double full_avg10;                  //% of the last 10 s all tasks stalled
+    unsigned long long some_total;      //stall time in us
+    unsigned long long full_total;
+    unsigned long long pgscan;          //pages scanned by every reclaimer: kswapd, direct, khugepaged, proactive
+    unsigned long long pgsteal;         //pages reclaimed by them
+    unsigned long long pswpin;
+    unsigned long long pswpout;
+} sys_pressure_t;
+
+typedef struct {
+    long long ts_ms;
+    unsigned long minflt;               //target, cumulative
+    unsigned long majflt;
+    sys_pressure_t sys;
+} pressure_sample_t;
+
+//per second between two samples, stalls in % of wall time
+typedef struct pressure_rates {
+    double minflt;
+    double majflt;
+    double some_pct;
+    double full_pct;
+    double pgscan;
+    double pgsteal;
+    double pswpin;
+    double pswpout;
+} pressure_rates_t;
+
+int read_sys_pressure(sys_pressure_t *sys);
+int sys_pressure_tick(long long tick_ms, sys_pressure_t *sys);
+int pressure_sample(pid_t pid, long long tick_ms, pressure_sample_t *s);
+int pressure_rates(const pressure_sample_t *prev, const pressure_sample_t *cur,
+                   pressure_rates_t *out);
+
+#endif
@@ -0,0 +1,58 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-7-24 20:06:45
+ * @Last modified: 2025-7-24 20:06:45
+ * @Description: follow processes by name. fork, exec, comm and exit events
+ *               come from the netlink proc connector (needs CAP_NET_ADMIN), so
+ *               the cost follows process churn; without it /proc is rescanned.
+ *               a process matches when the regex finds its comm or cmdline.
+ */
+#ifndef PROCWATCH_H
+#define PROCWATCH_H
+#include "memtrc.h"
+#include <regex.h>
+
+#define PROCWATCH_RCVBUF (4 << 20)      //socket buffer, an overrun costs a rescan
+#define PROCWATCH_COMM   16
+
+typedef enum {
+    PROCWATCH_NETLINK,
+    PROCWATCH_SCAN
+} procwatch_mode_t;
+
+typedef enum {
+    PROCWATCH_ATTACH,
+    PROCWATCH_DETACH
+} procwatch_what_t;
+
+typedef void (*procwatch_cb_t)(void *ctx, pid_t pid, procwatch_what_t what, const char *comm);
+
+typedef struct {
+    pid_t pid;
+    char comm[PROCWATCH_COMM];
+} procwatch_proc_t;
+
+typedef struct procwatch {
+    regex_t re;
+    procwatch_mode_t mode;
+    int fd;                             //netlink socket, -1 when scanning
+    procwatch_proc_t *procs;            //matched and alive
+    int count;
+    int cap;
+    procwatch_cb_t cb;
+    void *ctx;
+    unsigned long events;               //connector messages handled
+    unsigned long scans;                //full /proc walks, the first one included
+    unsigned long resyncs;              //socket overruns repaired by a rescan
+    long long latency_max_ns;           //event to attach
+    long long latency_sum_ns;
+    unsigned long latency_n;
+} procwatch_t;
+
+int procwatch_open(procwatch_t *pw, const char *pattern, int scan_only,
+                   procwatch_cb_t cb, void *ctx);
+int procwatch_poll(procwatch_t *pw);
+const procwatch_proc_t *procwatch_find(const procwatch_t *pw, pid_t pid);
+void procwatch_close(procwatch_t *pw);
+
+#endif
@@ -0,0 +1,69 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-6-25 21:17:40
+ * @Last modified: 2025-6-25 21:17:40
+ * @Description: flight recorder. the sampler pushes every sample into a
+ *               pre-allocated single producer ring; when an RSS threshold or
+ *               growth trigger fires, a dumper thread writes the window around
+ *               it, a smaps_rollup snapshot and optionally runs a hook command.
+ */
+#ifndef RECORDER_H
+#define RECORDER_H
+#include "memtrc.h"
+#include <semaphore.h>
+
+#define RECORDER_SAMPLE_MS   100     //sampling pace while armed, unless adaptive is faster
+#define RECORDER_PRE_MS      10000
+#define RECORDER_POST_MS     5000
+#define RECORDER_MAX_HOOKS   8       //hook commands still running at once
+#define RECORDER_ROLLUP_SIZE 4096
+
+typedef struct {
+    long long ts_ms;
+    long vmsize;
+    long vmrss;
+    long vmdata;
+    long vmstk;
+    proc_type_t proc_type;
+} recorder_sample_t;
+
+typedef struct recorder {
+    pid_t pid;
+    long threshold;             //bytes of RSS, 0 disables
+    long growth;                //bytes of RSS growth within growth_ms, 0 disables
+    int growth_ms;
+    int pre_ms;                 //window dumped before the trigger
+    int post_ms;                //and after it
+    char dir[PATH_MAX];         //where dumps go
+    char *hook;                 //sh -c command run after each dump, may be NULL
+
+    recorder_sample_t *ring;    //cap entries, cap is a power of two
+    unsigned long cap;
+    unsigned long head;         //samples ever pushed, published with release stores
+
+    //sampler side trigger state, only the producer touches these
+    unsigned long window_start; //oldest sample inside growth_ms
+    int above;                  //last sample was above threshold
+
+    //trigger handoff, written by the producer before sem_post
+    int armed;                  //1 while no dump is pending
+    long long trigger_ts;
+    unsigned long trigger_idx;
+    char reason[128];
+
+    sem_t wake;
+    pthread_t thread;
+    int running;
+    int started;
+    pid_t hooks[RECORDER_MAX_HOOKS];
+    int dumps;                  //completed dumps
+    char last_dump[PATH_MAX];
+} recorder_t;
+
+int recorder_init(recorder_t *rec, pid_t pid);
+int recorder_start(recorder_t *rec, int sample_ms);
+void recorder_push(recorder_t *rec, long long ts_ms, const mem_info_t *info);
+void recorder_stop(recorder_t *rec);
+void recorder_free(recorder_t *rec);
+
+#endif
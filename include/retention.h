@@ -0,0 +1,78 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-6-28 20:41:06
+ * @Last modified: 2025-6-28 20:41:06
+ * @Description: tiered retention store. raw samples for about an hour, then
+ *               1 minute and 1 hour min/max/avg rollups, all in fixed size rings
+ *               that can live in an mmap'd file so history survives restarts.
+ */
+#ifndef RETENTION_H
+#define RETENTION_H
+#include "memtrc.h"
+#include "sketch.h"
+#include <stdint.h>
+
+#define RETAIN_MAGIC        "MTRS"
+#define RETAIN_VERSION      2
+#define RETAIN_COLS         4           //VSZ, RSS, Data, Stack, same order as the zlog
+#define RETAIN_RAW_CAP      4096        //an hour at 1 s, less at faster paces
+#define RETAIN_MINUTE_MS    60000LL
+#define RETAIN_MINUTE_SLOTS 1440        //a day of minutes
+#define RETAIN_HOUR_MS      3600000LL
+#define RETAIN_HOUR_SLOTS   720         //a month of hours
+
+typedef struct {
+    int64_t ts_ms;
+    int64_t v[RETAIN_COLS];
+} retain_raw_t;
+
+//one rollup slot, start_ms tells whether it holds the period we look for
+typedef struct {
+    int64_t start_ms;
+    int64_t count;
+    int64_t min[RETAIN_COLS];
+    int64_t max[RETAIN_COLS];
+    int64_t sum[RETAIN_COLS];
+} retain_bucket_t;
+
+//the whole store, plain data so it can be mapped from a file as is
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t raw_cap;           //layout check on reopen
+    uint32_t minute_slots;
+    uint32_t hour_slots;
+    int32_t pid;                //last target written
+    int64_t newest_ms;
+    uint64_t raw_head;          //raw samples ever appended
+    retain_raw_t raw[RETAIN_RAW_CAP];
+    retain_bucket_t minutes[RETAIN_MINUTE_SLOTS];
+    retain_bucket_t hours[RETAIN_HOUR_SLOTS];
+    sketch_t rss_dist;          //every sample ever appended, for quantiles
+    sketch_t vsz_dist;
+} retain_store_t;
+
+typedef struct retention {
+    retain_store_t *st;
+    int fd;                     //-1 when the store is anonymous memory
+} retention_t;
+
+//query output, min == max == avg for raw samples
+typedef struct {
+    long long ts_ms;            //start of the point
+    long count;                 //samples folded into it
+    long min[RETAIN_COLS];
+    long max[RETAIN_COLS];
+    long avg[RETAIN_COLS];
+} retain_point_t;
+
+int retention_open(retention_t *r, const char *path, pid_t pid, int reset);
+int retention_is_store(const char *path);
+void retention_append(retention_t *r, long long ts_ms, const long *vals);
+int retention_query(const retention_t *r, long long from_ms, long long to_ms,
+                     int max_points, retain_point_t **out, long long *res_ms);
+int retention_export(const retention_t *r, FILE *fp, long long from_ms, long long to_ms, int json);
+void retention_close(retention_t *r);
+long long parse_span(const char *s);
+
+#endif
@@ -0,0 +1,49 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-6-18 19:42:30
+ * @Last modified: 2025-6-18 19:42:30
+ * @Description: batched sampler for large target sets. every target keeps its
+ *               status fd open between ticks; a tick is either one pread per
+ *               target or io_uring batches of registered reads.
+ */
+#ifndef SAMPLER_H
+#define SAMPLER_H
+#include "memtrc.h"
+
+#define SAMPLER_BUF_SIZE   4096    //per read, the Vm* lines sit well inside it
+#define SAMPLER_RING_DEPTH 1024    //reads per io_uring batch
+
+typedef enum {
+    SAMPLER_AUTO,       //io_uring when the kernel allows it, else pread
+    SAMPLER_PREAD,
+    SAMPLER_URING
+} sampler_backend_t;
+
+typedef struct {
+    pid_t pid;
+    int fd;             //open /proc/<pid>/status, -1 once the process is gone
+    mem_info_t info;    //values of the last tick, same units as read_mem_info()
+} sampler_target_t;
+
+typedef struct sampler {
+    sampler_backend_t backend;      //resolved backend, never SAMPLER_AUTO after init
+    sampler_target_t *targets;
+    int count;
+    int cap;
+    int alive;                      //targets that answered the last tick
+    char *bufs;                     //SAMPLER_RING_DEPTH read buffers
+    struct sampler_ring *ring;      //NULL for pread
+    int files_dirty;                //target set changed since the fds were registered
+    unsigned long long ticks;
+    unsigned long long syscalls;    //pread or io_uring_enter calls made by ticks
+} sampler_t;
+
+int sampler_init(sampler_t *s, sampler_backend_t backend);
+int sampler_add(sampler_t *s, pid_t pid);
+int sampler_remove(sampler_t *s, pid_t pid);
+int sampler_tick(sampler_t *s);
+void sampler_free(sampler_t *s);
+const char *sampler_backend_name(sampler_backend_t backend);
+int parse_status_buffer(const char *buf, size_t len, mem_info_t *info);
+
+#endif
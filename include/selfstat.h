@@ -0,0 +1,50 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-6-3 20:15:47
+ * @Last modified: 2025-6-3 20:15:47
+ * @Description: self instrumentation, per-thread probe counters with log2
+ *               latency histograms plus memtrc's own cpu, rss and syscalls
+ */
+#ifndef SELFSTAT_H
+#define SELFSTAT_H
+#include "memtrc.h"
+#include <stdint.h>
+
+#define PROBE_BUCKETS 40    //bucket i holds durations in [2^(i-1), 2^i) ns
+
+typedef enum {
+    PROBE_PROC_TYPE,    //get_process_type()
+    PROBE_READ_MEM,     //read_user/kernel_proc_mem_info()
+    PROBE_RENDER,       //display_mem_info() and charts
+    PROBE_LOG,          //text and compressed logging
+    PROBE_TICK,         //one whole sampling tick
+    PROBE_COUNT
+} probe_t;
+
+typedef struct {
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t hist[PROBE_BUCKETS];
+} probe_counter_t;
+
+typedef struct {
+    probe_counter_t probes[PROBE_COUNT];
+    double cpu_user;        //seconds
+    double cpu_sys;
+    long rss_kb;            //current resident set
+    long maxrss_kb;         //peak resident set
+    uint64_t syscalls;      //read + write syscalls (/proc/self/io syscr + syscw)
+} selfstat_snapshot_t;
+
+uint64_t selfstat_now(void);
+void selfstat_record(probe_t probe, uint64_t start_ns);
+
+void selfstat_snapshot(selfstat_snapshot_t *snap);
+void selfstat_diff(const selfstat_snapshot_t *end, const selfstat_snapshot_t *start,
+        selfstat_snapshot_t *out);
+uint64_t selfstat_percentile(const probe_counter_t *c, int pct);
+void selfstat_print(FILE *fp, const selfstat_snapshot_t *snap);
+void selfstat_log(FILE *fp, const selfstat_snapshot_t *snap);
+
+#endif
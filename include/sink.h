@@ -0,0 +1,58 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-7-21 21:14:09
+ * @Last modified: 2025-7-21 21:14:09
+ * @Description: streaming csv / json lines output for other tools. rows are
+ *               formatted without printf into a block buffer that goes out with
+ *               one write() per block (or per second), the date part of the
+ *               timestamp is formatted once per second. an optional deadband
+ *               only emits rows that moved, with a heartbeat in between.
+ */
+#ifndef SINK_H
+#define SINK_H
+#include "memtrc.h"
+
+#define SINK_BUF_SIZE     65536
+#define SINK_FLUSH_MS     1000      //longest a row waits in the buffer
+#define SINK_HEARTBEAT_MS 60000     //default heartbeat with a deadband
+#define SINK_COLS         4         //VSZ, RSS, Data, Stack
+
+typedef enum {
+    SINK_CSV,
+    SINK_JSONL
+} sink_format_t;
+
+//deadband state of one stream of rows
+typedef struct {
+    long long emitted_ms;       //last row written
+    long last[SINK_COLS];       //values of that row
+    int have_last;
+} sink_band_t;
+
+typedef struct sink {
+    sink_format_t format;
+    int fd;
+    int to_stdout;              //the monitor leaves the screen to the rows then
+    char *buf;
+    size_t len;
+    long long flushed_ms;       //sample time of the last flush
+    long long date_sec;         //second the cached date belongs to
+    char date[24];              //YYYY-MM-DDTHH:MM:SS local time
+    long deadband;              //bytes, 0 emits every row
+    long long heartbeat_ms;
+    sink_band_t band;           //of sink_write(), a single pid
+    unsigned long rows;
+    unsigned long suppressed;   //rows held back by the deadband
+} sink_t;
+
+int sink_parse_format(const char *name, sink_format_t *format);
+int sink_open(sink_t *s, const char *path, sink_format_t format, long deadband_kb,
+              long long heartbeat_ms);
+int sink_write(sink_t *s, long long ts_ms, pid_t pid, const mem_info_t *info);
+int sink_write_band(sink_t *s, sink_band_t *band, long long ts_ms, pid_t pid,
+                    const mem_info_t *info);
+int sink_flush(sink_t *s);
+void sink_close(sink_t *s);
+char *sink_put_long(char *p, long v);
+
+#endif
@@ -0,0 +1,33 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-7-2 19:26:51
+ * @Last modified: 2025-7-2 19:26:51
+ * @Description: streaming quantile sketch, an HDR style log linear histogram.
+ *               O(1) per sample, fixed memory, and two sketches merge by adding
+ *               their buckets, so targets and log files can be combined.
+ */
+#ifndef SKETCH_H
+#define SKETCH_H
+#include "memtrc.h"
+#include <stdint.h>
+
+#define SKETCH_SUB_BITS  7      //128 sub-buckets per power of two, < 0.8% error
+#define SKETCH_MAX_BITS  48     //values up to 256 TB, larger ones share the last bucket
+#define SKETCH_BUCKETS   ((SKETCH_MAX_BITS - SKETCH_SUB_BITS + 1) << SKETCH_SUB_BITS)
+
+//plain data, it is also stored in retention files
+typedef struct {
+    uint64_t count;
+    int64_t min;
+    int64_t max;
+    double sum;
+    uint64_t buckets[SKETCH_BUCKETS];
+} sketch_t;
+
+void sketch_init(sketch_t *s);
+void sketch_add(sketch_t *s, long value);
+void sketch_merge(sketch_t *dst, const sketch_t *src);
+long sketch_quantile(const sketch_t *s, double q);
+void sketch_print(FILE *fp, const char *name, const sketch_t *s);
+
+#endif
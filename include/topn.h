@@ -0,0 +1,24 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-8-12 20:17:03
+ * @Last modified: 2025-8-12 20:17:03
+ * @Description: partial top-n selection shared by the leaderboards (growth,
+ *               allocation sites, fault regions, slab caches, vmalloc callers).
+ *               one pass, insertion into the n best seen so far.
+ */
+#ifndef TOPN_H
+#define TOPN_H
+#include <stddef.h>
+
+#define TOPN_STACK 64               //keys kept on the stack up to this n
+
+/*
+ * key of item: key[0] ranks, key[1] breaks ties, larger first. returns 0 to
+ * leave the item out.
+ */
+typedef int (*topn_key_t)(const void *item, const void *ctx, double key[2]);
+
+int topn_select(const void *items, size_t count, size_t size, topn_key_t key,
+                const void *ctx, const void **out, int n);
+
+#endif
@@ -0,0 +1,334 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-8-5 20:18:02
+ * @Last modified: 2025-8-5 20:18:02
+ * @Description: kernel memory sampling. the three files are read through a
+ *               fixed window a line at a time. a slabinfo line is hashed
+ *               before it is parsed, a cache whose line did not change since
+ *               the last sample is left alone, and only caches that changed
+ *               once get a history of their own.
+ */
+
+#include "include/memtrc.h"
+#include "include/kmem.h"
+#include "include/topn.h"
+#include <fcntl.h>
+#include <time.h>
+
+static const char *field_names[KMEM_FIELDS] = {
+    "Slab:", "SReclaimable:", "SUnreclaim:", "VmallocUsed:", "PageTables:", "KernelStack:"
+};
+
+static const char *field_titles[KMEM_FIELDS] = {
+    "slab", "reclaimable", "unreclaimable", "vmalloc", "page tables", "kernel stacks"
+};
+
+typedef void (*kmem_line_fn)(kmem_t *km, char *line);
+
+
+int kmem_init(kmem_t *km) {
+    if (!km) {
+        fprintf(stderr, "Error: Invalid arguments to kmem_init()\n");
+        return -1;
+    }
+    memset(km, 0, sizeof(kmem_t));
+    km->page_kb = sysconf(_SC_PAGESIZE) / 1024;
+    if (km->page_kb <= 0) km->page_kb = 4;
+    for (int f = 0; f < KMEM_FIELDS; f++) init_history(&km->field_hist[f]);
+    km->callers = calloc(KMEM_CALLERS, sizeof(kmem_caller_t));
+    if (!km->callers) {
+        fprintf(stderr, "Error: out of memory for kernel memory tracking\n");
+        return -1;
+    }
+    return 0;
+}
+
+
+//every line of a file under the procfs root, in a fixed window
+static int read_lines(kmem_t *km, const char *name, kmem_line_fn fn) {
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/%s", get_procfs_root(), name) >= (int)sizeof(path)) {
+        return -1;
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    char buf[KMEM_BUF];
+    size_t len = 0;
+    for (;;) {
+        ssize_t n = read(fd, buf + len, sizeof(buf) - 1 - len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        len += (size_t)n;
+        char *start = buf, *nl;
+        while ((nl = memchr(start, '\n', buf + len - start)) != NULL) {
+            *nl = '\0';
+            fn(km, start);
+            start = nl + 1;
+        }
+        len -= (size_t)(start - buf);
+        memmove(buf, start, len);
+        if (len == sizeof(buf) - 1) len = 0;    //no line is that long, drop it
+    }
+    if (len > 0) {
+        buf[len] = '\0';
+        fn(km, buf);
+    }
+    close(fd);
+    return 0;
+}
+
+
+static void meminfo_line(kmem_t *km, char *line) {
+    for (int f = 0; f < KMEM_FIELDS; f++) {
+        size_t n = strlen(field_names[f]);
+        if (strncmp(line, field_names[f], n) == 0) {
+            km->fields[f] = strtol(line + n, NULL, 10);
+            return;
+        }
+    }
+}
+
+
+static uint64_t hash_line(const char *s) {
+    uint64_t h = 1469598103934665603ULL;
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+
+static kmem_slab_t *find_slab(kmem_t *km, const char *name) {
+    //the cursor guess holds unless a cache came or went
+    if (km->slab_cursor < km->nslabs && strcmp(km->slabs[km->slab_cursor].name, name) == 0) {
+        return &km->slabs[km->slab_cursor++];
+    }
+    for (int i = 0; i < km->nslabs; i++) {
+        if (strcmp(km->slabs[i].name, name) == 0) {
+            km->slab_cursor = i + 1;
+            return &km->slabs[i];
+        }
+    }
+    if (km->nslabs == km->slab_cap) {
+        int cap = km->slab_cap ? km->slab_cap * 2 : 256;
+        kmem_slab_t *s = realloc(km->slabs, cap * sizeof(kmem_slab_t));
+        if (!s) return NULL;
+        km->slabs = s;
+        km->slab_cap = cap;
+    }
+    kmem_slab_t *s = &km->slabs[km->nslabs++];
+    memset(s, 0, sizeof(kmem_slab_t));
+    snprintf(s->name, sizeof(s->name), "%s", name);
+    km->slab_cursor = km->nslabs;
+    return s;
+}
+
+
+/*
+ * "<name> <active_objs> <num_objs> <objsize> <objperslab> <pagesperslab>
+ *  : tunables .. : slabdata <active_slabs> <num_slabs> <sharedavail>"
+ */
+static void slab_line(kmem_t *km, char *line) {
+    if (line[0] == '#' || strncmp(line, "slabinfo", 8) == 0) return;
+    char name[32];
+    size_t n = strcspn(line, " ");
+    if (n == 0 || n >= sizeof(name)) return;
+    memcpy(name, line, n);
+    name[n] = '\0';
+    uint64_t h = hash_line(line + n);
+    kmem_slab_t *s = find_slab(km, name);
+    if (!s) return;
+    int fresh = s->gen == 0;
+    s->gen = km->samples + 1;
+    if (!fresh && s->line_hash == h) return;
+    s->line_hash = h;
+
+    char *p = line + n, *end;
+    long v[5];
+    for (int i = 0; i < 5; i++) {
+        v[i] = strtol(p, &end, 10);
+        if (end == p) return;
+        p = end;
+    }
+    char *data = strstr(p, "slabdata");
+    if (!data) return;
+    strtol(data + 8, &end, 10);             //active slabs
+    long slabs = strtol(end, NULL, 10);
+    s->active_objs = v[0];
+    s->num_objs = v[1];
+    s->objsize = v[2];
+    s->kb = slabs * v[4] * km->page_kb;
+    if (fresh) {
+        //caches made after the first sample (module loads) grew from nothing
+        s->start_kb = km->samples == 0 ? s->kb : 0;
+        return;
+    }
+    km->slab_changed++;
+    if (!s->hist && (s->hist = malloc(sizeof(history_data_t))) != NULL) {
+        init_history(s->hist);
+    }
+}
+
+
+static kmem_caller_t *find_caller(kmem_t *km, const char *caller) {
+    uint64_t h = hash_line(caller);
+    for (int i = 0; i < KMEM_CALLERS; i++) {
+        kmem_caller_t *c = &km->callers[(h + i) & (KMEM_CALLERS - 1)];
+        if (c->caller[0] == '\0') {
+            snprintf(c->caller, sizeof(c->caller), "%s", caller);
+            c->start_kb = -1;
+            return c;
+        }
+        if (strcmp(c->caller, caller) == 0) return c;
+    }
+    return NULL;
+}
+
+
+//"0x..-0x.. <size> <caller+off/len> pages=<n> vmalloc ..." only areas with pages are ram
+static void vmalloc_line(kmem_t *km, char *line) {
+    char *pages = strstr(line, " pages=");
+    if (!pages) return;     //ioremap, vmap of pages someone else owns, guard areas
+    char *p = strchr(line, ' ');
+    if (!p) return;
+    while (*p == ' ') p++;
+    p = strchr(p, ' ');     //past the size
+    if (!p) return;
+    p++;
+    size_t n = strcspn(p, "+ ");
+    char caller[48];
+    if (n >= sizeof(caller)) n = sizeof(caller) - 1;
+    memcpy(caller, p, n);
+    caller[n] = '\0';
+    kmem_caller_t *c = find_caller(km, caller);
+    if (!c) return;
+    if (c->gen != km->vmalloc_gen) {
+        c->gen = km->vmalloc_gen;
+        c->kb = 0;
+    }
+    c->kb += strtol(pages + 7, NULL, 10) * km->page_kb;
+}
+
+
+//returns 0, or -1 when not even meminfo could be read
+int kmem_sample(kmem_t *km, long long now_ms) {
+    if (!km || !km->callers) return -1;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int f = 0; f < KMEM_FIELDS; f++) km->fields[f] = -1;
+    if (read_lines(km, "meminfo", meminfo_line) != 0) return -1;
+
+    km->slab_changed = 0;
+    km->slab_cursor = 0;
+    km->have_slabinfo = read_lines(km, "slabinfo", slab_line) == 0;
+    if (km->samples % KMEM_VMALLOC_EVERY == 0) {
+        km->vmalloc_gen++;
+        km->have_vmalloc = read_lines(km, "vmallocinfo", vmalloc_line) == 0;
+        for (int i = 0; i < KMEM_CALLERS; i++) {
+            kmem_caller_t *c = &km->callers[i];
+            if (c->caller[0] && c->gen != km->vmalloc_gen) c->kb = 0;  //all freed
+            if (c->caller[0] && c->start_kb < 0) c->start_kb = km->vmalloc_gen == 1 ? c->kb : 0;
+        }
+    }
+
+    for (int f = 0; f < KMEM_FIELDS; f++) {
+        if (km->fields[f] < 0) continue;
+        if (km->samples == 0) km->start_fields[f] = km->fields[f];
+        update_history_at(&km->field_hist[f], now_ms, km->fields[f]);
+    }
+    for (int i = 0; i < km->nslabs; i++) {
+        kmem_slab_t *s = &km->slabs[i];
+        if (s->gen != km->samples + 1) {
+            //destroyed, a cache made again with the same line must be parsed again
+            s->kb = 0;
+            s->line_hash = 0;
+        }
+        if (s->hist) update_history_at(s->hist, now_ms, s->kb);
+    }
+    km->samples++;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    km->sample_us = (t1.tv_sec - t0.tv_sec) * 1000000LL + (t1.tv_nsec - t0.tv_nsec) / 1000;
+    return 0;
+}
+
+
+static int slab_key(const void *item, const void *ctx, double key[2]) {
+    const kmem_slab_t *s = item;
+    (void)ctx;
+    key[0] = (double)(s->kb - s->start_kb);
+    key[1] = 0;
+    return s->kb > s->start_kb;
+}
+
+
+static int caller_key(const void *item, const void *ctx, double key[2]) {
+    const kmem_caller_t *c = item;
+    (void)ctx;
+    key[0] = (double)(c->kb - c->start_kb);
+    key[1] = 0;
+    return c->caller[0] && c->kb > c->start_kb;
+}
+
+
+//the n caches that grew most since the first sample, most first
+int kmem_top_slabs(const kmem_t *km, const kmem_slab_t **out, int n) {
+    if (!km || !out || n <= 0) return 0;
+    return topn_select(km->slabs, km->nslabs, sizeof(kmem_slab_t), slab_key, NULL,
+                       (const void **)out, n);
+}
+
+
+int kmem_top_callers(const kmem_t *km, const kmem_caller_t **out, int n) {
+    if (!km || !km->callers || !out || n <= 0) return 0;
+    return topn_select(km->callers, KMEM_CALLERS, sizeof(kmem_caller_t), caller_key, NULL,
+                       (const void **)out, n);
+}
+
+
+void kmem_report(const kmem_t *km, FILE *fp, int n) {
+    if (!km || !fp || km->samples == 0) return;
+    fprintf(fp, "==== kernel memory: %d slab caches, %lu changed, sampled in %.1f ms ====\n",
+            km->nslabs, km->slab_changed, km->sample_us / 1000.0);
+    for (int f = 0; f < KMEM_FIELDS; f++) {
+        if (km->fields[f] < 0) continue;
+        fprintf(fp, "%s%s %ld KB (%+ld)", f ? " | " : "", field_titles[f], km->fields[f],
+                km->fields[f] - km->start_fields[f]);
+    }
+    fprintf(fp, "\n");
+    if (!km->have_slabinfo || !km->have_vmalloc) {
+        fprintf(fp, "slabinfo and vmallocinfo are readable by root only, totals shown\n");
+    }
+
+    const kmem_slab_t *slabs[KMEM_TOP * 4];
+    if (n > KMEM_TOP * 4) n = KMEM_TOP * 4;
+    int found = kmem_top_slabs(km, slabs, n);
+    if (found > 0) {
+        fprintf(fp, "slab caches grown since the first sample:\n%-24s %8s %10s %10s %10s\n",
+                "cache", "objsize", "objects", "KB", "+KB");
+        for (int i = 0; i < found; i++) {
+            fprintf(fp, "%-24s %8ld %10ld %10ld %+10ld\n", slabs[i]->name, slabs[i]->objsize,
+                    slabs[i]->active_objs, slabs[i]->kb, slabs[i]->kb - slabs[i]->start_kb);
+        }
+    }
+    const kmem_caller_t *callers[KMEM_TOP * 4];
+    found = kmem_top_callers(km, callers, n);
+    if (found > 0) {
+        fprintf(fp, "vmalloc callers grown since the first sample:\n%-40s %10s %10s\n",
+                "caller", "KB", "+KB");
+        for (int i = 0; i < found; i++) {
+            fprintf(fp, "%-40s %10ld %+10ld\n", callers[i]->caller, callers[i]->kb,
+                    callers[i]->kb - callers[i]->start_kb);
+        }
+    }
+}
+
+
+void kmem_free(kmem_t *km) {
+    if (!km) return;
+    for (int f = 0; f < KMEM_FIELDS; f++) cleanup_history(&km->field_hist[f]);
+    for (int i = 0; i < km->nslabs; i++) free(km->slabs[i].hist);
+    free(km->slabs);
+    free(km->callers);
+    memset(km, 0, sizeof(kmem_t));
+}
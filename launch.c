@@ -0,0 +1,237 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-7-13 10:18:44
+ * @Last modified: 2025-7-13 10:18:44
+ * @Description: run a command and profile its memory from exec on. the status
+ *               fd is opened while the child waits on a pipe, so the first read
+ *               needs no path lookup; with PTRACE_TRACEME the kernel stops the
+ *               new image before its first instruction and sample 0 is taken
+ *               there. without ptrace sampling starts as soon as exec returns.
+ */
+#define _GNU_SOURCE
+#include "include/memtrc.h"
+#include "include/launch.h"
+#include "include/chart.h"
+#include "include/sampler.h"
+#include <fcntl.h>
+#include <math.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+
+
+static long long now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+//one pread of the open status fd, -1 once the process is gone
+static int take_sample(launch_t *l, int fd, long long t_us) {
+    char buf[SAMPLER_BUF_SIZE];
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) return -1;
+    buf[n] = '\0';
+
+    if (l->count == l->cap) {
+        size_t cap = l->cap ? l->cap * 2 : 1024;
+        launch_sample_t *tmp = realloc(l->samples, cap * sizeof(launch_sample_t));
+        if (!tmp) return -1;
+        l->samples = tmp;
+        l->cap = cap;
+    }
+    launch_sample_t *s = &l->samples[l->count];
+    s->t_us = t_us;
+    s->info.proc_type = PROC_TYPE_USER;
+    //a zombie's status has no Vm lines, that is the end as well
+    if (parse_status_buffer(buf, n, &s->info) == 0) return -1;
+    const char *hwm = strstr(buf, "VmHWM:");
+    s->vmhwm = hwm ? strtol(hwm + 6, NULL, 10) * KB_UNIT : 0;
+    if (s->vmhwm > l->vmhwm) l->vmhwm = s->vmhwm;
+    if (s->info.vmrss > l->peak_rss) l->peak_rss = s->info.vmrss;
+    l->count++;
+    return 0;
+}
+
+
+static void sleep_us(long long us) {
+    struct timespec ts = { us / 1000000, (us % 1000000) * 1000 };
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR);
+}
+
+
+/*
+ * fork, hold, exec argv and sample it until it exits, max_ms caps the interval.
+ * samples stay in memory so logging costs nothing while the start is sampled.
+ * returns -1 if the command never ran.
+ */
+int launch_run(launch_t *l, char *const argv[], int max_ms) {
+    if (!l || !argv || !argv[0] || max_ms <= 0) {
+        fprintf(stderr, "Error: Invalid arguments to launch_run()\n");
+        return -1;
+    }
+    memset(l, 0, sizeof(launch_t));
+    int barrier[2], report[2];
+    if (pipe(barrier) != 0) return -1;
+    if (pipe2(report, O_CLOEXEC) != 0) {
+        close(barrier[0]);
+        close(barrier[1]);
+        return -1;
+    }
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid < 0) {
+        fprintf(stderr, "Failed to fork: %s\n", strerror(errno));
+        close(barrier[0]);
+        close(barrier[1]);
+        close(report[0]);
+        close(report[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        //child: wait for the sampler, then say whether we are traced and exec
+        close(barrier[1]);
+        close(report[0]);
+        char go;
+        if (read(barrier[0], &go, 1) != 1) _exit(127);
+        close(barrier[0]);
+        char traced = ptrace(PTRACE_TRACEME, 0, NULL, NULL) == 0 ? 'T' : 'N';
+        if (write(report[1], &traced, 1) != 1) _exit(127);
+        execvp(argv[0], argv);
+        int err = errno;
+        if (write(report[1], &err, sizeof(err)) != sizeof(err)) _exit(127);
+        _exit(127);
+    }
+
+    close(barrier[0]);
+    close(report[1]);
+    l->pid = pid;
+    char path[PATH_MAX];
+    int fd = -1;
+    if (proc_path(path, sizeof(path), pid, "status") == 0) {
+        fd = open(path, O_RDONLY | O_CLOEXEC);     //the same file after exec
+    }
+    char go = 1, traced = 'N';
+    int err = 0;
+    ssize_t n = -1;
+    if (fd >= 0 && write(barrier[1], &go, 1) == 1 && read(report[0], &traced, 1) == 1) {
+        n = read(report[0], &err, sizeof(err));     //EOF means exec went through
+    }
+    close(barrier[1]);
+    close(report[0]);
+    if (fd < 0 || n != 0) {
+        if (n > 0) fprintf(stderr, "Failed to run %s: %s\n", argv[0], strerror(err));
+        else fprintf(stderr, "Failed to start %s\n", argv[0]);
+        if (fd >= 0) close(fd);
+        kill(pid, SIGKILL);
+        wait4(pid, &l->status, 0, &l->ru);
+        return -1;
+    }
+
+    long long t0 = now_us();
+    l->start_ms = current_time_ms();
+    if (traced == 'T') {
+        //stopped by the exec SIGTRAP, nothing of the new image has run yet
+        int st;
+        if (waitpid(pid, &st, 0) == pid && WIFSTOPPED(st)) {
+            l->traced = 1;
+            t0 = now_us();
+            l->start_ms = current_time_ms();
+            take_sample(l, fd, 0);
+            ptrace(PTRACE_DETACH, pid, NULL, NULL);
+        }
+    }
+
+    //sample until the child is reaped, interval grows with the elapsed time:
+    //each sample lands 2^(1/LAUNCH_DENSITY) times later than the one before
+    long long max_us = max_ms * 1000LL;
+    double step = exp2(1.0 / LAUNCH_DENSITY) - 1.0;
+    while (1) {
+        long long t = now_us() - t0;
+        pid_t done = wait4(pid, &l->status, WNOHANG, &l->ru);
+        if (done == pid) {
+            l->wall_us = t;
+            break;
+        }
+        take_sample(l, fd, t);
+        long long next = (long long)(t * step);
+        if (next < LAUNCH_MIN_US) next = LAUNCH_MIN_US;
+        if (next > max_us) next = max_us;
+        sleep_us(next);
+    }
+    close(fd);
+    return 0;
+}
+
+
+static void print_sample(const char *label, const launch_sample_t *s) {
+    printf("  %9s  RSS %9ld KB  VSZ %9ld KB  Data %9ld KB\n", label,
+           s->info.vmrss / KB_UNIT, s->info.vmsize / KB_UNIT, s->info.vmdata / KB_UNIT);
+}
+
+
+//summary, RSS at 1-2-5 milestones after exec and a chart with log spaced time
+void launch_report(const launch_t *l) {
+    if (!l) return;
+    printf("==== run: pid %d ====\n", l->pid);
+    if (WIFEXITED(l->status)) {
+        printf("exit status %d", WEXITSTATUS(l->status));
+    } else if (WIFSIGNALED(l->status)) {
+        printf("killed by signal %d", WTERMSIG(l->status));
+    }
+    printf(", %.3f s wall, %.3f s user, %.3f s sys, %ld minor / %ld major faults\n",
+           l->wall_us / 1e6,
+           l->ru.ru_utime.tv_sec + l->ru.ru_utime.tv_usec / 1e6,
+           l->ru.ru_stime.tv_sec + l->ru.ru_stime.tv_usec / 1e6,
+           l->ru.ru_minflt, l->ru.ru_majflt);
+    printf("peak RSS %ld KB (wait4), VmHWM %ld KB, largest sample %ld KB\n",
+           l->ru.ru_maxrss, l->vmhwm / KB_UNIT, l->peak_rss / KB_UNIT);
+    printf("%zu samples%s\n", l->count, l->traced ? ", first at the first instruction" : "");
+    if (l->count == 0) {
+        printf("=====================\n");
+        return;
+    }
+
+    print_sample("exec", &l->samples[0]);
+    size_t i = 0;
+    for (long long ms = 1; i < l->count; ms *= 10) {
+        static const int steps[] = { 1, 2, 5 };
+        for (int k = 0; k < 3; k++) {
+            long long at = ms * steps[k] * 1000;
+            if (at > l->samples[l->count - 1].t_us) {
+                i = l->count;
+                break;
+            }
+            while (i + 1 < l->count && l->samples[i + 1].t_us <= at) i++;
+            char label[32];
+            if (at < 1000000) snprintf(label, sizeof(label), "+%lld ms", at / 1000);
+            else snprintf(label, sizeof(label), "+%lld s", at / 1000000);
+            print_sample(label, &l->samples[i]);
+        }
+    }
+    print_sample("last", &l->samples[l->count - 1]);
+
+    //samples are already spaced evenly in log time, keep the peak of each column
+    history_data_t hist;
+    init_history(&hist);
+    int cols = l->count < CHART_WIDTH - 1 ? (int)l->count : CHART_WIDTH - 1;
+    for (int c = 0; c < cols; c++) {
+        size_t from = l->count * c / cols, to = l->count * (c + 1) / cols;
+        long best = 0;
+        for (size_t j = from; j < to; j++) {
+            if (l->samples[j].info.vmrss > best) best = l->samples[j].info.vmrss;
+        }
+        update_history(&hist, best);
+    }
+    draw_chart(&hist, "RSS after exec (log time)");
+    cleanup_history(&hist);
+    printf("=====================\n");
+}
+
+
+void launch_free(launch_t *l) {
+    if (!l) return;
+    free(l->samples);
+    l->samples = NULL;
+    l->count = l->cap = 0;
+}
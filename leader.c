@@ -0,0 +1,319 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-7-27 19:12:30
+ * @Last modified: 2025-7-27 19:12:30
+ * @Description: growth leaderboard over the whole system. scans come in pid
+ *               order from readdir, so the table is kept sorted by pid and each
+ *               scan is a merge: matching (pid, starttime) entries carry their
+ *               baselines over, the rest are exits and births. baselines are
+ *               taken every window / 4, the oldest one is the window start.
+ */
+
+#include "include/memtrc.h"
+#include "include/leader.h"
+#include "include/topn.h"
+#include <fcntl.h>
+#include <dirent.h>
+#include <time.h>
+
+#define LEADER_TOP_MAX  64
+#define LEADER_INIT_CAP 1024
+
+
+int leader_init(leader_t *lb, long long window_ms) {
+    if (!lb || window_ms < LEADER_POINTS - 1) {
+        fprintf(stderr, "Error: Invalid arguments to leader_init()\n");
+        return -1;
+    }
+    memset(lb, 0, sizeof(leader_t));
+    lb->window_ms = window_ms;
+    lb->page_kb = sysconf(_SC_PAGESIZE) / 1024;
+    if (lb->page_kb <= 0) lb->page_kb = 4;
+    lb->cap = LEADER_INIT_CAP;
+    lb->cur = malloc(lb->cap * sizeof(leader_entry_t));
+    lb->next = malloc(lb->cap * sizeof(leader_entry_t));
+    lb->seen = malloc(lb->cap * sizeof(leader_seen_t));
+    if (!lb->cur || !lb->next || !lb->seen) {
+        fprintf(stderr, "Error: out of memory for the leaderboard\n");
+        leader_free(lb);
+        return -1;
+    }
+    return 0;
+}
+
+
+static int grow(leader_t *lb) {
+    size_t cap = lb->cap * 2;
+    leader_entry_t *cur = realloc(lb->cur, cap * sizeof(leader_entry_t));
+    if (!cur) return -1;
+    lb->cur = cur;
+    leader_entry_t *next = realloc(lb->next, cap * sizeof(leader_entry_t));
+    if (!next) return -1;
+    lb->next = next;
+    leader_seen_t *seen = realloc(lb->seen, cap * sizeof(leader_seen_t));
+    if (!seen) return -1;
+    lb->seen = seen;
+    lb->cap = cap;
+    return 0;
+}
+
+
+//starttime (field 22) and rss in pages (field 24) from <pid>/stat under dfd
+static int read_seen(int dfd, const char *name, leader_seen_t *out, long page_kb) {
+    char path[32], buf[1024];
+    snprintf(path, sizeof(path), "%s/stat", name);
+    int fd = openat(dfd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) return -1;
+    buf[n] = '\0';
+    char *p = strrchr(buf, ')');
+    if (!p || p[1] != ' ' || !p[2]) return -1;
+    p += 3;
+    unsigned long long start = 0, rss = 0;
+    for (int field = 4; field <= 24; field++) {
+        char *end;
+        unsigned long long v = strtoull(p, &end, 10);
+        if (end == p) return -1;
+        if (field == 22) start = v;
+        else if (field == 24) rss = v;
+        p = end;
+    }
+    out->start = (uint32_t)start;
+    out->rss_kb = (uint32_t)(rss * page_kb);
+    return 0;
+}
+
+
+static int by_pid(const void *a, const void *b) {
+    int32_t x = ((const leader_seen_t *)a)->pid;
+    int32_t y = ((const leader_seen_t *)b)->pid;
+    return (x > y) - (x < y);
+}
+
+
+static void exited(leader_t *lb, const leader_entry_t *e) {
+    lb->exited_kb[lb->point] += e->rss_kb;
+    lb->exited_n[lb->point]++;
+}
+
+
+static void born(const leader_seen_t *s, leader_entry_t *e) {
+    e->pid = s->pid;
+    e->start = s->start;
+    e->rss_kb = s->rss_kb;
+    for (int k = 0; k < LEADER_POINTS; k++) e->base_kb[k] = LEADER_ABSENT;
+}
+
+
+/*
+ * one pass over the procfs root, merged into the table. processes without
+ * resident pages (kernel threads, zombies) are not kept. returns the number
+ * of processes in the table.
+ */
+int leader_scan(leader_t *lb, long long now_ms) {
+    if (!lb || !lb->cur) return -1;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    DIR *dir = opendir(get_procfs_root());
+    if (!dir) {
+        fprintf(stderr, "Can't open %s: %s\n", get_procfs_root(), strerror(errno));
+        return -1;
+    }
+    int dfd = dirfd(dir);
+    size_t nseen = 0;
+    int sorted = 1;
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        if (de->d_name[0] < '1' || de->d_name[0] > '9') continue;
+        if (nseen == lb->cap && grow(lb) != 0) break;
+        leader_seen_t *s = &lb->seen[nseen];
+        if (read_seen(dfd, de->d_name, s, lb->page_kb) != 0 || s->rss_kb == 0) continue;
+        s->pid = atoi(de->d_name);
+        if (nseen > 0 && s->pid < lb->seen[nseen - 1].pid) sorted = 0;
+        nseen++;
+    }
+    closedir(dir);
+    if (!sorted) qsort(lb->seen, nseen, sizeof(leader_seen_t), by_pid);
+
+    //merge join of the old table and the scan, both in pid order
+    size_t i = 0, j = 0, out = 0;
+    while (i < lb->count || j < nseen) {
+        if (j == nseen || (i < lb->count && lb->cur[i].pid < lb->seen[j].pid)) {
+            exited(lb, &lb->cur[i++]);
+        } else if (i == lb->count || lb->seen[j].pid < lb->cur[i].pid) {
+            born(&lb->seen[j++], &lb->next[out++]);
+        } else {
+            if (lb->cur[i].start == lb->seen[j].start) {
+                lb->next[out] = lb->cur[i];
+                lb->next[out++].rss_kb = lb->seen[j].rss_kb;
+            } else {
+                exited(lb, &lb->cur[i]);
+                born(&lb->seen[j], &lb->next[out++]);
+            }
+            i++;
+            j++;
+        }
+    }
+    leader_entry_t *swap = lb->cur;
+    lb->cur = lb->next;
+    lb->next = swap;
+    lb->count = out;
+
+    //take the baselines that fell due
+    long long step = lb->window_ms / (LEADER_POINTS - 1);
+    if (lb->scans == 0 || now_ms - lb->point_ms[lb->point] >= lb->window_ms) {
+        //first scan, or a gap longer than the window: every baseline is now
+        for (int k = 0; k < LEADER_POINTS; k++) {
+            lb->point_ms[k] = now_ms;
+            lb->exited_kb[k] = 0;
+            lb->exited_n[k] = 0;
+        }
+        for (size_t i = 0; i < lb->count; i++) {
+            for (int k = 0; k < LEADER_POINTS; k++) lb->cur[i].base_kb[k] = lb->cur[i].rss_kb;
+        }
+    }
+    while (now_ms - lb->point_ms[lb->point] >= step) {
+        long long due = lb->point_ms[lb->point] + step;
+        lb->point = (lb->point + 1) % LEADER_POINTS;
+        lb->point_ms[lb->point] = due;
+        lb->exited_kb[lb->point] = 0;
+        lb->exited_n[lb->point] = 0;
+        for (size_t i = 0; i < lb->count; i++) lb->cur[i].base_kb[lb->point] = lb->cur[i].rss_kb;
+    }
+    lb->scans++;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    lb->scan_us = (t1.tv_sec - t0.tv_sec) * 1000000LL + (t1.tv_nsec - t0.tv_nsec) / 1000;
+    return (int)lb->count;
+}
+
+
+typedef struct {
+    int oldest;                         //baseline point ranked against
+    leader_rank_t by;
+} rank_ctx_t;
+
+
+static int rank_key(const void *item, const void *ctx, double key[2]) {
+    const leader_entry_t *e = item;
+    const rank_ctx_t *rc = ctx;
+    uint32_t base = e->base_kb[rc->oldest];
+    key[1] = 0;
+    if (rc->by == LEADER_NEW) {
+        key[0] = (double)e->rss_kb;
+        return base == LEADER_ABSENT;
+    }
+    if (base == LEADER_ABSENT || e->rss_kb <= base) return 0;
+    if (rc->by == LEADER_ABS) {
+        key[0] = (double)(e->rss_kb - base);
+        return 1;
+    }
+    key[0] = (double)(e->rss_kb - base) / base;
+    return base >= LEADER_MIN_KB;
+}
+
+
+//the n best processes for a ranking into out, best first; returns how many
+int leader_top(const leader_t *lb, leader_rank_t by, leader_row_t *out, int n) {
+    if (!lb || !out || n <= 0) return 0;
+    if (n > LEADER_TOP_MAX) n = LEADER_TOP_MAX;
+    const void *best[LEADER_TOP_MAX];
+    rank_ctx_t rc = { (lb->point + 1) % LEADER_POINTS, by };
+    int found = topn_select(lb->cur, lb->count, sizeof(leader_entry_t), rank_key, &rc, best, n);
+    for (int i = 0; i < found; i++) {
+        const leader_entry_t *e = best[i];
+        uint32_t base = e->base_kb[rc.oldest];
+        out[i].pid = e->pid;
+        out[i].base_kb = base == LEADER_ABSENT ? -1 : (long)base;
+        out[i].rss_kb = e->rss_kb;
+    }
+    return found;
+}
+
+
+void leader_totals(const leader_t *lb, long long now_ms, leader_totals_t *t) {
+    if (!lb || !t) return;
+    memset(t, 0, sizeof(leader_totals_t));
+    int oldest = (lb->point + 1) % LEADER_POINTS;
+    t->procs = lb->count;
+    t->span_ms = lb->scans ? now_ms - lb->point_ms[oldest] : 0;
+    for (size_t i = 0; i < lb->count; i++) {
+        const leader_entry_t *e = &lb->cur[i];
+        uint32_t base = e->base_kb[oldest];
+        if (base == LEADER_ABSENT) {
+            t->new_n++;
+            t->new_kb += e->rss_kb;
+        } else if (e->rss_kb > base) {
+            t->grown_kb += e->rss_kb - base;
+        } else {
+            t->shrunk_kb += base - e->rss_kb;
+        }
+    }
+    for (int k = 0; k < LEADER_POINTS; k++) {
+        t->exited_n += lb->exited_n[k];
+        t->exited_kb += lb->exited_kb[k];
+    }
+}
+
+
+static void read_comm(pid_t pid, char *buf, size_t size) {
+    char path[PATH_MAX];
+    snprintf(buf, size, "?");
+    if (proc_path(path, sizeof(path), pid, "comm") != 0) return;
+    FILE *fp = fopen(path, "r");
+    if (!fp) return;
+    if (fgets(buf, size, fp)) buf[strcspn(buf, "\n")] = '\0';
+    fclose(fp);
+}
+
+
+static void print_rows(const leader_row_t *rows, int found, FILE *fp) {
+    char comm[32];
+    for (int i = 0; i < found; i++) {
+        read_comm(rows[i].pid, comm, sizeof(comm));
+        if (rows[i].base_kb < 0) {
+            fprintf(fp, "%8d %-16s %12s %12ld\n", rows[i].pid, comm, "new", rows[i].rss_kb);
+            continue;
+        }
+        long gain = rows[i].rss_kb - rows[i].base_kb;
+        fprintf(fp, "%8d %-16s %12ld %12ld %+11ld %+7.1f%%\n", rows[i].pid, comm, rows[i].base_kb,
+                rows[i].rss_kb, gain, rows[i].base_kb ? 100.0 * gain / rows[i].base_kb : 0.0);
+    }
+}
+
+
+//totals, then the top n by gain, by relative gain and of the new processes
+void leader_report(const leader_t *lb, long long now_ms, FILE *fp, int n) {
+    if (!lb || !fp) return;
+    leader_totals_t t;
+    leader_totals(lb, now_ms, &t);
+    long long span_s = t.span_ms / 1000;
+    fprintf(fp, "==== growth over the last %lldm%02llds: %zu processes, scan %.1f ms ====\n",
+            span_s / 60, span_s % 60, t.procs, lb->scan_us / 1000.0);
+    fprintf(fp, "grown %+lld KB, shrunk %lld KB | new %zu processes %lld KB | "
+            "exited %zu processes %lld KB\n", t.grown_kb, -t.shrunk_kb,
+            t.new_n, t.new_kb, t.exited_n, t.exited_kb);
+
+    leader_row_t rows[LEADER_TOP_MAX];
+    static const char *titles[] = {
+        "most KB gained", "most gained relative to the start (from 1 MB)", "largest new"
+    };
+    static const leader_rank_t ranks[] = { LEADER_ABS, LEADER_REL, LEADER_NEW };
+    for (int r = 0; r < 3; r++) {
+        int found = leader_top(lb, ranks[r], rows, n);
+        if (found == 0) continue;
+        fprintf(fp, "%s:\n%8s %-16s %12s %12s %11s %8s\n", titles[r],
+                "pid", "comm", "start KB", "now KB", "gain KB", "gain");
+        print_rows(rows, found, fp);
+    }
+}
+
+
+void leader_free(leader_t *lb) {
+    if (!lb) return;
+    free(lb->cur);
+    free(lb->next);
+    free(lb->seen);
+    memset(lb, 0, sizeof(leader_t));
+}
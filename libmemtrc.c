@@ -0,0 +1,288 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-8-8 19:52:36
+ * @Last modified: 2025-8-8 19:52:36
+ * @Description: libmemtrc. all state lives in the memtrc_self_t the caller
+ *               owns, so any number of them can run in one process. a sample
+ *               is a pread of statm at offset 0 (the kernel regenerates it),
+ *               getrusage and a vdso clock read. triggers work like the flight
+ *               recorder's: the threshold fires once per crossing, growth is
+ *               measured against the oldest sample inside the window.
+ */
+
+#include "include/libmemtrc.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+
+static long long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+
+//"size resident shared text lib data dt" in pages, plus the rusage fields
+int memtrc_read_statm(int fd, long page_kb, memtrc_sample_t *s) {
+    if (fd < 0 || page_kb <= 0 || !s) {
+        errno = EINVAL;
+        return -1;
+    }
+    char buf[128];
+    ssize_t n;
+    do {
+        n = pread(fd, buf, sizeof(buf) - 1, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) return -1;
+    buf[n] = '\0';
+    long v[7] = { 0 };
+    const char *p = buf;
+    for (int i = 0; i < 7; i++) {
+        while (*p == ' ') p++;
+        if (*p < '0' || *p > '9') {
+            errno = EPROTO;
+            return -1;
+        }
+        while (*p >= '0' && *p <= '9') v[i] = v[i] * 10 + (*p++ - '0');
+    }
+    s->vmsize_kb = v[0] * page_kb;
+    s->rss_kb = v[1] * page_kb;
+    s->shared_kb = v[2] * page_kb;
+    s->data_kb = v[5] * page_kb;
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+        s->maxrss_kb = ru.ru_maxrss;
+        s->minflt = ru.ru_minflt;
+        s->majflt = ru.ru_majflt;
+    }
+    s->ts_ms = monotonic_ms();
+    return 0;
+}
+
+
+int memtrc_self_init(memtrc_self_t *ms) {
+    if (!ms) {
+        errno = EINVAL;
+        return -1;
+    }
+    memset(ms, 0, sizeof(memtrc_self_t));
+    ms->page_kb = sysconf(_SC_PAGESIZE) / 1024;
+    if (ms->page_kb <= 0) ms->page_kb = 4;
+    //a child after fork() still reads its parent's statm through this fd, init one there
+    ms->statm_fd = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+    if (ms->statm_fd < 0) return -1;
+    ms->ring = calloc(MEMTRC_SELF_HISTORY, sizeof(memtrc_sample_t));
+    if (!ms->ring) {
+        close(ms->statm_fd);
+        ms->statm_fd = -1;
+        errno = ENOMEM;
+        return -1;
+    }
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&ms->wake, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&ms->lock, NULL);
+    return 0;
+}
+
+
+void memtrc_self_set_threshold(memtrc_self_t *ms, long rss_kb) {
+    if (!ms || !ms->ring) return;
+    pthread_mutex_lock(&ms->lock);
+    ms->threshold_kb = rss_kb > 0 ? rss_kb : 0;
+    ms->above = 0;
+    pthread_mutex_unlock(&ms->lock);
+}
+
+
+void memtrc_self_set_growth(memtrc_self_t *ms, long kb, int within_ms) {
+    if (!ms || !ms->ring) return;
+    pthread_mutex_lock(&ms->lock);
+    ms->growth_kb = kb > 0 && within_ms > 0 ? kb : 0;
+    ms->growth_ms = within_ms;
+    ms->window_start = ms->head;
+    pthread_mutex_unlock(&ms->lock);
+}
+
+
+void memtrc_self_set_callback(memtrc_self_t *ms, memtrc_self_cb cb, void *ctx) {
+    if (!ms || !ms->ring) return;
+    pthread_mutex_lock(&ms->lock);
+    ms->cb = cb;
+    ms->ctx = ctx;
+    pthread_mutex_unlock(&ms->lock);
+}
+
+
+//with the lock held: push s, returns how many events were written to ev
+static int push_sample(memtrc_self_t *ms, const memtrc_sample_t *s, memtrc_event_t ev[2]) {
+    unsigned long mask = MEMTRC_SELF_HISTORY - 1;
+    unsigned long h = ms->head++;
+    ms->ring[h & mask] = *s;
+    int n = 0;
+    if (ms->threshold_kb > 0) {
+        int above = s->rss_kb >= ms->threshold_kb;
+        if (above && !ms->above) {
+            ev[n].kind = MEMTRC_THRESHOLD;
+            ev[n].sample = *s;
+            ev[n].grown_kb = 0;
+            ev[n++].over_ms = 0;
+        }
+        ms->above = above;
+    }
+    if (ms->growth_kb > 0) {
+        if (h - ms->window_start >= MEMTRC_SELF_HISTORY - 1) ms->window_start = h - MEMTRC_SELF_HISTORY + 2;
+        while (ms->window_start < h && ms->ring[ms->window_start & mask].ts_ms < s->ts_ms - ms->growth_ms) {
+            ms->window_start++;
+        }
+        const memtrc_sample_t *old = &ms->ring[ms->window_start & mask];
+        if (s->rss_kb - old->rss_kb >= ms->growth_kb) {
+            ev[n].kind = MEMTRC_GROWTH;
+            ev[n].sample = *s;
+            ev[n].grown_kb = s->rss_kb - old->rss_kb;
+            ev[n++].over_ms = s->ts_ms - old->ts_ms;
+            ms->window_start = h;   //growth has to build up again
+        }
+    }
+    ms->events += n;
+    return n;
+}
+
+
+//one sample now, recorded and checked like the sampler thread's
+int memtrc_self_sample(memtrc_self_t *ms, memtrc_sample_t *out) {
+    if (!ms || !ms->ring) {
+        errno = EINVAL;
+        return -1;
+    }
+    memtrc_sample_t s;
+    memset(&s, 0, sizeof(s));
+    if (memtrc_read_statm(ms->statm_fd, ms->page_kb, &s) != 0) return -1;
+    memtrc_event_t ev[2];
+    pthread_mutex_lock(&ms->lock);
+    int n = push_sample(ms, &s, ev);
+    memtrc_self_cb cb = ms->cb;
+    void *ctx = ms->ctx;
+    pthread_mutex_unlock(&ms->lock);
+    for (int i = 0; i < n && cb; i++) cb(&ev[i], ctx);
+    if (out) *out = s;
+    return 0;
+}
+
+
+static void *sampler_main(void *arg) {
+    memtrc_self_t *ms = arg;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    pthread_mutex_lock(&ms->lock);
+    while (ms->running) {
+        pthread_mutex_unlock(&ms->lock);
+        memtrc_self_sample(ms, NULL);
+        pthread_mutex_lock(&ms->lock);
+        //absolute deadlines keep the rate, a late tick is not made up for
+        next.tv_nsec += (long)ms->period_ms * 1000000L;
+        next.tv_sec += next.tv_nsec / 1000000000L;
+        next.tv_nsec %= 1000000000L;
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec > next.tv_sec || (now.tv_sec == next.tv_sec && now.tv_nsec > next.tv_nsec)) {
+            next = now;
+            continue;
+        }
+        while (ms->running && pthread_cond_timedwait(&ms->wake, &ms->lock, &next) != ETIMEDOUT) {
+        }
+    }
+    pthread_mutex_unlock(&ms->lock);
+    struct timespec cpu;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu) == 0) {
+        ms->cpu_ns = cpu.tv_sec * 1000000000LL + cpu.tv_nsec;
+    }
+    return NULL;
+}
+
+
+//sample every period_ms on a thread of our own, until memtrc_self_stop
+int memtrc_self_start(memtrc_self_t *ms, int period_ms) {
+    if (!ms || !ms->ring || period_ms <= 0 || ms->started) {
+        errno = EINVAL;
+        return -1;
+    }
+    ms->period_ms = period_ms;
+    ms->running = 1;
+    ms->cpu_ns = 0;
+    //the host's signal handlers never run on our thread
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int ret = pthread_create(&ms->thread, NULL, sampler_main, ms);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (ret != 0) {
+        ms->running = 0;
+        errno = ret;
+        return -1;
+    }
+    ms->started = 1;
+    return 0;
+}
+
+
+void memtrc_self_stop(memtrc_self_t *ms) {
+    if (!ms || !ms->started) return;
+    pthread_mutex_lock(&ms->lock);
+    ms->running = 0;
+    pthread_cond_signal(&ms->wake);
+    pthread_mutex_unlock(&ms->lock);
+    pthread_join(ms->thread, NULL);
+    ms->started = 0;
+}
+
+
+int memtrc_self_latest(memtrc_self_t *ms, memtrc_sample_t *out) {
+    if (!ms || !ms->ring || !out) {
+        errno = EINVAL;
+        return -1;
+    }
+    pthread_mutex_lock(&ms->lock);
+    int ret = -1;
+    if (ms->head > 0) {
+        *out = ms->ring[(ms->head - 1) & (MEMTRC_SELF_HISTORY - 1)];
+        ret = 0;
+    }
+    pthread_mutex_unlock(&ms->lock);
+    if (ret != 0) errno = EAGAIN;
+    return ret;
+}
+
+
+//the newest n samples at most, oldest first; returns how many were copied
+size_t memtrc_self_history(memtrc_self_t *ms, memtrc_sample_t *out, size_t n) {
+    if (!ms || !ms->ring || !out) return 0;
+    pthread_mutex_lock(&ms->lock);
+    size_t have = ms->head < MEMTRC_SELF_HISTORY ? ms->head : MEMTRC_SELF_HISTORY;
+    if (n > have) n = have;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = ms->ring[(ms->head - n + i) & (MEMTRC_SELF_HISTORY - 1)];
+    }
+    pthread_mutex_unlock(&ms->lock);
+    return n;
+}
+
+
+void memtrc_self_free(memtrc_self_t *ms) {
+    if (!ms || !ms->ring) return;
+    memtrc_self_stop(ms);
+    pthread_mutex_destroy(&ms->lock);
+    pthread_cond_destroy(&ms->wake);
+    close(ms->statm_fd);
+    free(ms->ring);
+    memset(ms, 0, sizeof(memtrc_self_t));
+    ms->statm_fd = -1;
+}
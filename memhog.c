@@ -0,0 +1,76 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-8-11 21:06:44
+ * @Last modified: 2025-8-11 21:06:44
+ * @Description: command line front end of the workload generator, a process
+ *               with a known memory shape to point trace, top or kmem at
+ */
+
+#include "include/memtrc.h"
+#include "include/hog.h"
+#include <time.h>
+
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-p pattern] [-s size_kb] [-d duration_ms] [-P period_ms]\n"
+            "       [-r rate] [-t step_ms] [-w wait_ms] [-o truth.csv]\n"
+            "  patterns: leak, sawtooth, spike, stack, churn, huge\n"
+            "  -P  sawtooth cycle, spike hold (default 1000)\n"
+            "  -r  churn: mmap/munmap pairs per second; huge: KB touched per second\n"
+            "  -w  wait before the first step, time to attach a tracer\n", prog);
+}
+
+
+int main(int argc, char *argv[]) {
+    hog_spec_t spec;
+    int opt, pattern = HOG_LEAK, wait_ms = 0;
+    long size_kb = 0, rate = -1;
+    int duration_ms = 0, period_ms = 0, step_ms = 0;
+    const char *out = NULL;
+
+    while ((opt = getopt(argc, argv, "p:s:d:P:r:t:w:o:h")) != -1) {
+        switch (opt) {
+            case 'p': pattern = hog_parse_pattern(optarg); break;
+            case 's': size_kb = atol(optarg); break;
+            case 'd': duration_ms = atoi(optarg); break;
+            case 'P': period_ms = atoi(optarg); break;
+            case 'r': rate = atol(optarg); break;
+            case 't': step_ms = atoi(optarg); break;
+            case 'w': wait_ms = atoi(optarg); break;
+            case 'o': out = optarg; break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (optind != argc || pattern < 0 || wait_ms < 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    hog_default_spec(&spec, pattern);
+    if (size_kb) spec.size_kb = size_kb;
+    if (duration_ms) spec.duration_ms = duration_ms;
+    if (period_ms) spec.period_ms = period_ms;
+    if (rate >= 0) spec.rate = rate;
+    if (step_ms) spec.step_ms = step_ms;
+
+    FILE *truth = NULL;
+    if (out && !(truth = fopen(out, "w"))) {
+        fprintf(stderr, "Failed to open %s: %s\n", out, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    printf("memhog %d: %s, %ld KB over %d ms\n", getpid(), hog_pattern_name(spec.pattern),
+           spec.size_kb, spec.duration_ms);
+    fflush(stdout);
+    if (wait_ms > 0) {
+        struct timespec ts = { wait_ms / 1000, (wait_ms % 1000) * 1000000L };
+        nanosleep(&ts, NULL);
+    }
+    hog_result_t res;
+    int ret = hog_run(&spec, truth, &res);
+    if (truth) fclose(truth);
+    if (ret != 0) return EXIT_FAILURE;
+    printf("baseline %ld KB, peak +%ld KB, %lu events, %lu steps in %lld ms\n", res.baseline_kb,
+           res.peak_kb, res.events, res.steps, res.elapsed_ms);
+    return EXIT_SUCCESS;
+}
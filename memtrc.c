@@ -5,74 +5,197 @@
  * @Description: 
  * core functions of memtrc, including: analyzing process type, reading memory info, 
  * writing log, manipulating config, monitoring thread, etc.
- * @Note: process type judgement maybe not accurate.
+ * @Note: process type comes from the PF_KTHREAD stat flag, cached per (pid, starttime).
  */
 
 #include "include/memtrc.h"
 #include "include/chart.h"
+#include "include/analyze.h"
+#include "include/codec.h"
+#include "include/selfstat.h"
+#include "include/adaptive.h"
+#include "include/recorder.h"
+#include "include/retention.h"
+#include "include/sketch.h"
+#include "include/pressure.h"
+#include "include/allocprof.h"
+#include "include/launch.h"
+#include "include/faultprof.h"
+#include "include/numa.h"
+#include "include/sink.h"
+#include "include/sampler.h"
+#include "include/colstore.h"
+#include "include/procwatch.h"
+#include "include/leader.h"
+#include "include/group.h"
+#include "include/kmem.h"
+#include <fcntl.h>
+#include <poll.h>
 
 config_t *g_cfg = NULL;   //define global config 
+static char procfs_root[PATH_MAX] = "/proc";  //where per-pid files are read from
 
-proc_type_t get_process_type(pid_t pid) {
-    char path[BUF_SIZE];
-    char buffer[BUF_SIZE];
-    int is_kernel = 0;
-    FILE *fp = NULL;        //first initialize file pointer to NULL
-    
-    //check if it's PID equals 1 (init process)
-    if (pid == 1) {
-        return PROC_TYPE_USER;  
-    }    
-    //check /proc/<pid>/cmdline is whether empty
-    //kernel thread's cmdline is usually empty
-    snprintf(path, BUF_SIZE, "/proc/%d/cmdline", pid);
-    if ((fp = fopen(path, "r"))) {
-        size_t bytes_read = fread(buffer, 1, sizeof(buffer) - 1, fp);
-        fclose(fp);
-        fp = NULL;
-        
-        if (bytes_read == 0) {
-            is_kernel = 1;  //maybe a kernel thread
-        }
-    }    
-    //check /proc/<pid>/stat's 3rd field (state)
-    //if it contains special flags, also consider it a kernel thread
-    if (!is_kernel) {
-        snprintf(path, BUF_SIZE, "/proc/%d/stat", pid);
-        if ((fp = fopen(path, "r"))) {
-            if (fgets(buffer, sizeof(buffer), fp)) {
-                char *state = strchr(buffer, ')');
-                if (state && *(state + 1) == ' ' && *(state + 2)) {                    
-                    if (strchr("Z", *(state + 2)) || strchr("T", *(state + 2))) {
-                        is_kernel = 1;
-                    }
-                }
-            }
-            fclose(fp);
-            fp = NULL;
-        }
-    }    
-    //check /proc/<pid>/status's VmSize field
-    //some kernel threads may not have VmSize field
-    if (!is_kernel) {
-        snprintf(path, BUF_SIZE, "/proc/%d/status", pid);        
-        if ((fp = fopen(path, "r")) != NULL) {
-            is_kernel = 1;  // Assume it's kernel thread unless we find VmSize
-            
-            while (fgets(buffer, sizeof(buffer), fp)) {
-                if (strncmp(buffer, "VmSize:", 7) == 0) {
-                    is_kernel = 0;  // Found VmSize, not a kernel thread
-                    break;
-                }
-            }        
-            fclose(fp);
-        } else {
-            //fopen failed, maybe the process is dead,or the process is a kernel thread
-            is_kernel = 1;
+
+//point all /proc reads at another tree, e.g. a synthetic fixture
+int set_procfs_root(const char *root) {
+    if (!root || !*root || strlen(root) >= sizeof(procfs_root) - 32) {
+        fprintf(stderr, "Error: invalid procfs root\n");
+        return -1;
+    }
+    if (access(root, R_OK | X_OK) != 0) {
+        fprintf(stderr, "Error: can't access procfs root %s: %s\n", root, strerror(errno));
+        return -1;
+    }
+    strcpy(procfs_root, root);
+    proc_type_cache_clear();    //same pids, different processes
+    //drop trailing slashes, paths are built as <root>/<pid>/<file>
+    size_t len = strlen(procfs_root);
+    while (len > 1 && procfs_root[len - 1] == '/') procfs_root[--len] = '\0';
+    return 0;
+}
+
+
+const char *get_procfs_root(void) {
+    return procfs_root;
+}
+
+
+//build <root>/<pid>/<file>, return 0 on success and -1 when it doesn't fit
+int proc_path(char *buf, size_t size, pid_t pid, const char *file) {
+    int n = snprintf(buf, size, "%s/%d/%s", procfs_root, pid, file);
+    if (n < 0 || (size_t)n >= size) {
+        fprintf(stderr, "Path too long for pid %d\n", pid);
+        return -1;
+    }
+    return 0;
+}
+
+
+//kill(pid, 0) only speaks for the live /proc, fixtures are checked by directory
+int process_exists(pid_t pid) {
+    if (strcmp(procfs_root, "/proc") == 0) {
+        return kill(pid, 0) == 0 || errno == EPERM;
+    }
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/%d", procfs_root, pid) >= (int)sizeof(path)) {
+        return 0;
+    }
+    return access(path, F_OK) == 0;
+}
+
+#define PROC_TYPE_CACHE_SIZE 4096   //direct mapped by pid, power of two
+
+typedef struct {
+    pid_t pid;                      //0 marks an empty slot
+    unsigned long long starttime;
+    proc_type_t type;
+} proc_type_entry_t;
+
+static proc_type_entry_t proc_type_cache[PROC_TYPE_CACHE_SIZE];
+static pthread_mutex_t proc_type_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static proc_type_t stat_to_type(const proc_stat_t *st) {
+    return (st->flags & PF_KTHREAD) ? PROC_TYPE_KERNEL : PROC_TYPE_USER;
+}
+
+
+//a stat read is the only place starttime is seen, so it also retires entries of reused pids
+static void proc_type_cache_store(pid_t pid, const proc_stat_t *st) {
+    proc_type_entry_t *e = &proc_type_cache[pid & (PROC_TYPE_CACHE_SIZE - 1)];
+    pthread_mutex_lock(&proc_type_lock);
+    e->pid = pid;
+    e->starttime = st->starttime;
+    e->type = stat_to_type(st);
+    pthread_mutex_unlock(&proc_type_lock);
+}
+
+
+void proc_type_cache_forget(pid_t pid) {
+    proc_type_entry_t *e = &proc_type_cache[pid & (PROC_TYPE_CACHE_SIZE - 1)];
+    pthread_mutex_lock(&proc_type_lock);
+    if (e->pid == pid) e->pid = 0;
+    pthread_mutex_unlock(&proc_type_lock);
+}
+
+
+void proc_type_cache_clear(void) {
+    pthread_mutex_lock(&proc_type_lock);
+    memset(proc_type_cache, 0, sizeof(proc_type_cache));
+    pthread_mutex_unlock(&proc_type_lock);
+}
+
+
+//parse /proc/<pid>/stat, comm may hold spaces and ')' so fields start after the last ')'
+int read_proc_stat(pid_t pid, proc_stat_t *st) {
+    char path[PATH_MAX];
+    char buffer[1024];
+    if (pid <= 0 || !st || proc_path(path, sizeof(path), pid, "stat") != 0) {
+        return -1;
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t n = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if (n <= 0) return -1;
+    buffer[n] = '\0';
+
+    char *p = strrchr(buffer, ')');
+    if (!p || p[1] != ' ' || !p[2]) return -1;
+    memset(st, 0, sizeof(proc_stat_t));
+    st->state = p[2];
+    p += 3;
+    //field 4 onwards, numbered as in proc(5)
+    for (int field = 4; field <= 22; field++) {
+        char *end;
+        unsigned long long v = strtoull(p, &end, 10);   //negative fields wrap, none are kept
+        if (end == p) return -1;
+        switch (field) {
+            case 4: st->ppid = (pid_t)v; break;
+            case 9: st->flags = (unsigned long)v; break;
+            case 10: st->minflt = (unsigned long)v; break;
+            case 12: st->majflt = (unsigned long)v; break;
+            case 22: st->starttime = v; break;
+            default: break;
         }
+        p = end;
     }
-    
-    return is_kernel ? PROC_TYPE_KERNEL : PROC_TYPE_USER;
+    proc_type_cache_store(pid, st);
+    return 0;
+}
+
+
+/*
+ * kernel threads carry PF_KTHREAD in the stat flags, which is exact unlike the
+ * old cmdline/state/VmSize guesses (zombies and stopped user processes looked
+ * like kernel threads). the answer never changes for a live (pid, starttime),
+ * so repeat calls are answered from the cache without any syscall. entries are
+ * replaced whenever a stat read sees a new starttime, dropped when the status
+ * read of a tick fails and checked against what that read found, see
+ * read_mem_info().
+ */
+static proc_type_t classify_process(pid_t pid) {
+    proc_type_entry_t *e = &proc_type_cache[pid & (PROC_TYPE_CACHE_SIZE - 1)];
+    proc_type_t type = PROC_TYPE_UNKNOWN;
+
+    pthread_mutex_lock(&proc_type_lock);
+    if (e->pid == pid && pid > 0) type = e->type;
+    pthread_mutex_unlock(&proc_type_lock);
+    if (type != PROC_TYPE_UNKNOWN) return type;
+
+    proc_stat_t st;
+    if (read_proc_stat(pid, &st) != 0) {
+        return PROC_TYPE_UNKNOWN;   //gone, or never existed
+    }
+    return stat_to_type(&st);
+}
+
+
+proc_type_t get_process_type(pid_t pid) {
+    uint64_t start = selfstat_now();
+    proc_type_t type = classify_process(pid);
+    selfstat_record(PROBE_PROC_TYPE, start);
+    return type;
 }
 
 
@@ -86,13 +209,12 @@ int read_user_proc_mem_info(pid_t pid, mem_info_t *info) {
         return -1;
     }
 
-    char path[BUF_SIZE];
+    char path[PATH_MAX];
     char line[BUF_SIZE];
     FILE *fp = NULL;
     int ret = -1;
 
-    if (snprintf(path, sizeof(path), "/proc/%d/status", pid) >= (int)sizeof(path)) {
-        fprintf(stderr, "Path too long for pid %d\n", pid);
+    if (proc_path(path, sizeof(path), pid, "status") != 0) {
         return -1;
     }
 
@@ -109,7 +231,10 @@ int read_user_proc_mem_info(pid_t pid, mem_info_t *info) {
         char *nl = strchr(line, '\n');
         
         if (!nl && !feof(fp)) {
-            fprintf(stderr, "Warning: Line truncated in %s\n", path);
+            //long mask lines (Mems_allowed on big hosts) are expected, only ours matter
+            if (strncmp(line, "Vm", 2) == 0) {
+                fprintf(stderr, "Warning: Line truncated in %s\n", path);
+            }
             int c;
             while ((c = fgetc(fp)) != EOF && c != '\n');
             continue;
@@ -154,7 +279,7 @@ cleanup:
 
 
 int read_kernel_proc_mem_info(pid_t pid, mem_info_t *info){
-    char path[BUF_SIZE];
+    char path[PATH_MAX];
     char buffer[BUF_SIZE];
     FILE *fp;
     int ret = 0;
@@ -162,8 +287,7 @@ int read_kernel_proc_mem_info(pid_t pid, mem_info_t *info){
     //initialize memory info and construct path
     memset(info, 0, sizeof(mem_info_t));
     info->proc_type = PROC_TYPE_KERNEL; //set default process type    
-    if (snprintf(path, BUF_SIZE, "/proc/%d/status", pid) >= BUF_SIZE) {
-        fprintf(stderr, "Path too long for pid %d\n", pid);
+    if (proc_path(path, sizeof(path), pid, "status") != 0) {
         return -1;
     }
     //deal with open file failure
@@ -227,11 +351,29 @@ int read_mem_info(pid_t pid, mem_info_t *info) {
     info->proc_type = proc_type;
     
     //according to process type, use different read method
+    uint64_t start = selfstat_now();
+    int ret;
     if (proc_type == PROC_TYPE_KERNEL) {
-        return read_kernel_proc_mem_info(pid, info);
+        ret = read_kernel_proc_mem_info(pid, info);
     } else {
-        return read_user_proc_mem_info(pid, info);
+        ret = read_user_proc_mem_info(pid, info);
+    }
+    selfstat_record(PROBE_READ_MEM, start);
+    if (ret != 0) {
+        proc_type_cache_forget(pid);    //likely exited, the pid may come back as someone else
+        return ret;
     }
+    /*
+     * the status just read vouches for the cached answer at no extra cost: a
+     * user process has Vm* lines until it exits, a kernel thread never has
+     * them. a mismatch is a pid reused behind our back (or a zombie), which a
+     * fresh stat read settles, the values read stay valid either way.
+     */
+    if ((proc_type == PROC_TYPE_USER) != (info->vmsize > 0)) {
+        proc_type_cache_forget(pid);
+        info->proc_type = get_process_type(pid);
+    }
+    return ret;
 }
 
 
@@ -261,6 +403,7 @@ void display_mem_info(const mem_info_t *info) {
         
         printf("kernel process comment share kernel space," 
             "the above values may not represent the actual exclusive memory.\n");
+        printf("use kmem to follow slab caches, vmalloc and kernel stacks instead.\n");
     } else {
         // user process display way
         printf("process type: %s\n", info->proc_type == 
@@ -276,42 +419,62 @@ void display_mem_info(const mem_info_t *info) {
 
 
 void write_log(FILE *fp, const mem_info_t *info) {
+    write_log_at(fp, current_time_ms(), info);
+}
+
+
+//one log line stamped with ts_ms, used for samples taken earlier (flight recorder)
+void write_log_at(FILE *fp, long long ts_ms, const mem_info_t *info) {
+    write_log_ex(fp, ts_ms, info, NULL);
+}
+
+
+//rates, when given, add the fault and pressure columns after the memory ones
+void write_log_ex(FILE *fp, long long ts_ms, const mem_info_t *info,
+        const pressure_rates_t *rates) {
     if (!fp || !info) {
         fprintf(stderr, "Error: Invalid arguments to write_log()\n");
         return;
     }
 
-    //set time format and time string
-    time_t now;
-    struct tm *tm_info;
+    //set time format and time string, milliseconds keep fast samples apart
+    long long now_ms = ts_ms;
+    time_t now = now_ms / 1000;
+    struct tm tm_info;
     char time_str[30];
-    //get current time and format it
-    time(&now);
-    tm_info = localtime(&now);
     //check time info and format validity
-    if (!tm_info) {
+    if (!localtime_r(&now, &tm_info)) {
         fprintf(stderr, "Error getting local time\n");
         return;
     }
-    if (strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info) == 0) {
+    size_t n = strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", &tm_info);
+    if (n == 0) {
         fprintf(stderr, "Error formatting time string\n");
         return;
     }
+    snprintf(time_str + n, sizeof(time_str) - n, ".%03lld", now_ms % 1000);
     
     // Thread-safe logging
     if (info->proc_type == PROC_TYPE_KERNEL) {
-        fprintf(fp, "[%s] type: kernel process, RSS: %ld KB, VSZ: %ld KB\n", 
+        fprintf(fp, "[%s] type: kernel process, RSS: %ld KB, VSZ: %ld KB", 
                 time_str,
                 info->vmrss > 0 ? info->vmrss : -1,
                 info->vmsize > 0 ? info->vmsize : -1);
     } else {
-        fprintf(fp, "[%s] type: user process, VSZ: %ld KB, RSS: %ld KB, Data: %ld KB, Stack: %ld KB\n",
+        fprintf(fp, "[%s] type: user process, VSZ: %ld KB, RSS: %ld KB, Data: %ld KB, Stack: %ld KB",
                 time_str,
                 info->vmsize,
                 info->vmrss,
                 info->vmdata,
                 info->vmstk);
     }
+    if (rates) {
+        fprintf(fp, ", minflt/s: %.1f, majflt/s: %.1f, psi some: %.2f%%, psi full: %.2f%%, "
+                "pgscan/s: %.0f, pgsteal/s: %.0f, pswpin/s: %.0f, pswpout/s: %.0f",
+                rates->minflt, rates->majflt, rates->some_pct, rates->full_pct,
+                rates->pgscan, rates->pgsteal, rates->pswpin, rates->pswpout);
+    }
+    fputc('\n', fp);
     
     //check if log file is valid
     if (fflush(fp) != 0) {
@@ -320,6 +483,135 @@ void write_log(FILE *fp, const mem_info_t *info) {
 }
 
 
+//wall clock in milliseconds, the timestamp unit of compressed histories
+long long current_time_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+//append one sample as a VSZ/RSS/Data/Stack row to the compressed log
+static void write_zlog(config_t *cfg, long long ts_ms, const mem_info_t *info) {
+    long row[CODEC_MAX_COLS] = { info->vmsize, info->vmrss, info->vmdata, info->vmstk };
+    if (codec_writer_append(cfg->zlog, ts_ms, row) != 0) {
+        fprintf(stderr, "Error: failed to append to compressed log\n");
+    }
+}
+
+
+static void close_zlog(config_t *cfg) {
+    if (cfg->zlog) {
+        codec_writer_close(cfg->zlog);
+        free(cfg->zlog);
+        cfg->zlog = NULL;
+    }
+}
+
+
+static void close_sink(config_t *cfg) {
+    if (cfg->sink) {
+        sink_close(cfg->sink);
+        free(cfg->sink);
+        cfg->sink = NULL;
+    }
+}
+
+
+static void close_recorder(config_t *cfg) {
+    if (cfg->recorder) {
+        recorder_free(cfg->recorder);
+        free(cfg->recorder);
+        cfg->recorder = NULL;
+    }
+}
+
+
+static void close_retention(config_t *cfg) {
+    if (cfg->retain) {
+        retention_close(cfg->retain);
+        free(cfg->retain);
+        cfg->retain = NULL;
+    }
+}
+
+
+static void close_allocprof(config_t *cfg) {
+    if (cfg->allocprof) {
+        allocprof_detach(cfg->allocprof);
+        free(cfg->allocprof);
+        cfg->allocprof = NULL;
+    }
+}
+
+
+static void close_faultprof(config_t *cfg) {
+    if (cfg->faultprof) {
+        faultprof_detach(cfg->faultprof);
+        free(cfg->faultprof);
+        cfg->faultprof = NULL;
+    }
+}
+
+
+static void close_numa(config_t *cfg) {
+    if (cfg->numa) {
+        numa_close(cfg->numa);
+        free(cfg->numa);
+        cfg->numa = NULL;
+    }
+}
+
+
+//path NULL keeps the history in memory until the next trace
+static int open_retention(config_t *cfg, const char *path, int reset) {
+    close_retention(cfg);
+    cfg->retain = malloc(sizeof(retention_t));
+    if (!cfg->retain || retention_open(cfg->retain, path, cfg->target_pid, reset) != 0) {
+        free(cfg->retain);
+        cfg->retain = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+
+static void retain_sample(config_t *cfg, long long ts_ms, const mem_info_t *info) {
+    long row[RETAIN_COLS] = { info->vmsize, info->vmrss, info->vmdata, info->vmstk };
+    retention_append(cfg->retain, ts_ms, row);
+}
+
+
+//history and export read the -f file if given, else the last trace's store
+static retention_t *query_store(config_t *cfg, const char *file, retention_t *tmp) {
+    if (file) {
+        if (!retention_is_store(file)) {
+            printf("error: %s is not a retention file\n", file);
+            return NULL;
+        }
+        return retention_open(tmp, file, 0, 0) == 0 ? tmp : NULL;
+    }
+    if (!cfg->retain || cfg->retain->st->raw_head == 0) {
+        printf("error: no history yet, trace a process or pass -f file\n");
+        return NULL;
+    }
+    return cfg->retain;
+}
+
+
+//trigger options create the recorder on first use
+static recorder_t *get_recorder(config_t *cfg) {
+    if (!cfg->recorder) {
+        cfg->recorder = malloc(sizeof(recorder_t));
+        if (!cfg->recorder || recorder_init(cfg->recorder, cfg->target_pid) != 0) {
+            free(cfg->recorder);
+            cfg->recorder = NULL;
+        }
+    }
+    return cfg->recorder;
+}
+
+
 int init_config(config_t *cfg) {
     if (!cfg){ 
         fprintf(stderr, "Error: config_t pointer is NULL\n");    
@@ -329,9 +621,26 @@ int init_config(config_t *cfg) {
     cfg->log_file = NULL;
     cfg->log_fp = NULL;
     cfg->interval = 1;
+    cfg->adaptive = 0;
+    cfg->min_interval_ms = ADAPTIVE_MIN_MS;
+    cfg->max_interval_ms = ADAPTIVE_MAX_MS;
+    cfg->pressure = 0;
     cfg->continuous = 0;    
     cfg->monitoring = 0;  
     cfg->target_pid = 0;
+    cfg->zlog = NULL;
+    cfg->sink = NULL;
+    cfg->recorder = NULL;
+    cfg->retain = NULL;
+    cfg->allocprof = NULL;
+    cfg->faultprof = NULL;
+    cfg->numa = NULL;
+
+    //MEMTRC_PROCFS redirects every /proc read, e.g. to a synthetic fixture tree
+    const char *root = getenv("MEMTRC_PROCFS");
+    if (root && set_procfs_root(root) != 0) {
+        return 0;
+    }
     
     //NOTE:mutex lock initialization is here
     if (pthread_mutex_init(&cfg->lock, NULL) != 0) {
@@ -373,12 +682,20 @@ void cleanup_config(config_t *cfg) {
     free(cfg->log_file); // free is safe at this time 
     cfg->log_fp = NULL;
     cfg->log_file = NULL;
+    close_zlog(cfg);
+    close_sink(cfg);
+    close_recorder(cfg);
+    close_retention(cfg);
+    close_allocprof(cfg);
+    close_faultprof(cfg);
+    close_numa(cfg);
     
     pthread_mutex_unlock(&cfg->lock);
     
     //reset other config values
     cfg->target_pid = 0;
     cfg->interval = 1;
+    cfg->adaptive = 0;
     cfg->continuous = 0;    
     
     int destroy_ret = pthread_mutex_destroy(&cfg->lock);
@@ -400,6 +717,47 @@ void *monitor_thread(void *arg) {
     
     init_history(&vmrss_hist);
     init_history(&vmsize_hist);
+
+    //faults and system pressure as rates between consecutive samples
+    history_data_t fault_hist, stall_hist, scan_hist;
+    pressure_sample_t pres_prev, pres_cur;
+    pressure_rates_t rates;
+    int have_prev = 0, have_rates = 0;
+    init_history(&fault_hist);
+    init_history(&stall_hist);
+    init_history(&scan_hist);
+
+    selfstat_snapshot_t stats_start;
+    selfstat_snapshot(&stats_start);
+
+    //whole session history, compressed so long sessions stay cheap
+    ts_series_t *session = malloc(sizeof(ts_series_t));
+    if (session && ts_series_init(session, 2) != 0) {
+        free(session);
+        session = NULL;
+    }
+
+    //RSS and VSZ distributions of every sample, for the end of session quantiles
+    sketch_t *dist = malloc(2 * sizeof(sketch_t));
+    if (dist) {
+        sketch_init(&dist[0]);
+        sketch_init(&dist[1]);
+    }
+
+    //adaptive mode samples up to every min_interval_ms but renders at the -i pace
+    adaptive_t ctl;
+    int adaptive = cfg->adaptive &&
+                   adaptive_init(&ctl, cfg->min_interval_ms, cfg->max_interval_ms) == 0;
+    //an armed flight recorder wants a high rate history in its ring at all times
+    recorder_t *rec = cfg->recorder;
+    if (rec && recorder_start(rec, adaptive ? cfg->min_interval_ms : RECORDER_SAMPLE_MS) != 0) {
+        rec = NULL;
+    }
+    int fast = adaptive || rec;
+    int interval_ms = adaptive ? ctl.cur_ms : rec ? RECORDER_SAMPLE_MS : cfg->interval * 1000;
+    long long last_render_ms = 0;
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
     
     while(1) {
         pthread_mutex_lock(&cfg->lock);
@@ -407,35 +765,118 @@ void *monitor_thread(void *arg) {
         pthread_mutex_unlock(&cfg->lock);
         
         if (!monitoring) break;
+        uint64_t tick_start = selfstat_now();
         //check the process is whether still alive
-        if (kill(cfg->target_pid, 0) == -1) {
+        if (!process_exists(cfg->target_pid)) {
+            proc_type_cache_forget(cfg->target_pid);
             printf("Process %d terminated\n", cfg->target_pid);
             break;
         }
         
         if (read_mem_info(cfg->target_pid, &info) == 0) {
             retry_count = 0;
+            long long now_ms = current_time_ms();
             
-            update_history(&vmrss_hist, info.vmrss);
-            update_history(&vmsize_hist, info.vmsize);            
-            display_mem_info(&info);
-            
-            if (vmrss_hist.count > MAX_HISTORY) {
-                cleanup_history(&vmrss_hist);
-                init_history(&vmrss_hist);
+            update_history_at(&vmrss_hist, now_ms, info.vmrss);
+            update_history_at(&vmsize_hist, now_ms, info.vmsize);            
+            if (session) {
+                long row[2] = { info.vmrss, info.vmsize };
+                ts_series_append(session, now_ms, row);
             }
-            if (vmsize_hist.count > MAX_HISTORY) {
-                cleanup_history(&vmsize_hist);
-                init_history(&vmsize_hist);
+            if (cfg->allocprof) {
+                allocprof_poll(cfg->allocprof);
+            }
+            if (cfg->faultprof) {
+                faultprof_poll(cfg->faultprof);
+            }
+            if (cfg->numa) {
+                numa_sample(cfg->numa, now_ms);     //on its own, slower cadence
+            }
+            if (cfg->pressure && pressure_sample(cfg->target_pid, now_ms, &pres_cur) == 0) {
+                have_rates = have_prev && pressure_rates(&pres_prev, &pres_cur, &rates) == 0;
+                if (have_rates) {
+                    update_history_at(&fault_hist, now_ms, (long)(rates.minflt + rates.majflt));
+                    update_history_at(&stall_hist, now_ms, (long)(rates.some_pct * 100));
+                    update_history_at(&scan_hist, now_ms, (long)rates.pgscan);
+                }
+                pres_prev = pres_cur;
+                have_prev = 1;
+            }
+            if (dist) {
+                sketch_add(&dist[0], info.vmrss);
+                sketch_add(&dist[1], info.vmsize);
+            }
+            if (adaptive) {
+                interval_ms = adaptive_next(&ctl, now_ms, info.vmrss);
+            }
+            if (rec) {
+                recorder_push(rec, now_ms, &info);
+            }
+
+            int due = !fast || now_ms - last_render_ms >= cfg->interval * 1000LL;
+            //rows on stdout own the screen
+            if (due && (!cfg->sink || !cfg->sink->to_stdout)) {
+                uint64_t render_start = selfstat_now();
+                last_render_ms = now_ms;
+                display_mem_info(&info);
+                
+                if (vmrss_hist.count > MAX_HISTORY) {
+                    cleanup_history(&vmrss_hist);
+                    init_history(&vmrss_hist);
+                }
+                if (vmsize_hist.count > MAX_HISTORY) {
+                    cleanup_history(&vmsize_hist);
+                    init_history(&vmsize_hist);
+                }
+                
+                draw_chart(&vmrss_hist, "RSS History");
+                if (cfg->allocprof) {
+                    allocprof_report(cfg->allocprof, stdout, ALLOCPROF_TOP);
+                }
+                if (cfg->faultprof) {
+                    faultprof_report(cfg->faultprof, stdout, FAULTPROF_TOP);
+                }
+                draw_chart(&vmsize_hist, "VSZ History");
+                if (cfg->numa && cfg->numa->samples > 0) {
+                    numa_t *nm = cfg->numa;
+                    numa_report(nm, stdout);
+                    for (int node = 0; node < nm->sys_nodes && node < NUMA_CHART_NODES; node++) {
+                        char title[64];
+                        snprintf(title, sizeof(title), "Node %d RSS (KB)", node);
+                        draw_chart(&nm->node_hist[node], title);
+                    }
+                    if (nm->sys_nodes > 1) {
+                        draw_chart(&nm->remote_hist, "Remote Memory (0.1%)");
+                    }
+                }
+                if (have_rates) {
+                    printf("faults: %.0f minor/s, %.0f major/s | psi some %.2f%%, full %.2f%% | "
+                           "pgscan %.0f/s, pgsteal %.0f/s, swap in %.0f/s, out %.0f/s\n",
+                           rates.minflt, rates.majflt, rates.some_pct, rates.full_pct,
+                           rates.pgscan, rates.pgsteal, rates.pswpin, rates.pswpout);
+                    draw_chart(&fault_hist, "Page Faults/s (minor + major)");
+                    draw_chart(&stall_hist, "Memory Stall (PSI some, 0.01%)");
+                    draw_chart(&scan_hist, "Reclaim Scan (pages/s)");
+                }
+                selfstat_record(PROBE_RENDER, render_start);
             }
             
-            draw_chart(&vmrss_hist, "RSS History");
-            draw_chart(&vmsize_hist, "VSZ History");
-            
+            //adaptive logs every sample, the recorder's fast pace is for its ring only
             pthread_mutex_lock(&cfg->lock);
-            if (cfg->log_fp) {
-                write_log(cfg->log_fp, &info);
+            uint64_t log_start = selfstat_now();
+            if (cfg->log_fp && (adaptive || due)) {
+                write_log_ex(cfg->log_fp, now_ms, &info, have_rates ? &rates : NULL);
+            }
+            if (cfg->zlog && (adaptive || due)) {
+                write_zlog(cfg, now_ms, &info);
+            }
+            if (cfg->sink && (adaptive || due)) {
+                sink_write(cfg->sink, now_ms, cfg->target_pid, &info);
             }
+            if (cfg->retain) {
+                retain_sample(cfg, now_ms, &info);
+            }
+            selfstat_record(PROBE_LOG, log_start);
             pthread_mutex_unlock(&cfg->lock);
             
         } else {
@@ -447,11 +888,73 @@ void *monitor_thread(void *arg) {
             }
         }
         
-        sleep(cfg->interval);   //sleep() enough     
+        selfstat_record(PROBE_TICK, tick_start);
+        //absolute deadlines, so the tick's own cost doesn't stretch the period
+        deadline.tv_sec += interval_ms / 1000;
+        deadline.tv_nsec += (interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec > deadline.tv_sec ||
+            (now.tv_sec == deadline.tv_sec && now.tv_nsec > deadline.tv_nsec)) {
+            deadline = now;     //overran, don't try to catch up with a burst of ticks
+        } else {
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR);
+        }
     }
 
     cleanup_history(&vmrss_hist);
     cleanup_history(&vmsize_hist);
+    cleanup_history(&fault_hist);
+    cleanup_history(&stall_hist);
+    cleanup_history(&scan_hist);
+
+    if (cfg->allocprof) {
+        allocprof_poll(cfg->allocprof);
+        allocprof_report(cfg->allocprof, stdout, ALLOCPROF_TOP);
+    }
+    if (cfg->faultprof) {
+        faultprof_poll(cfg->faultprof);
+        faultprof_report(cfg->faultprof, stdout, FAULTPROF_TOP);
+    }
+    if (rec) {
+        recorder_stop(rec);
+        printf("flight recorder: %d dumps\n", rec->dumps);
+    }
+    if (adaptive && ctl.samples > 0) {
+        printf("adaptive: %lu samples, mean interval %.0f ms, %lu at %d ms\n",
+               ctl.samples, (double)ctl.total_ms / ctl.samples, ctl.fast_samples, ctl.min_ms);
+    }
+    if (session) {
+        if (session->rows > 0) {
+            size_t sealed = session->rows - session->tail_rows;
+            printf("session: %zu samples, %zu compressed in %zu bytes (%.2f bytes/sample)\n",
+                   session->rows, sealed, session->enc_bytes,
+                   sealed ? (double)session->enc_bytes / sealed : 0.0);
+            draw_series_chart(session, 0, "RSS Session History");
+        }
+        ts_series_free(session);
+        free(session);
+    }
+    if (dist) {
+        sketch_print(stdout, "session RSS", &dist[0]);
+        sketch_print(stdout, "session VSZ", &dist[1]);
+        free(dist);
+    }
+
+    //what this session cost us, on screen and in the log
+    selfstat_snapshot_t stats_end, stats_session;
+    selfstat_snapshot(&stats_end);
+    selfstat_diff(&stats_end, &stats_start, &stats_session);
+    selfstat_print(stdout, &stats_session);
+    pthread_mutex_lock(&cfg->lock);
+    if (cfg->log_fp) {
+        selfstat_log(cfg->log_fp, &stats_session);
+    }
+    pthread_mutex_unlock(&cfg->lock);
     
     printf("Monitor thread exited\n");
     return NULL;
@@ -471,9 +974,34 @@ void show_menu(void) {
     printf("   options:\n");
     printf("     -i interval - set the monitoring interval (seconds)\n");
     printf("     -c - enable continuous monitoring mode\n");
+    printf("     -a [min:max] - adaptive interval in ms (default 10:1000), implies -c\n");
     printf("     -l logfile - specify the log file\n");
-    printf("2. help - display this help message\n");
-    printf("3. quit - exit the program\n");
+    printf("     -z file - also write a compressed (delta-of-delta) log\n");
+    printf("     -o csv|jsonl [file] - stream rows to stdout or file, -d kb[:s] deadband\n");
+    printf("     -T mb / -G mb:secs - flight recorder trigger: rss above mb, or grown\n");
+    printf("       by mb within secs; implies -c, samples every 100 ms (or faster with -a)\n");
+    printf("     -W pre:post - seconds dumped around a trigger (default 10:5)\n");
+    printf("     -D dir - where dumps go (default .)\n");
+    printf("     -x cmd... - run cmd after each dump (rest of the line, $MEMTRC_DUMP)\n");
+    printf("     -R file [--reset] - keep the tiered history in file, it survives restarts\n");
+    printf("     -p - also sample page fault rates, PSI and reclaim (charts and log)\n");
+    printf("     -A - top growing allocation sites of a target run with libmemtrc_preload.so\n");
+    printf("     -F [period] - page faults by mapping and code site (perf_event, 1 in period)\n");
+    printf("     -N [secs] - numa placement per node and mapping type, every secs (10)\n");
+    printf("   trace --match <regex> [-i s] [-o ...] [--scan] - every matching process\n");
+    printf("2. run [-m ms] [-l logfile] -- cmd args - start cmd and profile it from exec\n");
+    printf("3. top [-w span] [-n count] [-i secs] - who grew most, system wide\n");
+    printf("4. group <pid>... | --match <regex> [-t n] - unique memory of a process group\n");
+    printf("5. kmem [-i secs] [-n count] - slab caches, vmalloc and kernel totals\n");
+    printf("6. analyze <logfile>... - summarize log files, several are also merged\n");
+    printf("   options:\n");
+    printf("     -t threads - number of parser threads (default: all cpus)\n");
+    printf("7. history [span] [-f file] - chart the retained RSS history (default 1h)\n");
+    printf("8. export <out> [span] [-f file] - write retained history as csv or .json\n");
+    printf("9. stats - show memtrc's own overhead since start\n");
+    printf("10. procfs [dir] - show or change where /proc files are read from\n");
+    printf("11. help - display this help message\n");
+    printf("12. quit - exit the program\n");
     printf("=====================\n");
 }
 
@@ -484,8 +1012,9 @@ cmd_type_t parse_command(char *cmd_line, char *args[], int *arg_count) {
         return CMD_UNKNOWN; 
     }
     
-    //copy command line to prevent original input from being modified
-    char cmd_copy[MAX_CMD_LENGTH];
+    //copy command line to prevent original input from being modified,
+    //static because args[] point into it after we return
+    static char cmd_copy[MAX_CMD_LENGTH];
     strncpy(cmd_copy, cmd_line, MAX_CMD_LENGTH - 1);
     cmd_copy[MAX_CMD_LENGTH - 1] = '\0';
     
@@ -518,6 +1047,24 @@ cmd_type_t parse_command(char *cmd_line, char *args[], int *arg_count) {
     if (count > 0) {
         if (strcmp(args[0], "trace") == 0) {
             return CMD_TRACE;
+        } else if (strcmp(args[0], "run") == 0) {
+            return CMD_RUN;
+        } else if (strcmp(args[0], "top") == 0) {
+            return CMD_TOP;
+        } else if (strcmp(args[0], "group") == 0) {
+            return CMD_GROUP;
+        } else if (strcmp(args[0], "kmem") == 0) {
+            return CMD_KMEM;
+        } else if (strcmp(args[0], "analyze") == 0) {
+            return CMD_ANALYZE;
+        } else if (strcmp(args[0], "history") == 0) {
+            return CMD_HISTORY;
+        } else if (strcmp(args[0], "export") == 0) {
+            return CMD_EXPORT;
+        } else if (strcmp(args[0], "stats") == 0) {
+            return CMD_STATS;
+        } else if (strcmp(args[0], "procfs") == 0) {
+            return CMD_PROCFS;
         } else if (strcmp(args[0], "help") == 0) {
             return CMD_HELP;
         } else if (strcmp(args[0], "quit") == 0) {
@@ -547,6 +1094,452 @@ void sigint_handler(int sig, siginfo_t *si, void *ucontext) {
 }
 
 
+/*
+ * run fn(arg) on a monitoring thread until enter or Ctrl+C clears
+ * cfg->monitoring, then join it. -1 if the thread couldn't be started
+ */
+static int run_until_stopped(config_t *cfg, void *(*fn)(void *), void *arg) {
+    printf("press Ctrl+C or enter to stop monitoring...\n");
+    struct sigaction sa = {
+        .sa_sigaction = sigint_handler,
+        .sa_flags = SA_SIGINFO | SA_RESTART
+    };
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGINT, &sa, NULL) == -1) {
+        perror("Failed to set SIGINT handler");
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_lock(&cfg->lock);
+    cfg->monitoring = 1;
+    pthread_mutex_unlock(&cfg->lock);
+
+    pthread_t tid;
+    int ret = pthread_create(&tid, NULL, fn, arg);
+    if (ret != 0) {
+        printf("error: failed to create monitoring thread: %s\n", strerror(ret));
+        pthread_mutex_lock(&cfg->lock);
+        cfg->monitoring = 0;
+        pthread_mutex_unlock(&cfg->lock);
+        return -1;
+    }
+    getchar();      //wait for user input to stop
+    pthread_mutex_lock(&cfg->lock);
+    cfg->monitoring = 0;
+    pthread_mutex_unlock(&cfg->lock);
+    pthread_join(tid, NULL);
+    return 0;
+}
+
+
+//trace --match: every process whose comm or cmdline matches, found by procwatch
+typedef struct {
+    config_t *cfg;
+    const char *pattern;
+    procwatch_t watch;
+    sampler_t smp;
+    colstore_t cols;
+    int quiet;                  //rows on stdout own the screen
+    sink_band_t *bands;         //deadband state per sampler slot
+    int bands_cap;
+    unsigned long attached;
+    unsigned long detached;
+} match_session_t;
+
+
+static void match_event(void *ctx, pid_t pid, procwatch_what_t what, const char *comm) {
+    match_session_t *ms = ctx;
+    if (what == PROCWATCH_ATTACH) {
+        if (ms->smp.count == ms->bands_cap) {
+            int cap = ms->bands_cap ? ms->bands_cap * 2 : 64;
+            sink_band_t *bands = realloc(ms->bands, cap * sizeof(sink_band_t));
+            if (!bands) return;
+            ms->bands = bands;
+            ms->bands_cap = cap;
+        }
+        if (sampler_add(&ms->smp, pid) != 0) return;
+        memset(&ms->bands[ms->smp.count - 1], 0, sizeof(sink_band_t));
+        ms->attached++;
+        if (!ms->quiet) printf("+ %d %s\n", pid, comm);
+    } else {
+        //the sampler moves its last slot into the freed one, the bands follow
+        for (int i = 0; i < ms->smp.count; i++) {
+            if (ms->smp.targets[i].pid == pid) ms->bands[i] = ms->bands[ms->smp.count - 1];
+        }
+        sampler_remove(&ms->smp, pid);
+        ms->detached++;
+        if (!ms->quiet) printf("- %d %s\n", pid, comm);
+    }
+}
+
+
+static int by_rss_desc(const void *a, const void *b) {
+    long x = ((const sampler_target_t *)a)->info.vmrss;
+    long y = ((const sampler_target_t *)b)->info.vmrss;
+    return (x < y) - (x > y);
+}
+
+
+//fleet line plus the largest matches, sorted on a copy so slots stay put
+static void match_render(match_session_t *ms, const char *pattern) {
+    colstore_agg_t rss, vsz;
+    colstore_aggregate(&ms->cols, COL_RSS, 0, &rss);
+    colstore_aggregate(&ms->cols, COL_VSZ, 0, &vsz);
+    printf("==== %zu processes matching %s ====\n", rss.n, pattern);
+    if (rss.n == 0) return;
+    printf("RSS total %lld KB, mean %lld KB, max %d KB | VSZ total %lld KB\n",
+           (long long)rss.sum, (long long)(rss.sum / (int64_t)rss.n), rss.max, (long long)vsz.sum);
+    sampler_target_t *top = malloc(ms->smp.count * sizeof(sampler_target_t));
+    if (!top) return;
+    int n = 0;
+    for (int i = 0; i < ms->smp.count; i++) {
+        if (ms->smp.targets[i].fd >= 0) top[n++] = ms->smp.targets[i];
+    }
+    qsort(top, n, sizeof(sampler_target_t), by_rss_desc);
+    printf("%8s %-16s %12s %12s\n", "pid", "comm", "RSS KB", "VSZ KB");
+    for (int i = 0; i < n && i < 10; i++) {
+        const procwatch_proc_t *p = procwatch_find(&ms->watch, top[i].pid);
+        printf("%8d %-16s %12ld %12ld\n", top[i].pid, p ? p->comm : "?",
+               top[i].info.vmrss / KB_UNIT, top[i].info.vmsize / KB_UNIT);
+    }
+    free(top);
+}
+
+
+static void *match_thread(void *arg) {
+    match_session_t *ms = arg;
+    config_t *cfg = ms->cfg;
+    long long period_ms = cfg->interval * 1000LL;
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    while (__atomic_load_n(&cfg->monitoring, __ATOMIC_SEQ_CST)) {
+        long long now_ms = current_time_ms();
+        sampler_tick(&ms->smp);
+        colstore_load(&ms->cols, &ms->smp);
+        if (!ms->quiet) match_render(ms, ms->pattern);
+        if (cfg->sink) {
+            for (int i = 0; i < ms->smp.count; i++) {
+                const sampler_target_t *t = &ms->smp.targets[i];
+                if (t->fd >= 0) sink_write_band(cfg->sink, &ms->bands[i], now_ms, t->pid, &t->info);
+            }
+        }
+        fflush(stdout);
+
+        //until the next tick, handle events as they come (or rescan once)
+        deadline.tv_sec += period_ms / 1000;
+        deadline.tv_nsec += (period_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        while (__atomic_load_n(&cfg->monitoring, __ATOMIC_SEQ_CST)) {
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            long long left = (deadline.tv_sec - now.tv_sec) * 1000LL +
+                             (deadline.tv_nsec - now.tv_nsec) / 1000000L;
+            if (left <= 0) break;
+            if (ms->watch.mode == PROCWATCH_SCAN) {
+                //short naps, so enter and Ctrl+C stop promptly
+                struct timespec nap = { 0, (left < 100 ? left : 100) * 1000000L };
+                nanosleep(&nap, NULL);
+                continue;
+            }
+            struct pollfd pfd = { ms->watch.fd, POLLIN, 0 };
+            if (poll(&pfd, 1, left < 100 ? (int)left : 100) > 0) procwatch_poll(&ms->watch);
+        }
+        if (ms->watch.mode == PROCWATCH_SCAN) procwatch_poll(&ms->watch);
+    }
+    return NULL;
+}
+
+
+//trace --match <regex> [-i secs] [-o csv|jsonl [file]] [-d kb[:secs]] [--scan]
+static int trace_match(config_t *cfg, char *args[], int arg_count) {
+    if (arg_count < 3) {
+        printf("error: missing pattern, e.g. trace --match '^worker'\n");
+        return 0;
+    }
+    const char *pattern = args[2];
+    int scan_only = 0, want_sink = 0;
+    const char *sink_path = NULL;
+    sink_format_t sink_format = SINK_CSV;
+    long deadband_kb = 0, heartbeat_s = 0;
+    cfg->interval = 1;
+    for (int i = 3; i < arg_count; i++) {
+        if (strcmp(args[i], "-i") == 0 && i + 1 < arg_count) {
+            cfg->interval = atoi(args[++i]);
+            if (cfg->interval <= 0) {
+                printf("error: invalid interval\n");
+                return 0;
+            }
+        } else if (strcmp(args[i], "--scan") == 0) {
+            scan_only = 1;
+        } else if (strcmp(args[i], "-o") == 0 && i + 1 < arg_count) {
+            if (sink_parse_format(args[++i], &sink_format) != 0) {
+                printf("error: unknown output format %s, csv or jsonl\n", args[i]);
+                return 0;
+            }
+            want_sink = 1;
+            if (i + 1 < arg_count && args[i + 1][0] != '-') sink_path = args[++i];
+        } else if (strcmp(args[i], "-d") == 0 && i + 1 < arg_count) {
+            int n = sscanf(args[++i], "%ld:%ld", &deadband_kb, &heartbeat_s);
+            if (n < 1 || deadband_kb <= 0 || heartbeat_s < 0) {
+                printf("error: invalid deadband, expected kb[:heartbeat_s]\n");
+                return 0;
+            }
+        }
+    }
+    if (deadband_kb && !want_sink) {
+        printf("error: -d needs an output, -o csv or -o jsonl\n");
+        return 0;
+    }
+    if (want_sink) {
+        cfg->sink = malloc(sizeof(sink_t));
+        if (!cfg->sink || sink_open(cfg->sink, sink_path, sink_format, deadband_kb,
+                                    heartbeat_s * 1000LL) != 0) {
+            printf("error: can't open output %s\n", sink_path ? sink_path : "stdout");
+            free(cfg->sink);
+            cfg->sink = NULL;
+            return 0;
+        }
+    }
+
+    match_session_t *ms = calloc(1, sizeof(match_session_t));
+    if (!ms || sampler_init(&ms->smp, SAMPLER_PREAD) != 0) {
+        printf("error: memory allocation failed\n");
+        free(ms);
+        close_sink(cfg);
+        return 0;
+    }
+    ms->cfg = cfg;
+    ms->pattern = pattern;
+    ms->quiet = cfg->sink && cfg->sink->to_stdout;
+    if (colstore_init(&ms->cols, 0) != 0 ||
+        procwatch_open(&ms->watch, pattern, scan_only, match_event, ms) != 0) {
+        printf("error: can't watch for %s\n", pattern);
+        sampler_free(&ms->smp);
+        colstore_free(&ms->cols);
+        free(ms->bands);
+        free(ms);
+        close_sink(cfg);
+        return 0;
+    }
+    printf("following processes matching %s (%s), %lu now\n", pattern,
+           ms->watch.mode == PROCWATCH_NETLINK ? "proc connector" : "rescanning /proc",
+           ms->attached);
+    run_until_stopped(cfg, match_thread, ms);
+
+    printf("matched: %lu attached, %lu detached, %lu events, %lu scans, %lu resyncs",
+           ms->attached, ms->detached, ms->watch.events, ms->watch.scans, ms->watch.resyncs);
+    if (ms->watch.latency_n) {
+        printf(", attach %.2f ms mean / %.2f ms max after the event",
+               ms->watch.latency_sum_ns / 1e6 / ms->watch.latency_n, ms->watch.latency_max_ns / 1e6);
+    }
+    printf("\n");
+    procwatch_close(&ms->watch);
+    sampler_free(&ms->smp);
+    colstore_free(&ms->cols);
+    free(ms->bands);
+    free(ms);
+    close_sink(cfg);
+    printf("monitoring stopped\n");
+    return 0;
+}
+
+
+typedef struct {
+    config_t *cfg;
+    leader_t board;
+    int top_n;
+} top_session_t;
+
+
+static void *top_thread(void *arg) {
+    top_session_t *ts = arg;
+    config_t *cfg = ts->cfg;
+    while (__atomic_load_n(&cfg->monitoring, __ATOMIC_SEQ_CST)) {
+        long long now_ms = current_time_ms();
+        if (leader_scan(&ts->board, now_ms) < 0) break;
+        leader_report(&ts->board, now_ms, stdout, ts->top_n);
+        fflush(stdout);
+        //short naps, so enter and Ctrl+C stop promptly
+        struct timespec nap = { 0, 100000000L };
+        for (int i = 0; i < cfg->interval * 10 && __atomic_load_n(&cfg->monitoring, __ATOMIC_SEQ_CST); i++) {
+            nanosleep(&nap, NULL);
+        }
+    }
+    return NULL;
+}
+
+
+//top [-w span] [-n count] [-i secs]
+static int top_leaders(config_t *cfg, char *args[], int arg_count) {
+    long long window_ms = 5 * 60 * 1000LL;
+    int top_n = LEADER_TOP;
+    cfg->interval = 5;
+    for (int i = 1; i < arg_count; i++) {
+        if (strcmp(args[i], "-w") == 0 && i + 1 < arg_count) {
+            window_ms = parse_span(args[++i]);
+            if (window_ms <= 0) {
+                printf("error: invalid window %s, e.g. 90s, 5m, 1h\n", args[i]);
+                return 0;
+            }
+        } else if (strcmp(args[i], "-n") == 0 && i + 1 < arg_count) {
+            top_n = atoi(args[++i]);
+            if (top_n <= 0) {
+                printf("error: invalid count\n");
+                return 0;
+            }
+        } else if (strcmp(args[i], "-i") == 0 && i + 1 < arg_count) {
+            cfg->interval = atoi(args[++i]);
+            if (cfg->interval <= 0) {
+                printf("error: invalid interval\n");
+                return 0;
+            }
+        }
+    }
+
+    top_session_t *ts = calloc(1, sizeof(top_session_t));
+    if (!ts || leader_init(&ts->board, window_ms) != 0) {
+        printf("error: memory allocation failed\n");
+        free(ts);
+        return 0;
+    }
+    ts->cfg = cfg;
+    ts->top_n = top_n;
+    printf("scanning every %d s, growth over %lld s windows\n", cfg->interval, window_ms / 1000);
+    run_until_stopped(cfg, top_thread, ts);
+    printf("%lu scans, %zu processes in the table (%zu bytes)\n", ts->board.scans,
+           ts->board.count, ts->board.count * sizeof(leader_entry_t));
+    leader_free(&ts->board);
+    free(ts);
+    printf("monitoring stopped\n");
+    return 0;
+}
+
+
+static void group_collect(void *ctx, pid_t pid, procwatch_what_t what, const char *comm) {
+    (void)comm;
+    if (what == PROCWATCH_ATTACH) group_add(ctx, pid);
+}
+
+
+//group <pid>... | group --match <regex>, [-t threads]
+static int group_footprint(char *args[], int arg_count) {
+    group_t g;
+    int threads = 0;
+    const char *pattern = NULL;
+    if (group_init(&g) != 0) return 0;
+    for (int i = 1; i < arg_count; i++) {
+        if (strcmp(args[i], "-t") == 0 && i + 1 < arg_count) {
+            threads = atoi(args[++i]);
+            if (threads <= 0) {
+                printf("error: invalid thread count\n");
+                group_free(&g);
+                return 0;
+            }
+        } else if (strcmp(args[i], "--match") == 0 && i + 1 < arg_count) {
+            pattern = args[++i];
+        } else if (atoi(args[i]) > 0) {
+            group_add(&g, atoi(args[i]));
+        }
+    }
+    if (pattern) {
+        //one /proc rescan is all it takes, no need for the connector
+        procwatch_t pw;
+        if (procwatch_open(&pw, pattern, 1, group_collect, &g) != 0) {
+            printf("error: invalid pattern %s\n", pattern);
+            group_free(&g);
+            return 0;
+        }
+        procwatch_close(&pw);
+    }
+    if (g.count == 0) {
+        printf("error: no processes, e.g. group 1234 1235 or group --match '^worker'\n");
+    } else if (group_scan(&g, threads) == 0) {
+        group_report(&g, stdout);
+    }
+    group_free(&g);
+    return 0;
+}
+
+
+
+typedef struct {
+    config_t *cfg;
+    kmem_t km;
+    int top_n;
+} kmem_session_t;
+
+
+static void *kmem_thread(void *arg) {
+    kmem_session_t *ks = arg;
+    config_t *cfg = ks->cfg;
+    while (__atomic_load_n(&cfg->monitoring, __ATOMIC_SEQ_CST)) {
+        if (kmem_sample(&ks->km, current_time_ms()) < 0) {
+            printf("error: can't read %s/meminfo\n", get_procfs_root());
+            break;
+        }
+        kmem_report(&ks->km, stdout, ks->top_n);
+        if (ks->km.samples > 1) {
+            draw_chart(&ks->km.field_hist[KMEM_SLAB], "Slab (KB)");
+            const kmem_slab_t *top[3];
+            int n = kmem_top_slabs(&ks->km, top, 3);
+            for (int i = 0; i < n; i++) {
+                if (!top[i]->hist) continue;
+                char title[64];
+                snprintf(title, sizeof(title), "%s (KB)", top[i]->name);
+                draw_chart(top[i]->hist, title);
+            }
+        }
+        fflush(stdout);
+        struct timespec nap = { 0, 100000000L };
+        for (int i = 0; i < cfg->interval * 10 && __atomic_load_n(&cfg->monitoring, __ATOMIC_SEQ_CST); i++) {
+            nanosleep(&nap, NULL);
+        }
+    }
+    return NULL;
+}
+
+
+//kmem [-i secs] [-n count]
+static int kmem_monitor(config_t *cfg, char *args[], int arg_count) {
+    int top_n = KMEM_TOP;
+    cfg->interval = KMEM_INTERVAL_S;
+    for (int i = 1; i < arg_count; i++) {
+        if (strcmp(args[i], "-i") == 0 && i + 1 < arg_count) {
+            cfg->interval = atoi(args[++i]);
+            if (cfg->interval <= 0) {
+                printf("error: invalid interval\n");
+                return 0;
+            }
+        } else if (strcmp(args[i], "-n") == 0 && i + 1 < arg_count) {
+            top_n = atoi(args[++i]);
+            if (top_n <= 0) {
+                printf("error: invalid count\n");
+                return 0;
+            }
+        }
+    }
+
+    kmem_session_t *ks = calloc(1, sizeof(kmem_session_t));
+    if (!ks || kmem_init(&ks->km) != 0) {
+        printf("error: memory allocation failed\n");
+        free(ks);
+        return 0;
+    }
+    ks->cfg = cfg;
+    ks->top_n = top_n;
+    printf("sampling kernel memory every %d s, vmalloc callers every %d samples\n",
+           cfg->interval, KMEM_VMALLOC_EVERY);
+    run_until_stopped(cfg, kmem_thread, ks);
+    printf("%lu samples, %d slab caches tracked\n", ks->km.samples, ks->km.nslabs);
+    kmem_free(&ks->km);
+    free(ks);
+    printf("monitoring stopped\n");
+    return 0;
+}
+
 int execute_command(config_t *cfg, cmd_type_t cmd, char *args[], int arg_count) {
     switch (cmd) {
         case CMD_TRACE: {
@@ -555,6 +1548,15 @@ int execute_command(config_t *cfg, cmd_type_t cmd, char *args[], int arg_count)
                 return 0;
             }
             
+            if (strcmp(args[1], "--match") == 0) {
+                if (cfg->log_fp) {
+                    fclose(cfg->log_fp);
+                    cfg->log_fp = NULL;
+                }
+                close_zlog(cfg);
+                close_sink(cfg);
+                return trace_match(cfg, args, arg_count);
+            }
             pid_t pid = atoi(args[1]);
             if (pid <= 0) {
                 printf("error: invalid PID\n");
@@ -570,8 +1572,28 @@ int execute_command(config_t *cfg, cmd_type_t cmd, char *args[], int arg_count)
                 free(cfg->log_file);
                 cfg->log_file = NULL;
             }
+            close_zlog(cfg);
+            close_sink(cfg);
+            close_recorder(cfg);
+            close_retention(cfg);
+            close_allocprof(cfg);
+            close_faultprof(cfg);
+            close_numa(cfg);
+            int profile_allocs = 0;
+            const char *sink_path = NULL;
+            sink_format_t sink_format = SINK_CSV;
+            int want_sink = 0;
+            long deadband_kb = 0, heartbeat_s = 0;
+            long fault_period = 0;     //0 leaves page fault sampling off
+            long numa_secs = 0;        //0 leaves numa_maps sampling off
+            const char *retain_path = NULL;
+            int retain_reset = 0;
             //default config
             cfg->interval = 1;
+            cfg->adaptive = 0;
+            cfg->min_interval_ms = ADAPTIVE_MIN_MS;
+            cfg->max_interval_ms = ADAPTIVE_MAX_MS;
+            cfg->pressure = 0;
             cfg->continuous = 0;
             cfg->target_pid = pid;
             
@@ -585,8 +1607,95 @@ int execute_command(config_t *cfg, cmd_type_t cmd, char *args[], int arg_count)
                     }
                     cfg->interval = interval;
                     i++;
+                } else if (strcmp(args[i], "-a") == 0) {
+                    //optional min:max in ms, e.g. -a 10:1000
+                    cfg->adaptive = 1;
+                    cfg->continuous = 1;
+                    if (i + 1 < arg_count && isdigit((unsigned char)args[i + 1][0])) {
+                        int min_ms, max_ms;
+                        if (sscanf(args[i + 1], "%d:%d", &min_ms, &max_ms) != 2 ||
+                            min_ms <= 0 || max_ms < min_ms) {
+                            printf("error: invalid adaptive bounds, expected min_ms:max_ms\n");
+                            return 0;
+                        }
+                        cfg->min_interval_ms = min_ms;
+                        cfg->max_interval_ms = max_ms;
+                        i++;
+                    }
+                } else if ((strcmp(args[i], "-T") == 0 || strcmp(args[i], "-G") == 0 ||
+                            strcmp(args[i], "-W") == 0 || strcmp(args[i], "-D") == 0) &&
+                           i + 1 < arg_count) {
+                    recorder_t *rec = get_recorder(cfg);
+                    if (!rec) {
+                        printf("error: memory allocation failed\n");
+                        return 0;
+                    }
+                    const char *opt = args[i++];
+                    long mb = 0;
+                    int a = 0, b = 0;
+                    if (opt[1] == 'T' && sscanf(args[i], "%ld", &mb) == 1 && mb > 0) {
+                        rec->threshold = mb << 20;
+                    } else if (opt[1] == 'G' && sscanf(args[i], "%ld:%d", &mb, &a) == 2 &&
+                               mb > 0 && a > 0) {
+                        rec->growth = mb << 20;
+                        rec->growth_ms = a * 1000;
+                    } else if (opt[1] == 'W' && sscanf(args[i], "%d:%d", &a, &b) == 2 &&
+                               a >= 0 && b >= 0) {
+                        rec->pre_ms = a * 1000;
+                        rec->post_ms = b * 1000;
+                    } else if (opt[1] == 'D' && strlen(args[i]) < sizeof(rec->dir) - 64 &&
+                               access(args[i], W_OK) == 0) {
+                        strcpy(rec->dir, args[i]);
+                    } else {
+                        printf("error: invalid value for %s: %s\n", opt, args[i]);
+                        close_recorder(cfg);
+                        return 0;
+                    }
+                    cfg->continuous = 1;
+                } else if (strcmp(args[i], "-x") == 0 && i + 1 < arg_count) {
+                    //the hook is the rest of the line
+                    recorder_t *rec = get_recorder(cfg);
+                    size_t len = 0;
+                    for (int j = i + 1; j < arg_count; j++) len += strlen(args[j]) + 1;
+                    if (!rec || !(rec->hook = malloc(len))) {
+                        printf("error: memory allocation failed\n");
+                        return 0;
+                    }
+                    rec->hook[0] = '\0';
+                    for (int j = i + 1; j < arg_count; j++) {
+                        if (j > i + 1) strcat(rec->hook, " ");
+                        strcat(rec->hook, args[j]);
+                    }
+                    i = arg_count;
                 } else if (strcmp(args[i], "-c") == 0) {
                     cfg->continuous = 1;
+                } else if (strcmp(args[i], "-p") == 0) {
+                    cfg->pressure = 1;
+                } else if (strcmp(args[i], "-A") == 0) {
+                    profile_allocs = 1;
+                    cfg->continuous = 1;
+                } else if (strcmp(args[i], "-F") == 0) {
+                    //optional sample period in minor faults, e.g. -F 16
+                    fault_period = FAULTPROF_PERIOD;
+                    cfg->continuous = 1;
+                    if (i + 1 < arg_count && isdigit((unsigned char)args[i + 1][0])) {
+                        fault_period = atol(args[++i]);
+                        if (fault_period <= 0) {
+                            printf("error: invalid fault sample period\n");
+                            return 0;
+                        }
+                    }
+                } else if (strcmp(args[i], "-N") == 0) {
+                    //optional numa_maps period in seconds, e.g. -N 30
+                    numa_secs = NUMA_INTERVAL_MS / 1000;
+                    cfg->continuous = 1;
+                    if (i + 1 < arg_count && isdigit((unsigned char)args[i + 1][0])) {
+                        numa_secs = atol(args[++i]);
+                        if (numa_secs <= 0) {
+                            printf("error: invalid numa interval\n");
+                            return 0;
+                        }
+                    }
                 } else if (strcmp(args[i], "-l") == 0 && i + 1 < arg_count) {
                     cfg->log_file = strdup(args[i + 1]);
                     if (!cfg->log_file) {
@@ -601,84 +1710,406 @@ int execute_command(config_t *cfg, cmd_type_t cmd, char *args[], int arg_count)
                         return 0;
                     }
                     i++;
+                } else if (strcmp(args[i], "-z") == 0 && i + 1 < arg_count) {
+                    close_zlog(cfg);
+                    cfg->zlog = malloc(sizeof(codec_writer_t));
+                    if (!cfg->zlog) {
+                        printf("error: memory allocation failed\n");
+                        return 0;
+                    }
+                    if (codec_writer_open(cfg->zlog, args[i + 1], CODEC_MAX_COLS) != 0) {
+                        printf("error:can't open compressed log file %s\n", args[i + 1]);
+                        free(cfg->zlog);
+                        cfg->zlog = NULL;
+                        return 0;
+                    }
+                    i++;
+                } else if (strcmp(args[i], "-R") == 0 && i + 1 < arg_count) {
+                    retain_path = args[++i];
+                } else if (strcmp(args[i], "--reset") == 0) {
+                    retain_reset = 1;
+                } else if (strcmp(args[i], "-o") == 0 && i + 1 < arg_count) {
+                    //-o csv|jsonl [file], stdout without a file
+                    if (sink_parse_format(args[++i], &sink_format) != 0) {
+                        printf("error: unknown output format %s, csv or jsonl\n", args[i]);
+                        return 0;
+                    }
+                    want_sink = 1;
+                    if (i + 1 < arg_count && args[i + 1][0] != '-') sink_path = args[++i];
+                } else if (strcmp(args[i], "-d") == 0 && i + 1 < arg_count) {
+                    //-d kb[:heartbeat_s]
+                    int n = sscanf(args[++i], "%ld:%ld", &deadband_kb, &heartbeat_s);
+                    if (n < 1 || deadband_kb <= 0 || heartbeat_s < 0) {
+                        printf("error: invalid deadband, expected kb[:heartbeat_s]\n");
+                        return 0;
+                    }
                 }
             }
             
+            if (want_sink) {
+                cfg->sink = malloc(sizeof(sink_t));
+                if (!cfg->sink || sink_open(cfg->sink, sink_path, sink_format, deadband_kb,
+                                            heartbeat_s * 1000LL) != 0) {
+                    printf("error: can't open output %s\n", sink_path ? sink_path : "stdout");
+                    free(cfg->sink);
+                    cfg->sink = NULL;
+                    return 0;
+                }
+            } else if (deadband_kb) {
+                printf("error: -d needs an output, -o csv or -o jsonl\n");
+                return 0;
+            }
+            if (cfg->recorder && !cfg->recorder->threshold && !cfg->recorder->growth) {
+                printf("error: flight recorder needs a trigger, -T mb or -G mb:secs\n");
+                close_recorder(cfg);
+                return 0;
+            }
+            if (profile_allocs) {
+                cfg->allocprof = malloc(sizeof(allocprof_t));
+                if (!cfg->allocprof || allocprof_attach(cfg->allocprof, pid) != 0) {
+                    printf("error: can't attach the allocation profiler to %d\n", pid);
+                    free(cfg->allocprof);
+                    cfg->allocprof = NULL;
+                    close_recorder(cfg);
+                    return 0;
+                }
+            }
+            if (fault_period) {
+                cfg->faultprof = malloc(sizeof(faultprof_t));
+                if (!cfg->faultprof || faultprof_attach(cfg->faultprof, pid, fault_period) != 0) {
+                    printf("error: can't sample page faults of %d\n", pid);
+                    free(cfg->faultprof);
+                    cfg->faultprof = NULL;
+                    close_allocprof(cfg);
+                    close_recorder(cfg);
+                    return 0;
+                }
+            }
+            if (numa_secs) {
+                cfg->numa = malloc(sizeof(numa_t));
+                if (!cfg->numa || numa_open(cfg->numa, pid, numa_secs * 1000) != 0) {
+                    printf("error: can't read the numa placement of %d\n", pid);
+                    free(cfg->numa);
+                    cfg->numa = NULL;
+                    close_faultprof(cfg);
+                    close_allocprof(cfg);
+                    close_recorder(cfg);
+                    return 0;
+                }
+            }
+            //a one shot trace only keeps history when it goes to a file
+            if ((cfg->continuous || retain_path) && open_retention(cfg, retain_path, retain_reset) != 0) {
+                printf("error: can't open retention store %s\n", retain_path ? retain_path : "");
+                close_recorder(cfg);
+                return 0;
+            }
+
             //non-continuous mode, read once
             if (!cfg->continuous) {
                 mem_info_t info;
                 if (read_mem_info(pid, &info) == 0) {
-                    display_mem_info(&info);
+                    if (!cfg->sink || !cfg->sink->to_stdout) {
+                        display_mem_info(&info);
+                    }
                     if (cfg->log_fp) {
                         write_log(cfg->log_fp, &info);
                     }
+                    if (cfg->sink) {
+                        sink_write(cfg->sink, current_time_ms(), pid, &info);
+                    }
+                    if (cfg->zlog) {
+                        write_zlog(cfg, current_time_ms(), &info);
+                    }
+                    if (cfg->retain) {
+                        retain_sample(cfg, current_time_ms(), &info);
+                    }
                 } else {
                     printf("error: can't read memory info of process %d\n", pid);
                 }
+                close_zlog(cfg);
+                close_sink(cfg);
+                close_retention(cfg);
                 return 0;
             }
             
             //continuous mode
-            printf("start monitoring the process%d (each %d updated once second)\n", pid, cfg->interval);
-            printf("press Ctrl+C or enter to stop monitoring...\n");
-            
-            /*
-            1.unified initialization of sigaction structure
-            2.verify sigint_handler validity
-            3.initialize signal mask
-            4.set signal handler
-            */
-            struct sigaction sa = {
-                .sa_sigaction = sigint_handler,   //function pointer
-                .sa_flags = SA_SIGINFO | SA_RESTART
-            };            
-            sigemptyset(&sa.sa_mask);            
-            if (sigaction(SIGINT, &sa, NULL) == -1) {
-                perror("Failed to set SIGINT handler");
-                exit(EXIT_FAILURE);
-            }
-            
-            //create monitoring thread
-            pthread_t tid;
-            pthread_mutex_lock(&cfg->lock);
-            cfg->monitoring = 1;
-            pthread_mutex_unlock(&cfg->lock);
-            
-            //check return value
-            int ret = pthread_create(&tid, NULL, monitor_thread, cfg);
-            if (ret != 0) {
-                printf("error: failed to create monitoring thread: %s\n", strerror(ret));
-                pthread_mutex_lock(&cfg->lock);
-                cfg->monitoring = 0;
-                pthread_mutex_unlock(&cfg->lock);
-                return 0;
+            if (cfg->adaptive) {
+                printf("start monitoring the process%d (adaptive, every %d-%d ms)\n", pid,
+                       cfg->min_interval_ms, cfg->max_interval_ms);
+            } else {
+                printf("start monitoring the process%d (each %d updated once second)\n", pid, cfg->interval);
             }
-            
-            //wait for user input to stop
-            getchar();
-            
-            //stop monitoring
-            pthread_mutex_lock(&cfg->lock);
-            cfg->monitoring = 0;
-            pthread_mutex_unlock(&cfg->lock);
-            
-            //wait for monitoring thread to finish
-            pthread_join(tid, NULL);            
+            run_until_stopped(cfg, monitor_thread, cfg);
+            close_zlog(cfg);    //seal the open block so the file is complete
+            close_sink(cfg);
+            close_allocprof(cfg);
+            close_faultprof(cfg);
+            close_numa(cfg);
             printf("monitoring stopped\n");
             return 0;
         }
         
+        case CMD_RUN: {
+            //run [-m ms] [-l logfile] -- cmd args
+            int max_ms = LAUNCH_MAX_MS;
+            const char *log = NULL;
+            int i = 1;
+            for (; i < arg_count && strcmp(args[i], "--") != 0; i++) {
+                if (strcmp(args[i], "-m") == 0 && i + 1 < arg_count) {
+                    max_ms = atoi(args[++i]);
+                    if (max_ms <= 0) {
+                        printf("error: invalid interval\n");
+                        return 0;
+                    }
+                } else if (strcmp(args[i], "-l") == 0 && i + 1 < arg_count) {
+                    log = args[++i];
+                } else {
+                    break;
+                }
+            }
+            if (i < arg_count && strcmp(args[i], "--") == 0) i++;
+            if (i >= arg_count) {
+                printf("error: missing command, e.g. run -- ls -l\n");
+                return 0;
+            }
+            char *argv[MAX_ARGS + 1];
+            int n = 0;
+            for (; i < arg_count; i++) argv[n++] = args[i];
+            argv[n] = NULL;
+
+            launch_t run;
+            if (launch_run(&run, argv, max_ms) != 0) {
+                launch_free(&run);
+                return 0;
+            }
+            launch_report(&run);
+
+            //after the fact, so the sampling loop never waits on the disk
+            FILE *fp = log ? fopen(log, "a") : NULL;
+            if (log && !fp) printf("error: can't open log file %s\n", log);
+            cfg->target_pid = run.pid;
+            int retained = open_retention(cfg, NULL, 0) == 0;
+            for (size_t k = 0; k < run.count; k++) {
+                long long ts = run.start_ms + run.samples[k].t_us / 1000;
+                if (fp) write_log_at(fp, ts, &run.samples[k].info);
+                if (retained) retain_sample(cfg, ts, &run.samples[k].info);
+            }
+            if (fp) fclose(fp);
+            launch_free(&run);
+            return 0;
+        }
+
+        case CMD_TOP:
+            return top_leaders(cfg, args, arg_count);
+
+        case CMD_GROUP:
+            return group_footprint(args, arg_count);
+
+        case CMD_KMEM:
+            return kmem_monitor(cfg, args, arg_count);
+
+        case CMD_ANALYZE: {
+            if (arg_count < 2) {
+                printf("error: missing log file argument\n");
+                return 0;
+            }
+
+            int threads = 0;    //0 means one per online cpu
+            char *paths[MAX_ARGS];
+            int npaths = 0;
+            for (int i = 1; i < arg_count; i++) {
+                if (strcmp(args[i], "-t") == 0 && i + 1 < arg_count) {
+                    threads = atoi(args[i + 1]);
+                    if (threads <= 0) {
+                        printf("error: invalid thread count\n");
+                        return 0;
+                    }
+                    i++;
+                } else {
+                    paths[npaths++] = args[i];
+                }
+            }
+            if (npaths == 0) {
+                printf("error: missing log file argument\n");
+                return 0;
+            }
+            if (analyze_logs(paths, npaths, threads) != 0 && npaths == 1) {
+                printf("error: can't analyze log file %s\n", paths[0]);
+            }
+            return 0;
+        }
+
+        case CMD_HISTORY:
+        case CMD_EXPORT: {
+            //history [span] [-f file], export <out> [span] [-f file]
+            int first = 1;
+            if (cmd == CMD_EXPORT) {
+                if (arg_count < 2) {
+                    printf("error: missing output file argument\n");
+                    return 0;
+                }
+                first = 2;
+            }
+            long long span = cmd == CMD_HISTORY ? RETAIN_HOUR_MS : RETAIN_HOUR_SLOTS * RETAIN_HOUR_MS;
+            const char *file = NULL;
+            for (int i = first; i < arg_count; i++) {
+                if (strcmp(args[i], "-f") == 0 && i + 1 < arg_count) {
+                    file = args[++i];
+                } else if ((span = parse_span(args[i])) < 0) {
+                    printf("error: invalid time span %s, e.g. 90s, 15m, 6h, 7d\n", args[i]);
+                    return 0;
+                }
+            }
+
+            retention_t tmp;
+            retention_t *store = query_store(cfg, file, &tmp);
+            if (!store) return 0;
+            //spans end at the newest sample, so old files are still browsable
+            long long to = store->st->newest_ms;
+            long long from = to - span + 1;
+
+            if (cmd == CMD_EXPORT) {
+                FILE *fp = fopen(args[1], "w");
+                const char *ext = strrchr(args[1], '.');
+                int json = ext && (strcmp(ext, ".json") == 0 || strcmp(ext, ".jsonl") == 0);
+                int n = fp ? retention_export(store, fp, from, to, json) : -1;
+                if (fp && fclose(fp) != 0) n = -1;
+                if (n < 0) {
+                    printf("error: can't export to %s\n", args[1]);
+                } else {
+                    printf("exported %d rows to %s\n", n, args[1]);
+                }
+            } else {
+                retain_point_t *pts;
+                long long res;
+                int n = retention_query(store, from, to, CHART_WIDTH - 2, &pts, &res);
+                if (n > 0) {
+                    history_data_t hist;
+                    init_history(&hist);
+                    for (int i = 0; i < n; i++) {
+                        update_history_at(&hist, pts[i].ts_ms, pts[i].max[1]);
+                    }
+                    printf("pid %d, %d points from %s\n", store->st->pid, n,
+                           res == 0 ? "raw samples" : res == RETAIN_MINUTE_MS ?
+                           "1 minute rollups" : "1 hour rollups");
+                    draw_chart(&hist, "RSS History (peak per point)");
+                    sketch_print(stdout, "retained RSS", &store->st->rss_dist);
+                    cleanup_history(&hist);
+                } else if (n == 0) {
+                    printf("no samples in that span\n");
+                }
+                free(pts);
+            }
+            if (store == &tmp) retention_close(&tmp);
+            return 0;
+        }
+
+        case CMD_STATS: {
+            selfstat_snapshot_t snap;
+            selfstat_snapshot(&snap);
+            selfstat_print(stdout, &snap);
+            return 0;
+        }
+
+        case CMD_PROCFS:
+            if (arg_count >= 2 && set_procfs_root(args[1]) != 0) {
+                printf("error: can't use %s as procfs root\n", args[1]);
+                return 0;
+            }
+            printf("procfs root: %s\n", get_procfs_root());
+            return 0;
+
         case CMD_HELP:
             printf("\nUsage:\n");
             printf("1. trace <pid> - view the memory usage of a process\n");
             printf("   options:\n");
             printf("     -i interval - set the monitoring interval (seconds)\n");
             printf("     -c - enable continuous monitoring mode\n");
+            printf("     -a [min:max] - adaptive interval in ms (default 10:1000), implies -c\n");
             printf("     -l logfile - specify the log file\n");
+            printf("     -z file - also write a compressed (delta-of-delta) log\n");
+            printf("     -o csv|jsonl [file] - stream rows (ts_ms, time, pid, type and VSZ/RSS/\n");
+            printf("       Data/Stack in KB) to file or, without one, to stdout instead of charts\n");
+            printf("     -d kb[:secs] - with -o, only rows where a value moved more than kb,\n");
+            printf("       and one every secs (default 60) regardless\n");
+            printf("     -T mb / -G mb:secs - flight recorder trigger: rss above mb, or grown\n");
+            printf("       by mb within secs; implies -c, samples every 100 ms (or faster with -a)\n");
+            printf("     -W pre:post - seconds dumped around a trigger (default 10:5)\n");
+            printf("     -D dir - where dumps go (default .)\n");
+            printf("     -x cmd... - run cmd after each dump (rest of the line, $MEMTRC_DUMP)\n");
+            printf("     -R file - keep the tiered history (1 h raw, 1 day of minutes, 30 days\n");
+            printf("       of hours) in a mapped file, reopened by later traces; a file that\n");
+            printf("       isn't a store of this layout is refused, --reset starts it over\n");
+            printf("     -p - co-sample minor/major faults per second of the process and the\n");
+            printf("       system's memory PSI and reclaim/swap rates, charted and logged\n");
+            printf("     -A - allocation sites: the target must run with\n");
+            printf("       LD_PRELOAD=libmemtrc_preload.so (make preload), implies -c\n");
+            printf("     -F [period] - sample page faults with perf_event software events, one\n");
+            printf("       per period minor faults (default 1) and every major one; shows the\n");
+            printf("       hottest mappings and faulting instructions, implies -c\n");
+            printf("     -N [secs] - numa placement from numa_maps every secs (default 10):\n");
+            printf("       KB per node by anon/heap/stack/file, charts per node and of the\n");
+            printf("       share on nodes the threads did not run on, implies -c\n");
             printf("     example:\n");
             printf("     trace 1234 -c -i 2 -l memory.log\n");
-            printf("2. help - display this help information\n");
-            printf("3. quit - exit the program\n");            
+            printf("     trace 1234 -a 10:1000 -l memory.log\n");
+            printf("     trace 1234 -c -o jsonl -d 64:10 | jq .rss_kb\n");
+            printf("     trace 1234 -T 512 -G 100:5 -D /tmp -x gzip $MEMTRC_DUMP\n");
+            printf("   trace --match <regex> [-i s] [-o csv|jsonl [file]] [-d kb[:s]] [--scan]\n");
+            printf("     follow every process whose name or command line matches: attached\n");
+            printf("     at exec and detached at exit through the proc connector (root), or by\n");
+            printf("     rescanning /proc each interval (--scan, or when unprivileged); shows\n");
+            printf("     fleet RSS and the largest matches, -o writes one row per process\n");
+            printf("     trace --match '^worker' -i 2 -o csv fleet.csv\n");
+            printf("2. run [-m ms] [-l logfile] -- cmd args - start cmd and sample it from its\n");
+            printf("   first instruction: densely at first, then a fixed number of samples per\n");
+            printf("   doubling of the run time; prints peak RSS (wait4 and VmHWM), RSS at\n");
+            printf("   1/2/5 ms... after exec and a chart, history and export work afterwards\n");
+            printf("   options:\n");
+            printf("     -m ms - longest interval between samples (default 100)\n");
+            printf("     -l logfile - also write every sample to the log\n");
+            printf("     example:\n");
+            printf("     run -- python3 -c \"import numpy\"\n");
+            printf("3. top [-w span] [-n count] [-i secs] - system wide leaderboard of RSS\n");
+            printf("   growth: every interval (default 5 s) the stat file of every process is\n");
+            printf("   read and the top count (default 10) by KB gained, by gain relative to\n");
+            printf("   the start and the largest new processes over the window (default 5m)\n");
+            printf("   are shown, with exited processes counted apart\n");
+            printf("     example:\n");
+            printf("     top -w 15m -n 20 -i 10\n");
+            printf("4. group <pid>... | --match <regex> [-t threads] - exact footprint of a\n");
+            printf("   process group (e.g. pre-forked workers) from the pagemap of every member,\n");
+            printf("   needs root: the group's unique KB, KB shared within the group and the\n");
+            printf("   private KB of each member, members are walked by threads (default 8)\n");
+            printf("     example:\n");
+            printf("     group --match '^php-fpm' -t 4\n");
+            printf("5. kmem [-i secs] [-n count] - kernel memory, every interval (default\n");
+            printf("   10 s): Slab, SReclaimable, SUnreclaim, VmallocUsed, PageTables and\n");
+            printf("   KernelStack from meminfo, the slab caches grown most since the start\n");
+            printf("   with a chart each, and vmalloc use by caller every 6th sample;\n");
+            printf("   slabinfo and vmallocinfo need root, else only the totals are shown\n");
+            printf("     example:\n");
+            printf("     kmem -i 30 -n 10\n");
+            printf("6. analyze <logfile>... - summarize logs written by trace -l or -z; with\n");
+            printf("   several logs (e.g. one per target) their quantiles are also merged\n");
+            printf("   options:\n");
+            printf("     -t threads - number of parser threads (default: all cpus)\n");
+            printf("     example:\n");
+            printf("     analyze memory.log -t 4\n");
+            printf("     analyze a.log b.log c.log\n");
+            printf("7. history [span] [-f file] - chart RSS peaks over the span ending at the\n");
+            printf("   newest sample, from the last trace or a -R file; span is 90s, 15m, 6h, 7d\n");
+            printf("     example:\n");
+            printf("     history 6h -f memory.ret\n");
+            printf("8. export <out> [span] [-f file] - min/max/avg rows at the resolution\n");
+            printf("   retained for the span (default all), csv or json lines for .json/.jsonl\n");
+            printf("     example:\n");
+            printf("     export day.csv 1d -f memory.ret\n");
+            printf("9. stats - show memtrc's own cost: probe latencies, cpu, rss, syscalls\n");
+            printf("10. procfs [dir] - show or change the procfs root (default /proc,\n");
+            printf("   or $MEMTRC_PROCFS), e.g. a tree written by procfix\n");
+            printf("11. help - display this help information\n");
+            printf("12. quit - exit the program\n");            
             return 0;
             
             case CMD_QUIT:
@@ -691,6 +2122,12 @@ int execute_command(config_t *cfg, cmd_type_t cmd, char *args[], int arg_count)
                 free(cfg->log_file);
                 cfg->log_file = NULL;
             }
+            close_zlog(cfg);
+            close_sink(cfg);
+            close_retention(cfg);
+            close_allocprof(cfg);
+            close_faultprof(cfg);
+            close_numa(cfg);
             return 1;  //exit
             
         case CMD_UNKNOWN:
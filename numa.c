@@ -0,0 +1,257 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-7-29 21:40:18
+ * @Last modified: 2025-7-29 21:40:18
+ * @Description: numa_maps sampling. the parser works on a fixed window read
+ *               straight from the fd and splits lines in place, so thousands
+ *               of mappings cost no allocation and no stdio. a line is
+ *               "<addr> <policy> [heap|stack|file=<path>] anon=.. N<node>=<pages>
+ *               .. kernelpagesize_kB=<kb>", the page size comes last.
+ */
+
+#include "include/memtrc.h"
+#include "include/numa.h"
+#include <fcntl.h>
+#include <dirent.h>
+#include <ctype.h>
+#include <time.h>
+
+static const char *kind_names[NUMA_KINDS] = { "anon", "heap", "stack", "file" };
+
+
+//"0-3,8,10-11" into cpu_node
+static void read_cpulist(numa_t *nm, int node, const char *list) {
+    const char *p = list;
+    while (isdigit((unsigned char)*p)) {
+        char *end;
+        long lo = strtol(p, &end, 10), hi = lo;
+        if (*end == '-') hi = strtol(end + 1, &end, 10);
+        for (long c = lo; c <= hi && c < NUMA_MAX_CPUS; c++) nm->cpu_node[c] = (int16_t)node;
+        p = *end == ',' ? end + 1 : end;
+    }
+}
+
+
+int numa_open(numa_t *nm, pid_t pid, long long interval_ms) {
+    if (!nm || pid <= 0 || interval_ms <= 0) {
+        fprintf(stderr, "Error: Invalid arguments to numa_open()\n");
+        return -1;
+    }
+    memset(nm, 0, sizeof(numa_t));
+    char path[PATH_MAX];
+    int fd = proc_path(path, sizeof(path), pid, "numa_maps") == 0 ? open(path, O_RDONLY | O_CLOEXEC) : -1;
+    if (fd < 0) {
+        fprintf(stderr, "Can't read numa_maps of %d: %s\n", pid, strerror(errno));
+        return -1;
+    }
+    close(fd);
+    nm->pid = pid;
+    nm->interval_ms = interval_ms;
+    for (int c = 0; c < NUMA_MAX_CPUS; c++) nm->cpu_node[c] = -1;
+    for (int node = 0; node < NUMA_MAX_NODES; node++) {
+        char list[1024];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE *fp = fopen(path, "r");
+        if (!fp) continue;
+        if (fgets(list, sizeof(list), fp)) read_cpulist(nm, node, list);
+        fclose(fp);
+        nm->sys_nodes = node + 1;
+    }
+    if (nm->sys_nodes == 0) {
+        //no node directories, a single node system
+        for (int c = 0; c < NUMA_MAX_CPUS; c++) nm->cpu_node[c] = 0;
+        nm->sys_nodes = 1;
+    }
+    for (int i = 0; i < NUMA_CHART_NODES; i++) init_history(&nm->node_hist[i]);
+    init_history(&nm->remote_hist);
+    return 0;
+}
+
+
+static void parse_line(char *line, numa_usage_t *u) {
+    int nodes[NUMA_MAX_NODES];
+    long pages[NUMA_MAX_NODES];
+    int n = 0;
+    numa_kind_t kind = NUMA_ANON;
+    long page_kb = 4;
+    u->lines++;
+    //address and policy first
+    char *p = line;
+    for (int skip = 0; skip < 2; skip++) {
+        p = strchr(p, ' ');
+        if (!p) return;
+        p++;
+    }
+    while (*p) {
+        char *tok = p;
+        char *end = strchr(p, ' ');
+        if (end) {
+            *end = '\0';
+            p = end + 1;
+        } else {
+            p += strlen(p);
+        }
+        if (tok[0] == 'N' && isdigit((unsigned char)tok[1])) {
+            char *eq;
+            long node = strtol(tok + 1, &eq, 10);
+            if (*eq == '=' && node < NUMA_MAX_NODES && n < NUMA_MAX_NODES) {
+                nodes[n] = (int)node;
+                pages[n++] = strtol(eq + 1, NULL, 10);
+            }
+        } else if (strncmp(tok, "file=", 5) == 0) {
+            kind = NUMA_FILE;
+        } else if (strcmp(tok, "heap") == 0) {
+            kind = NUMA_HEAP;
+        } else if (strncmp(tok, "stack", 5) == 0) {
+            kind = NUMA_STACK;  //older kernels write stack:<tid> for thread stacks
+        } else if (strncmp(tok, "kernelpagesize_kB=", 18) == 0) {
+            page_kb = strtol(tok + 18, NULL, 10);
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        u->kb[nodes[i]][kind] += pages[i] * page_kb;
+        if (nodes[i] >= u->nodes) u->nodes = nodes[i] + 1;
+    }
+}
+
+
+//whole numa_maps from fd into u, a window at a time
+int numa_parse(int fd, numa_usage_t *u) {
+    if (fd < 0 || !u) return -1;
+    memset(u, 0, sizeof(numa_usage_t));
+    char buf[NUMA_BUF];
+    size_t len = 0;
+    for (;;) {
+        ssize_t n = read(fd, buf + len, sizeof(buf) - 1 - len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+        if (n == 0) break;
+        len += (size_t)n;
+        char *start = buf, *nl;
+        while ((nl = memchr(start, '\n', buf + len - start)) != NULL) {
+            *nl = '\0';
+            parse_line(start, u);
+            start = nl + 1;
+        }
+        len -= (size_t)(start - buf);
+        memmove(buf, start, len);
+        if (len == sizeof(buf) - 1) {
+            //no newline in a full window, only a path could be that long: cut it there
+            buf[len] = '\0';
+            parse_line(buf, u);
+            len = 0;
+        }
+    }
+    if (len > 0) {
+        buf[len] = '\0';
+        parse_line(buf, u);
+    }
+    return 0;
+}
+
+
+long numa_node_kb(const numa_usage_t *u, int node) {
+    long kb = 0;
+    for (int k = 0; u && node >= 0 && node < NUMA_MAX_NODES && k < NUMA_KINDS; k++) {
+        kb += u->kb[node][k];
+    }
+    return kb;
+}
+
+
+//nodes of the cpus the threads last ran on, stat field 39
+static uint64_t thread_nodes(const numa_t *nm) {
+    char path[PATH_MAX];
+    if (proc_path(path, sizeof(path), nm->pid, "task") != 0) return 0;
+    DIR *dir = opendir(path);
+    if (!dir) return 0;
+    uint64_t mask = 0;
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        if (!isdigit((unsigned char)de->d_name[0])) continue;
+        char stat[32], buf[1024];
+        snprintf(stat, sizeof(stat), "%.16s/stat", de->d_name);
+        int fd = openat(dirfd(dir), stat, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) continue;
+        ssize_t n = read(fd, buf, sizeof(buf) - 1);
+        close(fd);
+        if (n <= 0) continue;
+        buf[n] = '\0';
+        char *p = strrchr(buf, ')');
+        if (!p || !p[1]) continue;
+        p += 2;
+        for (int field = 3; field < 39 && p; field++) {
+            p = strchr(p, ' ');
+            if (p) p++;
+        }
+        if (!p) continue;
+        long cpu = strtol(p, NULL, 10);
+        if (cpu >= 0 && cpu < NUMA_MAX_CPUS && nm->cpu_node[cpu] >= 0) {
+            mask |= 1ULL << nm->cpu_node[cpu];
+        }
+    }
+    closedir(dir);
+    return mask;
+}
+
+
+//returns 1 when a sample was taken, 0 when not due yet, -1 on failure
+int numa_sample(numa_t *nm, long long now_ms) {
+    if (!nm || nm->pid <= 0) return -1;
+    if (nm->samples > 0 && now_ms - nm->last_ms < nm->interval_ms) return 0;
+    char path[PATH_MAX];
+    if (proc_path(path, sizeof(path), nm->pid, "numa_maps") != 0) return -1;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int ret = numa_parse(fd, &nm->cur);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    close(fd);
+    if (ret != 0) return -1;
+    nm->parse_us = (t1.tv_sec - t0.tv_sec) * 1000000LL + (t1.tv_nsec - t0.tv_nsec) / 1000;
+    nm->last_ms = now_ms;
+    nm->samples++;
+
+    nm->local_nodes = thread_nodes(nm);
+    if (!nm->local_nodes) nm->local_nodes = 1;     //threads unreadable, call node 0 home
+    nm->local_kb = nm->remote_kb = 0;
+    for (int node = 0; node < nm->cur.nodes; node++) {
+        long kb = numa_node_kb(&nm->cur, node);
+        if (nm->local_nodes & (1ULL << node)) nm->local_kb += kb;
+        else nm->remote_kb += kb;
+    }
+    for (int node = 0; node < NUMA_CHART_NODES && node < nm->sys_nodes; node++) {
+        update_history_at(&nm->node_hist[node], now_ms, numa_node_kb(&nm->cur, node));
+    }
+    long total = nm->local_kb + nm->remote_kb;
+    update_history_at(&nm->remote_hist, now_ms, total ? nm->remote_kb * 1000 / total : 0);
+    return 1;
+}
+
+
+//per node table, local nodes starred, then the local/remote split
+void numa_report(const numa_t *nm, FILE *fp) {
+    if (!nm || !fp || nm->samples == 0) return;
+    int nodes = nm->cur.nodes > nm->sys_nodes ? nm->cur.nodes : nm->sys_nodes;
+    fprintf(fp, "%6s", "node");
+    for (int k = 0; k < NUMA_KINDS; k++) fprintf(fp, " %11s", kind_names[k]);
+    fprintf(fp, " %11s (KB)\n", "total");
+    for (int node = 0; node < nodes; node++) {
+        fprintf(fp, "%5d%c", node, nm->local_nodes & (1ULL << node) ? '*' : ' ');
+        for (int k = 0; k < NUMA_KINDS; k++) fprintf(fp, " %11ld", nm->cur.kb[node][k]);
+        fprintf(fp, " %11ld\n", numa_node_kb(&nm->cur, node));
+    }
+    long total = nm->local_kb + nm->remote_kb;
+    fprintf(fp, "local %ld KB, remote %ld KB (%.1f%%), * = nodes the threads ran on | "
+            "%ld mappings read in %.1f ms\n", nm->local_kb, nm->remote_kb,
+            total ? 100.0 * nm->remote_kb / total : 0.0, nm->cur.lines, nm->parse_us / 1000.0);
+}
+
+
+void numa_close(numa_t *nm) {
+    if (!nm) return;
+    for (int i = 0; i < NUMA_CHART_NODES; i++) cleanup_history(&nm->node_hist[i]);
+    cleanup_history(&nm->remote_hist);
+    memset(nm, 0, sizeof(numa_t));
+}
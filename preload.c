@@ -0,0 +1,320 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-7-9 21:03:37
+ * @Last modified: 2025-7-9 21:03:37
+ * @Description: libmemtrc_preload.so, LD_PRELOAD allocation sampler. every
+ *               thread counts allocated bytes down from an exponentially drawn
+ *               interval (Poisson sampling by bytes), only the allocation that
+ *               crosses it takes a backtrace and goes into the thread's ring in
+ *               /dev/shm/memtrc-<pid>. everything else costs a thread local
+ *               subtraction, frees a probe of the sampled address table.
+ *               built with `make preload`, glibc only (uses __libc_malloc and
+ *               friends, so no dlsym bootstrapping). memalign family blocks
+ *               are not sampled.
+ */
+#define _GNU_SOURCE
+#include "include/allocprof.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <execinfo.h>
+#include <dlfcn.h>
+#include <link.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+#define TLS __thread __attribute__((tls_model("initial-exec")))
+#define ADDR_EMPTY   0
+#define ADDR_DELETED 1
+#define ADDR_PROBES  64
+
+static allocprof_shm_t *shm;
+static uint64_t *addrs;             //sampled blocks still live, open addressing
+static uint64_t live_sampled;       //entries in addrs, frees skip the probe while 0
+static double mean_bytes = ALLOCPROF_SAMPLE_BYTES;
+static int enabled;
+static pthread_key_t ring_key;
+static char shm_name[64];
+static uintptr_t self_start, self_end;  //our own code, never reported as a call site
+
+static TLS int in_hook;             //backtrace() may allocate, and we never sample ourselves
+static TLS int64_t until_sample;    //bytes left before the next sample
+static TLS int primed;
+static TLS uint64_t rnd;
+static TLS allocprof_ring_t *ring;
+
+
+static void *raw_mmap(void *addr, size_t len, int prot, int flags, int fd, off_t off) {
+    return (void *)syscall(SYS_mmap, addr, len, prot, flags, fd, off);
+}
+
+
+static double next_uniform(void) {
+    rnd ^= rnd << 13;
+    rnd ^= rnd >> 7;
+    rnd ^= rnd << 17;
+    return ((rnd >> 11) + 0.5) / 9007199254740992.0;   //(0, 1)
+}
+
+
+//exponential gaps make every byte equally likely to be sampled, whatever the sizes
+static int64_t next_interval(void) {
+    return (int64_t)(-log(next_uniform()) * mean_bytes) + 1;
+}
+
+
+static void release_ring(void *r) {
+    __atomic_store_n(&((allocprof_ring_t *)r)->owner, 0, __ATOMIC_RELEASE);
+}
+
+
+static allocprof_ring_t *claim_ring(void) {
+    uint32_t tid = (uint32_t)syscall(SYS_gettid);
+    for (int i = 0; i < ALLOCPROF_RINGS; i++) {
+        uint32_t free_owner = 0;
+        if (__atomic_compare_exchange_n(&shm->rings[i].owner, &free_owner, tid, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            pthread_setspecific(ring_key, &shm->rings[i]);
+            return &shm->rings[i];
+        }
+    }
+    return NULL;
+}
+
+
+static inline uint64_t addr_hash(uint64_t a) {
+    a ^= a >> 33;
+    a *= 0xff51afd7ed558ccdULL;
+    a ^= a >> 33;
+    return a;
+}
+
+
+static int addr_insert(uint64_t a) {
+    uint64_t h = addr_hash(a);
+    for (int i = 0; i < ADDR_PROBES; i++) {
+        uint64_t *slot = &addrs[(h + i) & (ALLOCPROF_ADDR_SLOTS - 1)];
+        uint64_t cur = __atomic_load_n(slot, __ATOMIC_RELAXED);
+        if ((cur == ADDR_EMPTY || cur == ADDR_DELETED) &&
+            __atomic_compare_exchange_n(slot, &cur, a, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            __atomic_fetch_add(&live_sampled, 1, __ATOMIC_RELAXED);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+
+static int addr_remove(uint64_t a) {
+    uint64_t h = addr_hash(a);
+    for (int i = 0; i < ADDR_PROBES; i++) {
+        uint64_t *slot = &addrs[(h + i) & (ALLOCPROF_ADDR_SLOTS - 1)];
+        uint64_t cur = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+        if (cur == ADDR_EMPTY) return -1;
+        if (cur == a && __atomic_compare_exchange_n(slot, &cur, ADDR_DELETED, 0,
+                                                    __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            __atomic_fetch_sub(&live_sampled, 1, __ATOMIC_RELAXED);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+
+static void push(uint32_t type, void *p, size_t size, uint64_t weight) {
+    if (!ring && !(ring = claim_ring())) {
+        __atomic_fetch_add(&shm->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    uint64_t head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= ALLOCPROF_RING_EVENTS) {
+        ring->dropped++;
+        return;
+    }
+    allocprof_event_t *ev = &ring->events[head & (ALLOCPROF_RING_EVENTS - 1)];
+    ev->seq = __atomic_fetch_add(&shm->seq, 1, __ATOMIC_RELAXED);
+    ev->addr = (uint64_t)p;
+    ev->size = size;
+    ev->weight = weight;
+    ev->type = type;
+    ev->depth = 0;
+    if (type == ALLOCPROF_ALLOC) {
+        void *frames[ALLOCPROF_DEPTH + 4];
+        int n = backtrace(frames, ALLOCPROF_DEPTH + 4);
+        for (int i = 0; i < n && ev->depth < ALLOCPROF_DEPTH; i++) {
+            uintptr_t f = (uintptr_t)frames[i];
+            if (f >= self_start && f < self_end) continue;  //push, record_alloc, the hook
+            ev->frames[ev->depth++] = f;
+        }
+    }
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+
+static void record_alloc(void *p, size_t size) {
+    if (!p || !enabled || in_hook) return;
+    if (!primed) {
+        rnd = (uint64_t)syscall(SYS_gettid) * 0x9e3779b97f4a7c15ULL ^ (uint64_t)time(NULL);
+        if (!rnd) rnd = 1;
+        until_sample = next_interval();
+        primed = 1;
+    }
+    until_sample -= (int64_t)size;
+    if (until_sample > 0) return;
+
+    in_hook = 1;
+    until_sample = next_interval();
+    //a block of size s is sampled with probability 1 - e^(-s/mean), weight it back up
+    uint64_t weight = (uint64_t)(size / -expm1(-(double)size / mean_bytes));
+    if (addr_insert((uint64_t)p) == 0) {
+        push(ALLOCPROF_ALLOC, p, size, weight);
+    } else {
+        __atomic_fetch_add(&shm->dropped, 1, __ATOMIC_RELAXED);
+    }
+    in_hook = 0;
+}
+
+
+static void record_free(void *p) {
+    if (!p || !enabled || in_hook) return;
+    if (__atomic_load_n(&live_sampled, __ATOMIC_RELAXED) == 0) return;
+    in_hook = 1;
+    if (addr_remove((uint64_t)p) == 0) {
+        push(ALLOCPROF_FREE, p, 0, 0);
+    }
+    in_hook = 0;
+}
+
+
+void *malloc(size_t size) {
+    void *p = __libc_malloc(size);
+    record_alloc(p, size);
+    return p;
+}
+
+
+void *calloc(size_t nmemb, size_t size) {
+    void *p = __libc_calloc(nmemb, size);
+    record_alloc(p, nmemb * size);
+    return p;
+}
+
+
+/*
+ * the old block's free goes out before libc can hand its address to another
+ * thread, whose sampled alloc would otherwise come first. a failed realloc
+ * leaves the block live but no longer sampled, it is rare enough.
+ */
+void *realloc(void *ptr, size_t size) {
+    record_free(ptr);
+    void *p = __libc_realloc(ptr, size);
+    record_alloc(p, size);
+    return p;
+}
+
+
+void free(void *ptr) {
+    record_free(ptr);
+    __libc_free(ptr);
+}
+
+
+//anonymous mappings only, file mappings are not heap
+void *mmap(void *addr, size_t len, int prot, int flags, int fd, off_t off) {
+    void *p = raw_mmap(addr, len, prot, flags, fd, off);
+    if (p != MAP_FAILED && (flags & MAP_ANONYMOUS)) record_alloc(p, len);
+    return p;
+}
+
+
+//a partial unmap counts as a full one, the sample is gone either way
+int munmap(void *addr, size_t len) {
+    record_free(addr);
+    return (int)syscall(SYS_munmap, addr, len);
+}
+
+
+//executable segments of the object holding base
+static int find_self(struct dl_phdr_info *info, size_t size, void *base) {
+    (void)size;
+    if ((void *)info->dlpi_addr != base) return 0;
+    for (int i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr) *ph = &info->dlpi_phdr[i];
+        if (ph->p_type != PT_LOAD || !(ph->p_flags & PF_X)) continue;
+        uintptr_t start = info->dlpi_addr + ph->p_vaddr;
+        if (!self_start || start < self_start) self_start = start;
+        if (start + ph->p_memsz > self_end) self_end = start + ph->p_memsz;
+    }
+    return 1;
+}
+
+
+//a forked child has its own heap but would write into our rings, or unlink them at exit
+static void atfork_child(void) {
+    enabled = 0;
+    shm = NULL;
+    pthread_setspecific(ring_key, NULL);    //the parent's thread still owns that ring
+}
+
+
+__attribute__((constructor))
+static void preload_init(void) {
+    const char *env = getenv("MEMTRC_SAMPLE_BYTES");
+    if (env && atol(env) > 0) mean_bytes = (double)atol(env);
+
+    snprintf(shm_name, sizeof(shm_name), ALLOCPROF_SHM_FMT, (int)getpid());
+    int fd = shm_open(shm_name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) return;
+    if (ftruncate(fd, sizeof(allocprof_shm_t)) != 0) {
+        close(fd);
+        shm_unlink(shm_name);
+        return;
+    }
+    void *map = raw_mmap(NULL, sizeof(allocprof_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    void *table = raw_mmap(NULL, ALLOCPROF_ADDR_SLOTS * sizeof(uint64_t), PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED || table == MAP_FAILED) {
+        shm_unlink(shm_name);
+        return;
+    }
+    shm = map;
+    addrs = table;
+    shm->version = ALLOCPROF_VERSION;
+    shm->pid = getpid();
+    shm->nrings = ALLOCPROF_RINGS;
+    shm->sample_bytes = (uint64_t)mean_bytes;
+
+    //backtrace() loads libgcc_s on first use, do it before any hook relies on it
+    in_hook = 1;
+    void *warm[2];
+    backtrace(warm, 2);
+    Dl_info di;
+    if (dladdr((void *)preload_init, &di) && di.dli_fbase) {
+        dl_iterate_phdr(find_self, di.dli_fbase);
+    }
+    pthread_key_create(&ring_key, release_ring);
+    pthread_atfork(NULL, NULL, atfork_child);
+    in_hook = 0;
+
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(shm->magic, ALLOCPROF_MAGIC, 4);     //last, memtrc checks it
+    enabled = 1;
+}
+
+
+__attribute__((destructor))
+static void preload_fini(void) {
+    //memtrc keeps its mapping until it detaches; only the process that made it unlinks
+    if (shm && shm->pid == getpid()) shm_unlink(shm_name);
+}
@@ -0,0 +1,151 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-7-6 14:52:19
+ * @Last modified: 2025-7-6 14:52:19
+ * @Description: page fault and memory pressure co-sampling. the system files
+ *               are read under the procfs root like everything else, so fixture
+ *               trees can provide them; a missing pressure file only means no PSI.
+ */
+
+#include "include/memtrc.h"
+#include "include/pressure.h"
+#include <fcntl.h>
+
+static pthread_mutex_t sys_lock = PTHREAD_MUTEX_INITIALIZER;
+static long long sys_tick = -1;    //tick of the shared copy
+static sys_pressure_t sys_shared;
+static int sys_ok;
+
+
+static ssize_t read_root_file(const char *name, char *buf, size_t size) {
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/%s", get_procfs_root(), name) >= (int)sizeof(path)) {
+        return -1;
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t n = read(fd, buf, size - 1);
+    close(fd);
+    if (n < 0) return -1;
+    buf[n] = '\0';
+    return n;
+}
+
+
+//"some avg10=0.00 avg60=0.00 avg300=0.00 total=0" and the same for "full"
+static void parse_psi(const char *buf, sys_pressure_t *sys) {
+    const char *line = buf;
+    while (line && *line) {
+        double avg10;
+        unsigned long long total;
+        const char *t = strstr(line, "total=");
+        if (sscanf(line + 5, "avg10=%lf", &avg10) == 1 && t &&
+            sscanf(t, "total=%llu", &total) == 1) {
+            if (strncmp(line, "some ", 5) == 0) {
+                sys->some_avg10 = avg10;
+                sys->some_total = total;
+                sys->has_psi = 1;
+            } else if (strncmp(line, "full ", 5) == 0) {
+                sys->full_avg10 = avg10;
+                sys->full_total = total;
+            }
+        }
+        line = strchr(line, '\n');
+        if (line) line++;
+    }
+}
+
+
+//pgscan_anon/pgscan_file split the same pages again, only the reclaimer counters are summed
+static void parse_vmstat(const char *buf, sys_pressure_t *sys) {
+    const char *line = buf;
+    while (line && *line) {
+        char key[64];
+        unsigned long long v;
+        if (sscanf(line, "%63s %llu", key, &v) == 2) {
+            if (strcmp(key, "pgscan_kswapd") == 0 || strcmp(key, "pgscan_direct") == 0 ||
+                strcmp(key, "pgscan_khugepaged") == 0 || strcmp(key, "pgscan_proactive") == 0) {
+                sys->pgscan += v;
+            } else if (strcmp(key, "pgsteal_kswapd") == 0 || strcmp(key, "pgsteal_direct") == 0 ||
+                       strcmp(key, "pgsteal_khugepaged") == 0 || strcmp(key, "pgsteal_proactive") == 0) {
+                sys->pgsteal += v;
+            } else if (strcmp(key, "pswpin") == 0) {
+                sys->pswpin = v;
+            } else if (strcmp(key, "pswpout") == 0) {
+                sys->pswpout = v;
+            }
+        }
+        line = strchr(line, '\n');
+        if (line) line++;
+    }
+}
+
+
+int read_sys_pressure(sys_pressure_t *sys) {
+    if (!sys) return -1;
+    memset(sys, 0, sizeof(sys_pressure_t));
+    //vmstat is about 4 KB on current kernels, 16 KB leaves room for new counters
+    char buf[16384];
+    if (read_root_file("pressure/memory", buf, sizeof(buf)) > 0) {
+        parse_psi(buf, sys);
+    }
+    if (read_root_file("vmstat", buf, sizeof(buf)) <= 0) return -1;
+    parse_vmstat(buf, sys);
+    return 0;
+}
+
+
+/*
+ * the system counters for tick_ms. the first caller of a tick reads them, every
+ * other target sampled in the same tick gets the shared copy without syscalls.
+ */
+int sys_pressure_tick(long long tick_ms, sys_pressure_t *sys) {
+    if (!sys) return -1;
+    pthread_mutex_lock(&sys_lock);
+    if (tick_ms != sys_tick) {
+        sys_ok = read_sys_pressure(&sys_shared) == 0;
+        sys_tick = tick_ms;
+    }
+    *sys = sys_shared;
+    int ok = sys_ok;
+    pthread_mutex_unlock(&sys_lock);
+    return ok ? 0 : -1;
+}
+
+
+//fault counters of pid plus the tick's system counters, -1 if pid's stat is unreadable
+int pressure_sample(pid_t pid, long long tick_ms, pressure_sample_t *s) {
+    if (!s) return -1;
+    proc_stat_t st;
+    if (read_proc_stat(pid, &st) != 0) return -1;
+    s->ts_ms = tick_ms;
+    s->minflt = st.minflt;
+    s->majflt = st.majflt;
+    if (sys_pressure_tick(tick_ms, &s->sys) != 0) {
+        memset(&s->sys, 0, sizeof(sys_pressure_t));
+    }
+    return 0;
+}
+
+
+static double per_sec(unsigned long long prev, unsigned long long cur, double secs) {
+    return cur >= prev ? (cur - prev) / secs : 0;   //a reset counter reads as idle
+}
+
+
+//rates between two samples of the same target, -1 until time has passed
+int pressure_rates(const pressure_sample_t *prev, const pressure_sample_t *cur,
+                   pressure_rates_t *out) {
+    if (!prev || !cur || !out || cur->ts_ms <= prev->ts_ms) return -1;
+    double secs = (cur->ts_ms - prev->ts_ms) / 1000.0;
+    out->minflt = per_sec(prev->minflt, cur->minflt, secs);
+    out->majflt = per_sec(prev->majflt, cur->majflt, secs);
+    //stall us per second of wall time, exact over any interval unlike avg10
+    out->some_pct = per_sec(prev->sys.some_total, cur->sys.some_total, secs) / 1e4;
+    out->full_pct = per_sec(prev->sys.full_total, cur->sys.full_total, secs) / 1e4;
+    out->pgscan = per_sec(prev->sys.pgscan, cur->sys.pgscan, secs);
+    out->pgsteal = per_sec(prev->sys.pgsteal, cur->sys.pgsteal, secs);
+    out->pswpin = per_sec(prev->sys.pswpin, cur->sys.pswpin, secs);
+    out->pswpout = per_sec(prev->sys.pswpout, cur->sys.pswpout, secs);
+    return 0;
+}
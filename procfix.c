@@ -0,0 +1,63 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-6-14 15:26:09
+ * @Last modified: 2025-6-14 15:26:09
+ * @Description: command line front end of the fixture generator, builds a
+ *               synthetic /proc tree to point MEMTRC_PROCFS or `procfs` at
+ */
+
+#include "include/memtrc.h"
+#include "include/fixture.h"
+
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-n count] [-p first_pid] [-k kernel_every] [-z zombie_every]\n"
+            "       [-t stopped_every] [-s status_pad_lines] [-m smaps_mappings]\n"
+            "       [-S seed] [-r] <root>\n"
+            "  -r  remove <root> instead of generating it, only a tree procfix made\n", prog);
+}
+
+
+int main(int argc, char *argv[]) {
+    fixture_opts_t opts;
+    int opt;
+    int remove_tree = 0;
+
+    fixture_default_opts(&opts);
+    while ((opt = getopt(argc, argv, "n:p:k:z:t:s:m:S:rh")) != -1) {
+        switch (opt) {
+            case 'n': opts.count = atoi(optarg); break;
+            case 'p': opts.first_pid = atoi(optarg); break;
+            case 'k': opts.kernel_every = atoi(optarg); break;
+            case 'z': opts.zombie_every = atoi(optarg); break;
+            case 't': opts.stopped_every = atoi(optarg); break;
+            case 's': opts.status_pad_lines = atoi(optarg); break;
+            case 'm': opts.smaps_mappings = atoi(optarg); break;
+            case 'S': opts.seed = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 'r': remove_tree = 1; break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (optind != argc - 1 || opts.count < 0 || opts.first_pid <= 0 ||
+        opts.status_pad_lines < 0 || opts.smaps_mappings < 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char *root = argv[optind];
+    if (remove_tree) {
+        return fixture_remove(root) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    long long start = current_time_ms();
+    if (fixture_generate(root, &opts) != 0) {
+        fprintf(stderr, "Failed to generate fixture in %s\n", root);
+        return EXIT_FAILURE;
+    }
+    printf("%d processes (pids %d-%d) written to %s in %lld ms\n", opts.count,
+           opts.first_pid, opts.first_pid + opts.count - 1, root,
+           current_time_ms() - start);
+    return EXIT_SUCCESS;
+}
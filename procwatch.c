@@ -0,0 +1,284 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-7-24 20:06:45
+ * @Last modified: 2025-7-24 20:06:45
+ * @Description: process discovery. one /proc walk at start, then proc
+ *               connector events: exec, fork of a process (not a thread) and
+ *               comm changes are matched as they come, exits detach. a socket
+ *               overrun (ENOBUFS) loses events, a rescan repairs the set.
+ *               without the connector every poll is a rescan.
+ */
+#define _GNU_SOURCE
+#include "include/memtrc.h"
+#include "include/procwatch.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+
+
+static long long mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+static int read_small(pid_t pid, const char *file, char *buf, size_t size) {
+    char path[PATH_MAX];
+    if (proc_path(path, sizeof(path), pid, file) != 0) return -1;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t n = read(fd, buf, size - 1);
+    close(fd);
+    if (n < 0) return -1;
+    buf[n] = '\0';
+    return (int)n;
+}
+
+
+//regex against the comm, then the command line with its NULs as spaces
+static int matches(procwatch_t *pw, pid_t pid, char *comm) {
+    char buf[1024];
+    int n = read_small(pid, "comm", comm, PROCWATCH_COMM);
+    if (n < 0) return 0;
+    comm[strcspn(comm, "\n")] = '\0';
+    if (regexec(&pw->re, comm, 0, NULL, 0) == 0) return 1;
+    n = read_small(pid, "cmdline", buf, sizeof(buf));
+    if (n <= 0) return 0;
+    for (int i = 0; i < n - 1; i++) {
+        if (buf[i] == '\0') buf[i] = ' ';
+    }
+    return regexec(&pw->re, buf, 0, NULL, 0) == 0;
+}
+
+
+static int find_index(const procwatch_t *pw, pid_t pid) {
+    for (int i = 0; i < pw->count; i++) {
+        if (pw->procs[i].pid == pid) return i;
+    }
+    return -1;
+}
+
+
+const procwatch_proc_t *procwatch_find(const procwatch_t *pw, pid_t pid) {
+    int i = pw ? find_index(pw, pid) : -1;
+    return i < 0 ? NULL : &pw->procs[i];
+}
+
+
+static void attach(procwatch_t *pw, pid_t pid, const char *comm) {
+    if (find_index(pw, pid) >= 0) return;
+    if (pw->count == pw->cap) {
+        int cap = pw->cap ? pw->cap * 2 : 64;
+        procwatch_proc_t *procs = realloc(pw->procs, cap * sizeof(procwatch_proc_t));
+        if (!procs) return;
+        pw->procs = procs;
+        pw->cap = cap;
+    }
+    procwatch_proc_t *p = &pw->procs[pw->count++];
+    p->pid = pid;
+    snprintf(p->comm, sizeof(p->comm), "%s", comm);
+    pw->cb(pw->ctx, pid, PROCWATCH_ATTACH, p->comm);
+}
+
+
+static void detach(procwatch_t *pw, pid_t pid) {
+    int i = find_index(pw, pid);
+    if (i < 0) return;
+    procwatch_proc_t gone = pw->procs[i];
+    pw->procs[i] = pw->procs[--pw->count];
+    pw->cb(pw->ctx, gone.pid, PROCWATCH_DETACH, gone.comm);
+}
+
+
+//match pid again, e.g. after an exec, attaching or detaching as needed
+static void recheck(procwatch_t *pw, pid_t pid, long long event_ns) {
+    char comm[PROCWATCH_COMM];
+    if (pid == getpid()) return;
+    if (!matches(pw, pid, comm)) {
+        detach(pw, pid);
+        return;
+    }
+    if (find_index(pw, pid) >= 0) return;
+    attach(pw, pid, comm);
+    if (event_ns > 0) {
+        long long lat = mono_ns() - event_ns;
+        if (lat > pw->latency_max_ns) pw->latency_max_ns = lat;
+        pw->latency_sum_ns += lat;
+        pw->latency_n++;
+    }
+}
+
+
+//walk /proc, attach new matches and detach the ones gone or renamed
+static int rescan(procwatch_t *pw) {
+    DIR *dir = opendir(get_procfs_root());
+    if (!dir) {
+        fprintf(stderr, "Failed to open %s: %s\n", get_procfs_root(), strerror(errno));
+        return -1;
+    }
+    pw->scans++;
+    int known = pw->count;      //entries attached by this walk go after them
+    char *seen = calloc(known + 1, 1);
+    struct dirent *de;
+    while ((de = readdir(dir))) {
+        if (de->d_name[0] < '1' || de->d_name[0] > '9') continue;
+        pid_t pid = atoi(de->d_name);
+        char comm[PROCWATCH_COMM];
+        if (pid == getpid() || !matches(pw, pid, comm)) continue;
+        int i = find_index(pw, pid);
+        if (i >= 0) {
+            if (seen && i < known) seen[i] = 1;
+        } else {
+            attach(pw, pid, comm);
+        }
+    }
+    closedir(dir);
+    //walk backwards, a detach moves an entry already checked into the hole
+    if (!seen) known = 0;
+    for (int i = known - 1; i >= 0; i--) {
+        if (!seen[i]) detach(pw, pw->procs[i].pid);
+    }
+    free(seen);
+    return 0;
+}
+
+
+static int connector_listen(procwatch_t *pw) {
+    int fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (fd < 0) return -1;
+    struct sockaddr_nl addr = { .nl_family = AF_NETLINK, .nl_groups = CN_IDX_PROC };
+    int rcvbuf = PROCWATCH_RCVBUF;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) != 0) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    char buf[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op))];
+    memset(buf, 0, sizeof(buf));
+    struct nlmsghdr *nl = (struct nlmsghdr *)buf;
+    struct cn_msg *cn = NLMSG_DATA(nl);
+    enum proc_cn_mcast_op op = PROC_CN_MCAST_LISTEN;
+    nl->nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(op));
+    nl->nlmsg_type = NLMSG_DONE;
+    cn->id.idx = CN_IDX_PROC;
+    cn->id.val = CN_VAL_PROC;
+    cn->len = sizeof(op);
+    memcpy(cn->data, &op, sizeof(op));
+    if (send(fd, nl, nl->nlmsg_len, 0) != (ssize_t)nl->nlmsg_len) {
+        close(fd);
+        return -1;
+    }
+    pw->fd = fd;
+    return 0;
+}
+
+
+/*
+ * pattern is an extended regex. existing matches are reported to cb before this
+ * returns, later ones from procwatch_poll(). scan_only skips the connector.
+ */
+int procwatch_open(procwatch_t *pw, const char *pattern, int scan_only,
+                   procwatch_cb_t cb, void *ctx) {
+    if (!pw || !pattern || !cb) {
+        fprintf(stderr, "Error: Invalid arguments to procwatch_open()\n");
+        return -1;
+    }
+    memset(pw, 0, sizeof(procwatch_t));
+    pw->fd = -1;
+    pw->cb = cb;
+    pw->ctx = ctx;
+    int err = regcomp(&pw->re, pattern, REG_EXTENDED | REG_NOSUB);
+    if (err != 0) {
+        char msg[128];
+        regerror(err, &pw->re, msg, sizeof(msg));
+        fprintf(stderr, "Invalid pattern %s: %s\n", pattern, msg);
+        return -1;
+    }
+    //listen first, so nothing that starts during the first walk is missed
+    pw->mode = !scan_only && connector_listen(pw) == 0 ? PROCWATCH_NETLINK : PROCWATCH_SCAN;
+    if (rescan(pw) != 0) {
+        procwatch_close(pw);
+        return -1;
+    }
+    return 0;
+}
+
+
+static void handle_event(procwatch_t *pw, const struct proc_event *ev) {
+    pw->events++;
+    switch (ev->what) {
+        case PROC_EVENT_EXEC:
+            if (ev->event_data.exec.process_pid == ev->event_data.exec.process_tgid) {
+                recheck(pw, ev->event_data.exec.process_pid, (long long)ev->timestamp_ns);
+            }
+            break;
+        case PROC_EVENT_FORK:
+            //a new process, not a thread: it runs its parent's image until it execs
+            if (ev->event_data.fork.child_pid == ev->event_data.fork.child_tgid) {
+                recheck(pw, ev->event_data.fork.child_pid, (long long)ev->timestamp_ns);
+            }
+            break;
+        case PROC_EVENT_COMM:
+            if (ev->event_data.comm.process_pid == ev->event_data.comm.process_tgid) {
+                recheck(pw, ev->event_data.comm.process_pid, (long long)ev->timestamp_ns);
+            }
+            break;
+        case PROC_EVENT_EXIT:
+            if (ev->event_data.exit.process_pid == ev->event_data.exit.process_tgid) {
+                detach(pw, ev->event_data.exit.process_pid);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+
+//drain the connector (or rescan without it), returns attached count or -1
+int procwatch_poll(procwatch_t *pw) {
+    if (!pw) return -1;
+    if (pw->mode == PROCWATCH_SCAN) {
+        return rescan(pw) == 0 ? pw->count : -1;
+    }
+    char buf[8192] __attribute__((aligned(NLMSG_ALIGNTO)));
+    while (1) {
+        struct sockaddr_nl from;
+        socklen_t len = sizeof(from);
+        ssize_t n = recvfrom(pw->fd, buf, sizeof(buf), 0, (struct sockaddr *)&from, &len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == ENOBUFS) {
+                pw->resyncs++;
+                rescan(pw);
+                continue;
+            }
+            break;  //EAGAIN, drained
+        }
+        if (from.nl_pid != 0) continue;     //only the kernel speaks for the connector
+        for (struct nlmsghdr *nl = (struct nlmsghdr *)buf; NLMSG_OK(nl, (size_t)n);
+             nl = NLMSG_NEXT(nl, n)) {
+            if (nl->nlmsg_type == NLMSG_ERROR || nl->nlmsg_type == NLMSG_NOOP) continue;
+            struct cn_msg *cn = NLMSG_DATA(nl);
+            if (cn->id.idx != CN_IDX_PROC || cn->id.val != CN_VAL_PROC) continue;
+            handle_event(pw, (const struct proc_event *)cn->data);
+        }
+    }
+    return pw->count;
+}
+
+
+void procwatch_close(procwatch_t *pw) {
+    if (!pw) return;
+    if (pw->fd >= 0) close(pw->fd);
+    regfree(&pw->re);
+    free(pw->procs);
+    memset(pw, 0, sizeof(procwatch_t));
+    pw->fd = -1;
+}
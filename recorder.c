@@ -0,0 +1,317 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-6-25 21:17:40
+ * @Last modified: 2025-6-25 21:17:40
+ * @Description: flight recorder. recorder_push() runs on the sampler thread and
+ *               never blocks: one store into the ring, a release of the head and
+ *               at most a sem_post. everything slow (smaps_rollup, waiting for
+ *               the post window, file output, hooks) happens on the dumper thread.
+ */
+
+#include "include/memtrc.h"
+#include "include/recorder.h"
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+
+int recorder_init(recorder_t *rec, pid_t pid) {
+    if (!rec || pid <= 0) {
+        fprintf(stderr, "Error: Invalid arguments to recorder_init()\n");
+        return -1;
+    }
+    memset(rec, 0, sizeof(recorder_t));
+    rec->pid = pid;
+    rec->pre_ms = RECORDER_PRE_MS;
+    rec->post_ms = RECORDER_POST_MS;
+    strcpy(rec->dir, ".");
+    return 0;
+}
+
+
+static void reap_hooks(recorder_t *rec) {
+    for (int i = 0; i < RECORDER_MAX_HOOKS; i++) {
+        if (rec->hooks[i] > 0 && waitpid(rec->hooks[i], NULL, WNOHANG) != 0) {
+            rec->hooks[i] = 0;
+        }
+    }
+}
+
+
+//fire and forget, the hook learns about the dump from its environment
+static void run_hook(recorder_t *rec) {
+    int slot = -1;
+    reap_hooks(rec);
+    for (int i = 0; i < RECORDER_MAX_HOOKS && slot < 0; i++) {
+        if (rec->hooks[i] == 0) slot = i;
+    }
+    if (slot < 0) {
+        fprintf(stderr, "Warning: %d hooks still running, skipping hook\n", RECORDER_MAX_HOOKS);
+        return;
+    }
+
+    int nenv = 0;
+    while (environ && environ[nenv]) nenv++;
+    char **envp = malloc((nenv + 4) * sizeof(char *));
+    if (!envp) return;
+    char env_pid[32], env_dump[PATH_MAX + 16], env_reason[160];
+    snprintf(env_pid, sizeof(env_pid), "MEMTRC_PID=%d", rec->pid);
+    snprintf(env_dump, sizeof(env_dump), "MEMTRC_DUMP=%s", rec->last_dump);
+    snprintf(env_reason, sizeof(env_reason), "MEMTRC_REASON=%s", rec->reason);
+    memcpy(envp, environ, nenv * sizeof(char *));
+    envp[nenv] = env_pid;
+    envp[nenv + 1] = env_dump;
+    envp[nenv + 2] = env_reason;
+    envp[nenv + 3] = NULL;
+
+    char *argv[] = { "sh", "-c", rec->hook, NULL };
+    pid_t child;
+    int err = posix_spawn(&child, "/bin/sh", NULL, NULL, argv, envp);
+    if (err != 0) {
+        fprintf(stderr, "Failed to run hook: %s\n", strerror(err));
+    } else {
+        rec->hooks[slot] = child;
+    }
+    free(envp);
+}
+
+
+static void read_rollup(pid_t pid, char *buf, size_t size) {
+    char path[PATH_MAX];
+    buf[0] = '\0';
+    if (proc_path(path, sizeof(path), pid, "smaps_rollup") != 0) return;
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        snprintf(buf, size, "unavailable: %s\n", strerror(errno));
+        return;
+    }
+    size_t n = fread(buf, 1, size - 1, fp);
+    buf[n] = '\0';
+    fclose(fp);
+}
+
+
+static int write_dump(recorder_t *rec, const char *rollup) {
+    unsigned long mask = rec->cap - 1;
+    unsigned long head = __atomic_load_n(&rec->head, __ATOMIC_ACQUIRE);
+    //entry head - cap may be mid-write by the producer, stay one behind it
+    unsigned long oldest = head >= rec->cap ? head - rec->cap + 1 : 0;
+    long long from = rec->trigger_ts - rec->pre_ms;
+    long long until = rec->trigger_ts + rec->post_ms;
+
+    unsigned long first = rec->trigger_idx < oldest ? oldest : rec->trigger_idx;
+    while (first > oldest && rec->ring[(first - 1) & mask].ts_ms >= from) first--;
+    unsigned long count = head - first;
+    recorder_sample_t *copy = malloc((count ? count : 1) * sizeof(recorder_sample_t));
+    if (!copy) return -1;
+    for (unsigned long i = 0; i < count; i++) {
+        copy[i] = rec->ring[(first + i) & mask];
+    }
+    //the producer kept going while we copied, drop whatever it may have overwritten
+    unsigned long now = __atomic_load_n(&rec->head, __ATOMIC_ACQUIRE);
+    unsigned long safe = now >= rec->cap ? now - rec->cap + 1 : 0;
+    unsigned long lost = safe > first ? safe - first : 0;
+    if (lost > count) lost = count;
+
+    time_t trigger_secs = rec->trigger_ts / 1000;
+    struct tm tm_info;
+    char stamp[32];
+    if (!localtime_r(&trigger_secs, &tm_info) ||
+        strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm_info) == 0) {
+        strcpy(stamp, "unknown");
+    }
+    if (snprintf(rec->last_dump, sizeof(rec->last_dump), "%s/memtrc-%d-%s-%d.dump", rec->dir,
+                 rec->pid, stamp, rec->dumps) >= (int)sizeof(rec->last_dump)) {
+        free(copy);
+        return -1;
+    }
+    FILE *fp = fopen(rec->last_dump, "w");
+    if (!fp) {
+        fprintf(stderr, "Can't open file %s: %s\n", rec->last_dump, strerror(errno));
+        free(copy);
+        return -1;
+    }
+
+    //'#' lines are skipped by analyze, so a dump can be analyzed like any log
+    unsigned long written = 0;
+    for (unsigned long i = lost; i < count; i++) {
+        if (copy[i].ts_ms <= until) written++;
+    }
+    fprintf(fp, "# memtrc flight recorder dump\n# pid: %d\n# reason: %s\n"
+            "# trigger: %lld ms\n# window: -%d ms .. +%d ms, %lu samples",
+            rec->pid, rec->reason, rec->trigger_ts, rec->pre_ms, rec->post_ms, written);
+    if (lost) fprintf(fp, ", %lu overwritten before the copy", lost);
+    fprintf(fp, "\n# smaps_rollup at trigger:\n");
+    for (const char *p = rollup; *p; ) {
+        const char *nl = strchr(p, '\n');
+        int len = nl ? (int)(nl - p) : (int)strlen(p);
+        fprintf(fp, "#   %.*s\n", len, p);
+        p += len + (nl ? 1 : 0);
+    }
+    for (unsigned long i = lost; i < count; i++) {
+        if (copy[i].ts_ms > until) break;
+        mem_info_t info = {
+            .vmsize = copy[i].vmsize,
+            .vmrss = copy[i].vmrss,
+            .vmdata = copy[i].vmdata,
+            .vmstk = copy[i].vmstk,
+            .proc_type = copy[i].proc_type
+        };
+        write_log_at(fp, copy[i].ts_ms, &info);
+    }
+    free(copy);
+    if (fclose(fp) != 0) {
+        fprintf(stderr, "Error writing %s: %s\n", rec->last_dump, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+
+static void *dumper_thread(void *arg) {
+    recorder_t *rec = (recorder_t *)arg;
+    char *rollup = malloc(RECORDER_ROLLUP_SIZE);
+    if (!rollup) return NULL;
+
+    while (1) {
+        while (sem_wait(&rec->wake) != 0 && errno == EINTR);
+        reap_hooks(rec);
+        if (__atomic_load_n(&rec->armed, __ATOMIC_ACQUIRE)) {
+            //woken by recorder_stop() with nothing pending
+            if (!__atomic_load_n(&rec->running, __ATOMIC_ACQUIRE)) break;
+            continue;
+        }
+
+        //snapshot first, it should describe the process at the trigger
+        read_rollup(rec->pid, rollup, RECORDER_ROLLUP_SIZE);
+
+        long long until = rec->trigger_ts + rec->post_ms;
+        while (__atomic_load_n(&rec->running, __ATOMIC_ACQUIRE)) {
+            unsigned long head = __atomic_load_n(&rec->head, __ATOMIC_ACQUIRE);
+            if (head > 0 && rec->ring[(head - 1) & (rec->cap - 1)].ts_ms >= until) break;
+            struct timespec ts = { 0, 10000000 };   //10ms
+            nanosleep(&ts, NULL);
+        }
+
+        int ok = write_dump(rec, rollup) == 0;
+        if (ok) {
+            printf("flight recorder: %s, dumped to %s\n", rec->reason, rec->last_dump);
+            if (rec->hook) run_hook(rec);
+        }
+        //re-arm before publishing the count, so whoever sees the dump can trigger the next
+        __atomic_store_n(&rec->armed, 1, __ATOMIC_RELEASE);
+        if (ok) __atomic_add_fetch(&rec->dumps, 1, __ATOMIC_RELEASE);
+        if (!__atomic_load_n(&rec->running, __ATOMIC_ACQUIRE)) break;
+    }
+    free(rollup);
+    return NULL;
+}
+
+
+//sample_ms is the fastest pace the sampler will push at, it sizes the ring
+int recorder_start(recorder_t *rec, int sample_ms) {
+    if (!rec || rec->started || sample_ms <= 0) return -1;
+    unsigned long need = 2UL * (rec->pre_ms + rec->post_ms) / sample_ms + 64;
+    rec->cap = 256;
+    while (rec->cap < need) rec->cap <<= 1;
+    rec->ring = malloc(rec->cap * sizeof(recorder_sample_t));
+    if (!rec->ring) {
+        fprintf(stderr, "Failed to allocate flight recorder ring\n");
+        return -1;
+    }
+    memset(rec->ring, 0, rec->cap * sizeof(recorder_sample_t));   //fault it in now
+    rec->head = 0;
+    rec->window_start = 0;
+    rec->above = 0;
+    rec->armed = 1;
+    rec->running = 1;
+    if (sem_init(&rec->wake, 0, 0) != 0) {
+        free(rec->ring);
+        rec->ring = NULL;
+        return -1;
+    }
+    if (pthread_create(&rec->thread, NULL, dumper_thread, rec) != 0) {
+        fprintf(stderr, "Failed to create dumper thread\n");
+        sem_destroy(&rec->wake);
+        free(rec->ring);
+        rec->ring = NULL;
+        return -1;
+    }
+    rec->started = 1;
+    return 0;
+}
+
+
+void recorder_push(recorder_t *rec, long long ts_ms, const mem_info_t *info) {
+    if (!rec || !rec->ring || !info) return;
+    unsigned long mask = rec->cap - 1;
+    unsigned long h = rec->head;
+    recorder_sample_t *s = &rec->ring[h & mask];
+    s->ts_ms = ts_ms;
+    s->vmsize = info->vmsize;
+    s->vmrss = info->vmrss;
+    s->vmdata = info->vmdata;
+    s->vmstk = info->vmstk;
+    s->proc_type = info->proc_type;
+    __atomic_store_n(&rec->head, h + 1, __ATOMIC_RELEASE);
+
+    char reason[sizeof(rec->reason)];
+    reason[0] = '\0';
+    //threshold is edge triggered, one dump per crossing
+    if (rec->threshold > 0) {
+        int above = info->vmrss >= rec->threshold;
+        if (above && !rec->above) {
+            snprintf(reason, sizeof(reason), "rss %ld MB crossed threshold %ld MB",
+                     info->vmrss >> 20, rec->threshold >> 20);
+        }
+        rec->above = above;
+    }
+    //growth compares against the oldest sample still inside growth_ms
+    if (rec->growth > 0) {
+        if (h - rec->window_start >= rec->cap - 1) rec->window_start = h - rec->cap + 2;
+        while (rec->window_start < h &&
+               rec->ring[rec->window_start & mask].ts_ms < ts_ms - rec->growth_ms) {
+            rec->window_start++;
+        }
+        long grown = info->vmrss - rec->ring[rec->window_start & mask].vmrss;
+        if (grown >= rec->growth) {
+            if (!reason[0]) {
+                snprintf(reason, sizeof(reason), "rss grew %ld MB in %lld ms", grown >> 20,
+                         ts_ms - rec->ring[rec->window_start & mask].ts_ms);
+            }
+            rec->window_start = h;  //growth has to build up again
+        }
+    }
+
+    int expected = 1;
+    if (reason[0] && __atomic_compare_exchange_n(&rec->armed, &expected, 0, 0,
+                                                 __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        rec->trigger_ts = ts_ms;
+        rec->trigger_idx = h;
+        memcpy(rec->reason, reason, sizeof(reason));
+        sem_post(&rec->wake);   //async signal safe and never blocks
+    }
+}
+
+
+//a pending dump is finished with the samples there are
+void recorder_stop(recorder_t *rec) {
+    if (!rec || !rec->started) return;
+    __atomic_store_n(&rec->running, 0, __ATOMIC_RELEASE);
+    sem_post(&rec->wake);
+    pthread_join(rec->thread, NULL);
+    reap_hooks(rec);
+    sem_destroy(&rec->wake);
+    rec->started = 0;
+}
+
+
+void recorder_free(recorder_t *rec) {
+    if (!rec) return;
+    recorder_stop(rec);
+    free(rec->ring);
+    free(rec->hook);
+    rec->ring = NULL;
+    rec->hook = NULL;
+}
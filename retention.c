@@ -0,0 +1,366 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-6-28 20:41:06
+ * @Last modified: 2025-6-28 20:41:06
+ * @Description: tiered retention store. every append writes one raw slot and
+ *               folds the sample into its minute and hour buckets, so rollups
+ *               are always current and the memory cost never grows. buckets are
+ *               direct mapped by period, a slot holding an older period is
+ *               simply overwritten.
+ */
+
+#include "include/memtrc.h"
+#include "include/retention.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+static void init_store(retain_store_t *st) {
+    memset(st, 0, sizeof(retain_store_t));
+    memcpy(st->magic, RETAIN_MAGIC, 4);
+    st->version = RETAIN_VERSION;
+    st->raw_cap = RETAIN_RAW_CAP;
+    st->minute_slots = RETAIN_MINUTE_SLOTS;
+    st->hour_slots = RETAIN_HOUR_SLOTS;
+    sketch_init(&st->rss_dist);
+    sketch_init(&st->vsz_dist);
+}
+
+
+static int valid_store(const retain_store_t *st) {
+    return memcmp(st->magic, RETAIN_MAGIC, 4) == 0 &&
+           st->version == RETAIN_VERSION &&
+           st->raw_cap == RETAIN_RAW_CAP &&
+           st->minute_slots == RETAIN_MINUTE_SLOTS &&
+           st->hour_slots == RETAIN_HOUR_SLOTS;
+}
+
+
+/**
+ * path NULL keeps the store in memory, otherwise it is mapped from path and reused
+ * if valid. a new or empty file becomes a store; a file that holds something else
+ * is refused unless reset is set, then it is started over.
+ */
+int retention_open(retention_t *r, const char *path, pid_t pid, int reset) {
+    if (!r) {
+        fprintf(stderr, "Error: Invalid arguments to retention_open()\n");
+        return -1;
+    }
+    r->st = NULL;
+    r->fd = -1;
+
+    if (!path) {
+        r->st = malloc(sizeof(retain_store_t));
+        if (!r->st) {
+            fprintf(stderr, "Error: Failed to allocate retention store\n");
+            return -1;
+        }
+        init_store(r->st);
+        r->st->pid = pid;
+        return 0;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open retention file %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    struct stat sb;
+    if (fstat(fd, &sb) != 0) {
+        fprintf(stderr, "Failed to stat retention file %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    //a store has exactly this size, anything else is checked before it is resized
+    int other = sb.st_size > 0 && (size_t)sb.st_size != sizeof(retain_store_t);
+    if (other && !reset) {
+        fprintf(stderr, "Error: %s is not a retention file of this layout\n", path);
+        close(fd);
+        return -1;
+    }
+    if ((size_t)sb.st_size != sizeof(retain_store_t) && ftruncate(fd, sizeof(retain_store_t)) != 0) {
+        fprintf(stderr, "Failed to size retention file %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, sizeof(retain_store_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Failed to map retention file %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    if (!other && sb.st_size > 0 && !valid_store(map)) {
+        if (!reset) {
+            fprintf(stderr, "Error: %s is not a retention file of this layout\n", path);
+            munmap(map, sizeof(retain_store_t));
+            close(fd);
+            return -1;
+        }
+        other = 1;
+    }
+    r->st = map;
+    r->fd = fd;
+    if (sb.st_size == 0 || other) {
+        if (other) fprintf(stderr, "Warning: %s is not a retention file of this layout, starting over\n", path);
+        init_store(r->st);
+    }
+    if (pid > 0) r->st->pid = pid;
+    return 0;
+}
+
+
+//1 if path starts with a retention header, so queries never reset other files
+int retention_is_store(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return 0;
+    char magic[4];
+    int ok = fread(magic, 1, 4, fp) == 4 && memcmp(magic, RETAIN_MAGIC, 4) == 0;
+    fclose(fp);
+    return ok;
+}
+
+
+static void fold(retain_bucket_t *b, long long start, const long *vals) {
+    if (b->start_ms != start || b->count == 0) {
+        b->start_ms = start;
+        b->count = 0;
+        for (int c = 0; c < RETAIN_COLS; c++) {
+            b->min[c] = b->max[c] = vals[c];
+            b->sum[c] = 0;
+        }
+    }
+    b->count++;
+    for (int c = 0; c < RETAIN_COLS; c++) {
+        if (vals[c] < b->min[c]) b->min[c] = vals[c];
+        if (vals[c] > b->max[c]) b->max[c] = vals[c];
+        b->sum[c] += vals[c];
+    }
+}
+
+
+//vals holds RETAIN_COLS values, VSZ/RSS/Data/Stack
+void retention_append(retention_t *r, long long ts_ms, const long *vals) {
+    if (!r || !r->st || !vals || ts_ms < 0) return;
+    retain_store_t *st = r->st;
+
+    retain_raw_t *e = &st->raw[st->raw_head % RETAIN_RAW_CAP];
+    e->ts_ms = ts_ms;
+    for (int c = 0; c < RETAIN_COLS; c++) e->v[c] = vals[c];
+    st->raw_head++;     //after the slot, a crash mid append loses only this sample
+
+    long long minute = ts_ms / RETAIN_MINUTE_MS;
+    long long hour = ts_ms / RETAIN_HOUR_MS;
+    fold(&st->minutes[minute % RETAIN_MINUTE_SLOTS], minute * RETAIN_MINUTE_MS, vals);
+    fold(&st->hours[hour % RETAIN_HOUR_SLOTS], hour * RETAIN_HOUR_MS, vals);
+    sketch_add(&st->vsz_dist, vals[0]);
+    sketch_add(&st->rss_dist, vals[1]);
+    if (ts_ms > st->newest_ms) st->newest_ms = ts_ms;
+}
+
+
+static void merge(retain_bucket_t *dst, const retain_bucket_t *src) {
+    if (dst->count == 0) {
+        *dst = *src;
+        return;
+    }
+    dst->count += src->count;
+    for (int c = 0; c < RETAIN_COLS; c++) {
+        if (src->min[c] < dst->min[c]) dst->min[c] = src->min[c];
+        if (src->max[c] > dst->max[c]) dst->max[c] = src->max[c];
+        dst->sum[c] += src->sum[c];
+    }
+}
+
+
+//rollups of [from, to] from one tier, in time order
+static size_t collect_tier(const retain_bucket_t *tier, int slots, long long period,
+                           long long from_ms, long long to_ms, retain_bucket_t *out) {
+    size_t n = 0;
+    for (long long p = from_ms / period; p <= to_ms / period; p++) {
+        const retain_bucket_t *b = &tier[p % slots];
+        if (b->count > 0 && b->start_ms == p * period) out[n++] = *b;
+    }
+    return n;
+}
+
+
+/*
+ * points of [from_ms, to_ms] at the finest tier still covering from_ms: raw
+ * samples, then minutes, then hours. with max_points > 0 neighbours are merged
+ * into at most that many equal time buckets, keeping their min/max, so peaks
+ * survive. *out is malloc'd, returns the number of points or -1.
+ */
+int retention_query(const retention_t *r, long long from_ms, long long to_ms,
+                     int max_points, retain_point_t **out, long long *res_ms) {
+    if (!r || !r->st || !out || to_ms < from_ms || max_points < 0) {
+        fprintf(stderr, "Error: Invalid arguments to retention_query()\n");
+        return -1;
+    }
+    const retain_store_t *st = r->st;
+    *out = NULL;
+
+    uint64_t raw_n = st->raw_head < RETAIN_RAW_CAP ? st->raw_head : RETAIN_RAW_CAP;
+    uint64_t raw_first = st->raw_head - raw_n;
+    long long minute_first = (st->newest_ms / RETAIN_MINUTE_MS - (RETAIN_MINUTE_SLOTS - 1)) * RETAIN_MINUTE_MS;
+    long long hour_first = (st->newest_ms / RETAIN_HOUR_MS - (RETAIN_HOUR_SLOTS - 1)) * RETAIN_HOUR_MS;
+    if (to_ms > st->newest_ms) to_ms = st->newest_ms;
+    if (from_ms < hour_first) from_ms = hour_first;
+    if (to_ms < from_ms) {
+        *out = malloc(sizeof(retain_point_t));
+        if (res_ms) *res_ms = 0;
+        return *out ? 0 : -1;
+    }
+
+    retain_bucket_t *buf;
+    size_t n = 0;
+    long long res;
+    //a ring that never wrapped holds everything there is at full resolution
+    if (raw_n > 0 && (st->raw_head <= RETAIN_RAW_CAP ||
+                      from_ms >= st->raw[raw_first % RETAIN_RAW_CAP].ts_ms)) {
+        res = 0;
+        buf = malloc(raw_n * sizeof(retain_bucket_t));
+        for (uint64_t i = raw_first; buf && i < st->raw_head; i++) {
+            const retain_raw_t *e = &st->raw[i % RETAIN_RAW_CAP];
+            if (e->ts_ms < from_ms || e->ts_ms > to_ms) continue;
+            buf[n].start_ms = e->ts_ms;
+            buf[n].count = 1;
+            for (int c = 0; c < RETAIN_COLS; c++) {
+                buf[n].min[c] = buf[n].max[c] = buf[n].sum[c] = e->v[c];
+            }
+            n++;
+        }
+    } else if (from_ms >= minute_first) {
+        res = RETAIN_MINUTE_MS;
+        buf = malloc(RETAIN_MINUTE_SLOTS * sizeof(retain_bucket_t));
+        if (buf) n = collect_tier(st->minutes, RETAIN_MINUTE_SLOTS, res, from_ms, to_ms, buf);
+    } else {
+        res = RETAIN_HOUR_MS;
+        buf = malloc(RETAIN_HOUR_SLOTS * sizeof(retain_bucket_t));
+        if (buf) n = collect_tier(st->hours, RETAIN_HOUR_SLOTS, res, from_ms, to_ms, buf);
+    }
+    if (!buf) {
+        fprintf(stderr, "Error: Failed to allocate query buffer\n");
+        return -1;
+    }
+    if (res_ms) *res_ms = res;
+
+    //fold neighbours in place, bucket index only ever grows with time
+    if (max_points > 0 && n > (size_t)max_points) {
+        long long span = to_ms - from_ms + 1;
+        size_t m = 0;
+        long last = -1;
+        for (size_t i = 0; i < n; i++) {
+            long idx = buf[i].start_ms > from_ms ?
+                       (long)((buf[i].start_ms - from_ms) * max_points / span) : 0;
+            if (idx != last) {
+                buf[m++] = buf[i];
+                last = idx;
+            } else {
+                merge(&buf[m - 1], &buf[i]);
+            }
+        }
+        n = m;
+    }
+
+    retain_point_t *pts = malloc((n ? n : 1) * sizeof(retain_point_t));
+    if (!pts) {
+        fprintf(stderr, "Error: Failed to allocate query result\n");
+        free(buf);
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        pts[i].ts_ms = buf[i].start_ms;
+        pts[i].count = buf[i].count;
+        for (int c = 0; c < RETAIN_COLS; c++) {
+            pts[i].min[c] = buf[i].min[c];
+            pts[i].max[c] = buf[i].max[c];
+            pts[i].avg[c] = buf[i].sum[c] / buf[i].count;
+        }
+    }
+    free(buf);
+    *out = pts;
+    return (int)n;
+}
+
+
+//native resolution rows of [from_ms, to_ms] as csv, or json lines
+int retention_export(const retention_t *r, FILE *fp, long long from_ms, long long to_ms, int json) {
+    static const char *names[RETAIN_COLS] = { "vsz", "rss", "data", "stack" };
+    retain_point_t *pts;
+    long long res;
+    int n = retention_query(r, from_ms, to_ms, 0, &pts, &res);
+    if (n < 0) return -1;
+
+    if (!json) {
+        fprintf(fp, "ts_ms,resolution_ms,count");
+        for (int c = 0; c < RETAIN_COLS; c++) {
+            fprintf(fp, ",%s_min,%s_max,%s_avg", names[c], names[c], names[c]);
+        }
+        fputc('\n', fp);
+    }
+    for (int i = 0; i < n; i++) {
+        const retain_point_t *p = &pts[i];
+        if (json) {
+            fprintf(fp, "{\"ts_ms\":%lld,\"resolution_ms\":%lld,\"count\":%ld", p->ts_ms, res, p->count);
+            for (int c = 0; c < RETAIN_COLS; c++) {
+                fprintf(fp, ",\"%s\":{\"min\":%ld,\"max\":%ld,\"avg\":%ld}",
+                        names[c], p->min[c], p->max[c], p->avg[c]);
+            }
+            fprintf(fp, "}\n");
+        } else {
+            fprintf(fp, "%lld,%lld,%ld", p->ts_ms, res, p->count);
+            for (int c = 0; c < RETAIN_COLS; c++) {
+                fprintf(fp, ",%ld,%ld,%ld", p->min[c], p->max[c], p->avg[c]);
+            }
+            fputc('\n', fp);
+        }
+    }
+    free(pts);
+
+    //quantiles of everything retained, a trailing object or csv comment lines
+    const sketch_t *dist[2] = { &r->st->vsz_dist, &r->st->rss_dist };
+    if (json) fprintf(fp, "{\"quantiles\":true,\"count\":%llu", (unsigned long long)dist[1]->count);
+    for (int c = 0; c < 2 && dist[1]->count > 0; c++) {
+        long q[4] = { sketch_quantile(dist[c], 0.50), sketch_quantile(dist[c], 0.95),
+                      sketch_quantile(dist[c], 0.99), (long)dist[c]->max };
+        if (json) {
+            fprintf(fp, ",\"%s\":{\"p50\":%ld,\"p95\":%ld,\"p99\":%ld,\"max\":%ld}",
+                    names[c], q[0], q[1], q[2], q[3]);
+        } else {
+            fprintf(fp, "# %s p50 %ld p95 %ld p99 %ld max %ld\n", names[c], q[0], q[1], q[2], q[3]);
+        }
+    }
+    if (json) fprintf(fp, "}\n");
+    return ferror(fp) ? -1 : n;
+}
+
+
+void retention_close(retention_t *r) {
+    if (!r || !r->st) return;
+    if (r->fd >= 0) {
+        msync(r->st, sizeof(retain_store_t), MS_SYNC);
+        munmap(r->st, sizeof(retain_store_t));
+        close(r->fd);
+    } else {
+        free(r->st);
+    }
+    r->st = NULL;
+    r->fd = -1;
+}
+
+
+//"90", "90s", "15m", "6h", "7d" to milliseconds, -1 if malformed
+long long parse_span(const char *s) {
+    if (!s) return -1;
+    char *end;
+    long long v = strtoll(s, &end, 10);
+    if (end == s || v <= 0) return -1;
+    long long unit = 1000;
+    if (*end == 'm') unit = RETAIN_MINUTE_MS;
+    else if (*end == 'h') unit = RETAIN_HOUR_MS;
+    else if (*end == 'd') unit = 24 * RETAIN_HOUR_MS;
+    else if (*end != 's' && *end != '\0') return -1;
+    if (*end && end[1] != '\0') return -1;
+    return v * unit;
+}
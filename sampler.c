@@ -0,0 +1,412 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-6-18 19:42:30
+ * @Last modified: 2025-6-18 19:42:30
+ * @Description: batched sampler. the pread backend costs one syscall per target
+ *               per tick; the io_uring backend registers the status fds and one
+ *               buffer area, then submits and reaps SAMPLER_RING_DEPTH reads per
+ *               io_uring_enter. io_uring is driven with raw syscalls, there is
+ *               no liburing dependency, and any setup failure falls back to pread.
+ */
+
+#define _DEFAULT_SOURCE     //syscall(), MAP_POPULATE and MAP_ANONYMOUS, before any header
+#include "include/memtrc.h"
+#include "include/sampler.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#if defined(__NR_io_uring_setup) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define SAMPLER_HAVE_URING 1
+#endif
+#endif
+
+
+int parse_status_buffer(const char *buf, size_t len, mem_info_t *info) {
+    const char *p = buf, *end = buf + len;
+    int found = 0;
+    //kernel threads report raw values like read_kernel_proc_mem_info(), users in bytes
+    long scale = info->proc_type == PROC_TYPE_KERNEL ? 1 : KB_UNIT;
+
+    info->vmsize = info->vmrss = info->vmdata = info->vmstk = 0;
+    while (p < end && found < 4) {
+        const char *nl = memchr(p, '\n', end - p);
+        if (!nl) nl = end;
+        if (nl - p > 7 && p[0] == 'V' && p[1] == 'm') {
+            long *field = NULL;
+            if (strncmp(p, "VmSize:", 7) == 0) field = &info->vmsize;
+            else if (strncmp(p, "VmRSS:", 6) == 0) field = &info->vmrss;
+            else if (strncmp(p, "VmData:", 7) == 0) field = &info->vmdata;
+            else if (strncmp(p, "VmStk:", 6) == 0) field = &info->vmstk;
+            if (field) {
+                const char *q = memchr(p, ':', nl - p) + 1;
+                long v = 0;
+                while (q < nl && (*q == ' ' || *q == '\t')) q++;
+                while (q < nl && *q >= '0' && *q <= '9') v = v * 10 + (*q++ - '0');
+                *field = v * scale;
+                found++;
+            }
+        }
+        p = nl + 1;
+    }
+    if (info->proc_type == PROC_TYPE_KERNEL) {
+        if (info->vmsize == 0) info->vmsize = -1;
+        if (info->vmrss == 0) info->vmrss = -1;
+        if (info->vmdata == 0) info->vmdata = -1;
+        if (info->vmstk == 0) info->vmstk = -1;
+    }
+    return found;
+}
+
+
+const char *sampler_backend_name(sampler_backend_t backend) {
+    switch (backend) {
+        case SAMPLER_PREAD: return "pread";
+        case SAMPLER_URING: return "io_uring";
+        case SAMPLER_AUTO:
+        default: return "auto";
+    }
+}
+
+
+#ifdef SAMPLER_HAVE_URING
+
+struct sampler_ring {
+    int fd;
+    unsigned entries;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr, *cq_ptr;
+    size_t sq_size, cq_size;
+    int fixed_bufs;         //buffer area registered, READ_FIXED usable
+    int fixed_files;        //fd table registered, IOSQE_FIXED_FILE usable
+};
+
+
+static int ring_enter(int fd, unsigned submit, unsigned wait) {
+    int ret;
+    do {
+        ret = (int)syscall(__NR_io_uring_enter, fd, submit, wait,
+                           wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    } while (ret < 0 && errno == EINTR);
+    return ret;
+}
+
+
+static void ring_free(struct sampler_ring *r) {
+    if (!r) return;
+    if (r->sqes) munmap(r->sqes, r->entries * sizeof(struct io_uring_sqe));
+    if (r->cq_ptr && r->cq_ptr != r->sq_ptr) munmap(r->cq_ptr, r->cq_size);
+    if (r->sq_ptr) munmap(r->sq_ptr, r->sq_size);
+    if (r->fd >= 0) close(r->fd);
+    free(r);
+}
+
+
+static struct sampler_ring *ring_create(unsigned entries, void *bufs, size_t bufs_size) {
+    struct io_uring_params p;
+    struct sampler_ring *r = calloc(1, sizeof(struct sampler_ring));
+    if (!r) return NULL;
+    memset(&p, 0, sizeof(p));
+    r->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0) {
+        free(r);
+        return NULL;
+    }
+    r->entries = p.sq_entries;
+    r->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cq_size > r->sq_size) r->sq_size = r->cq_size;
+        r->cq_size = r->sq_size;
+    }
+
+    r->sq_ptr = mmap(NULL, r->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ptr == MAP_FAILED) {
+        r->sq_ptr = NULL;
+        goto fail;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_ptr = r->sq_ptr;
+    } else {
+        r->cq_ptr = mmap(NULL, r->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_ptr == MAP_FAILED) {
+            r->cq_ptr = NULL;
+            goto fail;
+        }
+    }
+    r->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        r->sqes = NULL;
+        goto fail;
+    }
+
+    char *sq = r->sq_ptr, *cq = r->cq_ptr;
+    r->sq_head = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    //fixed buffers need locked memory, plain reads still batch without them
+    struct iovec iov = { bufs, bufs_size };
+    r->fixed_bufs = syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_BUFFERS, &iov, 1) == 0;
+    return r;
+
+fail:
+    ring_free(r);
+    return NULL;
+}
+
+
+static void ring_register_files(sampler_t *s) {
+    struct sampler_ring *r = s->ring;
+    if (r->fixed_files) {
+        syscall(__NR_io_uring_register, r->fd, IORING_UNREGISTER_FILES, NULL, 0);
+        r->fixed_files = 0;
+    }
+    s->files_dirty = 0;
+    if (s->count == 0) return;
+    int *fds = malloc(s->count * sizeof(int));
+    if (!fds) return;
+    for (int i = 0; i < s->count; i++) fds[i] = s->targets[i].fd;   //-1 leaves a hole
+    r->fixed_files = syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_FILES,
+                             fds, s->count) == 0;
+    free(fds);
+}
+
+#endif
+
+
+//procfs answers a read on the fd of a reaped process with ESRCH or 0 bytes
+static void finish_read(sampler_t *s, sampler_target_t *t, const char *buf, long n) {
+    if (n <= 0) {
+        close(t->fd);
+        t->fd = -1;
+        t->info.vmsize = t->info.vmrss = t->info.vmdata = t->info.vmstk = -1;
+        proc_type_cache_forget(t->pid);
+        s->files_dirty = 1;
+        return;
+    }
+    parse_status_buffer(buf, n, &t->info);
+    s->alive++;
+}
+
+
+static int tick_pread(sampler_t *s) {
+    for (int i = 0; i < s->count; i++) {
+        sampler_target_t *t = &s->targets[i];
+        if (t->fd < 0) continue;
+        ssize_t n = pread(t->fd, s->bufs, SAMPLER_BUF_SIZE, 0);
+        s->syscalls++;
+        finish_read(s, t, s->bufs, n);
+    }
+    return 0;
+}
+
+
+#ifdef SAMPLER_HAVE_URING
+static int tick_uring(sampler_t *s) {
+    struct sampler_ring *r = s->ring;
+    if (s->files_dirty) ring_register_files(s);
+
+    int next = 0;
+    while (next < s->count) {
+        //fill one batch, slot i of the batch reads into buffer i
+        unsigned mask = *r->sq_mask;
+        unsigned tail = *r->sq_tail;
+        unsigned batch = 0;
+        for (; next < s->count && batch < r->entries && batch < SAMPLER_RING_DEPTH; next++) {
+            sampler_target_t *t = &s->targets[next];
+            if (t->fd < 0) continue;
+            struct io_uring_sqe *sqe = &r->sqes[tail & mask];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = r->fixed_bufs ? IORING_OP_READ_FIXED : IORING_OP_READ;
+            if (r->fixed_files) {
+                sqe->fd = next;
+                sqe->flags = IOSQE_FIXED_FILE;
+            } else {
+                sqe->fd = t->fd;
+            }
+            sqe->addr = (unsigned long)(s->bufs + (size_t)batch * SAMPLER_BUF_SIZE);
+            sqe->len = SAMPLER_BUF_SIZE;
+            sqe->off = 0;
+            sqe->buf_index = 0;
+            sqe->user_data = ((unsigned long long)batch << 32) | (unsigned)next;
+            r->sq_array[tail & mask] = tail & mask;
+            tail++;
+            batch++;
+        }
+        if (batch == 0) break;
+        __atomic_store_n(r->sq_tail, tail, __ATOMIC_RELEASE);
+
+        //submit and wait in one call, then reap whatever is still missing
+        unsigned done = 0;
+        int ret = ring_enter(r->fd, batch, batch);
+        s->syscalls++;
+        if (ret < 0) {
+            fprintf(stderr, "io_uring_enter failed: %s\n", strerror(errno));
+            return -1;
+        }
+        while (done < batch) {
+            unsigned head = *r->cq_head;
+            unsigned cq_tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+            if (head == cq_tail) {
+                if (ring_enter(r->fd, 0, batch - done) < 0) {
+                    fprintf(stderr, "io_uring_enter failed: %s\n", strerror(errno));
+                    return -1;
+                }
+                s->syscalls++;
+                continue;
+            }
+            for (; head != cq_tail; head++, done++) {
+                struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+                unsigned slot = (unsigned)(cqe->user_data >> 32);
+                int idx = (int)(cqe->user_data & 0xffffffffu);
+                finish_read(s, &s->targets[idx], s->bufs + (size_t)slot * SAMPLER_BUF_SIZE,
+                            cqe->res);
+            }
+            __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+        }
+    }
+    return 0;
+}
+#endif
+
+
+int sampler_init(sampler_t *s, sampler_backend_t backend) {
+    if (!s) return -1;
+    memset(s, 0, sizeof(sampler_t));
+    size_t bufs_size = (size_t)SAMPLER_RING_DEPTH * SAMPLER_BUF_SIZE;
+    s->bufs = mmap(NULL, bufs_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (s->bufs == MAP_FAILED) {
+        s->bufs = NULL;
+        fprintf(stderr, "Failed to allocate sampler buffers\n");
+        return -1;
+    }
+
+    s->backend = SAMPLER_PREAD;
+    if (backend != SAMPLER_PREAD) {
+#ifdef SAMPLER_HAVE_URING
+        s->ring = ring_create(SAMPLER_RING_DEPTH, s->bufs, bufs_size);
+#endif
+        if (s->ring) {
+            s->backend = SAMPLER_URING;
+        } else if (backend == SAMPLER_URING) {
+            fprintf(stderr, "Warning: io_uring unavailable (%s), using pread\n", strerror(errno));
+        }
+    }
+    return 0;
+}
+
+
+//one fd per target, ask for a larger fd budget when the soft limit is hit
+static int raise_fd_limit(int wanted) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0) return -1;
+    rlim_t target = (rlim_t)wanted * 2;
+    if (rl.rlim_max != RLIM_INFINITY && rl.rlim_max < target) {
+        struct rlimit raised = { target, target };
+        if (setrlimit(RLIMIT_NOFILE, &raised) == 0) return 0;   //needs CAP_SYS_RESOURCE
+        target = rl.rlim_max;
+    }
+    if (rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur >= target) return -1;
+    rl.rlim_cur = target;
+    return setrlimit(RLIMIT_NOFILE, &rl);
+}
+
+
+int sampler_add(sampler_t *s, pid_t pid) {
+    char path[PATH_MAX];
+    if (!s || pid <= 0 || proc_path(path, sizeof(path), pid, "status") != 0) {
+        return -1;
+    }
+    if (s->count == s->cap) {
+        int cap = s->cap ? s->cap * 2 : 64;
+        sampler_target_t *targets = realloc(s->targets, cap * sizeof(sampler_target_t));
+        if (!targets) {
+            fprintf(stderr, "Failed to grow sampler targets\n");
+            return -1;
+        }
+        s->targets = targets;
+        s->cap = cap;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    int err = errno;
+    if (fd < 0 && err == EMFILE && raise_fd_limit(s->count + 64) == 0) {
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        err = errno;
+    }
+    if (fd < 0) {
+        fprintf(stderr, "Can't open file %s: %s\n", path, strerror(err));
+        return -1;
+    }
+
+    sampler_target_t *t = &s->targets[s->count++];
+    memset(t, 0, sizeof(sampler_target_t));
+    t->pid = pid;
+    t->fd = fd;
+    t->info.proc_type = get_process_type(pid);
+    s->files_dirty = 1;
+    return 0;
+}
+
+
+//stop sampling pid, the last target takes its slot
+int sampler_remove(sampler_t *s, pid_t pid) {
+    if (!s) return -1;
+    for (int i = 0; i < s->count; i++) {
+        if (s->targets[i].pid != pid) continue;
+        if (s->targets[i].fd >= 0) close(s->targets[i].fd);
+        s->targets[i] = s->targets[--s->count];
+        s->files_dirty = 1;
+        return 0;
+    }
+    return -1;
+}
+
+
+//read every live target once, returns how many answered
+int sampler_tick(sampler_t *s) {
+    if (!s) return -1;
+    s->alive = 0;
+    int ret;
+#ifdef SAMPLER_HAVE_URING
+    if (s->ring) {
+        ret = tick_uring(s);
+    } else
+#endif
+    {
+        ret = tick_pread(s);
+    }
+    s->ticks++;
+    return ret == 0 ? s->alive : -1;
+}
+
+
+void sampler_free(sampler_t *s) {
+    if (!s) return;
+#ifdef SAMPLER_HAVE_URING
+    ring_free(s->ring);     //drops the registered files before they are closed
+#endif
+    s->ring = NULL;
+    for (int i = 0; i < s->count; i++) {
+        if (s->targets[i].fd >= 0) close(s->targets[i].fd);
+    }
+    free(s->targets);
+    if (s->bufs) munmap(s->bufs, (size_t)SAMPLER_RING_DEPTH * SAMPLER_BUF_SIZE);
+    memset(s, 0, sizeof(sampler_t));
+}
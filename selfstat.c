@@ -0,0 +1,240 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-6-3 20:15:47
+ * @Last modified: 2025-6-3 20:15:47
+ * @Description: self instrumentation of the sampling path. each thread owns its
+ *               counters, so recording is two clock reads and a few plain stores;
+ *               the lock is only taken when a thread registers or on snapshot.
+ */
+
+#include "include/memtrc.h"
+#include "include/selfstat.h"
+#include "include/libmemtrc.h"
+#include <fcntl.h>
+#include <sys/resource.h>
+
+
+typedef struct thread_probes {
+    probe_counter_t probes[PROBE_COUNT];
+    int retired;                //owner exited, block may be adopted
+    struct thread_probes *next;
+} thread_probes_t;
+
+static const char *probe_names[PROBE_COUNT] = {
+    "proc_type", "read_mem", "render", "log", "tick"
+};
+
+static thread_probes_t *all_threads = NULL;
+static pthread_mutex_t threads_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t probes_key;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static __thread thread_probes_t *local_probes = NULL;
+
+
+//thread exit: keep the counts (they are cumulative) but let a new thread adopt the block
+static void retire_probes(void *arg) {
+    thread_probes_t *tp = (thread_probes_t *)arg;
+    pthread_mutex_lock(&threads_lock);
+    tp->retired = 1;
+    pthread_mutex_unlock(&threads_lock);
+}
+
+
+static void make_probes_key(void) {
+    pthread_key_create(&probes_key, retire_probes);
+}
+
+
+static thread_probes_t *register_thread(void) {
+    pthread_once(&key_once, make_probes_key);
+
+    pthread_mutex_lock(&threads_lock);
+    thread_probes_t *tp = all_threads;
+    while (tp && !tp->retired) tp = tp->next;
+    if (tp) {
+        tp->retired = 0;
+    } else {
+        tp = calloc(1, sizeof(thread_probes_t));
+        if (tp) {
+            tp->next = all_threads;
+            all_threads = tp;
+        }
+    }
+    pthread_mutex_unlock(&threads_lock);
+
+    if (tp) {
+        pthread_setspecific(probes_key, tp);
+    }
+    local_probes = tp;
+    return tp;
+}
+
+
+uint64_t selfstat_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+//relaxed stores, the owner is the only writer and snapshots tolerate a torn update
+#define PROBE_ADD(field, v) \
+    __atomic_store_n(&(field), (field) + (v), __ATOMIC_RELAXED)
+
+void selfstat_record(probe_t probe, uint64_t start_ns) {
+    thread_probes_t *tp = local_probes ? local_probes : register_thread();
+    if (!tp || probe >= PROBE_COUNT) return;
+
+    uint64_t ns = selfstat_now() - start_ns;
+    int bucket = ns ? 64 - __builtin_clzll(ns) : 0;
+    if (bucket >= PROBE_BUCKETS) bucket = PROBE_BUCKETS - 1;
+
+    probe_counter_t *c = &tp->probes[probe];
+    PROBE_ADD(c->count, 1);
+    PROBE_ADD(c->total_ns, ns);
+    PROBE_ADD(c->hist[bucket], 1);
+    if (ns > c->max_ns) {
+        __atomic_store_n(&c->max_ns, ns, __ATOMIC_RELAXED);
+    }
+}
+
+
+static uint64_t read_syscall_count(void) {
+    char line[BUF_SIZE];
+    uint64_t total = 0;
+    FILE *fp = fopen("/proc/self/io", "r");
+    if (!fp) return 0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "syscr:", 6) == 0 || strncmp(line, "syscw:", 6) == 0) {
+            total += strtoull(line + 6, NULL, 10);
+        }
+    }
+    fclose(fp);
+    return total;
+}
+
+
+static long read_self_rss_kb(void) {
+    memtrc_sample_t s;
+    int fd = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    int ret = memtrc_read_statm(fd, sysconf(_SC_PAGESIZE) / KB_UNIT, &s);
+    close(fd);
+    return ret == 0 ? s.rss_kb : 0;
+}
+
+
+void selfstat_snapshot(selfstat_snapshot_t *snap) {
+    if (!snap) return;
+    memset(snap, 0, sizeof(selfstat_snapshot_t));
+
+    pthread_mutex_lock(&threads_lock);
+    for (thread_probes_t *tp = all_threads; tp; tp = tp->next) {
+        for (int p = 0; p < PROBE_COUNT; p++) {
+            const probe_counter_t *src = &tp->probes[p];
+            probe_counter_t *dst = &snap->probes[p];
+            dst->count += __atomic_load_n(&src->count, __ATOMIC_RELAXED);
+            dst->total_ns += __atomic_load_n(&src->total_ns, __ATOMIC_RELAXED);
+            uint64_t max_ns = __atomic_load_n(&src->max_ns, __ATOMIC_RELAXED);
+            if (max_ns > dst->max_ns) dst->max_ns = max_ns;
+            for (int b = 0; b < PROBE_BUCKETS; b++) {
+                dst->hist[b] += __atomic_load_n(&src->hist[b], __ATOMIC_RELAXED);
+            }
+        }
+    }
+    pthread_mutex_unlock(&threads_lock);
+
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+        snap->cpu_user = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6;
+        snap->cpu_sys = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+        snap->maxrss_kb = ru.ru_maxrss;
+    }
+    snap->rss_kb = read_self_rss_kb();
+    snap->syscalls = read_syscall_count();
+}
+
+
+//counters of end minus start, max and rss keep the end values
+void selfstat_diff(const selfstat_snapshot_t *end, const selfstat_snapshot_t *start,
+        selfstat_snapshot_t *out) {
+    if (!end || !start || !out) return;
+    *out = *end;
+    for (int p = 0; p < PROBE_COUNT; p++) {
+        out->probes[p].count -= start->probes[p].count;
+        out->probes[p].total_ns -= start->probes[p].total_ns;
+        for (int b = 0; b < PROBE_BUCKETS; b++) {
+            out->probes[p].hist[b] -= start->probes[p].hist[b];
+        }
+    }
+    out->cpu_user -= start->cpu_user;
+    out->cpu_sys -= start->cpu_sys;
+    out->syscalls -= start->syscalls;
+}
+
+
+//upper bound of the histogram bucket holding the pct-th percentile, in ns
+uint64_t selfstat_percentile(const probe_counter_t *c, int pct) {
+    if (!c || c->count == 0) return 0;
+    uint64_t rank = (c->count * pct + 99) / 100;
+    uint64_t seen = 0;
+    for (int b = 0; b < PROBE_BUCKETS; b++) {
+        seen += c->hist[b];
+        if (seen >= rank && seen > 0) {
+            uint64_t bound = b ? (1ULL << b) - 1 : 0;
+            return bound < c->max_ns ? bound : c->max_ns;
+        }
+    }
+    return c->max_ns;
+}
+
+
+void selfstat_print(FILE *fp, const selfstat_snapshot_t *snap) {
+    if (!fp || !snap) return;
+    fprintf(fp, "==== memtrc self statistics ====\n");
+    fprintf(fp, "%-10s %10s %10s %10s %10s %10s\n",
+            "probe", "calls", "mean(us)", "p50(us)", "p99(us)", "max(us)");
+    for (int p = 0; p < PROBE_COUNT; p++) {
+        const probe_counter_t *c = &snap->probes[p];
+        fprintf(fp, "%-10s %10llu %10.1f %10.1f %10.1f %10.1f\n",
+                probe_names[p], (unsigned long long)c->count,
+                c->count ? c->total_ns / 1e3 / c->count : 0.0,
+                selfstat_percentile(c, 50) / 1e3,
+                selfstat_percentile(c, 99) / 1e3,
+                c->max_ns / 1e3);
+    }
+
+    uint64_t ticks = snap->probes[PROBE_TICK].count;
+    double cpu = snap->cpu_user + snap->cpu_sys;
+    fprintf(fp, "cpu: user %.3f s, sys %.3f s", snap->cpu_user, snap->cpu_sys);
+    if (ticks) fprintf(fp, ", %.1f us per tick", cpu * 1e6 / ticks);
+    fprintf(fp, "\nrss: %ld KB (peak %ld KB)\n", snap->rss_kb, snap->maxrss_kb);
+    fprintf(fp, "read/write syscalls: %llu", (unsigned long long)snap->syscalls);
+    if (ticks) fprintf(fp, " (%.1f per tick)", (double)snap->syscalls / ticks);
+    fprintf(fp, "\n=====================\n");
+}
+
+
+//one line summary in the log, analyze skips it since it has no "type:" tag
+void selfstat_log(FILE *fp, const selfstat_snapshot_t *snap) {
+    if (!fp || !snap) return;
+    time_t now = time(NULL);
+    struct tm tm_info;
+    char time_str[30];
+    if (!localtime_r(&now, &tm_info) ||
+        strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", &tm_info) == 0) {
+        return;
+    }
+
+    const probe_counter_t *tick = &snap->probes[PROBE_TICK];
+    uint64_t ticks = tick->count;
+    fprintf(fp, "[%s] stats: ticks %llu, tick mean %.1f us, tick p99 %.1f us, "
+            "read p99 %.1f us, cpu %.1f ms, rss %ld KB, syscalls/tick %.1f\n",
+            time_str, (unsigned long long)ticks,
+            ticks ? tick->total_ns / 1e3 / ticks : 0.0,
+            selfstat_percentile(tick, 99) / 1e3,
+            selfstat_percentile(&snap->probes[PROBE_READ_MEM], 99) / 1e3,
+            (snap->cpu_user + snap->cpu_sys) * 1e3, snap->rss_kb,
+            ticks ? (double)snap->syscalls / ticks : 0.0);
+    fflush(fp);
+}
@@ -0,0 +1,243 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-7-21 21:14:09
+ * @Last modified: 2025-7-21 21:14:09
+ * @Description: csv / json lines sink. integers go out two digits at a time
+ *               from a table, the date is cached per second, rows are
+ *               appended to a block buffer and written with raw write() calls.
+ *               values are real KB here, unlike the text log.
+ */
+#include "include/memtrc.h"
+#include "include/sink.h"
+#include <fcntl.h>
+
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+
+//decimal of v at p, returns the end. no terminator
+char *sink_put_long(char *p, long v) {
+    unsigned long u = v < 0 ? 0UL - (unsigned long)v : (unsigned long)v;
+    if (v < 0) *p++ = '-';
+    char tmp[24];
+    char *t = tmp + sizeof(tmp);
+    while (u >= 100) {
+        const char *d = &digit_pairs[(u % 100) * 2];
+        u /= 100;
+        *--t = d[1];
+        *--t = d[0];
+    }
+    if (u >= 10) {
+        *--t = digit_pairs[u * 2 + 1];
+        *--t = digit_pairs[u * 2];
+    } else {
+        *--t = (char)('0' + u);
+    }
+    size_t n = tmp + sizeof(tmp) - t;
+    memcpy(p, t, n);
+    return p + n;
+}
+
+
+static char *put_str(char *p, const char *s, size_t n) {
+    memcpy(p, s, n);
+    return p + n;
+}
+#define PUT_LIT(p, lit) put_str(p, lit, sizeof(lit) - 1)
+
+
+static char *put_2(char *p, int v) {
+    *p++ = digit_pairs[v * 2];
+    *p++ = digit_pairs[v * 2 + 1];
+    return p;
+}
+
+
+static char *put_millis(char *p, long long ts_ms) {
+    int ms = (int)(ts_ms % 1000);
+    *p++ = '.';
+    *p++ = (char)('0' + ms / 100);
+    return put_2(p, ms % 100);
+}
+
+
+//localtime_r once per second, the milliseconds are appended per row
+static void cache_date(sink_t *s, long long sec) {
+    if (sec == s->date_sec) return;
+    time_t t = (time_t)sec;
+    struct tm tm_info;
+    if (!localtime_r(&t, &tm_info)) {
+        memset(&tm_info, 0, sizeof(tm_info));
+    }
+    char *p = sink_put_long(s->date, tm_info.tm_year + 1900);
+    *p++ = '-';
+    p = put_2(p, tm_info.tm_mon + 1);
+    *p++ = '-';
+    p = put_2(p, tm_info.tm_mday);
+    *p++ = 'T';
+    p = put_2(p, tm_info.tm_hour);
+    *p++ = ':';
+    p = put_2(p, tm_info.tm_min);
+    *p++ = ':';
+    p = put_2(p, tm_info.tm_sec);
+    *p = '\0';
+    s->date_sec = sec;
+}
+
+
+int sink_parse_format(const char *name, sink_format_t *format) {
+    if (!name || !format) return -1;
+    if (strcmp(name, "csv") == 0) *format = SINK_CSV;
+    else if (strcmp(name, "jsonl") == 0 || strcmp(name, "json") == 0) *format = SINK_JSONL;
+    else return -1;
+    return 0;
+}
+
+
+/*
+ * path NULL or "-" is stdout, files are appended to. deadband_kb 0 writes every
+ * row, otherwise a row goes out when a value moved more than that since the
+ * last one written or heartbeat_ms passed (0 takes SINK_HEARTBEAT_MS).
+ */
+int sink_open(sink_t *s, const char *path, sink_format_t format, long deadband_kb,
+              long long heartbeat_ms) {
+    if (!s || deadband_kb < 0 || heartbeat_ms < 0) {
+        fprintf(stderr, "Error: Invalid arguments to sink_open()\n");
+        return -1;
+    }
+    memset(s, 0, sizeof(sink_t));
+    s->format = format;
+    s->date_sec = -1;
+    s->deadband = deadband_kb * KB_UNIT;
+    s->heartbeat_ms = heartbeat_ms ? heartbeat_ms : SINK_HEARTBEAT_MS;
+    s->buf = malloc(SINK_BUF_SIZE);
+    if (!s->buf) return -1;
+    if (!path || strcmp(path, "-") == 0) {
+        fflush(stdout);     //rows must not overtake what stdio still holds
+        s->fd = STDOUT_FILENO;
+        s->to_stdout = 1;
+    } else {
+        s->fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (s->fd < 0) {
+            fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+            free(s->buf);
+            s->buf = NULL;
+            return -1;
+        }
+    }
+    //csv gets its header once per file, json lines describe themselves
+    if (format == SINK_CSV && (s->to_stdout || lseek(s->fd, 0, SEEK_END) == 0)) {
+        static const char header[] = "ts_ms,time,pid,type,vsz_kb,rss_kb,data_kb,stack_kb\n";
+        memcpy(s->buf, header, sizeof(header) - 1);
+        s->len = sizeof(header) - 1;
+    }
+    return 0;
+}
+
+
+int sink_flush(sink_t *s) {
+    if (!s || !s->buf) return -1;
+    size_t off = 0;
+    while (off < s->len) {
+        ssize_t n = write(s->fd, s->buf + off, s->len - off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            fprintf(stderr, "Error writing samples: %s\n", strerror(errno));
+            s->len = 0;
+            return -1;
+        }
+        off += n;
+    }
+    s->len = 0;
+    return 0;
+}
+
+
+static int moved(const sink_t *s, const sink_band_t *band, const long *v) {
+    for (int i = 0; i < SINK_COLS; i++) {
+        long d = v[i] - band->last[i];
+        if (d > s->deadband || -d > s->deadband) return 1;
+    }
+    return 0;
+}
+
+
+static long to_kb(long v) {
+    return v < 0 ? -1 : v / KB_UNIT;
+}
+
+
+//1 when the row was written, 0 when the deadband held it back, -1 on errors
+int sink_write(sink_t *s, long long ts_ms, pid_t pid, const mem_info_t *info) {
+    return s ? sink_write_band(s, &s->band, ts_ms, pid, info) : -1;
+}
+
+
+//same, the deadband compares against band, one per pid when a sink takes several
+int sink_write_band(sink_t *s, sink_band_t *band, long long ts_ms, pid_t pid,
+                    const mem_info_t *info) {
+    if (!s || !s->buf || !band || !info) return -1;
+    long v[SINK_COLS] = { info->vmsize, info->vmrss, info->vmdata, info->vmstk };
+    if (s->deadband && band->have_last && !moved(s, band, v) && ts_ms - band->emitted_ms < s->heartbeat_ms) {
+        s->suppressed++;
+        return 0;
+    }
+    memcpy(band->last, v, sizeof(v));
+    band->have_last = 1;
+    band->emitted_ms = ts_ms;
+
+    if (s->len + 512 > SINK_BUF_SIZE && sink_flush(s) != 0) return -1;
+    cache_date(s, ts_ms / 1000);
+    int kernel = info->proc_type == PROC_TYPE_KERNEL;
+    char *p = s->buf + s->len;
+    if (s->format == SINK_CSV) {
+        p = sink_put_long(p, (long)ts_ms);
+        *p++ = ',';
+        p = put_str(p, s->date, 19);
+        p = put_millis(p, ts_ms);
+        *p++ = ',';
+        p = sink_put_long(p, pid);
+        p = kernel ? PUT_LIT(p, ",kernel") : PUT_LIT(p, ",user");
+        for (int i = 0; i < SINK_COLS; i++) {
+            *p++ = ',';
+            p = sink_put_long(p, to_kb(v[i]));
+        }
+    } else {
+        static const char *const keys[SINK_COLS] = {
+            ",\"vsz_kb\":", ",\"rss_kb\":", ",\"data_kb\":", ",\"stack_kb\":"
+        };
+        p = PUT_LIT(p, "{\"ts_ms\":");
+        p = sink_put_long(p, (long)ts_ms);
+        p = PUT_LIT(p, ",\"time\":\"");
+        p = put_str(p, s->date, 19);
+        p = put_millis(p, ts_ms);
+        p = PUT_LIT(p, "\",\"pid\":");
+        p = sink_put_long(p, pid);
+        p = kernel ? PUT_LIT(p, ",\"type\":\"kernel\"") : PUT_LIT(p, ",\"type\":\"user\"");
+        for (int i = 0; i < SINK_COLS; i++) {
+            p = put_str(p, keys[i], strlen(keys[i]));
+            p = sink_put_long(p, to_kb(v[i]));
+        }
+        *p++ = '}';
+    }
+    *p++ = '\n';
+    s->len = p - s->buf;
+    s->rows++;
+
+    if (s->len >= SINK_BUF_SIZE / 2 || ts_ms - s->flushed_ms >= SINK_FLUSH_MS) {
+        s->flushed_ms = ts_ms;
+        return sink_flush(s) == 0 ? 1 : -1;
+    }
+    return 1;
+}
+
+
+void sink_close(sink_t *s) {
+    if (!s || !s->buf) return;
+    sink_flush(s);
+    if (!s->to_stdout) close(s->fd);
+    free(s->buf);
+    memset(s, 0, sizeof(sink_t));
+}
@@ -0,0 +1,92 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-7-2 19:26:51
+ * @Last modified: 2025-7-2 19:26:51
+ * @Description: streaming quantile sketch. values below 2^SUB_BITS get a bucket
+ *               each, above that every power of two is split into 2^SUB_BITS
+ *               linear sub-buckets, so the relative error is bounded everywhere.
+ */
+
+#include "include/memtrc.h"
+#include "include/sketch.h"
+
+
+void sketch_init(sketch_t *s) {
+    if (!s) return;
+    memset(s, 0, sizeof(sketch_t));
+    s->min = INT64_MAX;
+    s->max = INT64_MIN;
+}
+
+
+static inline int bucket_of(long v) {
+    if (v < (1L << SKETCH_SUB_BITS)) return v < 0 ? 0 : (int)v;
+    int msb = 63 - __builtin_clzl((unsigned long)v);
+    if (msb >= SKETCH_MAX_BITS) return SKETCH_BUCKETS - 1;
+    int shift = msb - SKETCH_SUB_BITS;
+    return ((shift + 1) << SKETCH_SUB_BITS) + (int)((v >> shift) - (1L << SKETCH_SUB_BITS));
+}
+
+
+//highest value that lands in bucket idx
+static inline long bucket_high(int idx) {
+    if (idx < (2 << SKETCH_SUB_BITS)) return idx;
+    int shift = (idx >> SKETCH_SUB_BITS) - 1;
+    long sub = (idx & ((1 << SKETCH_SUB_BITS) - 1)) + (1L << SKETCH_SUB_BITS);
+    return ((sub + 1) << shift) - 1;
+}
+
+
+void sketch_add(sketch_t *s, long value) {
+    if (!s) return;
+    s->buckets[bucket_of(value)]++;
+    s->count++;
+    s->sum += value;
+    if (value < s->min) s->min = value;
+    if (value > s->max) s->max = value;
+}
+
+
+void sketch_merge(sketch_t *dst, const sketch_t *src) {
+    if (!dst || !src || src->count == 0) return;
+    for (int i = 0; i < SKETCH_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+
+/*
+ * value at quantile q (0..1), the upper edge of its bucket so a percentile is
+ * never understated, clamped to the exact extremes. 0 for an empty sketch.
+ */
+long sketch_quantile(const sketch_t *s, double q) {
+    if (!s || s->count == 0) return 0;
+    if (q <= 0) return s->min;
+    if (q >= 1) return s->max;
+    uint64_t rank = (uint64_t)ceil(q * s->count);
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < SKETCH_BUCKETS; i++) {
+        seen += s->buckets[i];
+        if (seen >= rank) {
+            long v = bucket_high(i);
+            if (v > s->max) v = s->max;
+            if (v < s->min) v = s->min;
+            return v;
+        }
+    }
+    return s->max;
+}
+
+
+void sketch_print(FILE *fp, const char *name, const sketch_t *s) {
+    if (!fp || !name || !s || s->count == 0) return;
+    fprintf(fp, "%s: samples %llu, p50 %ld KB, p95 %ld KB, p99 %ld KB, max %ld KB, mean %.1f KB\n",
+            name, (unsigned long long)s->count,
+            sketch_quantile(s, 0.50), sketch_quantile(s, 0.95),
+            sketch_quantile(s, 0.99), (long)s->max, s->sum / s->count);
+}
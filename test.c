@@ -6,9 +6,43 @@
  */
 
 
+#define _GNU_SOURCE
 #include "include/memtrc.h"
 #include "include/chart.h"
+#include "include/analyze.h"
+#include "include/codec.h"
+#include "include/selfstat.h"
+#include "include/fixture.h"
+#include "include/sampler.h"
+#include "include/adaptive.h"
+#include "include/recorder.h"
+#include "include/retention.h"
+#include "include/sketch.h"
+#include "include/pressure.h"
+#include "include/allocprof.h"
+#include "include/launch.h"
+#include "include/faultprof.h"
+#include "include/colstore.h"
+#include "include/sink.h"
+#include "include/procwatch.h"
+#include "include/leader.h"
+#include "include/numa.h"
+#include "include/group.h"
+#include "include/kmem.h"
+#include "include/libmemtrc.h"
+#include "include/hog.h"
+#include "include/topn.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <assert.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <stddef.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
 
 
 //global variables needed for tests
@@ -283,6 +317,11 @@ void test_write_log(void) {
     assert(strstr(buf, "type: user process") != NULL);
     assert(strstr(buf, "VSZ: 1024 KB") != NULL);
     assert(strstr(buf, "RSS: 512 KB") != NULL);
+    //"[YYYY-MM-DD HH:MM:SS.mmm]", millisecond timestamps
+    assert(buf[0] == '[' && buf[20] == '.' && buf[24] == ']');
+    log_record_t rec;
+    assert(parse_log_line(buf, strlen(buf), &rec) == 1);
+    assert(rec.vmrss == 512);
     
     //test with kernel process type
     info.proc_type = PROC_TYPE_KERNEL;
@@ -331,9 +370,2120 @@ void test_signal_handler(void) {
     printf("test_signal_handler passed!\n");
 }
 
+void test_analyze_log(void) {
+    printf("Testing log analysis functionality...\n");
+    log_record_t rec;
+
+    //test single line scanner on both write_log() layouts
+    const char *user_line = "[2025-05-01 10:00:00] type: user process, "
+            "VSZ: 4096 KB, RSS: 1024 KB, Data: 512 KB, Stack: 132 KB";
+    assert(parse_log_line(user_line, strlen(user_line), &rec) == 1);
+    assert(rec.vmsize == 4096);
+    assert(rec.vmrss == 1024);
+    const char *kernel_line = "[2025-05-01 10:00:01] type: kernel process, RSS: -1 KB, VSZ: -1 KB";
+    assert(parse_log_line(kernel_line, strlen(kernel_line), &rec) == 1);
+    assert(rec.vmrss == -1);
+    assert(rec.ts_ms % 1000 == 0);
+    assert(parse_log_line("garbage", 7, &rec) == 0);
+
+    //write a small log with a known linear RSS ramp
+    char path[] = "/tmp/memtrc_analyze_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    FILE *fp = fdopen(fd, "w");
+    assert(fp != NULL);
+    for (int i = 0; i < 100; i++) {
+        fprintf(fp, "[2025-05-01 10:%02d:%02d] type: user process, VSZ: %d KB, "
+                "RSS: %d KB, Data: 1 KB, Stack: 1 KB\n",
+                i / 60, i % 60, 10000, 1000 + i * 10);
+    }
+    fprintf(fp, "not a sample line\n");
+    mem_info_t info = { .proc_type = PROC_TYPE_USER, .vmsize = 1, .vmrss = 1 };
+    write_log(fp, &info);   //real write_log() output must parse too
+    fclose(fp);
+
+    log_data_t data;
+    assert(load_log_file(path, 2, &data) == 0);
+    assert(data.count == 101);
+    assert(data.skipped == 1);
+    assert(data.records[1].ts_ms - data.records[0].ts_ms == 1000);
+
+    //drop the trailing write_log() sample so the ramp stays exact
+    data.count = 100;
+    series_stats_t st;
+    assert(compute_series_stats(&data, LOG_FIELD_RSS, &st) == 0);
+    assert(st.samples == 100);
+    assert(st.peak == 1990);
+    assert(st.min == 1000);
+    assert(fabs(st.mean - 1495.0) < 1e-9);
+    assert(st.p50 == 1490);
+    assert(st.p99 == 1980);
+    assert(fabs(st.growth_per_sec - 10.0) < 1e-6);
+    free_log_data(&data);
+
+    //missing file should fail cleanly
+    assert(load_log_file("/nonexistent/memtrc.log", 1, &data) != 0);
+
+    assert(analyze_log(path, 0) == 0);
+    unlink(path);
+    printf("test_analyze_log passed!\n");
+}
+
+void test_codec(void) {
+    printf("Testing sample codec functionality...\n");
+    static long long ts[CODEC_BLOCK_ROWS];
+    static long vals[CODEC_MAX_COLS][CODEC_BLOCK_ROWS];
+    static long long out_ts[CODEC_BLOCK_ROWS];
+    static long out_vals[CODEC_MAX_COLS][CODEC_BLOCK_ROWS];
+
+    //irregular timestamps, page aligned steps, big jumps and negative values
+    long long t = 1746000000000LL;
+    for (int i = 0; i < CODEC_BLOCK_ROWS; i++) {
+        t += (i % 7 == 0) ? 100 : (i % 13 == 0 ? 100000 : 101);
+        ts[i] = t;
+        vals[0][i] = 4096L * (1000 + (i / 10));
+        vals[1][i] = (i == 500) ? LONG_MAX / 2 : 4096L * (i % 3);
+        vals[2][i] = -1;
+        vals[3][i] = (long)i * i * 7 - 100000;
+    }
+    codec_block_t blk;
+    assert(codec_encode_block(CODEC_MAX_COLS, ts, vals, CODEC_BLOCK_ROWS, &blk) == 0);
+    assert(blk.rows == CODEC_BLOCK_ROWS);
+    assert(codec_decode_block(CODEC_MAX_COLS, &blk, out_ts, out_vals) == 0);
+    assert(memcmp(ts, out_ts, sizeof(ts)) == 0);
+    assert(memcmp(vals, out_vals, sizeof(vals)) == 0);
+    codec_free_block(&blk);
+
+    //steady page aligned counters sampled every 100ms must compress well
+    ts_series_t *s = malloc(sizeof(ts_series_t));
+    assert(s != NULL);
+    assert(ts_series_init(s, 2) == 0);
+    for (int i = 0; i < 10 * CODEC_BLOCK_ROWS + 17; i++) {
+        long row[2] = { 4096L * (25000 + i / 50), 4096L * 100000 };
+        assert(ts_series_append(s, 1000LL + i * 100LL, row) == 0);
+    }
+    assert(s->nblocks == 10);
+    assert(s->tail_rows == 17);
+    assert(s->enc_bytes < s->rows);     //well under one byte per two column sample
+    assert(ts_series_find_block(s, 0) == -1);
+    assert(ts_series_find_block(s, 1000) == 0);
+    assert(ts_series_find_block(s, 1000LL + CODEC_BLOCK_ROWS * 100LL) == 1);
+    assert(ts_series_find_block(s, 1LL << 60) == 9);
+    assert(codec_decode_block(2, &s->blocks[3], out_ts, out_vals) == 0);
+    assert(out_ts[0] == 1000LL + 3 * CODEC_BLOCK_ROWS * 100LL);
+    assert(out_vals[0][5] == 4096L * (25000 + (3 * CODEC_BLOCK_ROWS + 5) / 50));
+    ts_series_free(s);
+    free(s);
+
+    //on-disk codec round trip with random access to the last short block
+    char path[] = "/tmp/memtrc_codec_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+    codec_writer_t *w = malloc(sizeof(codec_writer_t));
+    assert(w != NULL);
+    assert(codec_writer_open(w, path, CODEC_MAX_COLS) == 0);
+    for (int i = 0; i < CODEC_BLOCK_ROWS + 3; i++) {
+        long row[CODEC_MAX_COLS] = { i, 2L * i, 3L * i, 4L * i };
+        assert(codec_writer_append(w, 5000LL + i, row) == 0);
+    }
+    assert(codec_writer_close(w) == 0);
+    free(w);
+    assert(codec_is_compressed(path) == 1);
+
+    codec_reader_t r;
+    assert(codec_reader_open(&r, path) == 0);
+    assert(r.ncols == CODEC_MAX_COLS);
+    assert(r.nblocks == 2);
+    assert(codec_reader_block(&r, 1, &blk) == 0);
+    assert(blk.rows == 3);
+    assert(codec_decode_block(r.ncols, &blk, out_ts, out_vals) == 0);
+    assert(out_ts[2] == 5000LL + CODEC_BLOCK_ROWS + 2);
+    assert(out_vals[3][2] == 4L * (CODEC_BLOCK_ROWS + 2));
+    codec_free_block(&blk);
+    assert(codec_reader_block(&r, 2, &blk) != 0);
+    codec_reader_close(&r);
+
+    //analyze reads compressed logs as well
+    log_data_t data;
+    assert(load_log_file(path, 1, &data) == 0);
+    assert(data.count == CODEC_BLOCK_ROWS + 3);
+    assert(data.records[10].vmrss == 20);
+    free_log_data(&data);
+
+    //a crash mid block: the torn last payload is not indexed
+    struct stat sb;
+    assert(stat(path, &sb) == 0);
+    assert(truncate(path, sb.st_size - 1) == 0);
+    assert(codec_reader_open(&r, path) == 0);
+    assert(r.nblocks == 1);
+    assert(codec_reader_block(&r, 0, &blk) == 0 && blk.rows == CODEC_BLOCK_ROWS);
+    codec_free_block(&blk);
+    codec_reader_close(&r);
+    assert(load_log_file(path, 1, &data) == 0);
+    assert(data.count == CODEC_BLOCK_ROWS);
+    free_log_data(&data);
+    unlink(path);
+
+    //one row a second: the partial block is on disk before close
+    w = malloc(sizeof(codec_writer_t));
+    assert(w != NULL);
+    assert(codec_writer_open(w, path, CODEC_MAX_COLS) == 0);
+    int slow_rows = CODEC_FLUSH_MS / 1000 + 1;
+    for (int i = 0; i < slow_rows + 5; i++) {
+        long row[CODEC_MAX_COLS] = { i, i, i, i };
+        assert(codec_writer_append(w, 1000LL * i, row) == 0);
+    }
+    assert(codec_reader_open(&r, path) == 0);
+    assert(r.nblocks == 1);
+    assert(codec_reader_block(&r, 0, &blk) == 0 && blk.rows == (uint32_t)slow_rows);
+    codec_free_block(&blk);
+    codec_reader_close(&r);
+    assert(codec_writer_close(w) == 0);
+    free(w);
+    assert(load_log_file(path, 1, &data) == 0);
+    assert(data.count == (size_t)slow_rows + 5);
+    free_log_data(&data);
+    unlink(path);
+
+    printf("test_codec passed!\n");
+}
+
+static void *selfstat_worker(void *arg) {
+    (void)arg;
+    for (int i = 0; i < 10; i++) {
+        selfstat_record(PROBE_LOG, selfstat_now());
+    }
+    return NULL;
+}
+
+
+void test_selfstat(void) {
+    printf("Testing self instrumentation functionality...\n");
+    selfstat_snapshot_t start, end, diff;
+    selfstat_snapshot(&start);
+
+    //a probe on this thread with a known duration
+    uint64_t t0 = selfstat_now();
+    struct timespec ts = { 0, 2000000 };    //2ms
+    nanosleep(&ts, NULL);
+    selfstat_record(PROBE_TICK, t0);
+
+    //probes from another thread land in the same snapshot
+    pthread_t tid;
+    assert(pthread_create(&tid, NULL, selfstat_worker, NULL) == 0);
+    pthread_join(tid, NULL);
+
+    //the sampling path records itself
+    mem_info_t info;
+    assert(read_mem_info(getpid(), &info) == 0);
+
+    selfstat_snapshot(&end);
+    selfstat_diff(&end, &start, &diff);
+    assert(diff.probes[PROBE_TICK].count == 1);
+    assert(diff.probes[PROBE_TICK].total_ns >= 2000000);
+    assert(selfstat_percentile(&diff.probes[PROBE_TICK], 50) >= 1000000);
+    assert(diff.probes[PROBE_LOG].count == 10);
+    assert(diff.probes[PROBE_PROC_TYPE].count == 1);
+    assert(diff.probes[PROBE_READ_MEM].count == 1);
+    assert(end.rss_kb > 0);
+    assert(end.cpu_user + end.cpu_sys > 0);
+
+    //a dead worker's block is adopted, not leaked
+    assert(pthread_create(&tid, NULL, selfstat_worker, NULL) == 0);
+    pthread_join(tid, NULL);
+    selfstat_snapshot(&end);
+    selfstat_diff(&end, &start, &diff);
+    assert(diff.probes[PROBE_LOG].count == 20);
+
+    //log line must not be mistaken for a sample by analyze
+    FILE *tmp = tmpfile();
+    assert(tmp != NULL);
+    selfstat_log(tmp, &diff);
+    rewind(tmp);
+    char buf[512];
+    assert(fgets(buf, sizeof(buf), tmp) != NULL);
+    assert(strstr(buf, "stats: ticks 1") != NULL);
+    log_record_t rec;
+    assert(parse_log_line(buf, strlen(buf), &rec) == 0);
+    fclose(tmp);
+    selfstat_print(stdout, &diff);
+
+    char *args[MAX_ARGS];
+    int arg_count;
+    char cmd_line[] = "stats";
+    assert(parse_command(cmd_line, args, &arg_count) == CMD_STATS);
+
+    printf("test_selfstat passed!\n");
+}
+
+void test_procfs_root(void) {
+    printf("Testing procfs root and fixtures functionality...\n");
+    char root[] = "/tmp/memtrc_test_proc_XXXXXX";
+    assert(mkdtemp(root) != NULL);
+    //a directory without the marker is never removed
+    assert(fixture_remove(root) == -1 && access(root, F_OK) == 0);
+    assert(fixture_remove("/proc") == -1);
+
+    fixture_opts_t opts;
+    fixture_default_opts(&opts);
+    opts.count = 20;
+    opts.kernel_every = 5;
+    opts.status_pad_lines = 50;
+    assert(fixture_generate(root, &opts) == 0);
+
+    //same seed, same tree
+    fixture_proc_t a, b;
+    fixture_make_proc(&opts, 3, &a);
+    fixture_make_proc(&opts, 3, &b);
+    assert(memcmp(&a, &b, sizeof(a)) == 0);
+    assert(a.kind == FIXTURE_USER && a.pid == 1003);
+
+    assert(set_procfs_root("/nonexistent/memtrc") == -1);
+    assert(strcmp(get_procfs_root(), "/proc") == 0);
+    assert(set_procfs_root(root) == 0);
+    assert(strcmp(get_procfs_root(), root) == 0);
+
+    char path[PATH_MAX];
+    assert(proc_path(path, sizeof(path), 1003, "status") == 0);
+    assert(strncmp(path, root, strlen(root)) == 0);
+
+    mem_info_t info;
+    assert(read_mem_info(a.pid, &info) == 0);
+    assert(info.proc_type == PROC_TYPE_USER);
+    assert(info.vmsize == a.vmsize_kb * KB_UNIT);
+    assert(info.vmrss == a.vmrss_kb * KB_UNIT);
+    assert(info.vmstk == a.vmstk_kb * KB_UNIT);
+
+    //pid 1004 is the fifth entry, a kernel thread look-alike
+    assert(get_process_type(1004) == PROC_TYPE_KERNEL);
+    assert(read_mem_info(1004, &info) == 0);
+    assert(info.vmrss == -1);
+
+    assert(process_exists(1019) == 1);
+    assert(process_exists(1020) == 0);
+
+    assert(set_procfs_root("/proc") == 0);
+    assert(process_exists(getpid()) == 1);
+    assert(fixture_remove(root) == 0);
+    assert(access(root, F_OK) != 0);
+
+    printf("test_procfs_root passed!\n");
+}
+
+void test_process_type(void) {
+    printf("Testing process type classification functionality...\n");
+    char root[] = "/tmp/memtrc_test_type_XXXXXX";
+    assert(mkdtemp(root) != NULL);
+
+    //fixture matrix: every 2nd kernel, every 3rd zombie, every 5th stopped
+    fixture_opts_t opts;
+    fixture_default_opts(&opts);
+    opts.count = 30;
+    opts.kernel_every = 2;
+    opts.zombie_every = 3;
+    opts.stopped_every = 5;
+    opts.smaps_mappings = 0;
+    assert(fixture_generate(root, &opts) == 0);
+    assert(set_procfs_root(root) == 0);
+
+    int seen[4] = { 0 };
+    for (int i = 0; i < opts.count; i++) {
+        fixture_proc_t proc;
+        fixture_make_proc(&opts, i, &proc);
+        proc_type_t expect = proc.kind == FIXTURE_KERNEL ? PROC_TYPE_KERNEL : PROC_TYPE_USER;
+        assert(get_process_type(proc.pid) == expect);
+        assert(get_process_type(proc.pid) == expect);   //cached
+        seen[proc.kind]++;
+    }
+    assert(seen[FIXTURE_USER] && seen[FIXTURE_KERNEL] && seen[FIXTURE_ZOMBIE] && seen[FIXTURE_STOPPED]);
+
+    //short lived: the pid exits, the failed read of the tick drops the entry
+    char path[PATH_MAX];
+    mem_info_t info;
+    fixture_proc_t proc;
+    fixture_make_proc(&opts, 0, &proc);
+    assert(proc.kind == FIXTURE_USER);
+    proc_stat_t st;
+    assert(read_proc_stat(proc.pid, &st) == 0);
+    assert(st.starttime == proc.starttime && st.state == 'S' && st.ppid == 1);
+    assert(get_process_type(proc.pid) == PROC_TYPE_USER);
+    snprintf(path, sizeof(path), "%s/%d", root, proc.pid);
+    assert(fixture_mark(path) == 0 && fixture_remove(path) == 0);
+    assert(read_mem_info(proc.pid, &info) == -1);
+    proc.kind = FIXTURE_KERNEL;
+    proc.starttime += 100000;
+    assert(fixture_write_proc(root, &proc, &opts) == 0);
+    assert(get_process_type(proc.pid) == PROC_TYPE_KERNEL);
+
+    //reused between two ticks: the status read disagrees with the cache
+    proc.kind = FIXTURE_USER;
+    proc.starttime += 100000;
+    assert(fixture_write_proc(root, &proc, &opts) == 0);
+    assert(get_process_type(proc.pid) == PROC_TYPE_KERNEL);    //not looked at yet
+    assert(read_mem_info(proc.pid, &info) == 0 && info.proc_type == PROC_TYPE_USER);
+    assert(info.vmrss == proc.vmrss_kb);
+    assert(get_process_type(proc.pid) == PROC_TYPE_USER);
+    proc.kind = FIXTURE_KERNEL;
+    proc.starttime += 100000;
+    assert(fixture_write_proc(root, &proc, &opts) == 0);
+    assert(read_mem_info(proc.pid, &info) == 0 && info.proc_type == PROC_TYPE_KERNEL);
+
+    //a stat read with a new starttime replaces the entry too
+    proc.kind = FIXTURE_USER;
+    proc.starttime += 100000;
+    assert(fixture_write_proc(root, &proc, &opts) == 0);
+    assert(read_proc_stat(proc.pid, &st) == 0);
+    assert(get_process_type(proc.pid) == PROC_TYPE_USER);
+
+    //short lived: gone before it could be read
+    snprintf(path, sizeof(path), "%s/%d", root, opts.first_pid + opts.count);
+    assert(get_process_type(opts.first_pid + opts.count) == PROC_TYPE_UNKNOWN);
+    assert(read_mem_info(opts.first_pid + opts.count, &info) == -1);
+    assert(access(path, F_OK) != 0);
+
+    assert(set_procfs_root("/proc") == 0);
+    assert(fixture_remove(root) == 0);
+
+    //live matrix: ourselves, kthreadd, a zombie child and a stopped child
+    assert(get_process_type(getpid()) == PROC_TYPE_USER);
+    if (access("/proc/2/stat", R_OK) == 0) {
+        assert(get_process_type(2) == PROC_TYPE_KERNEL);
+    }
+    pid_t zombie = fork();
+    assert(zombie >= 0);
+    if (zombie == 0) _exit(0);
+    pid_t stopped = fork();
+    assert(stopped >= 0);
+    if (stopped == 0) {
+        pause();
+        _exit(0);
+    }
+    assert(kill(stopped, SIGSTOP) == 0);
+    for (int i = 0; i < 1000; i++) {
+        proc_stat_t zs, ss;
+        if (read_proc_stat(zombie, &zs) == 0 && zs.state == 'Z' &&
+            read_proc_stat(stopped, &ss) == 0 && ss.state == 'T') break;
+        usleep(1000);
+    }
+    assert(read_proc_stat(zombie, &st) == 0 && st.state == 'Z');
+    assert(get_process_type(zombie) == PROC_TYPE_USER);
+    assert(read_proc_stat(stopped, &st) == 0 && st.state == 'T');
+    assert(get_process_type(stopped) == PROC_TYPE_USER);
+    kill(stopped, SIGKILL);
+    waitpid(stopped, NULL, 0);
+    waitpid(zombie, NULL, 0);
+    proc_type_cache_forget(zombie);
+    proc_type_cache_forget(stopped);
+
+    //repeat classification is served from the cache without read syscalls
+    selfstat_snapshot_t s1, s2, s3;
+    get_process_type(getpid());
+    selfstat_snapshot(&s1);
+    selfstat_snapshot(&s2);
+    for (int i = 0; i < 100; i++) {
+        assert(get_process_type(getpid()) == PROC_TYPE_USER);
+    }
+    selfstat_snapshot(&s3);
+    assert(s3.syscalls - s2.syscalls == s2.syscalls - s1.syscalls);
+
+    /*
+     * and without any other syscall: a seccomp filter kills the child on
+     * anything but read, write, exit and the clock (no vdso on some hosts)
+     */
+    pid_t strict = fork();
+    assert(strict >= 0);
+    if (strict == 0) {
+        pid_t self = getpid();  //a syscall itself
+        if (get_process_type(self) != PROC_TYPE_USER) _exit(1);    //cached, probes set up
+        struct sock_filter allow[] = {
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr)),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_read, 5, 0),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_write, 4, 0),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_exit, 3, 0),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_exit_group, 2, 0),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_clock_gettime, 1, 0),
+            BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_KILL_PROCESS),
+            BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+        };
+        struct sock_fprog prog = { sizeof(allow) / sizeof(allow[0]), allow };
+        if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) != 0 ||
+            prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog) != 0) _exit(2);
+        int ok = 1;
+        for (int i = 0; i < 100; i++) ok &= get_process_type(self) == PROC_TYPE_USER;
+        _exit(ok ? 0 : 1);
+    }
+    int status;
+    assert(waitpid(strict, &status, 0) == strict);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    printf("test_process_type passed!\n");
+}
+
+void test_sampler(void) {
+    printf("Testing batched sampler functionality...\n");
+    char root[] = "/tmp/memtrc_test_sampler_XXXXXX";
+    assert(mkdtemp(root) != NULL);
+    fixture_opts_t opts;
+    fixture_default_opts(&opts);
+    opts.count = 50;
+    opts.kernel_every = 7;
+    opts.status_pad_lines = 300;   //status larger than one read buffer
+    opts.smaps_mappings = 0;
+    assert(fixture_generate(root, &opts) == 0);
+    assert(set_procfs_root(root) == 0);
+
+    //both backends agree with read_mem_info() on every target
+    sampler_backend_t backends[] = { SAMPLER_PREAD, SAMPLER_AUTO };
+    for (int b = 0; b < 2; b++) {
+        sampler_t s;
+        assert(sampler_init(&s, backends[b]) == 0);
+        assert(s.backend != SAMPLER_AUTO);
+        for (int i = 0; i < opts.count; i++) {
+            assert(sampler_add(&s, opts.first_pid + i) == 0);
+        }
+        assert(sampler_add(&s, opts.first_pid + opts.count) == -1);
+        for (int tick = 0; tick < 3; tick++) {
+            assert(sampler_tick(&s) == opts.count);
+        }
+        for (int i = 0; i < s.count; i++) {
+            mem_info_t info;
+            assert(read_mem_info(s.targets[i].pid, &info) == 0);
+            assert(s.targets[i].info.proc_type == info.proc_type);
+            assert(s.targets[i].info.vmsize == info.vmsize);
+            assert(s.targets[i].info.vmrss == info.vmrss);
+            assert(s.targets[i].info.vmdata == info.vmdata);
+            assert(s.targets[i].info.vmstk == info.vmstk);
+        }
+        if (s.backend == SAMPLER_URING) {
+            assert(s.syscalls == 3);   //one batch per tick
+        } else {
+            assert(s.syscalls == 3ULL * opts.count);
+        }
+        printf("%s backend ok\n", sampler_backend_name(s.backend));
+        sampler_free(&s);
+    }
+    assert(set_procfs_root("/proc") == 0);
+    assert(fixture_remove(root) == 0);
+
+    //a target that exits is dropped on the next tick
+    for (int b = 0; b < 2; b++) {
+        sampler_t s;
+        assert(sampler_init(&s, backends[b]) == 0);
+        pid_t child = fork();
+        assert(child >= 0);
+        if (child == 0) {
+            pause();
+            _exit(0);
+        }
+        assert(sampler_add(&s, getpid()) == 0);
+        assert(sampler_add(&s, child) == 0);
+        assert(sampler_tick(&s) == 2);
+        assert(s.targets[0].info.vmrss > 0);
+        kill(child, SIGKILL);
+        waitpid(child, NULL, 0);
+        assert(sampler_tick(&s) == 1);
+        assert(s.targets[1].fd == -1);
+        assert(sampler_tick(&s) == 1);
+        sampler_free(&s);
+    }
+
+    printf("test_sampler passed!\n");
+}
+
+//rss of a simulated process: idle, a 2 s allocation burst at t=30 s, idle again
+static long simulated_rss(long long t_ms) {
+    const long base = 100L << 20;
+    if (t_ms < 30000) return base + (t_ms / 1000 % 2) * 4096;   //page level jitter
+    if (t_ms < 32000) return base + (t_ms - 30000) * (1L << 20) / 10;   //100 MB/s
+    return base + 200L * (1L << 20);
+}
+
+void test_adaptive(void) {
+    printf("Testing adaptive sampling functionality...\n");
+    adaptive_t a;
+    assert(adaptive_init(&a, 0, 1000) == -1);
+    assert(adaptive_init(&a, 100, 10) == -1);
+    assert(adaptive_init(&a, ADAPTIVE_MIN_MS, ADAPTIVE_MAX_MS) == 0);
+
+    //a minute of simulated time, samples land where the controller asks
+    long long t = 0;
+    int burst_samples = 0;
+    while (t < 60000) {
+        int next = adaptive_next(&a, t, simulated_rss(t));
+        assert(next >= ADAPTIVE_MIN_MS && next <= ADAPTIVE_MAX_MS);
+        if (t >= 30000 && t < 32000) burst_samples++;
+        t += next;
+    }
+    //the burst is found within one max interval and followed at 10 ms
+    assert(burst_samples >= (2000 - ADAPTIVE_MAX_MS) / ADAPTIVE_MIN_MS);
+    //quiet stretches cost about what a 1 s sampler does
+    assert(a.samples - burst_samples < 2 * 58 + 20);
+    assert(a.cur_ms == ADAPTIVE_MAX_MS);
+    printf("adaptive: %lu samples in 60 s, %d during the 2 s burst\n", a.samples, burst_samples);
+
+    //a steady ramp below the noise floor per step still backs off
+    assert(adaptive_init(&a, ADAPTIVE_MIN_MS, ADAPTIVE_MAX_MS) == 0);
+    for (int i = 0; i < 20; i++) {
+        adaptive_next(&a, 1000LL * i, (100L << 20) + i * 1024L);
+    }
+    assert(a.cur_ms == ADAPTIVE_MAX_MS);
+
+    //timestamped history: the x axis follows time, not the sample index
+    history_data_t hist;
+    char chart[CHART_HEIGHT][CHART_WIDTH + 1];
+    init_history(&hist);
+    update_history_at(&hist, 1000000, 10);
+    update_history_at(&hist, 1000010, 20);
+    update_history_at(&hist, 1001000, 30);
+    prepare_chart(&hist, chart);
+    int cols[3], n = 0;
+    for (int x = 1; x < CHART_WIDTH; x++) {
+        for (int y = 0; y < CHART_HEIGHT - 1; y++) {
+            if (chart[y][x] == '*' && n < 3) cols[n++] = x;
+        }
+    }
+    assert(n == 3);
+    assert(cols[0] == 1 && cols[1] == 1 && cols[2] == CHART_WIDTH - 1);
+    cleanup_history(&hist);
+
+    //analyze keeps the millisecond spacing
+    const char *l1 = "[2025-05-01 10:00:00.120] type: user process, VSZ: 1 KB, RSS: 1 KB";
+    const char *l2 = "[2025-05-01 10:00:00.130] type: user process, VSZ: 1 KB, RSS: 2 KB";
+    log_record_t r1, r2;
+    assert(parse_log_line(l1, strlen(l1), &r1) == 1);
+    assert(parse_log_line(l2, strlen(l2), &r2) == 1);
+    assert(r2.ts_ms - r1.ts_ms == 10);
+
+    char *args[MAX_ARGS];
+    int arg_count;
+    char cmd_line[] = "trace 1 -a 20:500";
+    assert(parse_command(cmd_line, args, &arg_count) == CMD_TRACE);
+    assert(arg_count == 4 && strcmp(args[3], "20:500") == 0);
+
+    printf("test_adaptive passed!\n");
+}
+
+static int wait_for_dumps(recorder_t *rec, int dumps) {
+    for (int i = 0; i < 500 && __atomic_load_n(&rec->dumps, __ATOMIC_ACQUIRE) < dumps; i++) {
+        usleep(10000);
+    }
+    return __atomic_load_n(&rec->dumps, __ATOMIC_ACQUIRE) >= dumps;
+}
+
+void test_recorder(void) {
+    printf("Testing flight recorder functionality...\n");
+    char dir[] = "/tmp/memtrc_test_rec_XXXXXX";
+    assert(mkdtemp(dir) != NULL);
+    assert(fixture_mark(dir) == 0);
+    recorder_t rec;
+    assert(recorder_init(&rec, getpid()) == 0);
+    rec.threshold = 200L << 20;
+    rec.pre_ms = 1000;
+    rec.post_ms = 500;
+    strcpy(rec.dir, dir);
+    char hook[PATH_MAX + 64];
+    snprintf(hook, sizeof(hook), "echo \"$MEMTRC_PID $MEMTRC_REASON\" > %s/hook.out", dir);
+    rec.hook = strdup(hook);
+    assert(recorder_start(&rec, 10) == 0);
+    assert(rec.cap >= 2 * 1500 / 10);
+
+    //5 s of 10 ms samples, the ring wraps, rss crosses 200 MB at t = 3 s
+    mem_info_t info = { .proc_type = PROC_TYPE_USER, .vmsize = 1L << 30, .vmdata = 1 << 20,
+                        .vmstk = 135168 };
+    long long t0 = 1700000000000LL;
+    for (int i = 0; i < 500; i++) {
+        info.vmrss = (i < 300 ? 100L : 300L) << 20;
+        recorder_push(&rec, t0 + i * 10, &info);
+    }
+    assert(wait_for_dumps(&rec, 1));
+    assert(rec.trigger_ts == t0 + 3000);
+    assert(strstr(rec.reason, "crossed threshold 200 MB") != NULL);
+
+    //the dump has the trigger header, a rollup and the window as plain log lines
+    FILE *fp = fopen(rec.last_dump, "r");
+    assert(fp != NULL);
+    char line[512];
+    int rollup = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "#   Rss:", 8) == 0) rollup = 1;
+    }
+    fclose(fp);
+    assert(rollup);
+    log_data_t data;
+    assert(load_log_file(rec.last_dump, 1, &data) == 0);
+    assert(data.count == 151);      //-1000 ms .. +500 ms at 10 ms
+    assert(data.records[0].vmrss == 100L << 20);
+    assert(data.records[data.count - 1].vmrss == 300L << 20);
+    assert(data.records[data.count - 1].ts_ms - data.records[0].ts_ms == 1500);
+    free_log_data(&data);
+
+    //staying above doesn't fire again, growth does
+    rec.growth = 50L << 20;
+    rec.growth_ms = 1000;
+    for (int i = 500; i < 700; i++) {
+        info.vmrss = (300L << 20) + (i >= 600 ? 60L << 20 : 0);
+        recorder_push(&rec, t0 + i * 10, &info);
+    }
+    assert(wait_for_dumps(&rec, 2));
+    assert(rec.trigger_ts == t0 + 6000);
+    assert(strstr(rec.reason, "rss grew 60 MB") != NULL);
+
+    //the hook ran on its own with the dump in its environment
+    char out[PATH_MAX + 16];
+    snprintf(out, sizeof(out), "%s/hook.out", dir);
+    for (int i = 0; i < 300 && access(out, F_OK) != 0; i++) usleep(10000);
+    usleep(50000);
+    fp = fopen(out, "r");
+    assert(fp != NULL);
+    assert(fgets(line, sizeof(line), fp) != NULL);
+    assert(atoi(line) == getpid());
+    fclose(fp);
+
+    recorder_free(&rec);
+    assert(fixture_remove(dir) == 0);
+    printf("test_recorder passed!\n");
+}
+
+
+void test_retention(void) {
+    printf("Testing retention functionality...\n");
+    assert(parse_span("90") == 90000);
+    assert(parse_span("15m") == 15 * RETAIN_MINUTE_MS);
+    assert(parse_span("7d") == 7 * 24 * RETAIN_HOUR_MS);
+    assert(parse_span("0s") == -1 && parse_span("2x") == -1 && parse_span("1hh") == -1);
+
+    //3 hours at 1 s, the raw ring only keeps the last 4096 s
+    retention_t r;
+    assert(retention_open(&r, NULL, 42, 0) == 0);
+    long long t0 = 1700000000000LL / RETAIN_HOUR_MS * RETAIN_HOUR_MS;
+    for (long i = 0; i < 3 * 3600; i++) {
+        long row[RETAIN_COLS] = { 2 * i, i, 0, 0 };
+        retention_append(&r, t0 + i * 1000, row);
+    }
+    long long newest = r.st->newest_ms;
+    assert(newest == t0 + 10799000);
+
+    retain_point_t *pts;
+    long long res;
+    int n = retention_query(&r, newest - 1800000 + 1, newest, 0, &pts, &res);
+    assert(n == 1800 && res == 0);
+    assert(pts[n - 1].min[1] == 10799 && pts[n - 1].max[0] == 2 * 10799);
+    free(pts);
+
+    //2 hours is past the ring, answered by minute rollups
+    n = retention_query(&r, newest - 7200000 + 1, newest, 0, &pts, &res);
+    assert(res == RETAIN_MINUTE_MS && n == 121);
+    assert(pts[0].ts_ms == t0 + 59 * RETAIN_MINUTE_MS && pts[0].count == 60);
+    assert(pts[0].min[1] == 3540 && pts[0].max[1] == 3599 && pts[0].avg[1] == 3569);
+    free(pts);
+
+    //downsampled for a chart, the peak survives
+    n = retention_query(&r, t0, newest, 10, &pts, &res);
+    assert(n > 0 && n <= 10);
+    long peak = 0;
+    for (int i = 0; i < n; i++) peak = pts[i].max[1] > peak ? pts[i].max[1] : peak;
+    assert(peak == 10799 && pts[0].min[1] == 0);
+    free(pts);
+    retention_close(&r);
+
+    //4 days at 1 min, older than a day comes from hour rollups
+    assert(retention_open(&r, NULL, 42, 0) == 0);
+    for (long i = 0; i < 4 * 1440; i++) {
+        long row[RETAIN_COLS] = { i, i, i, i };
+        retention_append(&r, t0 + i * RETAIN_MINUTE_MS, row);
+    }
+    newest = r.st->newest_ms;
+    n = retention_query(&r, t0, newest, 0, &pts, &res);
+    assert(res == RETAIN_HOUR_MS && n == 96);
+    assert(pts[0].count == 60 && pts[0].max[3] == 59 && pts[95].min[2] == 95 * 60);
+    free(pts);
+    retention_close(&r);
+
+    //a file backed store survives close and reopen
+    char path[] = "/tmp/memtrc_test_ret_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+    assert(!retention_is_store(path));
+    assert(retention_open(&r, path, 7, 0) == 0);
+    for (long i = 0; i < 100; i++) {
+        long row[RETAIN_COLS] = { i, i, i, i };
+        retention_append(&r, t0 + i * 1000, row);
+    }
+    retention_close(&r);
+    assert(retention_is_store(path));
+    assert(retention_open(&r, path, 0, 0) == 0);
+    assert(r.st->raw_head == 100 && r.st->pid == 7 && r.st->newest_ms == t0 + 99000);
+
+    FILE *tmp = tmpfile();
+    assert(tmp != NULL);
+    assert(retention_export(&r, tmp, t0, t0 + 9999, 0) == 10);
+    rewind(tmp);
+    char line[512];
+    int lines = 0;
+    assert(fgets(line, sizeof(line), tmp) && strncmp(line, "ts_ms,resolution_ms,count,vsz_min", 33) == 0);
+    int comments = 0;
+    while (fgets(line, sizeof(line), tmp)) {
+        if (line[0] == '#') comments++;
+        else lines++;
+    }
+    assert(lines == 10 && comments == 2);
+    assert(r.st->rss_dist.count == 100 && r.st->rss_dist.max == 99);
+    fclose(tmp);
+    retention_close(&r);
+
+    //a file holding something else is left alone unless reset is asked for
+    FILE *fp = fopen(path, "w");
+    assert(fp);
+    fputs("ts_ms,rss_kb\n1,2\n", fp);
+    fclose(fp);
+    struct stat sb;
+    assert(retention_open(&r, path, 0, 0) == -1);
+    assert(stat(path, &sb) == 0 && sb.st_size == 17);
+    assert(retention_open(&r, path, 0, 1) == 0 && r.st->raw_head == 0);
+    retention_close(&r);
+    assert(retention_is_store(path));
+    unlink(path);
+
+    char *args[MAX_ARGS];
+    int arg_count;
+    char cmd_line[] = "history 6h -f memory.ret";
+    assert(parse_command(cmd_line, args, &arg_count) == CMD_HISTORY);
+    assert(arg_count == 4);
+    char cmd_line2[] = "export day.csv 1d";
+    assert(parse_command(cmd_line2, args, &arg_count) == CMD_EXPORT);
+
+    printf("test_retention passed!\n");
+}
+
+
+void test_sketch(void) {
+    printf("Testing quantile sketch functionality...\n");
+    sketch_t *a = malloc(3 * sizeof(sketch_t));
+    assert(a != NULL);
+    sketch_t *b = &a[1], *all = &a[2];
+    sketch_init(a);
+    sketch_init(b);
+    sketch_init(all);
+    assert(sketch_quantile(a, 0.5) == 0);
+
+    //small values are exact
+    for (long v = 1; v <= 100; v++) sketch_add(a, v);
+    assert(sketch_quantile(a, 0.50) == 50 && sketch_quantile(a, 0.99) == 99);
+    assert(sketch_quantile(a, 0) == 1 && sketch_quantile(a, 1) == 100);
+
+    //byte sized values stay within the bucket error, and never below the truth
+    sketch_init(a);
+    for (long i = 1; i <= 100000; i++) {
+        long v = i * 40960;
+        sketch_add(i % 2 ? a : b, v);
+        sketch_add(all, v);
+    }
+    long exact[3] = { 50000L * 40960, 95000L * 40960, 99000L * 40960 };
+    double qs[3] = { 0.50, 0.95, 0.99 };
+    for (int i = 0; i < 3; i++) {
+        long got = sketch_quantile(all, qs[i]);
+        assert(got >= exact[i] && got - exact[i] <= exact[i] / 128);
+    }
+    assert(sketch_quantile(all, 1) == 100000L * 40960);
+
+    //two halves merged answer like the whole
+    sketch_merge(a, b);
+    assert(a->count == all->count && a->max == all->max && a->min == all->min);
+    for (int i = 0; i < 3; i++) {
+        assert(sketch_quantile(a, qs[i]) == sketch_quantile(all, qs[i]));
+    }
+
+    //beyond the range, still counted and max stays exact
+    sketch_add(all, LONG_MAX);
+    assert(sketch_quantile(all, 1) == LONG_MAX);
+    free(a);
+
+    char *args[MAX_ARGS];
+    int arg_count;
+    char cmd_line[] = "analyze a.log b.log -t 2";
+    assert(parse_command(cmd_line, args, &arg_count) == CMD_ANALYZE);
+    assert(arg_count == 5);
+
+    printf("test_sketch passed!\n");
+}
+
+
+void test_pressure(void) {
+    printf("Testing pressure co-sampling functionality...\n");
+    sys_pressure_t sys;
+    assert(read_sys_pressure(&sys) == 0);   //the live vmstat is always there
+
+    char root[] = "/tmp/memtrc_test_psi_XXXXXX";
+    assert(mkdtemp(root) != NULL);
+    fixture_opts_t opts;
+    fixture_default_opts(&opts);
+    opts.count = 3;
+    assert(fixture_generate(root, &opts) == 0);
+    assert(set_procfs_root(root) == 0);
+
+    //anon/file split the same scans, they must not be added twice
+    assert(fixture_write_system(root, 10) == 0);
+    assert(read_sys_pressure(&sys) == 0);
+    assert(sys.has_psi && sys.some_total == 150000 && sys.full_total == 50000);
+    assert(sys.some_avg10 > 1.49 && sys.some_avg10 < 1.51);
+    assert(sys.pgscan == 20000 && sys.pgsteal == 10000);
+    assert(sys.pswpin == 100 && sys.pswpout == 200);
+
+    //one read per tick, shared by every target of that tick
+    pressure_sample_t a, b, c;
+    assert(pressure_sample(1000, 5000, &a) == 0);
+    assert(fixture_write_system(root, 20) == 0);
+    assert(pressure_sample(1001, 5000, &b) == 0);
+    assert(b.sys.pgscan == a.sys.pgscan);
+    assert(pressure_sample(1000, 6000, &c) == 0);
+    assert(c.sys.pgscan == 40000);
+
+    fixture_proc_t proc;
+    fixture_make_proc(&opts, 0, &proc);
+    assert(a.minflt == proc.minflt && a.majflt == proc.majflt);
+    assert(pressure_sample(999999, 6000, &b) == -1);
+
+    pressure_rates_t rates;
+    assert(pressure_rates(&c, &a, &rates) == -1);
+    assert(pressure_rates(&a, &c, &rates) == 0);
+    assert(rates.minflt == 0 && rates.pgscan == 20000 && rates.pswpout == 200);
+    assert(rates.some_pct > 14.99 && rates.some_pct < 15.01);
+    assert(rates.full_pct > 4.99 && rates.full_pct < 5.01);
+
+    //extra log columns don't disturb the parser
+    mem_info_t info = { .proc_type = PROC_TYPE_USER, .vmsize = 4096, .vmrss = 2048 };
+    FILE *tmp = tmpfile();
+    assert(tmp != NULL);
+    write_log_ex(tmp, 1700000000123LL, &info, &rates);
+    rewind(tmp);
+    char line[512];
+    assert(fgets(line, sizeof(line), tmp) != NULL);
+    assert(strstr(line, "majflt/s: 0.0, psi some: 15.00%, psi full: 5.00%, pgscan/s: 20000") != NULL);
+    log_record_t rec;
+    assert(parse_log_line(line, strlen(line) - 1, &rec) == 1);
+    assert(rec.vmrss == 2048 && rec.vmsize == 4096);
+    fclose(tmp);
+
+    char *args[MAX_ARGS];
+    int arg_count;
+    char cmd_line[] = "trace 1 -c -p";
+    assert(parse_command(cmd_line, args, &arg_count) == CMD_TRACE);
+    assert(arg_count == 4);
+
+    assert(set_procfs_root("/proc") == 0);
+    assert(fixture_remove(root) == 0);
+    printf("test_pressure passed!\n");
+}
+
+
+//runs in a child started with the preload library, see test_allocprof
+static int alloc_child(void) {
+    static void *volatile keep[400];
+    for (int i = 0; i < 400; i++) {
+        keep[i] = malloc(16384);
+        memset(keep[i], 1, 16384);
+    }
+    for (int i = 0; i < 200; i++) free(keep[i]);
+    //a worker that exits without exec must leave our segment alone
+    pid_t worker = fork();
+    if (worker == 0) {
+        free(malloc(16384));
+        exit(0);
+    }
+    if (worker < 0 || waitpid(worker, NULL, 0) != worker) return 1;
+    putchar('r');
+    fflush(stdout);
+    pause();
+    return 0;
+}
+
+
+static void push_event(allocprof_shm_t *shm, int ring, uint32_t type, uint64_t addr, uint64_t seq) {
+    allocprof_ring_t *r = &shm->rings[ring];
+    allocprof_event_t *ev = &r->events[r->head & (ALLOCPROF_RING_EVENTS - 1)];
+    memset(ev, 0, sizeof(allocprof_event_t));
+    ev->type = type;
+    ev->addr = addr;
+    ev->seq = seq;
+    ev->size = type == ALLOCPROF_ALLOC ? 4096 : 0;
+    ev->weight = type == ALLOCPROF_ALLOC ? 16384 : 0;
+    ev->depth = 1;
+    ev->frames[0] = 0x1234;
+    r->head++;
+}
+
+
+void test_allocprof(void) {
+    printf("Testing allocation profiler functionality...\n");
+    allocprof_t ap;
+    assert(allocprof_attach(&ap, getpid()) == -1);  //not preloaded
+
+    //a segment of our own: a free drained a poll before its alloc still matches it
+    char name[64];
+    snprintf(name, sizeof(name), ALLOCPROF_SHM_FMT, (int)getpid());
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    assert(fd >= 0 && ftruncate(fd, sizeof(allocprof_shm_t)) == 0);
+    allocprof_shm_t *shm = mmap(NULL, sizeof(allocprof_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    assert(shm != MAP_FAILED);
+    memcpy(shm->magic, ALLOCPROF_MAGIC, 4);
+    shm->version = ALLOCPROF_VERSION;
+    shm->nrings = ALLOCPROF_RINGS;
+    assert(allocprof_attach(&ap, getpid()) == 0);
+    push_event(shm, 1, ALLOCPROF_FREE, 0x1000, 11);
+    assert(allocprof_poll(&ap) == 1 && ap.npending == 1 && ap.unknown_frees == 0);
+    push_event(shm, 0, ALLOCPROF_ALLOC, 0x1000, 10);
+    push_event(shm, 0, ALLOCPROF_ALLOC, 0x2000, 12);
+    assert(allocprof_poll(&ap) == 2 && ap.npending == 0 && ap.unknown_frees == 0);
+    assert(allocprof_live(&ap) == 16384);   //only 0x2000 is live
+    push_event(shm, 1, ALLOCPROF_FREE, 0x3000, 13);
+    assert(allocprof_poll(&ap) == 1 && ap.unknown_frees == 0);
+    assert(allocprof_poll(&ap) == 0 && ap.npending == 0 && ap.unknown_frees == 1);
+    allocprof_detach(&ap);
+    munmap(shm, sizeof(allocprof_shm_t));
+    shm_unlink(name);
+
+    int fds[2];
+    assert(pipe(fds) == 0);
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        setenv("LD_PRELOAD", "./libmemtrc_preload.so", 1);
+        setenv("MEMTRC_SAMPLE_BYTES", "16384", 1);
+        execl("/proc/self/exe", "test", "--alloc-child", (char *)NULL);
+        _exit(127);
+    }
+    close(fds[1]);
+    char c;
+    assert(read(fds[0], &c, 1) == 1 && c == 'r');
+    close(fds[0]);
+
+    //200 blocks of 16 KB are still live, the estimate is within sampling error
+    assert(allocprof_attach(&ap, pid) == 0);
+    assert(ap.shm->sample_bytes == 16384);
+    assert(allocprof_poll(&ap) > 0);
+    int64_t live = allocprof_live(&ap);
+    assert(live > 200 * 16384 * 3 / 4 && live < 200 * 16384 * 5 / 4);
+    assert(allocprof_poll(&ap) == 0);
+
+    //the loop is the top site (stdio may add a small one), named after our own binary
+    allocprof_site_t *top[ALLOCPROF_TOP];
+    assert(allocprof_top(&ap, top, ALLOCPROF_TOP) >= 1);
+    assert(top[0]->live > live * 9 / 10 && top[0]->allocs > top[0]->frees && top[0]->depth > 0);
+    FILE *tmp = tmpfile();
+    assert(tmp != NULL);
+    allocprof_report(&ap, tmp, ALLOCPROF_TOP);
+    rewind(tmp);
+    char line[512];
+    assert(fgets(line, sizeof(line), tmp) && strstr(line, "1 sample per 16 KB"));
+    assert(fgets(line, sizeof(line), tmp) && strstr(line, "test+0x"));
+    fclose(tmp);
+    assert(top[0]->reported == top[0]->live);   //growth is measured from the report
+
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    allocprof_detach(&ap);  //the killed target's segment goes with it
+    char shm_path[64];
+    snprintf(shm_path, sizeof(shm_path), "/dev/shm/memtrc-%d", pid);
+    assert(access(shm_path, F_OK) != 0);
+
+    char *args[MAX_ARGS];
+    int arg_count;
+    char cmd_line[] = "trace 1 -A";
+    assert(parse_command(cmd_line, args, &arg_count) == CMD_TRACE);
+    assert(arg_count == 3);
+    printf("test_allocprof passed!\n");
+}
+
+
+//started by test_run, touches 32 MB and keeps it long enough to be sampled
+static int run_child(void) {
+    size_t size = 32 << 20;
+    char *p = malloc(size);
+    if (!p) return 1;
+    memset(p, 1, size);
+    struct timespec ts = { 0, 50 * 1000000 };
+    nanosleep(&ts, NULL);
+    free(p);
+    return 3;
+}
+
+
+void test_run(void) {
+    printf("Testing run functionality...\n");
+    launch_t run;
+    char *missing[] = { "/nonexistent/memtrc-cmd", NULL };
+    assert(launch_run(&run, missing, LAUNCH_MAX_MS) == -1);
+    launch_free(&run);
+    char *none[] = { NULL };
+    assert(launch_run(&run, none, LAUNCH_MAX_MS) == -1);
+
+    char *argv[] = { "/proc/self/exe", "--run-child", NULL };
+    assert(launch_run(&run, argv, LAUNCH_MAX_MS) == 0);
+    assert(WIFEXITED(run.status) && WEXITSTATUS(run.status) == 3);
+    assert(run.count > 10 && run.wall_us >= 50000);
+    assert(run.ru.ru_maxrss >= 32 * 1024);
+    assert(run.vmhwm >= 32L << 20 && run.peak_rss >= 32L << 20);
+    //dense at first: the first millisecond alone holds several samples
+    size_t early = 0;
+    for (size_t i = 0; i < run.count; i++) {
+        if (i > 0) assert(run.samples[i].t_us >= run.samples[i - 1].t_us);
+        if (run.samples[i].t_us < 1000) early++;
+    }
+    assert(early >= 2);
+    if (run.traced) assert(run.samples[0].t_us == 0);
+    launch_report(&run);
+    launch_free(&run);
+    assert(run.samples == NULL && run.count == 0);
+
+    char *args[MAX_ARGS];
+    int arg_count;
+    char cmd_line[] = "run -m 50 -- ls -l";
+    assert(parse_command(cmd_line, args, &arg_count) == CMD_RUN);
+    assert(arg_count == 6);
+    printf("test_run passed!\n");
+}
+
+
+void test_faultprof(void) {
+    printf("Testing page fault sampling functionality...\n");
+    faultprof_t fp;
+    assert(faultprof_attach(&fp, 0, 1) == -1);
+    assert(faultprof_attach(&fp, getpid(), 0) == -1);
+
+    int go[2], done[2];
+    assert(pipe(go) == 0 && pipe(done) == 0);
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        //touch 4096 fresh small pages once we are watched, then report where
+        char c;
+        if (read(go[0], &c, 1) != 1) _exit(1);
+        size_t size = 4096 * 4096;
+        char *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) _exit(1);
+        madvise(p, size, MADV_NOHUGEPAGE);
+        for (size_t off = 0; off < size; off += 4096) ((volatile char *)p)[off] = 1;
+        if (write(done[1], &p, sizeof(p)) != sizeof(p)) _exit(1);
+        pause();
+        _exit(0);
+    }
+    if (faultprof_attach(&fp, pid, 1) != 0) {
+        //perf_event_open is commonly blocked in containers, nothing to test then
+        printf("perf_event_open unavailable, skipped\n");
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        return;
+    }
+    assert(fp.nrings == 1);
+    char *region;
+    assert(write(go[1], "g", 1) == 1);
+    assert(read(done[0], &region, sizeof(region)) == sizeof(region));
+
+    //the ring holds all 4096 samples, so nothing is lost and the mapping wins
+    assert(faultprof_poll(&fp) >= 4096);
+    assert(fp.lost == 0 && fp.minor >= 4096);
+    const faultprof_region_t *regions[FAULTPROF_TOP];
+    assert(faultprof_top_regions(&fp, regions, FAULTPROF_TOP) >= 1);
+    assert(regions[0]->start <= (uint64_t)region && (uint64_t)region < regions[0]->end);
+    assert(regions[0]->minor >= 4096 && strcmp(regions[0]->name, "anon") == 0);
+    const faultprof_site_t *sites[FAULTPROF_TOP];
+    assert(faultprof_top_sites(&fp, sites, FAULTPROF_TOP) >= 1);
+    assert(sites[0]->minor >= 4096);
+    FILE *tmp = tmpfile();
+    assert(tmp != NULL);
+    faultprof_report(&fp, tmp, FAULTPROF_TOP);
+    rewind(tmp);
+    char line[512];
+    assert(fgets(line, sizeof(line), tmp) && strstr(line, "0 lost"));
+    assert(fgets(line, sizeof(line), tmp) && strstr(line, "anon"));
+    int named = 0;
+    while (fgets(line, sizeof(line), tmp)) {
+        if (strstr(line, "at test+0x")) named = 1;  //the loop above, in our own binary
+    }
+    assert(named);
+    fclose(tmp);
+    assert(faultprof_poll(&fp) == 0);
+
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    faultprof_detach(&fp);
+    assert(fp.sites == NULL && fp.nrings == 0);
+    close(go[0]);
+    close(go[1]);
+    close(done[0]);
+    close(done[1]);
+
+    char *args[MAX_ARGS];
+    int arg_count;
+    char cmd_line[] = "trace 1 -F 16";
+    assert(parse_command(cmd_line, args, &arg_count) == CMD_TRACE);
+    assert(arg_count == 4);
+    printf("test_faultprof passed!\n");
+}
+
+
+void test_colstore(void) {
+    printf("Testing column store functionality...\n");
+    colstore_t cs;
+    assert(colstore_init(&cs, 0) == 0);
+    colstore_agg_t agg;
+    colstore_aggregate(&cs, COL_RSS, 0, &agg);
+    assert(agg.n == 0 && agg.sum == 0);
+
+    //odd count, so every vector kernel also runs its scalar tail
+    srand(7);
+    const size_t n = 1003;
+    int64_t sum = 0;
+    int32_t lo = INT32_MAX, hi = 0;
+    size_t above = 0;
+    for (size_t i = 0; i < n; i++) {
+        mem_info_t info = { .proc_type = PROC_TYPE_USER };
+        info.vmrss = (long)(rand() % 4000000) * KB_UNIT;
+        if (i == 500) info.vmrss = (long)INT32_MAX * KB_UNIT;   //large values widen right
+        info.vmsize = info.vmrss * 2;
+        assert(colstore_set(&cs, i, 1000 + i, &info) == 0);
+        int32_t kb = (int32_t)(info.vmrss / KB_UNIT);
+        sum += kb;
+        if (kb < lo) lo = kb;
+        if (kb > hi) hi = kb;
+        above += kb > 1000000;
+    }
+    assert(cs.count == n && cs.cap >= n);
+    assert(((uintptr_t)cs.cols[COL_RSS] & (COLSTORE_ALIGN - 1)) == 0);
+
+    colstore_kernel_t kernels[] = { COLSTORE_KERNEL_SCALAR, COLSTORE_KERNEL_SSE2, COLSTORE_KERNEL_AVX2 };
+    for (int k = 0; k < 3; k++) {
+        if (colstore_set_kernel(kernels[k]) != 0) {
+            printf("%s kernel unsupported, skipped\n", colstore_kernel_name(kernels[k]));
+            continue;
+        }
+        assert(colstore_get_kernel() == kernels[k]);
+        colstore_aggregate(&cs, COL_RSS, 1000000, &agg);
+        assert(agg.n == n && agg.sum == sum && agg.min == lo && agg.max == hi);
+        assert(agg.above == above);
+        printf("%s kernel ok\n", colstore_kernel_name(kernels[k]));
+    }
+    assert(colstore_set_kernel(COLSTORE_KERNEL_AUTO) == 0);
+    assert(colstore_get_kernel() != COLSTORE_KERNEL_AUTO);
+
+    //windows fold ticks, the mean is over slot-ticks
+    colstore_window_t w;
+    colstore_window_reset(&w);
+    colstore_aggregate(&cs, COL_RSS, 1000000, &agg);
+    colstore_window_add(&w, &agg);
+    colstore_remove(&cs, 500);
+    assert(cs.count == n - 1 && cs.pids[500] == (pid_t)(1000 + n - 1));
+    colstore_aggregate(&cs, COL_RSS, 1000000, &agg);
+    assert(agg.max < hi && agg.above == above - 1);
+    colstore_window_add(&w, &agg);
+    assert(w.ticks == 2 && w.n == 2 * n - 1 && w.max == hi && w.above_peak == above);
+    assert(colstore_window_mean(&w) == (double)(2 * sum - hi) / (2 * n - 1));
+
+    //a sampler tick loads the user targets that answered
+    sampler_t s;
+    assert(sampler_init(&s, SAMPLER_PREAD) == 0);
+    assert(sampler_add(&s, getpid()) == 0);
+    assert(sampler_tick(&s) == 1);
+    assert(colstore_load(&cs, &s) == 1);
+    assert(cs.pids[0] == getpid() && cs.cols[COL_RSS][0] == s.targets[0].info.vmrss / KB_UNIT);
+    sampler_free(&s);
+    colstore_free(&cs);
+    assert(cs.count == 0 && cs.cols[0] == NULL);
+    printf("test_colstore passed!\n");
+}
+
+
+void test_sink(void) {
+    printf("Testing csv / json lines output functionality...\n");
+    char buf[64];
+    long vals[] = { 0, 7, 10, 99, 100, 12345, -1, 1099511627776L, LONG_MIN };
+    for (size_t i = 0; i < sizeof(vals) / sizeof(vals[0]); i++) {
+        char want[64];
+        snprintf(want, sizeof(want), "%ld", vals[i]);
+        *sink_put_long(buf, vals[i]) = '\0';
+        assert(strcmp(buf, want) == 0);
+    }
+    sink_format_t fmt;
+    assert(sink_parse_format("jsonl", &fmt) == 0 && fmt == SINK_JSONL);
+    assert(sink_parse_format("xml", &fmt) == -1);
+
+    char path[] = "/tmp/memtrc_test_sink_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+    //the date part must match strftime, including a second change between rows
+    long long ts = 1700000000999LL;
+    char date[2][32];
+    for (int k = 0; k < 2; k++) {
+        time_t t = (time_t)(ts / 1000 + k);
+        struct tm tm_info;
+        localtime_r(&t, &tm_info);
+        strftime(date[k], sizeof(date[k]), "%Y-%m-%dT%H:%M:%S", &tm_info);
+    }
+    mem_info_t info = { 4096L * 1024, 1024L * 1024, 512L * 1024, 132L * 1024, PROC_TYPE_USER };
+    sink_t s;
+    assert(sink_open(&s, path, SINK_CSV, 0, 0) == 0);
+    assert(sink_write(&s, ts, 42, &info) == 1);
+    assert(sink_write(&s, ts + 2, 42, &info) == 1);
+    sink_close(&s);
+    //appending to a file that has rows adds no second header
+    assert(sink_open(&s, path, SINK_CSV, 0, 0) == 0);
+    assert(sink_write(&s, ts + 3, 42, &info) == 1);
+    sink_close(&s);
+    FILE *fp = fopen(path, "r");
+    assert(fp);
+    char line[256], want[256];
+    assert(fgets(line, sizeof(line), fp) && strcmp(line, "ts_ms,time,pid,type,vsz_kb,rss_kb,data_kb,stack_kb\n") == 0);
+    snprintf(want, sizeof(want), "%lld,%s.999,42,user,4096,1024,512,132\n", ts, date[0]);
+    assert(fgets(line, sizeof(line), fp) && strcmp(line, want) == 0);
+    snprintf(want, sizeof(want), "%lld,%s.001,42,user,4096,1024,512,132\n", ts + 2, date[1]);
+    assert(fgets(line, sizeof(line), fp) && strcmp(line, want) == 0);
+    assert(fgets(line, sizeof(line), fp) && strncmp(line, "1700000001002,", 14) == 0);
+    assert(!fgets(line, sizeof(line), fp));
+    fclose(fp);
+
+    //deadband: small moves are held back until the heartbeat
+    assert(truncate(path, 0) == 0);
+    assert(sink_open(&s, path, SINK_JSONL, 64, 5000) == 0);
+    assert(sink_write(&s, ts, 42, &info) == 1);
+    info.vmrss += 32 * 1024;
+    assert(sink_write(&s, ts + 1000, 42, &info) == 0);
+    info.vmrss += 64 * 1024;    //96 KB from the last row written
+    assert(sink_write(&s, ts + 2000, 42, &info) == 1);
+    assert(sink_write(&s, ts + 3000, 42, &info) == 0);
+    assert(sink_write(&s, ts + 7000, 42, &info) == 1);
+    assert(s.rows == 3 && s.suppressed == 2);
+    sink_close(&s);
+    fp = fopen(path, "r");
+    assert(fp);
+    snprintf(want, sizeof(want), "{\"ts_ms\":%lld,\"time\":\"%s.999\",\"pid\":42,\"type\":\"user\","
+             "\"vsz_kb\":4096,\"rss_kb\":1024,\"data_kb\":512,\"stack_kb\":132}\n", ts, date[0]);
+    assert(fgets(line, sizeof(line), fp) && strcmp(line, want) == 0);
+    assert(fgets(line, sizeof(line), fp) && strstr(line, "\"rss_kb\":1120,"));
+    assert(fgets(line, sizeof(line), fp) && strstr(line, "\"ts_ms\":1700000007999,"));
+    assert(!fgets(line, sizeof(line), fp));
+    fclose(fp);
+
+    //a band per pid, the rows of one don't reset the deadband of the other
+    assert(truncate(path, 0) == 0);
+    sink_band_t band[2];
+    memset(band, 0, sizeof(band));
+    mem_info_t other = info;
+    other.vmrss += 1024 * 1024;
+    assert(sink_open(&s, path, SINK_CSV, 64, 5000) == 0);
+    assert(sink_write_band(&s, &band[0], ts, 42, &info) == 1);
+    assert(sink_write_band(&s, &band[1], ts, 43, &other) == 1);
+    assert(sink_write_band(&s, &band[0], ts + 1000, 42, &info) == 0);
+    assert(sink_write_band(&s, &band[1], ts + 1000, 43, &other) == 0);
+    assert(s.rows == 2 && s.suppressed == 2);
+    sink_close(&s);
+
+    //a one shot trace writes its sample once
+    assert(truncate(path, 0) == 0);
+    config_t *cfg = malloc(sizeof(config_t));
+    assert(cfg && init_config(cfg) != 0);
+    char *args[MAX_ARGS];
+    int arg_count;
+    char once[PATH_MAX + 64];
+    snprintf(once, sizeof(once), "trace %d -o csv %s", getpid(), path);
+    assert(parse_command(once, args, &arg_count) == CMD_TRACE);
+    assert(execute_command(cfg, CMD_TRACE, args, arg_count) == 0);
+    assert(cfg->sink == NULL);
+    cleanup_config(cfg);
+    free(cfg);
+    fp = fopen(path, "r");
+    assert(fp);
+    int rows = 0;
+    while (fgets(line, sizeof(line), fp)) rows++;
+    fclose(fp);
+    assert(rows == 2);      //header and one row
+    unlink(path);
+
+    char cmd_line[] = "trace 1 -c -o jsonl out.jsonl -d 64:10";
+    assert(parse_command(cmd_line, args, &arg_count) == CMD_TRACE);
+    assert(arg_count == 8);
+    printf("test_sink passed!\n");
+}
+
+
+typedef struct {
+    pid_t pid;
+    int attached;
+    int detached;
+} watch_seen_t;
+
+
+static void watch_cb(void *ctx, pid_t pid, procwatch_what_t what, const char *comm) {
+    watch_seen_t *seen = ctx;
+    if (pid != seen->pid) return;
+    assert(strcmp(comm, "sleep") == 0);
+    if (what == PROCWATCH_ATTACH) seen->attached++;
+    else seen->detached++;
+}
+
+
+//a sleep with an argument nothing else on the host has, held until released
+static pid_t spawn_sleeper(int *release) {
+    int fds[2];
+    assert(pipe(fds) == 0);
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        char c;
+        close(fds[1]);
+        if (read(fds[0], &c, 1) != 1) _exit(1);
+        execl("/bin/sleep", "sleep", "7.31415", (char *)NULL);
+        _exit(127);
+    }
+    close(fds[0]);
+    *release = fds[1];
+    return pid;
+}
+
+
+static void watch_until(procwatch_t *pw, int *flag) {
+    for (int i = 0; i < 200 && !*flag; i++) {
+        if (pw->mode == PROCWATCH_NETLINK) {
+            struct pollfd pfd = { pw->fd, POLLIN, 0 };
+            if (poll(&pfd, 1, 10) > 0) procwatch_poll(pw);
+        } else {
+            usleep(10000);
+            procwatch_poll(pw);
+        }
+    }
+}
+
+
+void test_procwatch(void) {
+    printf("Testing procwatch...\n");
+    procwatch_t pw;
+    assert(procwatch_open(NULL, "x", 0, watch_cb, NULL) == -1);
+    assert(procwatch_open(&pw, "(", 0, watch_cb, NULL) == -1);
+
+    //events: listening before the exec, attached on it and dropped at exit
+    watch_seen_t seen = { 0 };
+    int release;
+    seen.pid = spawn_sleeper(&release);
+    assert(procwatch_open(&pw, "sleep 7\\.31415", 0, watch_cb, &seen) == 0);
+    assert(seen.attached == 0 && pw.count == 0);
+    assert(write(release, "x", 1) == 1);
+    close(release);
+    watch_until(&pw, &seen.attached);
+    assert(seen.attached == 1 && procwatch_find(&pw, seen.pid));
+    if (pw.mode == PROCWATCH_NETLINK) {
+        assert(pw.events > 0 && pw.scans == 1);
+        assert(pw.latency_n == 1 && pw.latency_max_ns < 1000000000LL);
+    }
+    kill(seen.pid, SIGKILL);
+    waitpid(seen.pid, NULL, 0);
+    watch_until(&pw, &seen.detached);
+    assert(seen.detached == 1 && !procwatch_find(&pw, seen.pid) && pw.count == 0);
+    procwatch_close(&pw);
+
+    //rescans: an existing match is reported by open, its exit by a later poll
+    memset(&seen, 0, sizeof(seen));
+    seen.pid = spawn_sleeper(&release);
+    assert(write(release, "x", 1) == 1);
+    close(release);
+    char path[64], comm[32] = "";
+    snprintf(path, sizeof(path), "/proc/%d/comm", seen.pid);
+    for (int i = 0; i < 200 && strncmp(comm, "sleep", 5) != 0; i++) {   //wait for the exec
+        usleep(5000);
+        FILE *fp = fopen(path, "r");
+        if (fp && !fgets(comm, sizeof(comm), fp)) comm[0] = '\0';
+        if (fp) fclose(fp);
+    }
+    assert(procwatch_open(&pw, "^sleep$", 1, watch_cb, &seen) == 0);
+    assert(pw.mode == PROCWATCH_SCAN && pw.fd == -1);
+    assert(seen.attached == 1 && pw.scans == 1);
+    procwatch_poll(&pw);
+    assert(seen.attached == 1 && pw.scans == 2);
+    kill(seen.pid, SIGKILL);
+    waitpid(seen.pid, NULL, 0);
+    watch_until(&pw, &seen.detached);
+    assert(seen.detached == 1);
+    procwatch_close(&pw);
+
+    char *args[MAX_ARGS];
+    int arg_count;
+    char cmd_line[] = "trace --match ^worker -i 1 --scan";
+    assert(parse_command(cmd_line, args, &arg_count) == CMD_TRACE);
+    assert(arg_count == 6 && strcmp(args[2], "^worker") == 0);
+
+    //a deadband is validated as for a single pid and needs an output
+    config_t *cfg = malloc(sizeof(config_t));
+    assert(cfg && init_config(cfg) != 0);
+    char bad_heartbeat[] = "trace --match ^worker -d 64:-5 -o csv /dev/null";
+    assert(parse_command(bad_heartbeat, args, &arg_count) == CMD_TRACE);
+    assert(execute_command(cfg, CMD_TRACE, args, arg_count) == 0 && cfg->sink == NULL);
+    char no_output[] = "trace --match ^worker -d 64";
+    assert(parse_command(no_output, args, &arg_count) == CMD_TRACE);
+    assert(execute_command(cfg, CMD_TRACE, args, arg_count) == 0 && cfg->sink == NULL);
+    cleanup_config(cfg);
+    free(cfg);
+    printf("test_procwatch passed!\n");
+}
+
+
+void test_leader(void) {
+    printf("Testing growth leaderboard...\n");
+    leader_t lb;
+    assert(leader_init(NULL, 1000) == -1);
+    assert(leader_init(&lb, 0) == -1);
+    assert(sizeof(leader_entry_t) == 32);
+
+    char root[] = "/tmp/memtrc_test_leader_XXXXXX";
+    assert(mkdtemp(root) != NULL);
+    fixture_opts_t opts;
+    fixture_default_opts(&opts);
+    opts.count = 40;
+    opts.kernel_every = 4;
+    opts.smaps_mappings = 0;
+    assert(fixture_generate(root, &opts) == 0);
+    assert(set_procfs_root(root) == 0);
+
+    //window of 4 s, a baseline every second
+    assert(leader_init(&lb, 4000) == 0);
+    assert(leader_scan(&lb, 10000) == 30);      //kernel threads have no rss
+    leader_totals_t t;
+    leader_totals(&lb, 10000, &t);
+    assert(t.procs == 30 && t.new_n == 0 && t.grown_kb == 0 && t.exited_n == 0);
+
+    //index 0 doubles, index 1 grows a little from a bigger start, index 2 exits,
+    //index 5 is replaced by a new process under the same pid, one more is born
+    fixture_proc_t a, b, gone, reused, fresh;
+    fixture_make_proc(&opts, 0, &a);
+    fixture_make_proc(&opts, 1, &b);
+    fixture_make_proc(&opts, 2, &gone);
+    fixture_make_proc(&opts, 5, &reused);
+    fixture_make_proc(&opts, opts.count, &fresh);
+    long a_base = a.vmrss_kb;
+    a.vmrss_kb *= 2;
+    reused.starttime += 5000;
+    assert(fixture_write_proc(root, &a, &opts) == 0);
+    assert(fixture_write_proc(root, &reused, &opts) == 0);
+    assert(fixture_write_proc(root, &fresh, &opts) == 0);
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%d", root, gone.pid);
+    assert(fixture_mark(path) == 0 && fixture_remove(path) == 0);   //the pid exits
+    assert(leader_scan(&lb, 10500) == 30);
+    leader_totals(&lb, 10500, &t);
+    assert(t.new_n == 2 && t.exited_n == 2 && t.grown_kb == a.vmrss_kb - a_base);
+    assert(t.new_kb == reused.vmrss_kb + fresh.vmrss_kb);
+
+    leader_row_t rows[4];
+    assert(leader_top(&lb, LEADER_ABS, rows, 4) == 1);
+    assert(rows[0].pid == a.pid && rows[0].base_kb == a_base && rows[0].rss_kb == a.vmrss_kb);
+    assert(leader_top(&lb, LEADER_NEW, rows, 4) == 2 && rows[0].base_kb == -1);
+    assert(rows[0].rss_kb >= rows[1].rss_kb);
+
+    //b gains more KB than a but less relative to where it started
+    fixture_make_proc(&opts, 1, &b);
+    long b_base = b.vmrss_kb;
+    b.vmrss_kb += a.vmrss_kb - a_base + 4096;
+    assert(fixture_write_proc(root, &b, &opts) == 0);
+    assert(leader_scan(&lb, 11000) == 30);
+    assert(leader_top(&lb, LEADER_ABS, rows, 4) == 2);
+    assert(rows[0].pid == b.pid && rows[0].rss_kb - rows[0].base_kb == b.vmrss_kb - b_base);
+    assert(leader_top(&lb, LEADER_REL, rows, 1) == 1);
+    assert(rows[0].pid == (b_base < a_base ? b.pid : a.pid));
+
+    //after a whole window everything is measured from the new baselines
+    for (long long now = 12000; now <= 15000; now += 1000) assert(leader_scan(&lb, now) == 30);
+    leader_totals(&lb, 15000, &t);
+    assert(t.new_n == 0 && t.exited_n == 0 && t.grown_kb == 0 && t.span_ms == 4000);
+    assert(leader_top(&lb, LEADER_ABS, rows, 4) == 0);
+    assert(leader_scan(&lb, 60000) == 30);     //a long gap starts over
+    leader_totals(&lb, 60000, &t);
+    assert(t.span_ms == 0);
+
+    FILE *fp = tmpfile();
+    assert(fp);
+    leader_report(&lb, 60000, fp, 5);
+    rewind(fp);
+    char line[256];
+    assert(fgets(line, sizeof(line), fp) && strstr(line, "30 processes"));
+    fclose(fp);
+    leader_free(&lb);
+    assert(set_procfs_root("/proc") == 0);
+    assert(fixture_remove(root) == 0);
+
+    //the live system: at least ourselves
+    assert(leader_init(&lb, 60000) == 0);
+    assert(leader_scan(&lb, current_time_ms()) > 0);
+    leader_free(&lb);
+
+    char *args[MAX_ARGS];
+    int arg_count;
+    char cmd_line[] = "top -w 5m -n 20 -i 2";
+    assert(parse_command(cmd_line, args, &arg_count) == CMD_TOP);
+    assert(arg_count == 7);
+    printf("test_leader passed!\n");
+}
+
+
+void test_numa(void) {
+    printf("Testing numa_maps placement...\n");
+    numa_usage_t u;
+    assert(numa_parse(-1, &u) == -1);
+
+    //every kind, huge pages, a path with a space and enough lines to cross windows
+    FILE *fp = tmpfile();
+    assert(fp);
+    fprintf(fp, "55d0c0000000 default file=/usr/bin/db mapped=10 N0=6 N1=4 kernelpagesize_kB=4\n");
+    fprintf(fp, "55d0c1000000 default heap anon=300 dirty=300 N0=100 N1=200 kernelpagesize_kB=4\n");
+    fprintf(fp, "7ffd00000000 default stack anon=8 dirty=8 N1=8 kernelpagesize_kB=4\n");
+    fprintf(fp, "7f0000000000 bind:1 anon=4 dirty=4 N1=4 kernelpagesize_kB=2048\n");
+    fprintf(fp, "7f1000000000 default file=/data/my\\040table file=x mapped=2 N0=2 kernelpagesize_kB=4\n");
+    fprintf(fp, "7f2000000000 default\n");      //nothing resident
+    char path[3000];
+    memset(path, 'p', sizeof(path) - 1);
+    path[sizeof(path) - 1] = '\0';
+    for (int i = 0; i < 2000; i++) {
+        fprintf(fp, "7f3%09x default %s anon=1 dirty=1 N0=1 kernelpagesize_kB=4\n", i,
+                i % 100 == 0 ? "file=/x" : "");
+    }
+    fprintf(fp, "7f4000000000 default file=/%s mapped=1 N3=1 kernelpagesize_kB=4", path); //no newline
+    fflush(fp);
+    lseek(fileno(fp), 0, SEEK_SET);
+    assert(numa_parse(fileno(fp), &u) == 0);
+    assert(u.lines == 2007 && u.nodes == 4);
+    assert(u.kb[0][NUMA_FILE] == 24 + 8 + 20 * 4 && u.kb[1][NUMA_FILE] == 16);
+    assert(u.kb[0][NUMA_HEAP] == 400 && u.kb[1][NUMA_HEAP] == 800);
+    assert(u.kb[1][NUMA_STACK] == 32 && u.kb[1][NUMA_ANON] == 8192);
+    assert(u.kb[0][NUMA_ANON] == 1980 * 4 && u.kb[3][NUMA_FILE] == 4);
+    assert(numa_node_kb(&u, 1) == 16 + 800 + 32 + 8192 && numa_node_kb(&u, 2) == 0);
+    fclose(fp);
+
+    //ourselves, on the node we run on; the next sample waits for the interval
+    numa_t nm;
+    assert(numa_open(NULL, getpid(), 1000) == -1);
+    if (numa_open(&nm, getpid(), 60000) == 0) {
+        long long now = current_time_ms();
+        assert(numa_sample(&nm, now) == 1);
+        assert(nm.cur.lines > 10 && nm.local_kb > 0 && nm.local_nodes != 0);
+        assert(nm.node_hist[0].count == 1 && nm.remote_hist.count == 1);
+        assert(numa_sample(&nm, now + 1000) == 0);
+        assert(numa_sample(&nm, now + 60000) == 1 && nm.samples == 2);
+        fp = tmpfile();
+        assert(fp);
+        numa_report(&nm, fp);
+        rewind(fp);
+        char line[256];
+        assert(fgets(line, sizeof(line), fp) && strstr(line, "heap"));
+        fclose(fp);
+        numa_close(&nm);
+    } else {
+        printf("numa_maps not readable here, skipping the live part\n");
+    }
+
+    char *args[MAX_ARGS];
+    int arg_count;
+    char cmd_line[] = "trace 1 -N 30 -i 1";
+    assert(parse_command(cmd_line, args, &arg_count) == CMD_TRACE);
+    assert(arg_count == 6);
+    printf("test_numa passed!\n");
+}
+
+
+//a forked worker that stops after optionally dirtying the first half of buf
+static pid_t group_child(char *buf, size_t len, int dirty, int ready, int release) {
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        char c;
+        if (dirty) memset(buf, 2, len / 2);
+        if (write(ready, "r", 1) != 1 || read(release, &c, 1) < 0) _exit(1);
+        _exit(0);
+    }
+    return pid;
+}
+
+
+void test_group(void) {
+    printf("Testing process group footprint...\n");
+    group_t g;
+    assert(group_init(NULL) == -1);
+    assert(group_init(&g) == 0);
+    assert(group_add(&g, 0) == -1);
+    assert(group_scan(&g, 2) == -1);    //empty
+
+    //two workers forked from us: 8 MB copy-on-write, one of them rewrote 4 MB
+    size_t len = 8 << 20;
+    char *buf = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(buf != MAP_FAILED);
+    madvise(buf, len, MADV_NOHUGEPAGE);
+    memset(buf, 1, len);
+    int ready[2], release[2];
+    assert(pipe(ready) == 0 && pipe(release) == 0);
+    pid_t a = group_child(buf, len, 1, ready[1], release[0]);
+    pid_t b = group_child(buf, len, 0, ready[1], release[0]);
+    char c;
+    assert(read(ready[0], &c, 1) == 1 && read(ready[0], &c, 1) == 1);
+    assert(group_add(&g, a) == 0 && group_add(&g, b) == 0 && group_add(&g, a) == 0);
+    assert(g.count == 2);
+
+    if (group_scan(&g, 2) == 0) {
+        long kb = g.page_kb;
+        const group_member_t *ma = &g.members[0], *mb = &g.members[1];
+        assert(ma->error == 0 && mb->error == 0);
+        assert(ma->rss_pages * kb >= 8192 && mb->rss_pages * kb >= 8192);
+        //a's copies are its own, b keeps the originals it shares only with us
+        assert(ma->private_pages * kb >= 4096 && mb->private_pages * kb >= 4096);
+        assert(g.shared_pages * kb >= 4096);
+        assert(g.unique_pages == ma->private_pages + mb->private_pages + g.shared_pages);
+        assert(g.unique_pages < ma->rss_pages + mb->rss_pages);
+
+        //again with one worker, same answer
+        long unique = g.unique_pages;
+        assert(group_scan(&g, 1) == 0 && g.threads == 1 && g.unique_pages == unique);
+        FILE *fp = tmpfile();
+        assert(fp);
+        group_report(&g, fp);
+        rewind(fp);
+        char line[256];
+        assert(fgets(line, sizeof(line), fp) && strstr(line, "group of 2 processes"));
+        fclose(fp);
+    } else {
+        assert(geteuid() != 0);
+        printf("pagemap pfns need root, skipping the footprint checks\n");
+    }
+    assert(write(release[1], "xx", 2) == 2);
+    waitpid(a, NULL, 0);
+    waitpid(b, NULL, 0);
+    close(ready[0]);
+    close(ready[1]);
+    close(release[0]);
+    close(release[1]);
+    munmap(buf, len);
+    group_free(&g);
+
+    char *args[MAX_ARGS];
+    int arg_count;
+    char cmd_line[] = "group --match ^worker -t 4";
+    assert(parse_command(cmd_line, args, &arg_count) == CMD_GROUP);
+    assert(arg_count == 5);
+    printf("test_group passed!\n");
+}
+
+
+//slabinfo with count caches, slab i of them grown by grow[i] slabs
+static void kmem_write_slabinfo(const char *root, int count, const int *grow, int extra) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/slabinfo", root);
+    FILE *fp = fopen(path, "w");
+    assert(fp);
+    fprintf(fp, "slabinfo - version: 2.1\n# name            <active_objs> <num_objs> <objsize> "
+            "<objperslab> <pagesperslab> : tunables <limit> <batchcount> <sharedfactor> : "
+            "slabdata <active_slabs> <num_slabs> <sharedavail>\n");
+    for (int i = 0; i < count; i++) {
+        long slabs = 2 + i + (grow ? grow[i] : 0);
+        fprintf(fp, "cache%03d          %6ld %6ld %4d %4d %4d : tunables    0    0    0 : "
+                "slabdata %6ld %6ld      0\n", i, slabs * 32, slabs * 32, 128, 32, 1, slabs, slabs);
+    }
+    if (extra) {
+        fprintf(fp, "newcache          %6d %6d %4d %4d %4d : tunables    0    0    0 : "
+                "slabdata %6d %6d      0\n", 64, 64, 256, 16, 1, 4, 4);
+    }
+    fclose(fp);
+}
+
+
+static void kmem_write(const char *root, const char *name, const char *text) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", root, name);
+    FILE *fp = fopen(path, "w");
+    assert(fp);
+    fputs(text, fp);
+    fclose(fp);
+}
+
+
+void test_kmem(void) {
+    printf("Testing kernel memory sampling...\n");
+    char root[] = "/tmp/memtrc_test_kmem_XXXXXX";
+    assert(mkdtemp(root) != NULL);
+    assert(fixture_mark(root) == 0);
+    assert(kmem_init(NULL) == -1);
+    kmem_t km;
+    assert(kmem_init(&km) == 0);
+    long pk = km.page_kb;
+
+    //no meminfo, nothing sampled
+    assert(set_procfs_root(root) == 0);
+    assert(kmem_sample(&km, 1000) == -1 && km.samples == 0);
+
+    kmem_write(root, "meminfo", "MemTotal:       8000000 kB\nSlab:             1000 kB\n"
+               "SReclaimable:      600 kB\nSUnreclaim:        400 kB\nVmallocUsed:      2048 kB\n"
+               "PageTables:        300 kB\nKernelStack:       200 kB\n");
+    kmem_write(root, "vmallocinfo",
+               "0xffffc90000000000-0xffffc90000005000   20480 alloc_large_system_hash+0x1a/0x2b0 pages=4 vmalloc N0=4\n"
+               "0xffffc90000005000-0xffffc90000008000   12288 bpf_prog_alloc_no_stats+0x3c/0x1e0 pages=2 vmalloc\n"
+               "0xffffc90000008000-0xffffc9000000a000    8192 acpi_os_map_iomem+0x1b/0x1d0 phys=0xfed00000 ioremap\n"
+               "0xffffc9000000a000-0xffffc9000000c000    8192 unpurged vm_area\n");
+    //300 caches are several read windows
+    kmem_write_slabinfo(root, 300, NULL, 0);
+    assert(kmem_sample(&km, 1000) == 0);
+    assert(km.have_slabinfo && km.have_vmalloc && km.nslabs == 300 && km.slab_changed == 0);
+    assert(km.fields[KMEM_SLAB] == 1000 && km.fields[KMEM_KERNELSTACK] == 200);
+    assert(km.slabs[7].kb == 9 * pk && km.slabs[7].objsize == 128 && km.slabs[7].start_kb == 9 * pk);
+    const kmem_slab_t *top[KMEM_TOP];
+    const kmem_caller_t *callers[KMEM_TOP];
+    assert(kmem_top_slabs(&km, top, KMEM_TOP) == 0);
+    assert(kmem_top_callers(&km, callers, KMEM_TOP) == 0);
+
+    //three caches change, one appears, one goes; a caller grows and one is new
+    int grow[300] = { 0 };
+    grow[7] = 10;
+    grow[9] = 3;
+    grow[11] = -1;
+    kmem_write_slabinfo(root, 299, grow, 1);
+    kmem_write(root, "meminfo", "Slab:             1100 kB\nSReclaimable:      650 kB\n");
+    kmem_write(root, "vmallocinfo",
+               "0xffffc90000000000-0xffffc90000005000   20480 alloc_large_system_hash+0x1a/0x2b0 pages=4 vmalloc N0=4\n"
+               "0xffffc90000005000-0xffffc90000008000   12288 bpf_prog_alloc_no_stats+0x3c/0x1e0 pages=2 vmalloc\n"
+               "0xffffc90000010000-0xffffc90000020000   65536 bpf_prog_alloc_no_stats+0x3c/0x1e0 pages=16 vmalloc\n"
+               "0xffffc90000020000-0xffffc90000023000   12288 module_alloc+0x1/0x2 pages=3 vmalloc\n");
+    assert(kmem_sample(&km, 11000) == 0);
+    assert(km.slab_changed == 3 && km.nslabs == 301);
+    assert(km.fields[KMEM_SLAB] == 1100 && km.fields[KMEM_PAGETABLES] == -1);
+    assert(kmem_top_slabs(&km, top, KMEM_TOP) == 3);
+    assert(strcmp(top[0]->name, "cache007") == 0 && top[0]->kb - top[0]->start_kb == 10 * pk);
+    assert(strcmp(top[1]->name, "newcache") == 0 && top[1]->kb == 4 * pk && !top[1]->hist);
+    assert(strcmp(top[2]->name, "cache009") == 0 && top[2]->hist && top[2]->hist->count == 1);
+    assert(km.slabs[299].kb == 0);          //destroyed
+    //vmallocinfo waits for its turn
+    assert(kmem_top_callers(&km, callers, KMEM_TOP) == 0);
+    for (int i = 2; i < KMEM_VMALLOC_EVERY; i++) assert(kmem_sample(&km, i * 10000) == 0);
+    assert(km.slab_changed == 0 && km.slabs[7].hist->count == KMEM_VMALLOC_EVERY - 1);
+    assert(kmem_sample(&km, KMEM_VMALLOC_EVERY * 10000) == 0);
+    assert(kmem_top_callers(&km, callers, KMEM_TOP) == 2);
+    assert(strcmp(callers[0]->caller, "bpf_prog_alloc_no_stats") == 0);
+    assert(callers[0]->kb == 18 * pk && callers[0]->start_kb == 2 * pk);
+    assert(strcmp(callers[1]->caller, "module_alloc") == 0 && callers[1]->kb == 3 * pk);
+
+    FILE *fp = tmpfile();
+    assert(fp);
+    kmem_report(&km, fp, KMEM_TOP);
+    rewind(fp);
+    char line[512];
+    int saw_cache = 0, saw_caller = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "cache007", 8) == 0) saw_cache = 1;
+        if (strncmp(line, "module_alloc", 12) == 0) saw_caller = 1;
+    }
+    assert(saw_cache && saw_caller);
+    fclose(fp);
+
+    //the destroyed cache comes back with the very line it had
+    kmem_write_slabinfo(root, 300, grow, 1);
+    assert(kmem_sample(&km, (KMEM_VMALLOC_EVERY + 1) * 10000) == 0);
+    assert(km.nslabs == 301 && km.slabs[299].kb == 301 * pk);
+    kmem_free(&km);
+    assert(set_procfs_root("/proc") == 0);
+    assert(fixture_remove(root) == 0);
+
+    //the live kernel: meminfo always, slabinfo when root
+    assert(kmem_init(&km) == 0);
+    assert(kmem_sample(&km, current_time_ms()) == 0);
+    assert(km.fields[KMEM_SLAB] > 0);
+    if (km.have_slabinfo) assert(km.nslabs > 10);
+    kmem_free(&km);
+
+    char *args[MAX_ARGS];
+    int arg_count;
+    char cmd_line[] = "kmem -i 30 -n 10";
+    assert(parse_command(cmd_line, args, &arg_count) == CMD_KMEM);
+    assert(arg_count == 5);
+    printf("test_kmem passed!\n");
+}
+
+
+typedef struct {
+    int threshold;
+    int growth;
+    long grown_kb;
+    long latest_rss;
+} self_events_t;
+
+
+static void self_event(const memtrc_event_t *ev, void *ctx) {
+    self_events_t *se = ctx;
+    if (ev->kind == MEMTRC_THRESHOLD) {
+        __atomic_add_fetch(&se->threshold, 1, __ATOMIC_SEQ_CST);
+    } else {
+        se->grown_kb = ev->grown_kb;
+        __atomic_add_fetch(&se->growth, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+
+void test_libmemtrc(void) {
+    printf("Testing libmemtrc self monitoring...\n");
+    memtrc_sample_t s;
+    assert(memtrc_read_statm(-1, 4, &s) == -1 && errno == EINVAL);
+    assert(memtrc_self_init(NULL) == -1);
+
+    //two at once, nothing shared between them
+    memtrc_self_t a, b;
+    assert(memtrc_self_init(&a) == 0 && memtrc_self_init(&b) == 0);
+    assert(memtrc_self_latest(&a, &s) == -1);
+    assert(memtrc_self_sample(&a, &s) == 0);
+    mem_info_t info;
+    assert(read_mem_info(getpid(), &info) == 0);
+    assert(s.rss_kb > 0 && labs(s.rss_kb - info.vmrss / KB_UNIT) < 4096);
+    assert(s.vmsize_kb >= s.rss_kb && s.maxrss_kb >= s.rss_kb / 2 && s.ts_ms > 0);
+    assert(memtrc_self_sample(&b, NULL) == 0);
+    assert(a.head == 1 && b.head == 1);
+
+    //threshold above us and growth over a second, then grow by 32 MB
+    self_events_t se = { 0 };
+    memtrc_self_set_callback(&a, self_event, &se);
+    memtrc_self_set_threshold(&a, s.rss_kb + 16 * 1024);
+    memtrc_self_set_growth(&a, 16 * 1024, 1000);
+    assert(memtrc_self_start(&a, 0) == -1);
+    assert(memtrc_self_start(&a, 5) == 0);
+    assert(memtrc_self_start(&a, 5) == -1);     //already running
+    usleep(50000);
+    assert(__atomic_load_n(&se.threshold, __ATOMIC_SEQ_CST) == 0);
+    size_t len = 32UL << 20;
+    char *buf = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(buf != MAP_FAILED);
+    memset(buf, 1, len);
+    for (int i = 0; i < 200 && (__atomic_load_n(&se.threshold, __ATOMIC_SEQ_CST) == 0 ||
+                                __atomic_load_n(&se.growth, __ATOMIC_SEQ_CST) == 0); i++) {
+        usleep(10000);
+    }
+    assert(se.threshold == 1 && se.growth >= 1 && se.grown_kb >= 16 * 1024);
+    //edge triggered: staying above fires nothing more
+    usleep(50000);
+    assert(__atomic_load_n(&se.threshold, __ATOMIC_SEQ_CST) == 1);
+    munmap(buf, len);
+    memtrc_self_stop(&a);
+    assert(a.cpu_ns > 0 && a.head > 10);
+
+    memtrc_sample_t hist[MEMTRC_SELF_HISTORY];
+    size_t n = memtrc_self_history(&a, hist, MEMTRC_SELF_HISTORY);
+    assert(n == (a.head < MEMTRC_SELF_HISTORY ? a.head : MEMTRC_SELF_HISTORY));
+    for (size_t i = 1; i < n; i++) assert(hist[i].ts_ms >= hist[i - 1].ts_ms);
+    assert(memtrc_self_latest(&a, &s) == 0 && s.ts_ms == hist[n - 1].ts_ms);
+    assert(memtrc_self_history(&a, hist, 3) == 3 && hist[2].ts_ms == s.ts_ms);
+    assert(b.head == 1);
+    memtrc_self_free(&a);
+    memtrc_self_free(&b);
+    memtrc_self_free(&a);   //twice is fine
+    printf("test_libmemtrc passed!\n");
+}
+
+
+/*
+ * run a pattern in a child and trace it like `trace -l` does, every 15 ms;
+ * the child's truth rows end up in truth, its samples in the log at log_path
+ */
+static pid_t hog_traced(const hog_spec_t *spec, FILE *truth, const char *log_path) {
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        hog_result_t res;
+        _exit(hog_run(spec, truth, &res) == 0 ? 0 : 1);
+    }
+    FILE *log = fopen(log_path, "w");
+    assert(log);
+    mem_info_t info;
+    while (waitpid(pid, NULL, WNOHANG) == 0) {
+        if (read_mem_info(pid, &info) == 0) write_log_at(log, current_time_ms(), &info);
+        usleep(15000);
+    }
+    proc_type_cache_forget(pid);
+    fclose(log);
+    return pid;
+}
+
+
+static int truth_events(FILE *truth, const char *event, long *max_kb) {
+    char line[256];
+    int n = 0;
+    rewind(truth);
+    *max_kb = 0;
+    while (fgets(line, sizeof(line), truth)) {
+        long long t;
+        long kb;
+        char ev[64] = "";
+        if (line[0] == '#' || sscanf(line, "%lld,%ld,%63s", &t, &kb, ev) < 2) continue;
+        if (kb > *max_kb) *max_kb = kb;
+        if (strcmp(ev, event) == 0) n++;
+    }
+    return n;
+}
+
+
+void test_memhog(void) {
+    printf("Testing memhog workload patterns...\n");
+    hog_spec_t spec;
+    hog_result_t res;
+    assert(hog_parse_pattern("sawtooth") == HOG_SAWTOOTH && hog_parse_pattern("gc") == -1);
+    assert(strcmp(hog_pattern_name(HOG_HUGE), "huge") == 0);
+
+    //the shapes on their own
+    hog_default_spec(&spec, HOG_LEAK);
+    spec.size_kb = 1000 * 1024;
+    spec.duration_ms = 1000;
+    assert(hog_expected_kb(&spec, 0) == 0 && hog_expected_kb(&spec, 500) == 500 * 1024);
+    assert(hog_expected_kb(&spec, 5000) == spec.size_kb);
+    spec.pattern = HOG_SAWTOOTH;
+    spec.period_ms = 400;
+    assert(hog_expected_kb(&spec, 200) == 500 * 1024 && hog_expected_kb(&spec, 400) == 0);
+    spec.pattern = HOG_SPIKE;
+    spec.period_ms = 100;
+    assert(hog_expected_kb(&spec, 332) == 0 && hog_expected_kb(&spec, 333) == spec.size_kb);
+    assert(hog_expected_kb(&spec, 433) == 0);
+    spec.pattern = HOG_CHURN;
+    assert(hog_expected_kb(&spec, 500) == 0);
+    spec.rate = 0;
+    assert(hog_run(&spec, NULL, &res) == -1);
+
+    char log_path[] = "/tmp/memtrc_test_hog_XXXXXX";
+    int fd = mkstemp(log_path);
+    assert(fd >= 0);
+    close(fd);
+    log_data_t data;
+    series_stats_t st;
+    long max_kb;
+
+    //a linear leak: the slope analyze reports is the rate that was leaked
+    FILE *truth = tmpfile();
+    assert(truth);
+    hog_default_spec(&spec, HOG_LEAK);
+    spec.size_kb = 24 * 1024;
+    spec.duration_ms = 800;
+    hog_traced(&spec, truth, log_path);
+    assert(truth_events(truth, "end", &max_kb) == 1 && max_kb == spec.size_kb);
+    assert(load_log_file(log_path, 1, &data) == 0);
+    assert(compute_series_stats(&data, LOG_FIELD_RSS, &st) == 0 && st.samples > 20);
+    double rate = (double)spec.size_kb * KB_UNIT / (spec.duration_ms / 1000.0);
+    assert(st.growth_per_sec > rate * 0.7 && st.growth_per_sec < rate * 1.3);
+    assert(st.peak - st.min > max_kb * KB_UNIT * 8 / 10);
+    free_log_data(&data);
+    fclose(truth);
+
+    //sawtooth: every drop in the truth is a drop in the measured curve
+    truth = tmpfile();
+    assert(truth);
+    hog_default_spec(&spec, HOG_SAWTOOTH);
+    spec.size_kb = 16 * 1024;
+    spec.duration_ms = 900;
+    spec.period_ms = 300;
+    hog_traced(&spec, truth, log_path);
+    int drops = truth_events(truth, "drop", &max_kb);
+    assert(drops == 3);
+    assert(load_log_file(log_path, 1, &data) == 0);
+    int measured = 0;
+    for (size_t i = 1; i < data.count; i++) {
+        if (data.records[i - 1].vmrss - data.records[i].vmrss > max_kb * KB_UNIT / 2) measured++;
+    }
+    //the last drop is the child's exit, after the final sample
+    assert(measured >= drops - 1 && measured <= drops);
+    free_log_data(&data);
+    fclose(truth);
+
+    //stack growth shows in VmStk
+    truth = tmpfile();
+    assert(truth);
+    hog_default_spec(&spec, HOG_STACK);
+    spec.size_kb = 2048;
+    spec.duration_ms = 400;
+    hog_traced(&spec, truth, log_path);
+    assert(truth_events(truth, "end", &max_kb) == 1 && max_kb == 2048);
+    FILE *lf = fopen(log_path, "r");
+    assert(lf);
+    char line[512];
+    long stk_min = LONG_MAX, stk_max = 0;
+    while (fgets(line, sizeof(line), lf)) {
+        char *p = strstr(line, "Stack: ");
+        if (!p) continue;
+        long v = strtol(p + 7, NULL, 10);
+        if (v < stk_min) stk_min = v;
+        if (v > stk_max) stk_max = v;
+    }
+    fclose(lf);
+    assert(stk_max - stk_min > max_kb * KB_UNIT * 8 / 10 && stk_max - stk_min < max_kb * KB_UNIT * 13 / 10);
+    fclose(truth);
+    unlink(log_path);
+
+    //churn in process: the pairs are done and nothing stays behind
+    hog_default_spec(&spec, HOG_CHURN);
+    spec.duration_ms = 200;
+    spec.rate = 500;
+    assert(hog_run(&spec, NULL, &res) == 0);
+    assert(res.events >= 90 && res.events <= 110 && res.peak_kb == 0 && res.steps >= 10);
+
+    //a spike over the threshold fires it, once: the threshold is edge triggered
+    memtrc_self_t ms;
+    memtrc_sample_t s;
+    self_events_t se = { 0 };
+    assert(memtrc_self_init(&ms) == 0 && memtrc_self_sample(&ms, &s) == 0);
+    memtrc_self_set_callback(&ms, self_event, &se);
+    memtrc_self_set_threshold(&ms, s.rss_kb + 16 * 1024);
+    assert(memtrc_self_start(&ms, 5) == 0);
+    hog_default_spec(&spec, HOG_SPIKE);
+    spec.size_kb = 32 * 1024;
+    spec.duration_ms = 600;
+    spec.period_ms = 200;
+    assert(__atomic_load_n(&se.threshold, __ATOMIC_SEQ_CST) == 0);
+    assert(hog_run(&spec, NULL, &res) == 0);
+    assert(res.events == 1 && res.peak_kb == spec.size_kb);
+    memtrc_self_stop(&ms);
+    assert(__atomic_load_n(&se.threshold, __ATOMIC_SEQ_CST) == 1);
+    memtrc_self_free(&ms);
+    printf("test_memhog passed!\n");
+}
+
+
+static int pair_key(const void *item, const void *ctx, double key[2]) {
+    const long *p = item;
+    (void)ctx;
+    key[0] = (double)p[0];
+    key[1] = (double)p[1];
+    return p[0] >= 0;
+}
+
+
+void test_topn(void) {
+    printf("Testing top-n selection...\n");
+    long items[200][2];
+    const void *out[100];
+    for (int i = 0; i < 200; i++) {
+        items[i][0] = i % 3 == 0 ? -1 : i / 10;     //every third left out
+        items[i][1] = i % 2;
+    }
+    assert(topn_select(items, 200, sizeof(items[0]), pair_key, NULL, out, 0) == 0);
+    //ties on the key go to the larger tie break, then to table order
+    assert(topn_select(items, 200, sizeof(items[0]), pair_key, NULL, out, 3) == 3);
+    assert(out[0] == items[191] && out[1] == items[193] && out[2] == items[197]);
+    //more than the stack keeps, the rest of the order holds as well
+    int kept = 0;
+    for (int i = 0; i < 200; i++) kept += items[i][0] >= 0;
+    assert(topn_select(items, 200, sizeof(items[0]), pair_key, NULL, out, 100) == 100 && kept > 100);
+    for (int i = 1; i < 100; i++) {
+        const long *a = out[i - 1], *b = out[i];
+        assert(a[0] > b[0] || (a[0] == b[0] && (a[1] > b[1] || (a[1] == b[1] && a < b))));
+    }
+    printf("test_topn passed!\n");
+}
+
+
 int main(int argc, char *argv[]) {
-    (void)argc;
-    (void)argv;
+    if (argc > 1 && strcmp(argv[1], "--alloc-child") == 0) {
+        return alloc_child();
+    }
+    if (argc > 1 && strcmp(argv[1], "--run-child") == 0) {
+        return run_child();
+    }
     
     printf("\n====== Running MemTrace Tests ======\n\n");
     
@@ -348,6 +2498,30 @@ int main(int argc, char *argv[]) {
     test_parse_command();
     test_write_log();
     test_signal_handler();
+    test_analyze_log();
+    test_codec();
+    test_selfstat();
+    test_procfs_root();
+    test_process_type();
+    test_sampler();
+    test_adaptive();
+    test_recorder();
+    test_retention();
+    test_sketch();
+    test_pressure();
+    test_allocprof();
+    test_run();
+    test_faultprof();
+    test_colstore();
+    test_sink();
+    test_procwatch();
+    test_leader();
+    test_numa();
+    test_group();
+    test_kmem();
+    test_libmemtrc();
+    test_memhog();
+    test_topn();
     
     teardown();
     cleanup_tests();
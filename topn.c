@@ -0,0 +1,50 @@
+/**
+ * @Author: wizard jack
+ * @Date: 2025-8-12 20:17:03
+ * @Last modified: 2025-8-12 20:17:03
+ * @Description: partial top-n selection. n is small next to the tables it
+ *               runs over, so insertion into a sorted window beats a sort.
+ */
+
+#include "include/memtrc.h"
+#include "include/topn.h"
+
+
+/*
+ * the n items of the count in items (size bytes apart) with the largest keys
+ * into out, best first; equal keys keep table order. returns how many were
+ * put in out.
+ */
+int topn_select(const void *items, size_t count, size_t size, topn_key_t key,
+                const void *ctx, const void **out, int n) {
+    if (!items || !key || !out || n <= 0) return 0;
+    double stack_keys[TOPN_STACK][2];
+    double (*keys)[2] = n <= TOPN_STACK ? stack_keys : malloc(n * sizeof(keys[0]));
+    if (!keys) {
+        fprintf(stderr, "Error: out of memory selecting the top %d\n", n);
+        return 0;
+    }
+    int found = 0;
+    for (size_t i = 0; i < count; i++) {
+        const void *item = (const char *)items + i * size;
+        double k[2];
+        if (!key(item, ctx, k)) continue;
+        int pos = found < n ? found++ : n;
+        while (pos > 0 && (keys[pos - 1][0] < k[0] ||
+                           (keys[pos - 1][0] == k[0] && keys[pos - 1][1] < k[1]))) {
+            if (pos < n) {
+                keys[pos][0] = keys[pos - 1][0];
+                keys[pos][1] = keys[pos - 1][1];
+                out[pos] = out[pos - 1];
+            }
+            pos--;
+        }
+        if (pos < n) {
+            keys[pos][0] = k[0];
+            keys[pos][1] = k[1];
+            out[pos] = item;
+        }
+    }
+    if (keys != stack_keys) free(keys);
+    return found;
+}